@@ -100,6 +100,11 @@
 #include <time.h>
 #include <fcntl.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define TELETONE_GOERTZEL_SSE2 1
+#endif
+
 #define LOW_ENG 10000000
 #define ZC 2
 static teletone_detection_descriptor_t dtmf_detect_row[GRID_FACTOR];
@@ -134,6 +139,124 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 #pragma warning(disable:4244)
 #endif
 
+/*
+  Goertzel filter bank.
+
+  Every filter in a detector sees the same samples, so instead of stepping each
+  state in turn we gather the states into lanes and step them side by side.
+  The recurrence is evaluated exactly like the scalar code (fac is a double, so
+  the math is done in double and rounded back to float after every sample, with
+  separate multiply/subtract/add and no fused ops) which keeps the results, and
+  therefore every detection decision, bit for bit identical.
+*/
+
+#define GOERTZEL_BANK_STRIDE 8
+#define GOERTZEL_BANK_MAX_LANES (((TELETONE_MAX_TONES * 2) + GOERTZEL_BANK_STRIDE - 1) / GOERTZEL_BANK_STRIDE * GOERTZEL_BANK_STRIDE)
+
+typedef struct {
+	double v2[GOERTZEL_BANK_MAX_LANES];
+	double v3[GOERTZEL_BANK_MAX_LANES];
+	double fac[GOERTZEL_BANK_MAX_LANES];
+} goertzel_bank_t;
+
+#ifdef TELETONE_GOERTZEL_SSE2
+static int goertzel_bank_simd = 1;
+#else
+static int goertzel_bank_simd = 0;
+#endif
+
+TELETONE_API(int) teletone_detect_simd(int enable)
+{
+#ifdef TELETONE_GOERTZEL_SSE2
+	if (enable > -1) {
+		goertzel_bank_simd = !!enable;
+	}
+#endif
+	return goertzel_bank_simd;
+}
+
+#ifdef TELETONE_GOERTZEL_SSE2
+#define GOERTZEL_BANK_STEP(_v1, _v2, _v3, _fac, _famp)					\
+	_v1 = _v2;															\
+	_v2 = _v3;															\
+	_v3 = _mm_cvtps_pd(_mm_cvtpd_ps(_mm_add_pd(_mm_sub_pd(_mm_mul_pd(_fac, _v2), _v1), _famp)))
+
+static void goertzel_bank_run(goertzel_bank_t *bank, int lanes, int16_t sample_buffer[], int samples)
+{
+	int x, j;
+
+	for (x = 0; x < lanes; x += GOERTZEL_BANK_STRIDE) {
+		__m128d fa = _mm_loadu_pd(&bank->fac[x]), fb = _mm_loadu_pd(&bank->fac[x + 2]);
+		__m128d fc = _mm_loadu_pd(&bank->fac[x + 4]), fd = _mm_loadu_pd(&bank->fac[x + 6]);
+		__m128d v2a = _mm_loadu_pd(&bank->v2[x]), v2b = _mm_loadu_pd(&bank->v2[x + 2]);
+		__m128d v2c = _mm_loadu_pd(&bank->v2[x + 4]), v2d = _mm_loadu_pd(&bank->v2[x + 6]);
+		__m128d v3a = _mm_loadu_pd(&bank->v3[x]), v3b = _mm_loadu_pd(&bank->v3[x + 2]);
+		__m128d v3c = _mm_loadu_pd(&bank->v3[x + 4]), v3d = _mm_loadu_pd(&bank->v3[x + 6]);
+		__m128d v1, famp;
+
+		for (j = 0; j < samples; j++) {
+			famp = _mm_set1_pd((double) sample_buffer[j]);
+			GOERTZEL_BANK_STEP(v1, v2a, v3a, fa, famp);
+			GOERTZEL_BANK_STEP(v1, v2b, v3b, fb, famp);
+			GOERTZEL_BANK_STEP(v1, v2c, v3c, fc, famp);
+			GOERTZEL_BANK_STEP(v1, v2d, v3d, fd, famp);
+		}
+
+		_mm_storeu_pd(&bank->v2[x], v2a);
+		_mm_storeu_pd(&bank->v2[x + 2], v2b);
+		_mm_storeu_pd(&bank->v2[x + 4], v2c);
+		_mm_storeu_pd(&bank->v2[x + 6], v2d);
+		_mm_storeu_pd(&bank->v3[x], v3a);
+		_mm_storeu_pd(&bank->v3[x + 2], v3b);
+		_mm_storeu_pd(&bank->v3[x + 4], v3c);
+		_mm_storeu_pd(&bank->v3[x + 6], v3d);
+	}
+}
+#endif
+
+static void goertzel_bank_update(teletone_goertzel_state_t *gs[], int count, int16_t sample_buffer[], int samples)
+{
+	int x, j;
+	float v1, famp;
+
+	if (samples <= 0) {
+		return;
+	}
+
+#ifdef TELETONE_GOERTZEL_SSE2
+	if (goertzel_bank_simd) {
+		goertzel_bank_t bank;
+		int lanes = (count + GOERTZEL_BANK_STRIDE - 1) / GOERTZEL_BANK_STRIDE * GOERTZEL_BANK_STRIDE;
+
+		for (x = 0; x < count; x++) {
+			bank.v2[x] = gs[x]->v2;
+			bank.v3[x] = gs[x]->v3;
+			bank.fac[x] = gs[x]->fac;
+		}
+		for (; x < lanes; x++) {
+			bank.v2[x] = bank.v3[x] = bank.fac[x] = 0.0;
+		}
+
+		goertzel_bank_run(&bank, lanes, sample_buffer, samples);
+
+		for (x = 0; x < count; x++) {
+			gs[x]->v2 = (float) bank.v2[x];
+			gs[x]->v3 = (float) bank.v3[x];
+		}
+		return;
+	}
+#endif
+
+	for (j = 0; j < samples; j++) {
+		famp = sample_buffer[j];
+		for (x = 0; x < count; x++) {
+			v1 = gs[x]->v2;
+			gs[x]->v2 = gs[x]->v3;
+			gs[x]->v3 = (float)(gs[x]->fac * gs[x]->v2 - v1 + famp);
+		}
+	}
+}
+
 #define teletone_goertzel_result(gs) (double)(((gs)->v3 * (gs)->v3 + (gs)->v2 * (gs)->v2 - (gs)->v2 * (gs)->v3 * (gs)->fac))
 
 TELETONE_API(void) teletone_dtmf_detect_init (teletone_dtmf_detect_state_t *dtmf_detect_state, int sample_rate)
@@ -219,9 +342,16 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 								int samples)
 {
 	int sample, limit = 0, j, x = 0;
-	float v1, famp;
+	float famp;
 	float eng_sum = 0, eng_all[TELETONE_MAX_TONES] = {0.0};
 	int gtest = 0, see_hit = 0;
+	teletone_goertzel_state_t *gs[TELETONE_MAX_TONES * 2];
+	int count = 0;
+
+	for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
+		gs[count++] = &mt->gs[x];
+		gs[count++] = &mt->gs2[x];
+	}
 
 	for (sample = 0;  sample >= 0 && sample < samples; sample = limit) {
 		mt->total_samples++;
@@ -239,18 +369,10 @@ TELETONE_API(int) teletone_multi_tone_detect (teletone_multi_tone_t *mt,
 			famp = sample_buffer[j];
 			
 			mt->energy += famp*famp;
-
-			for(x = 0; x < TELETONE_MAX_TONES && x < mt->tone_count; x++) {
-				v1 = mt->gs[x].v2;
-				mt->gs[x].v2 = mt->gs[x].v3;
-				mt->gs[x].v3 = (float)(mt->gs[x].fac * mt->gs[x].v2 - v1 + famp);
-	
-				v1 = mt->gs2[x].v2;
-				mt->gs2[x].v2 = mt->gs2[x].v3;
-				mt->gs2[x].v3 = (float)(mt->gs2[x].fac*mt->gs2[x].v2 - v1 + famp);
-			}
 		}
 
+		goertzel_bank_update(gs, count, sample_buffer + sample, limit - sample);
+
 		mt->current_sample += (limit - sample);
 		if (mt->current_sample < mt->min_samples) {
 			continue;
@@ -311,7 +433,6 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 	float row_energy[GRID_FACTOR];
 	float col_energy[GRID_FACTOR];
 	float famp;
-	float v1;
 	int i;
 	int j;
 	int sample;
@@ -320,6 +441,14 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 	char hit = 0;
 	int limit;
 	teletone_hit_type_t r = 0;
+	teletone_goertzel_state_t *gs[GRID_FACTOR * 4];
+
+	for (i = 0; i < GRID_FACTOR; i++) {
+		gs[i] = &dtmf_detect_state->row_out[i];
+		gs[i + GRID_FACTOR] = &dtmf_detect_state->col_out[i];
+		gs[i + GRID_FACTOR * 2] = &dtmf_detect_state->col_out2nd[i];
+		gs[i + GRID_FACTOR * 3] = &dtmf_detect_state->row_out2nd[i];
+	}
 
 	for (sample = 0;  sample < samples;	 sample = limit) {
 		/* BLOCK_LEN is optimised to meet the DTMF specs. */
@@ -330,31 +459,13 @@ TELETONE_API(teletone_hit_type_t) teletone_dtmf_detect (teletone_dtmf_detect_sta
 		}
 
 		for (j = sample;  j < limit;  j++) {
-			int x = 0;
 			famp = sample_buffer[j];
 			
 			dtmf_detect_state->energy += famp*famp;
-
-			for(x = 0; x < GRID_FACTOR; x++) {
-				v1 = dtmf_detect_state->row_out[x].v2;
-				dtmf_detect_state->row_out[x].v2 = dtmf_detect_state->row_out[x].v3;
-				dtmf_detect_state->row_out[x].v3 = (float)(dtmf_detect_state->row_out[x].fac*dtmf_detect_state->row_out[x].v2 - v1 + famp);
-	
-				v1 = dtmf_detect_state->col_out[x].v2;
-				dtmf_detect_state->col_out[x].v2 = dtmf_detect_state->col_out[x].v3;
-				dtmf_detect_state->col_out[x].v3 = (float)(dtmf_detect_state->col_out[x].fac*dtmf_detect_state->col_out[x].v2 - v1 + famp);
-
-				v1 = dtmf_detect_state->col_out2nd[x].v2;
-				dtmf_detect_state->col_out2nd[x].v2 = dtmf_detect_state->col_out2nd[x].v3;
-				dtmf_detect_state->col_out2nd[x].v3 = (float)(dtmf_detect_state->col_out2nd[x].fac*dtmf_detect_state->col_out2nd[x].v2 - v1 + famp);
-		
-				v1 = dtmf_detect_state->row_out2nd[x].v2;
-				dtmf_detect_state->row_out2nd[x].v2 = dtmf_detect_state->row_out2nd[x].v3;
-				dtmf_detect_state->row_out2nd[x].v3 = (float)(dtmf_detect_state->row_out2nd[x].fac*dtmf_detect_state->row_out2nd[x].v2 - v1 + famp);
-			}
-
 		}
 
+		goertzel_bank_update(gs, GRID_FACTOR * 4, sample_buffer + sample, limit - sample);
+
 		if (dtmf_detect_state->zc > 0) {
 			if (dtmf_detect_state->energy < LOW_ENG && dtmf_detect_state->lenergy < LOW_ENG) {
 				if (!--dtmf_detect_state->zc) {
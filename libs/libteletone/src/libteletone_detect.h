@@ -262,6 +262,14 @@ TELETONE_API(void) teletone_goertzel_update(teletone_goertzel_state_t *goertzel_
 								  int16_t sample_buffer[],
 								  int samples);
 
+	/*! 
+	  \brief Select the vectorized Goertzel filter bank used by the detectors
+	  \param enable 1 to use it, 0 to fall back to the scalar filters, -1 to only query
+	  \return true when the vectorized filter bank is in use
+	  \note both paths produce identical results, this exists for testing and benchmarking
+	*/
+TELETONE_API(int) teletone_detect_simd(int enable);
+
 
 
 #ifdef __cplusplus
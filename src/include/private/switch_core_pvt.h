@@ -294,7 +294,7 @@ extern struct switch_runtime runtime;
 
 struct switch_session_manager {
 	switch_memory_pool_t *memory_pool;
-	switch_hash_t *session_table;
+	switch_concurrent_hash_t *session_table;
 	uint32_t session_count;
 	uint32_t session_limit;
 	switch_size_t session_id;
@@ -315,6 +315,10 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 void switch_core_sqldb_stop(void);
 void switch_core_session_init(switch_memory_pool_t *pool);
 void switch_core_session_uninit(void);
+void switch_core_file_init(switch_memory_pool_t *pool);
+void switch_core_file_uninit(void);
 void switch_core_state_machine_init(switch_memory_pool_t *pool);
+void switch_core_regex_init(void);
+void switch_core_regex_destroy(void);
 switch_memory_pool_t *switch_core_memory_init(void);
 void switch_core_memory_stop(void);
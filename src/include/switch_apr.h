@@ -837,6 +837,14 @@ SWITCH_DECLARE(switch_status_t) switch_file_remove(const char *path, switch_memo
 
 SWITCH_DECLARE(switch_status_t) switch_file_rename(const char *from_path, const char *to_path, switch_memory_pool_t *pool);
 
+/**
+ * Set the modification time of the specified file.
+ * @param fname The full path to the file (using / on all systems)
+ * @param mtime The new modification time
+ * @param pool The pool to use.
+ */
+SWITCH_DECLARE(switch_status_t) switch_file_mtime_set(const char *fname, switch_time_t mtime, switch_memory_pool_t *pool);
+
 /**
  * Read data from the specified file.
  * @param thefile The file descriptor to read from.
@@ -1176,6 +1184,20 @@ SWITCH_DECLARE(switch_status_t) switch_socket_send(switch_socket_t *sock, const
 SWITCH_DECLARE(switch_status_t) switch_socket_sendto(switch_socket_t *sock, switch_sockaddr_t *where, int32_t flags, const char *buf,
 													 switch_size_t *len);
 
+/**
+ * Send several datagrams to the same address, in as few system calls as the platform allows
+ * @param sock The socket to send from
+ * @param where The fspr_sockaddr_t describing where to send the data
+ * @param flags The flags to use
+ * @param bufs The datagrams to send
+ * @param lens The length of each datagram
+ * @param count The number of datagrams
+ * @param sent Optional, set to the number of datagrams handed to the kernel
+ * @remark On error the datagrams before *sent have been sent and the rest have not.
+ */
+SWITCH_DECLARE(switch_status_t) switch_socket_sendto_batch(switch_socket_t *sock, switch_sockaddr_t *where, int32_t flags, const char * const *bufs,
+														   const switch_size_t *lens, uint32_t count, uint32_t *sent);
+
 SWITCH_DECLARE(switch_status_t) switch_socket_send_nonblock(switch_socket_t *sock, const char *buf, switch_size_t *len);
 
 /**
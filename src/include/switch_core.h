@@ -1326,6 +1326,25 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_read_frame(_In_ switch_core_
 SWITCH_DECLARE(switch_bool_t) switch_core_session_transcoding(switch_core_session_t *session_a, switch_core_session_t *session_b, switch_media_type_t type);
 SWITCH_DECLARE(void) switch_core_session_passthru(switch_core_session_t *session, switch_media_type_t type, switch_bool_t on);
 
+/*!
+  \brief Forward the RTP a session receives straight out of its bridge peer from the shared relay workers
+  \param session the session whose inbound packets are relayed
+  \param peer_session the session they are sent from, ignored when turning the relay off
+  \param type the media type
+  \param on SWITCH_TRUE to start relaying, SWITCH_FALSE to stop relaying from and to session
+  \return SWITCH_STATUS_SUCCESS while relaying (or once stopped), SWITCH_STATUS_FALSE if the media cannot be relayed
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_session_relay(switch_core_session_t *session, switch_core_session_t *peer_session,
+														  switch_media_type_t type, switch_bool_t on);
+
+/*!
+  \brief Test if the packets a session receives are being relayed, its reads return CNG meanwhile
+  \param session the session
+  \param type the media type
+  \return SWITCH_TRUE while relaying
+*/
+SWITCH_DECLARE(switch_bool_t) switch_core_session_relaying(switch_core_session_t *session, switch_media_type_t type);
+
 /*!
   \brief Read a video frame from a session
   \param session the session to read from
@@ -1623,6 +1642,78 @@ SWITCH_DECLARE(switch_status_t) switch_core_inthash_insert(switch_inthash_t *has
 SWITCH_DECLARE(void *) switch_core_inthash_delete(switch_inthash_t *hash, uint32_t key);
 SWITCH_DECLARE(void *) switch_core_inthash_find(switch_inthash_t *hash, uint32_t key);
 
+/*!
+  \brief Initialize a hash table that is safe to use from many threads without an external lock
+  \param hash a NULL pointer to a hash table to aim at the new hash
+  \param stripes the number of independently locked stripes (rounded up to a power of 2, 0 for the default)
+  \param case_sensitive SWITCH_FALSE to compare keys without regard to case
+  \return SWITCH_STATUS_SUCCESS if the hash is created
+  \note keys are spread over the stripes so readers and writers only contend when they touch the same stripe
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_hash_init_concurrent(_Out_ switch_concurrent_hash_t **hash, uint32_t stripes, switch_bool_t case_sensitive);
+
+/*!
+  \brief Destroy a concurrent hash table, the values are not freed
+  \param hash the hash to destroy
+  \return SWITCH_STATUS_SUCCESS if the hash is destroyed
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_concurrent_hash_destroy(_Inout_ switch_concurrent_hash_t **hash);
+
+/*!
+  \brief Insert data into a concurrent hash, replacing any previous value for the key
+  \param hash the hash to add data to
+  \param key the name of the key to add the data to
+  \param data the data to add
+  \return SWITCH_STATUS_SUCCESS if the data is added
+*/
+SWITCH_DECLARE(switch_status_t) switch_core_concurrent_hash_insert(_In_ switch_concurrent_hash_t *hash, _In_z_ const char *key, _In_opt_ const void *data);
+
+/*!
+  \brief Delete data from a concurrent hash
+  \param hash the hash to delete from
+  \param key the key to delete
+  \return the value that was removed, or NULL
+*/
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_delete(_In_ switch_concurrent_hash_t *hash, _In_z_ const char *key);
+
+/*!
+  \brief Retrieve data from a concurrent hash
+  \param hash the hash to retrieve from
+  \param key the key to retrieve
+  \return a pointer to the data held in the key
+  \note the value may be removed by another thread as soon as this returns, use switch_core_concurrent_hash_find_callback to pin it
+*/
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_find(_In_ switch_concurrent_hash_t *hash, _In_z_ const char *key);
+
+/*!
+  \brief Retrieve data from a concurrent hash and run a callback on it while the entry is guaranteed to stay in the hash
+  \param hash the hash to retrieve from
+  \param key the key to retrieve
+  \param callback called with the value under the stripe read lock, return SWITCH_FALSE to reject the value
+  \param pData user data passed to the callback
+  \return the value if it was found and accepted by the callback, otherwise NULL
+  \note the callback must not modify the hash
+*/
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_find_callback(_In_ switch_concurrent_hash_t *hash, _In_z_ const char *key,
+																 _In_ switch_hash_walk_callback_t callback, _In_opt_ void *pData);
+
+/*!
+  \brief Call a function for every entry of a concurrent hash, one stripe at a time
+  \param hash the hash to walk
+  \param callback called with each key and value under the stripe read lock, return SWITCH_FALSE to stop the walk
+  \param pData user data passed to the callback
+  \return the number of entries visited
+  \note the callback must not modify the hash
+*/
+SWITCH_DECLARE(uint32_t) switch_core_concurrent_hash_walk(_In_ switch_concurrent_hash_t *hash, _In_ switch_hash_walk_callback_t callback, _In_opt_ void *pData);
+
+/*!
+  \brief Count the entries of a concurrent hash
+  \param hash the hash to count
+  \return the number of entries
+*/
+SWITCH_DECLARE(uint32_t) switch_core_concurrent_hash_count(_In_ switch_concurrent_hash_t *hash);
+
 ///\}
 
 ///\defgroup timer Timer Functions
@@ -2048,6 +2139,25 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 SWITCH_DECLARE(switch_status_t) switch_core_file_truncate(switch_file_handle_t *fh, int64_t offset);
 SWITCH_DECLARE(switch_bool_t) switch_core_file_has_video(switch_file_handle_t *fh, switch_bool_t CHECK_OPEN);
 
+/*!
+  \brief Set the memory budget of the decoded prompt cache
+  \param max_bytes total bytes of decoded audio to keep (0 disables the cache)
+  \param max_entry_bytes largest single prompt to cache (0 leaves it unchanged)
+*/
+SWITCH_DECLARE(void) switch_core_file_cache_set_limit(switch_size_t max_bytes, switch_size_t max_entry_bytes);
+
+/*!
+  \brief Drop every unreferenced entry from the decoded prompt cache
+  \return the number of entries dropped
+*/
+SWITCH_DECLARE(uint32_t) switch_core_file_cache_flush(void);
+
+/*!
+  \brief Report the decoded prompt cache counters
+  \return a cJSON object the caller must free
+*/
+SWITCH_DECLARE(cJSON *) switch_core_file_cache_stats(void);
+
 
 ///\}
 
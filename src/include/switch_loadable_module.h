@@ -322,6 +322,12 @@ SWITCH_DECLARE(switch_status_t) switch_json_api_execute(cJSON *json, switch_core
 */
 SWITCH_DECLARE(switch_status_t) switch_loadable_module_load_module(const char *dir, const char *fname, switch_bool_t runtime, const char **err);
 
+/*!
+  \brief Report how long each module took to load at startup
+  \return a json object with the total and one entry per module, free with cJSON_Delete
+*/
+SWITCH_DECLARE(cJSON *) switch_loadable_module_load_timeline(void);
+
 /*!
   \brief Check if a module is loaded
   \param mod the module name
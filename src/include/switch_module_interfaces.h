@@ -384,6 +384,8 @@ struct switch_file_handle {
 	int64_t vpos;
 	void *muxbuf;
 	switch_size_t muxlen;
+	/*! decoded prompt cache cursor, owned by the core */
+	void *cache_info;
 };
 
 /*! \brief Abstract interface to an asr module */
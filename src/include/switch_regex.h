@@ -76,6 +76,34 @@ SWITCH_DECLARE(void) switch_capture_regex(switch_regex_t *re, int match_count, c
 SWITCH_DECLARE_NONSTD(void) switch_regex_set_var_callback(const char *var, const char *val, void *user_data);
 SWITCH_DECLARE_NONSTD(void) switch_regex_set_event_header_callback(const char *var, const char *val, void *user_data);
 
+typedef struct {
+	uint32_t entries;
+	uint32_t max_entries;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	switch_size_t bytes;
+	switch_bool_t jit;
+} switch_regex_cache_stats_t;
+
+/*!
+ \brief Set the maximum number of compiled patterns kept by the regex cache (0 disables caching)
+ \param max The new limit, least recently used patterns beyond it are evicted
+*/
+SWITCH_DECLARE(void) switch_regex_cache_set_size(uint32_t max);
+
+/*!
+ \brief Drop every pattern from the regex cache
+ \return The number of patterns evicted
+*/
+SWITCH_DECLARE(uint32_t) switch_regex_cache_flush(void);
+
+/*!
+ \brief Get the regex cache counters
+ \param stats The structure to fill
+*/
+SWITCH_DECLARE(void) switch_regex_cache_get_stats(switch_regex_cache_stats_t *stats);
+
 #define switch_regex_safe_free(re)	if (re) {\
 				switch_regex_free(re);\
 				re = NULL;\
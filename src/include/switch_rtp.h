@@ -308,6 +308,13 @@ SWITCH_DECLARE(void) switch_rtp_kill_socket(switch_rtp_t *rtp_session);
 SWITCH_DECLARE(void) switch_rtp_break(switch_rtp_t *rtp_session);
 SWITCH_DECLARE(void) switch_rtp_flush(switch_rtp_t *rtp_session);
 
+/*!
+  \brief Send any packets of a locally packetized video frame still held for a batched send
+  \param rtp_session the RTP session to flush
+  \return SWITCH_STATUS_SUCCESS when nothing was pending or every packet was sent
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_flush_send_batch(switch_rtp_t *rtp_session);
+
 /*!
   \brief Test if an RTP session is ready
   \param rtp_session an RTP session to test
@@ -593,6 +600,82 @@ SWITCH_DECLARE(dtls_state_t) switch_rtp_dtls_state(switch_rtp_t *rtp_session, dt
 
 SWITCH_DECLARE(int) switch_rtp_has_dtls(void);
 
+#define SWITCH_RTP_DTLS_HIST_BUCKETS 8
+
+/*! \brief DTLS handshake counters, latency is measured from the first handshake packet to SRTP keys installed */
+typedef struct {
+	uint32_t workers;
+	uint32_t cached_sessions;
+	uint64_t handshakes;
+	uint64_t failures;
+	uint64_t resumed;
+	uint64_t verify_cache_hits;
+	uint64_t offloaded;
+	uint64_t total_usec;
+	uint64_t max_usec;
+	uint32_t hist_bound_ms[SWITCH_RTP_DTLS_HIST_BUCKETS];
+	uint64_t hist[SWITCH_RTP_DTLS_HIST_BUCKETS];
+} switch_rtp_dtls_stats_t;
+
+/*!
+  \brief Set the number of threads running DTLS handshakes off the media path, must be called before switch_rtp_init
+  \param workers thread count, 0 runs handshakes inline in the read thread, -1 picks one per 4 cpus
+*/
+SWITCH_DECLARE(void) switch_rtp_set_dtls_workers(int workers);
+
+/*!
+  \brief Run ICE connectivity checks and keepalives from the shared ICE agent thread instead of the media read loop, must be called before switch_rtp_init
+  \param enabled SWITCH_FALSE to send them inline as sessions are read
+*/
+SWITCH_DECLARE(void) switch_rtp_set_ice_agent(switch_bool_t enabled);
+
+/*!
+  \brief Forward the RTP arriving on one session out of another from the shared relay workers, without decoding it or waking either session's read thread
+  \param rtp_session the session packets arrive on
+  \param peer_session the session they are sent from, it stamps its own SSRC/seq/ts and SRTP
+  \return SWITCH_STATUS_SUCCESS once relaying, SWITCH_STATUS_FALSE if either session cannot be relayed (ICE, DTLS, video, proxy media ...)
+  \note while relaying, reads on rtp_session return CNG at the packet rate; RFC2833 on it ends the relay so the digits take the normal path
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *rtp_session, switch_rtp_t *peer_session);
+
+/*!
+  \brief Stop relaying packets from a session and to it
+  \param rtp_session the session
+*/
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session);
+
+/*!
+  \brief Test if a relay worker is forwarding the packets arriving on a session
+  \param rtp_session the session
+  \return SWITCH_TRUE while relaying
+*/
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relaying(switch_rtp_t *rtp_session);
+
+/*!
+  \brief Retrieve the DTLS handshake counters
+  \param stats the struct to fill in
+  \param reset clear the counters after reading them
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_get_dtls_stats(switch_rtp_dtls_stats_t *stats, switch_bool_t reset);
+
+/*!
+  \brief Set how often the inbound quality of the active audio sessions is sampled into the telemetry histograms, must be called before switch_rtp_init
+  \param seconds the sample interval, 0 to only sample on demand
+*/
+SWITCH_DECLARE(void) switch_rtp_set_telemetry_interval(uint32_t seconds);
+
+/*!
+  \brief Sample every active audio session into the telemetry histograms now
+*/
+SWITCH_DECLARE(void) switch_rtp_telemetry_sample(void);
+
+/*!
+  \brief Write the per gateway/profile jitter, loss, MOS and RTT histograms in Prometheus text format
+  \param stream the stream to write to
+  \param reset clear the histograms after writing them
+*/
+SWITCH_DECLARE(switch_status_t) switch_rtp_telemetry_write(switch_stream_handle_t *stream, switch_bool_t reset);
+
 SWITCH_DECLARE(switch_status_t) switch_rtp_req_bitrate(switch_rtp_t *rtp_session, uint32_t bps);
 SWITCH_DECLARE(switch_status_t) switch_rtp_ack_bitrate(switch_rtp_t *rtp_session, uint32_t bps);
 SWITCH_DECLARE(void) switch_rtp_video_refresh(switch_rtp_t *rtp_session);
@@ -1962,10 +1962,34 @@ typedef enum {
 	SWITCH_FILE_BREAK_ON_CHANGE = (1 << 18),
 	SWITCH_FILE_FLAG_VIDEO = (1 << 19),
 	SWITCH_FILE_FLAG_VIDEO_EOF = (1 << 20),
-	SWITCH_FILE_PRE_CLOSED = (1 << 21)
+	SWITCH_FILE_PRE_CLOSED = (1 << 21),
+	SWITCH_FILE_CACHED = (1 << 22),
+	SWITCH_FILE_NATIVE_FRAMED = (1 << 23),
+	SWITCH_FILE_MAPPED = (1 << 24)
 } switch_file_flag_enum_t;
 typedef uint32_t switch_file_flag_t;
 
+#define SWITCH_NATIVE_PROMPT_MAGIC "FSNP"
+#define SWITCH_NATIVE_PROMPT_VERSION 1
+#define SWITCH_NATIVE_PROMPT_EXT "fsnp"
+
+/*!
+  \brief Header of a pre-encoded prompt container.
+  It is followed by frames + 1 uint32_t payload offsets and then the packed payloads,
+  so packet n is the bytes between offset n and offset n + 1.
+*/
+typedef struct {
+	char magic[4];
+	uint32_t version;
+	char iananame[32];
+	uint32_t samples_per_second;
+	uint32_t actual_samples_per_second;
+	uint32_t microseconds_per_packet;
+	uint32_t samples_per_packet;
+	uint32_t channels;
+	uint32_t frames;
+} switch_native_prompt_header_t;
+
 typedef enum {
 	SWITCH_IO_FLAG_NONE = 0,
 	SWITCH_IO_FLAG_NOBLOCK = (1 << 0),
@@ -2480,6 +2504,8 @@ typedef switch_caller_extension_t *(*switch_dialplan_hunt_function_t) (switch_co
 
 typedef switch_bool_t (*switch_hash_delete_callback_t) (_In_ const void *key, _In_ const void *val, _In_opt_ void *pData);
 #define SWITCH_HASH_DELETE_FUNC(name) static switch_bool_t name (const void *key, const void *val, void *pData)
+typedef switch_bool_t (*switch_hash_walk_callback_t) (_In_ const void *key, _In_ void *val, _In_opt_ void *pData);
+#define SWITCH_HASH_WALK_FUNC(name) static switch_bool_t name (const void *key, void *val, void *pData)
 
 typedef struct switch_scheduler_task switch_scheduler_task_t;
 
@@ -2592,6 +2618,8 @@ struct switch_hashtable_iterator;
 typedef struct switch_hashtable switch_hash_t;
 typedef struct switch_hashtable switch_inthash_t;
 typedef struct switch_hashtable_iterator switch_hash_index_t;
+struct switch_concurrent_hash;
+typedef struct switch_concurrent_hash switch_concurrent_hash_t;
 
 struct switch_network_list;
 typedef struct switch_network_list switch_network_list_t;
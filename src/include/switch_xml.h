@@ -72,7 +72,8 @@ SWITCH_BEGIN_EXTERN_C
 	SWITCH_XML_NAMEM = (1 << 1),	// name is malloced
 	SWITCH_XML_TXTM = (1 << 2),	// txt is malloced
 	SWITCH_XML_DUP = (1 << 3),	// attribute name and value are strduped
-	SWITCH_XML_CDATA = (1 << 4) // body is in CDATA
+	SWITCH_XML_CDATA = (1 << 4), // body is in CDATA
+	SWITCH_XML_ARENA = (1 << 5) // tag lives in the arena of the parsed root, freed along with it
 } switch_xml_flag_t;
 
 /*! \brief A representation of an XML tree */
@@ -326,13 +327,24 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_set_flag(switch_xml_t xml, switch_xml_fl
 
 ///\brief removes a tag along with its subtags without freeing its memory
 ///\param xml the xml node
+///\note Tags of a parsed document carry SWITCH_XML_ARENA: the tags themselves and
+///\      their name and text live in memory owned by the root of the document they
+///\      were parsed into.  A cut tag still belongs to that root, freeing it with
+///\      switch_xml_free() only releases what it allocated on its own (attributes,
+///\      SWITCH_XML_NAMEM/TXTM strings, tags added later), and it must not be used
+///\      once the original root has been freed.  Use switch_xml_dup() for a copy
+///\      that outlives the document.
 SWITCH_DECLARE(switch_xml_t) switch_xml_cut(_In_ switch_xml_t xml);
 
 ///\brief inserts an existing tag into an ezxml structure
+///\note Inserting does not transfer the ownership of a SWITCH_XML_ARENA tag, the
+///\      root it was parsed into has to outlive dest, see switch_xml_cut().
 SWITCH_DECLARE(switch_xml_t) switch_xml_insert(_In_ switch_xml_t xml, _In_ switch_xml_t dest, _In_ switch_size_t off);
 
 ///\brief Moves an existing tag to become a subtag of dest at the given offset from
 ///\ the start of dest's character content. Returns the moved tag.
+///\ Within one document this is always safe, a tag moved into another document
+///\ keeps depending on the root it was parsed into, see switch_xml_cut().
 #define switch_xml_move(xml, dest, off) switch_xml_insert(switch_xml_cut(xml), dest, off)
 
 ///\brief removes a tag along with all its subtags
@@ -402,6 +414,12 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_in_domain(_In_z_ const ch
 
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, const char *user_name, const char *domain_name,
 															  const char *ip, switch_xml_t *user, switch_event_t *params);
+///\brief like switch_xml_locate_user_merged, and on failure tells whether the directory has no such user
+///\param not_found set to SWITCH_TRUE only when every binding answered and no key matched; a binding that
+///       failed to answer (timeout, HTTP error) leaves it SWITCH_FALSE
+SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged_ex(const char *key, const char *user_name, const char *domain_name,
+																 const char *ip, switch_xml_t *user, switch_event_t *params,
+																 switch_bool_t *not_found);
 SWITCH_DECLARE(uint32_t) switch_xml_clear_user_cache(const char *key, const char *user_name, const char *domain_name);
 SWITCH_DECLARE(void) switch_xml_merge_user(switch_xml_t user, switch_xml_t domain, switch_xml_t group);
 
@@ -24,6 +24,14 @@
 	#include "avmd_fast_acosf.h"
 #endif
 
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define AVMD_DESA2_SSE2 1
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+	#include <arm_neon.h>
+	#define AVMD_DESA2_NEON 1
+#endif
+
 
 double
 avmd_desa2_tweaked(circ_buffer_t *b, size_t i, double *amplitude) {
@@ -69,3 +77,62 @@ avmd_desa2_tweaked(circ_buffer_t *b, size_t i, double *amplitude) {
 	*amplitude = 2.0 * PSI_Xn / sqrt(PSI_Yn);
 	return result;
 }
+
+void
+avmd_desa2_tweaked_block(circ_buffer_t *b, size_t i, size_t n, double *omega, double *amplitude, double *scratch) {
+	const double *x = scratch;
+	size_t k = 0;
+
+	for (k = 0; k < n + 4; k++) {
+		scratch[k] = GET_SAMPLE((b), ((i) + k));
+	}
+	k = 0;
+
+#if defined(AVMD_DESA2_SSE2)
+	{
+		const __m128d two = _mm_set1_pd(2.0);
+
+		for (; k + 2 <= n; k += 2) {
+			__m128d x0 = _mm_loadu_pd(&x[k]);
+			__m128d x1 = _mm_loadu_pd(&x[k + 1]);
+			__m128d x2 = _mm_loadu_pd(&x[k + 2]);
+			__m128d x3 = _mm_loadu_pd(&x[k + 3]);
+			__m128d x4 = _mm_loadu_pd(&x[k + 4]);
+			__m128d x2sq = _mm_mul_pd(x2, x2);
+			__m128d d = _mm_mul_pd(two, _mm_sub_pd(x2sq, _mm_mul_pd(x1, x3)));
+			__m128d psi_xn = _mm_sub_pd(x2sq, _mm_mul_pd(x0, x4));
+			__m128d needed = _mm_add_pd(_mm_sub_pd(_mm_mul_pd(x1, x1), _mm_mul_pd(x0, x2)), _mm_sub_pd(_mm_mul_pd(x3, x3), _mm_mul_pd(x2, x4)));
+			__m128d nn = _mm_sub_pd(psi_xn, needed);
+			__m128d psi_yn = _mm_add_pd(needed, psi_xn);
+
+			_mm_storeu_pd(&omega[k], _mm_div_pd(nn, d));
+			_mm_storeu_pd(&amplitude[k], _mm_div_pd(_mm_mul_pd(two, psi_xn), _mm_sqrt_pd(psi_yn)));
+		}
+	}
+#elif defined(AVMD_DESA2_NEON)
+	{
+		const float64x2_t two = vdupq_n_f64(2.0);
+
+		for (; k + 2 <= n; k += 2) {
+			float64x2_t x0 = vld1q_f64(&x[k]);
+			float64x2_t x1 = vld1q_f64(&x[k + 1]);
+			float64x2_t x2 = vld1q_f64(&x[k + 2]);
+			float64x2_t x3 = vld1q_f64(&x[k + 3]);
+			float64x2_t x4 = vld1q_f64(&x[k + 4]);
+			float64x2_t x2sq = vmulq_f64(x2, x2);
+			float64x2_t d = vmulq_f64(two, vsubq_f64(x2sq, vmulq_f64(x1, x3)));
+			float64x2_t psi_xn = vsubq_f64(x2sq, vmulq_f64(x0, x4));
+			float64x2_t needed = vaddq_f64(vsubq_f64(vmulq_f64(x1, x1), vmulq_f64(x0, x2)), vsubq_f64(vmulq_f64(x3, x3), vmulq_f64(x2, x4)));
+			float64x2_t nn = vsubq_f64(psi_xn, needed);
+			float64x2_t psi_yn = vaddq_f64(needed, psi_xn);
+
+			vst1q_f64(&omega[k], vdivq_f64(nn, d));
+			vst1q_f64(&amplitude[k], vdivq_f64(vmulq_f64(two, psi_xn), vsqrtq_f64(psi_yn)));
+		}
+	}
+#endif
+
+	for (; k < n; k++) {
+		omega[k] = avmd_desa2_tweaked(b, i + k, &amplitude[k]);
+	}
+}
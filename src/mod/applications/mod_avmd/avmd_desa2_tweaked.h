@@ -47,5 +47,16 @@
  */
 double avmd_desa2_tweaked(circ_buffer_t *b, size_t i, double *amplitude) __attribute__ ((nonnull(1,3)));
 
+/* Block version of avmd_desa2_tweaked, evaluates the estimator
+ * at n consecutive positions i, i + 1, ..., i + n - 1 and stores
+ * the partial results in omega[] and amplitudes in amplitude[].
+ * The 5 point windows are copied out of the circular buffer into
+ * scratch (at least n + 4 elements) and then processed two
+ * positions at a time with SSE2 or NEON where available.
+ * Every lane does the same IEEE operations in the same order as
+ * the scalar estimator so the results are the same.
+ */
+void avmd_desa2_tweaked_block(circ_buffer_t *b, size_t i, size_t n, double *omega, double *amplitude, double *scratch) __attribute__ ((nonnull(1,4,5,6)));
+
 
 #endif  /* __AVMD_DESA2_TWEAKED_H__ */
@@ -115,6 +115,9 @@
 #define AVMD_READ_REPLACE	0
 #define AVMD_WRITE_REPLACE	1
 
+/*! Maximum number of session frames a worker takes off the queue at once */
+#define AVMD_WORKER_BATCH_MAX 32
+
 
 /* don't forget to update avmd_events_str table if you modify this */
 enum avmd_event
@@ -207,19 +210,25 @@ struct avmd_buffer {
 };
 
 struct avmd_detector {
-	switch_thread_t *thread;
-	switch_mutex_t *mutex;
-	uint8_t flag_processing_done;
-	uint8_t flag_should_exit;
 	enum avmd_detection_mode result;
-	switch_thread_cond_t *cond_start_processing;
 	struct avmd_buffer buffer;
 	avmd_session_t *s;
-	size_t samples;
+	size_t pos;
 	uint8_t idx;
 	uint8_t lagged, lag;
 };
 
+/*! DESA-2 estimates for one window of the current frame, shared by all detectors reading that window */
+struct avmd_estimates {
+	size_t pos;
+	size_t len;
+	size_t cap;
+	double *omega;
+	double *amplitude;
+	double *f;
+	double *scratch;
+};
+
 /*! Type that holds avmd detection session information. */
 struct avmd_session {
 	switch_core_session_t *session;
@@ -236,7 +245,12 @@ struct avmd_session {
 
 	switch_mutex_t *mutex_detectors_done;
 	switch_thread_cond_t *cond_detectors_done;
+	uint8_t detection_pending;
+	uint8_t detection_queued;
+	uint32_t frame_samples;
+	size_t samples;
 	struct avmd_detector *detectors;
+	struct avmd_estimates estimates;
 };
 
 static struct avmd_globals
@@ -245,6 +259,12 @@ static struct avmd_globals
 	struct avmd_settings settings;
 	switch_memory_pool_t *pool;
 	size_t session_n;
+	uint16_t worker_threads_n;
+	switch_queue_t *work_queue;
+	switch_mutex_t *workers_mutex;
+	switch_thread_t **workers;
+	uint16_t workers_n;
+	volatile uint8_t workers_running;
 } avmd_globals;
 
 static void avmd_process(avmd_session_t *session, switch_frame_t *frame, uint8_t direction);
@@ -257,7 +277,7 @@ static void avmd_unregister_all_events(void);
 static void avmd_fire_event(enum avmd_event type, switch_core_session_t *fs_s, double freq, double v_freq, double amp, double v_amp, avmd_beep_state_t beep_status, uint8_t info,
 		switch_time_t detection_start_time, switch_time_t detection_stop_time, switch_time_t start_time, switch_time_t stop_time, uint8_t resolution, uint8_t offset, uint8_t idx);
 
-static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buffer_t *b, size_t sample_n, size_t pos, struct avmd_detector *d);
+static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, const struct avmd_estimates *e, size_t k, struct avmd_detector *d);
 
 /* API [set default], reset to factory settings */
 static void avmd_set_xml_default_configuration(switch_mutex_t *mutex);
@@ -280,102 +300,118 @@ static void avmd_reloadxml_event_handler(switch_event_t *event);
 static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex);
 
 static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg);
+avmd_worker_func(switch_thread_t *thread, void *arg);
+
+static void
+avmd_detect_frame(avmd_session_t *s);
 
 static uint8_t
 avmd_detection_in_progress(avmd_session_t *s);
 
-static switch_status_t avmd_launch_threads(avmd_session_t *s) {
-	uint8_t idx;
-	struct avmd_detector *d;
+static void
+avmd_detection_finish(avmd_session_t *s);
+
+static switch_status_t avmd_start_workers(switch_memory_pool_t *pool) {
 	switch_threadattr_t *thd_attr = NULL;
+	uint16_t idx;
 
-	idx = 0;
-	while (idx < s->settings.detectors_n) {
-		d = &s->detectors[idx];
-		d->flag_processing_done = 1;
-		d->flag_should_exit = 0;
-		d->result = AVMD_DETECT_NONE;
-		d->lagged = 0;
-		d->lag = 0;
-		switch_threadattr_create(&thd_attr, avmd_globals.pool);
-		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(s->session)) != SWITCH_STATUS_SUCCESS) {
-			return SWITCH_STATUS_FALSE;
-		}
+	avmd_globals.workers_n = 0;
+	if (avmd_globals.worker_threads_n == 0) {
+		return SWITCH_STATUS_SUCCESS;
+	}
 
-		if (s->settings.debug) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started thread idx=%u\n", idx);
-		}
+	if (!avmd_globals.workers_mutex) {
+		switch_mutex_init(&avmd_globals.workers_mutex, SWITCH_MUTEX_NESTED, pool);
+	}
 
-		++idx;
+	if (switch_queue_create(&avmd_globals.work_queue, SWITCH_CORE_QUEUE_LEN, pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
 	}
+	avmd_globals.workers = switch_core_alloc(pool, avmd_globals.worker_threads_n * sizeof(switch_thread_t *));
+	avmd_globals.workers_running = 1;
 
-	idx = 0;
-	while (idx < s->settings.detectors_lagged_n) {
-		d = &s->detectors[s->settings.detectors_n + idx];
-		d->flag_processing_done = 1;
-		d->flag_should_exit = 0;
-		d->result = AVMD_DETECT_NONE;
-		d->lagged = 1;
-		d->lag = idx + 1;
-		switch_threadattr_create(&thd_attr, avmd_globals.pool);
+	for (idx = 0; idx < avmd_globals.worker_threads_n; ++idx) {
+		switch_threadattr_create(&thd_attr, pool);
 		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-		if (switch_thread_create(&d->thread, thd_attr, avmd_detector_func, d, switch_core_session_get_pool(s->session)) != SWITCH_STATUS_SUCCESS) {
-			return SWITCH_STATUS_FALSE;
-		}
-
-		if (s->settings.debug) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "AVMD: started lagged thread idx=%u\n", s->settings.detectors_n + idx);
+		switch_threadattr_priority_set(thd_attr, SWITCH_PRI_IMPORTANT);
+		if (switch_thread_create(&avmd_globals.workers[idx], thd_attr, avmd_worker_func, NULL, pool) != SWITCH_STATUS_SUCCESS) {
+			break;
 		}
+		++avmd_globals.workers_n;
+	}
 
-		++idx;
+	if (avmd_globals.workers_n == 0) {
+		avmd_globals.workers_running = 0;
+		return SWITCH_STATUS_FALSE;
 	}
 
 	return SWITCH_STATUS_SUCCESS;
 }
 
-static void avmd_join_threads(avmd_session_t *s) {
-	uint8_t idx;
-	struct avmd_detector *d;
+/*! \brief Stop the detector pool.
+ * @details No frame is queued once workers_running is cleared under workers_mutex.
+ * A worker that takes its stop marker mid-batch leaves whatever was queued behind it,
+ * so those frames are run here and their media threads released.
+ */
+static void avmd_stop_workers(void) {
 	switch_status_t status;
+	void *pop = NULL;
+	uint16_t idx;
 
-	idx = 0;
-	while (idx < s->settings.detectors_n) {
-		d = &s->detectors[idx];
-		switch_mutex_lock(d->mutex);
-		if (d->thread != NULL) {
-			d->flag_should_exit = 1;
-			d->samples = 0;
-			switch_thread_cond_signal(d->cond_start_processing);
-			switch_mutex_unlock(d->mutex);
-			switch_thread_join(&status, d->thread);
-			d->thread = NULL;
-			switch_mutex_destroy(d->mutex);
-			switch_thread_cond_destroy(d->cond_start_processing);
-		} else {
-			switch_mutex_unlock(d->mutex);
+	if (avmd_globals.workers_n == 0) {
+		return;
+	}
+
+	switch_mutex_lock(avmd_globals.workers_mutex);
+	avmd_globals.workers_running = 0;
+	switch_mutex_unlock(avmd_globals.workers_mutex);
+
+	for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+		switch_queue_push(avmd_globals.work_queue, NULL);
+	}
+	for (idx = 0; idx < avmd_globals.workers_n; ++idx) {
+		switch_thread_join(&status, avmd_globals.workers[idx]);
+	}
+	avmd_globals.workers_n = 0;
+
+	while (switch_queue_trypop(avmd_globals.work_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		avmd_session_t *s = (avmd_session_t *) pop;
+
+		if (s == NULL) {
+			continue;
 		}
-		++idx;
+
+		avmd_detect_frame(s);
+
+		switch_mutex_lock(s->mutex_detectors_done);
+		s->detection_pending = 0;
+		switch_thread_cond_signal(s->cond_detectors_done);
+		switch_mutex_unlock(s->mutex_detectors_done);
 	}
-	idx = 0;
-	while (idx < s->settings.detectors_lagged_n) {
-		d = &s->detectors[s->settings.detectors_n + idx];
-		switch_mutex_lock(d->mutex);
-		if (d->thread != NULL) {
-			d->flag_should_exit = 1;
-			d->samples = 0;
-			switch_thread_cond_signal(d->cond_start_processing);
-			switch_mutex_unlock(d->mutex);
-			switch_thread_join(&status, d->thread);
-			d->thread = NULL;
-			switch_mutex_destroy(d->mutex);
-			switch_thread_cond_destroy(d->cond_start_processing);
-		} else {
-			switch_mutex_unlock(d->mutex);
+}
+
+/*! \brief Hand the frame just inserted to the detector pool.
+ * @return SWITCH_STATUS_SUCCESS if a worker will run it, otherwise the caller runs it itself.
+ */
+static switch_status_t avmd_queue_frame(avmd_session_t *s) {
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!avmd_globals.workers_running) {
+		return status;
+	}
+
+	switch_mutex_lock(avmd_globals.workers_mutex);
+	if (avmd_globals.workers_running) {
+		switch_mutex_lock(s->mutex_detectors_done);
+		s->detection_pending = 1;
+		if ((status = switch_queue_trypush(avmd_globals.work_queue, s)) != SWITCH_STATUS_SUCCESS) {
+			s->detection_pending = 0;
 		}
-		++idx;
+		switch_mutex_unlock(s->mutex_detectors_done);
 	}
+	switch_mutex_unlock(avmd_globals.workers_mutex);
+
+	return status;
 }
 
 static switch_status_t avmd_init_buffer(struct avmd_buffer *b, size_t buf_sz, uint8_t resolution, uint8_t offset, switch_core_session_t *fs_session) {
@@ -458,6 +494,11 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
 	avmd_session->detection_start_time = 0;
 	avmd_session->detection_stop_time = 0;
 	avmd_session->frame_n_to_skip = 0;
+	avmd_session->detection_pending = 0;
+	avmd_session->detection_queued = 0;
+	avmd_session->frame_samples = 0;
+	avmd_session->samples = 0;
+	memset(&avmd_session->estimates, 0, sizeof(avmd_session->estimates));
 
 	buf_sz = AVMD_BEEP_LEN((uint32_t)avmd_session->rate) / (uint32_t) AVMD_SINE_LEN(avmd_session->rate);
 	if (buf_sz < 1) {
@@ -482,12 +523,11 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
 				goto end;
 			}
 			d->s = avmd_session;
-			d->flag_processing_done = 1;
-			d->flag_should_exit = 1;
+			d->result = AVMD_DETECT_NONE;
+			d->pos = avmd_session->pos;
 			d->idx = idx;
-			d->thread = NULL;
-			switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-			switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
+			d->lagged = 0;
+			d->lag = 0;
 			++offset;
 			++idx;
 		}
@@ -502,12 +542,11 @@ static switch_status_t init_avmd_session_data(avmd_session_t *avmd_session, swit
 				goto end;
 			}
 			d->s = avmd_session;
-			d->flag_processing_done = 1;
-			d->flag_should_exit = 1;
+			d->result = AVMD_DETECT_NONE;
+			d->pos = avmd_session->pos;
 			d->idx = avmd_session->settings.detectors_n + idx;
-			d->thread = NULL;
-			switch_mutex_init(&d->mutex, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
-			switch_thread_cond_create(&d->cond_start_processing, switch_core_session_get_pool(fs_session));
+			d->lagged = 1;
+			d->lag = idx + 1;
 			++idx;
 	}
 	switch_mutex_init(&avmd_session->mutex_detectors_done, SWITCH_MUTEX_DEFAULT, switch_core_session_get_pool(fs_session));
@@ -522,10 +561,6 @@ end:
 }
 
 static void avmd_session_close(avmd_session_t *s) {
-	uint8_t				 idx;
-	struct avmd_detector	*d;
-	switch_status_t		 status;
-
 	switch_mutex_lock(s->mutex);
 
 	switch_mutex_lock(s->mutex_detectors_done);
@@ -534,24 +569,11 @@ static void avmd_session_close(avmd_session_t *s) {
 	}
 	switch_mutex_unlock(s->mutex_detectors_done);
 
-	idx = 0;
-	while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-		d = &s->detectors[idx];
-		switch_mutex_lock(d->mutex);
-		d = &s->detectors[idx];
-		d->flag_processing_done = 0;
-		d->flag_should_exit = 1;
-		d->samples = 0;
-		switch_thread_cond_signal(d->cond_start_processing);
-		switch_mutex_unlock(d->mutex);
-
-		switch_thread_join(&status, d->thread);
-		d->thread = NULL;
-
-		switch_mutex_destroy(d->mutex);
-		switch_thread_cond_destroy(d->cond_start_processing);
-		++idx;
+	if (s->detection_queued) {
+		s->detection_queued = 0;
+		avmd_detection_finish(s);
 	}
+
 	switch_mutex_unlock(s->mutex);
 	switch_mutex_destroy(s->mutex_detectors_done);
 	switch_thread_cond_destroy(s->cond_detectors_done);
@@ -846,6 +868,7 @@ static void avmd_set_xml_default_configuration(switch_mutex_t *mutex) {
 	avmd_globals.settings.mode = AVMD_DETECT_BOTH;
 	avmd_globals.settings.detectors_n = 36;
 	avmd_globals.settings.detectors_lagged_n = 1;
+	avmd_globals.worker_threads_n = (uint16_t) switch_core_cpu_count();
 
 	if (mutex != NULL) {
 		switch_mutex_unlock(avmd_globals.mutex);
@@ -886,7 +909,7 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
 	switch_xml_t xml = NULL, x_lists = NULL, x_list = NULL, cfg = NULL;
 	uint8_t bad_debug = 1, bad_report = 1, bad_fast = 1, bad_req_cont = 1, bad_sample_n_cont = 1,
 			bad_sample_n_to_skip = 1, bad_req_cont_amp = 1, bad_sample_n_cont_amp = 1, bad_simpl = 1,
-			bad_inbound = 1, bad_outbound = 1, bad_mode = 1, bad_detectors = 1, bad_lagged = 1, bad = 0;
+			bad_inbound = 1, bad_outbound = 1, bad_mode = 1, bad_detectors = 1, bad_lagged = 1, bad_workers = 1, bad = 0;
 
 	if (mutex != NULL) {
 		switch_mutex_lock(mutex);
@@ -954,6 +977,13 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
 					if(!avmd_parse_u8_user_input(value, &avmd_globals.settings.detectors_lagged_n, 0, UINT8_MAX)) {
 						bad_lagged = 0;
 					}
+				} else if (!strcmp(name, "worker_threads")) {
+					if (!strcasecmp(value, "auto")) {
+						avmd_globals.worker_threads_n = (uint16_t) switch_core_cpu_count();
+						bad_workers = 0;
+					} else if(!avmd_parse_u16_user_input(value, &avmd_globals.worker_threads_n, 0, UINT16_MAX)) {
+						bad_workers = 0;
+					}
 				}
 			} // for
 		} // if list
@@ -1045,6 +1075,12 @@ static switch_status_t avmd_load_xml_configuration(switch_mutex_t *mutex) {
 		avmd_globals.settings.detectors_lagged_n = 1;
 	}
 
+	if (bad_workers) {
+		bad = 1;
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "AVMD config parameter 'worker_threads' missing or invalid - using default\n");
+		avmd_globals.worker_threads_n = (uint16_t) switch_core_cpu_count();
+	}
+
 	/**
 	 * Hint.
 	 */
@@ -1123,6 +1159,7 @@ static void avmd_show(switch_stream_handle_t *stream, switch_mutex_t *mutex) {
 	stream->write_function(stream, "sessions					   \t%"PRId64"\n", avmd_globals.session_n);
 	stream->write_function(stream, "detectors n					\t%u\n", avmd_globals.settings.detectors_n);
 	stream->write_function(stream, "detectors lagged n			 \t%u\n", avmd_globals.settings.detectors_lagged_n);
+	stream->write_function(stream, "worker threads				 \t%u\n", avmd_globals.workers_n);
 	stream->write_function(stream, "\n\n");
 
 	if (mutex != NULL) {
@@ -1162,6 +1199,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_avmd_load) {
 		avmd_set_xml_default_configuration(NULL);
 	}
 
+	if (avmd_start_workers(pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Couldn't start avmd worker threads, detection will run on the media threads\n");
+	}
+
 	if ((switch_event_bind(modname, SWITCH_EVENT_RELOADXML, NULL, avmd_reloadxml_event_handler, NULL) != SWITCH_STATUS_SUCCESS)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind our reloadxml handler! Module will not react to changes made in XML configuration\n");
 		/* Not so severe to prevent further loading, well - it depends, anyway */
@@ -1506,14 +1547,6 @@ SWITCH_STANDARD_APP(avmd_start_app) {
 		}
 	}
 
-	status = avmd_launch_threads(avmd_session);
-	if (status != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Failed to start detection threads\n");
-		avmd_join_threads(avmd_session);
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Joined detection threads\n");
-		goto end_unlock;
-	}
-
 	status = switch_core_media_bug_add(session, "avmd", NULL, avmd_callback, avmd_session, 0, flags, &bug); /* Add a media bug that allows me to intercept the audio stream */
 	if (status != SWITCH_STATUS_SUCCESS) { /* If adding a media bug fails exit */
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "Failed to add media bug!\n");
@@ -1635,6 +1668,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_avmd_shutdown) {
 	}
 
 	avmd_unregister_all_events();
+	avmd_stop_workers();
 
 #ifndef WIN32
 	if (avmd_globals.settings.fast_math == 1) {
@@ -2007,19 +2041,12 @@ static void avmd_report_detection(avmd_session_t *s, enum avmd_detection_mode mo
 	s->state.beep_state = BEEP_DETECTED;
 }
 
+/*! \brief Check if a frame of this session is still with a worker.
+ * @details Session's mutex_detectors_done must be locked.
+ */
 static uint8_t
 avmd_detection_in_progress(avmd_session_t *s) {
-	uint8_t idx = 0;
-	while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-		switch_mutex_lock(s->detectors[idx].mutex);
-		if (s->detectors[idx].flag_processing_done == 0) {
-			switch_mutex_unlock(s->detectors[idx].mutex);
-			return 1;
-		}
-		switch_mutex_unlock(s->detectors[idx].mutex);
-		++idx;
-	}
-	return 0;
+	return s->detection_pending;
 }
 
 static enum avmd_detection_mode
@@ -2037,14 +2064,32 @@ avmd_detection_result(avmd_session_t *s) {
 	return AVMD_DETECT_NONE;
 }
 
+/*! \brief Report the result of the last frame run and move the buffer position past it.
+ * @details Detection must not be in progress.
+ */
+static void
+avmd_detection_finish(avmd_session_t *s) {
+	avmd_detection_result(s);
+
+	++s->frame_n;
+	if (s->frame_n == 1) {
+		s->pos += s->frame_samples - AVMD_P;
+	} else {
+		s->pos += s->frame_samples;
+	}
+	s->pos &= s->b.mask;
+}
+
 /*! \brief Process one frame of data with avmd algorithm.
  * @param session An avmd session.
  * @param frame An audio frame.
+ * @details With worker threads configured the frame is queued to the shared
+ * detector pool and the media thread returns at once. Its result is picked up
+ * when the next frame arrives, a frame time later, so the media thread only
+ * waits if a worker is that far behind. Otherwise the frame is processed here.
  */
 static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direction) {
 	circ_buffer_t *b;
-	uint8_t idx;
-	struct avmd_detector *d;
 
 
 	b = &s->b;
@@ -2055,6 +2100,11 @@ static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direc
 	}
 	switch_mutex_unlock(s->mutex_detectors_done);
 
+	if (s->detection_queued) {
+		s->detection_queued = 0;
+		avmd_detection_finish(s);
+	}
+
 	if (s->state.beep_state == BEEP_DETECTED) {						 /* If beep has already been detected skip the CPU heavy stuff */
 		return;
 	}
@@ -2074,35 +2124,16 @@ static void avmd_process(avmd_session_t *s, switch_frame_t *frame, uint8_t direc
 
 	INSERT_INT16_FRAME(b, (int16_t *)(frame->data), frame->samples);	/* Insert frame of 16 bit samples into buffer */
 
-	idx = 0;
-	while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
-		d = &s->detectors[idx];
-		switch_mutex_lock(d->mutex);
-		d = &s->detectors[idx];
-		if (d->result == AVMD_DETECT_NONE) {
-			d->flag_processing_done = 0;
-			d->flag_should_exit = 0;
-			d->samples = (s->frame_n == 0 ? frame->samples - AVMD_P : frame->samples);
-			switch_thread_cond_signal(d->cond_start_processing);
-		}
-		switch_mutex_unlock(d->mutex);
-		++idx;
-	}
+	s->samples = (s->frame_n == 0 ? frame->samples - AVMD_P : frame->samples);
+	s->frame_samples = frame->samples;
 
-	switch_mutex_lock(s->mutex_detectors_done);
-	while (avmd_detection_in_progress(s) == 1) {
-		switch_thread_cond_wait(s->cond_detectors_done, s->mutex_detectors_done);
+	if (avmd_queue_frame(s) == SWITCH_STATUS_SUCCESS) {
+		s->detection_queued = 1;
+		return;
 	}
-	avmd_detection_result(s);
-	switch_mutex_unlock(s->mutex_detectors_done);
 
-	++s->frame_n;
-	if (s->frame_n == 1) {
-		s->pos += frame->samples - AVMD_P;
-	} else {
-		s->pos += frame->samples;
-	}
-	s->pos &= b->mask;
+	avmd_detect_frame(s);
+	avmd_detection_finish(s);
 
 	return;
 }
@@ -2111,7 +2142,7 @@ static void avmd_reloadxml_event_handler(switch_event_t *event) {
 	avmd_load_xml_configuration(avmd_globals.mutex);
 }
 
-static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buffer_t *b, size_t sample_n, size_t pos, struct avmd_detector *d) {
+static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, const struct avmd_estimates *e, size_t k, struct avmd_detector *d) {
 	struct avmd_buffer *buffer = &d->buffer;
 	uint16_t sample_to_skip_n = s->settings.sample_n_to_skip;
 	enum avmd_detection_mode mode = s->settings.mode;
@@ -2134,7 +2165,8 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
 		return AVMD_DETECT_NONE;
 	}
 
-	omega = avmd_desa2_tweaked(b, pos + sample_n, &amplitude);
+	omega = e->omega[k];
+	amplitude = e->amplitude[k];
 
 	if (mode == AVMD_DETECT_AMP || mode == AVMD_DETECT_BOTH) {
 		if (ISNAN(amplitude) || ISINF(amplitude)) {
@@ -2187,12 +2219,7 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
 			}
 		} else {
 			if (valid_omega) {
-
-#if !defined(WIN32) && defined(AVMD_FAST_MATH)
-				f =  0.5 * (double) fast_acosf((float)omega);
-#else
-				f = 0.5 * acos(omega);
-#endif /* !WIN32 && AVMD_FAST_MATH */
+				f = e->f[k];
 				f_fir = sma_b->pos > 1 ? (AVMD_MEDIAN_FILTER(sma_b->data[sma_b->pos - 2], sma_b->data[sma_b->pos - 1], f)) : f;
 
 				APPEND_SMA_VAL(sma_b, f); /* append frequency */
@@ -2235,66 +2262,143 @@ static enum avmd_detection_mode avmd_process_sample(avmd_session_t *s, circ_buff
 	return AVMD_DETECT_NONE;
 }
 
-static void* SWITCH_THREAD_FUNC
-avmd_detector_func(switch_thread_t *thread, void *arg) {
-	size_t sample_n = 0, samples = AVMD_P;
-	size_t pos;
-	uint8_t resolution, offset;
-	avmd_session_t  *s;
+/*! \brief Get the DESA-2 estimates for samples pos + 1 ... pos + samples of the current frame.
+ * @details All the regular detectors read the same window, so the estimator
+ * (and the arc cosine) runs once per frame for them instead of once per detector.
+ */
+static const struct avmd_estimates *
+avmd_estimates_get(avmd_session_t *s, size_t pos, size_t samples) {
+	struct avmd_estimates *e = &s->estimates;
+	size_t k;
+
+	if (e->len == samples && e->pos == pos) {
+		return e;
+	}
+
+	if (e->cap < samples) {
+		e->cap = samples;
+		e->omega = (double *) switch_core_session_alloc(s->session, e->cap * sizeof(double));
+		e->amplitude = (double *) switch_core_session_alloc(s->session, e->cap * sizeof(double));
+		e->f = (double *) switch_core_session_alloc(s->session, e->cap * sizeof(double));
+		e->scratch = (double *) switch_core_session_alloc(s->session, (e->cap + AVMD_P) * sizeof(double));
+	}
+
+	avmd_desa2_tweaked_block(&s->b, pos + 1, samples, e->omega, e->amplitude, e->scratch);
+
+	if (s->settings.mode == AVMD_DETECT_FREQ || s->settings.mode == AVMD_DETECT_BOTH) {
+		for (k = 0; k < samples; ++k) {
+			double omega = e->omega[k];
+
+			if (ISNAN(omega) || omega < -0.99999 || omega > 0.99999) {
+				e->f[k] = 0.0;
+				continue;
+			}
+#if !defined(WIN32) && defined(AVMD_FAST_MATH)
+			e->f[k] = 0.5 * (double) fast_acosf((float)omega);
+#else
+			e->f[k] = 0.5 * acos(omega);
+#endif /* !WIN32 && AVMD_FAST_MATH */
+		}
+	}
+
+	e->pos = pos;
+	e->len = samples;
+
+	return e;
+}
+
+static enum avmd_detection_mode
+avmd_detector_run(avmd_session_t *s, struct avmd_detector *d) {
+	size_t sample_n, samples = s->samples;
+	uint8_t resolution = d->buffer.resolution, offset = d->buffer.offset;
+	const struct avmd_estimates *e;
 	enum avmd_detection_mode res = AVMD_DETECT_NONE;
-	struct avmd_detector *d;
 
+	if (d->lagged == 1) {
+		if (d->lag > 0) {
+			--d->lag;
+			return AVMD_DETECT_NONE;
+		}
+		d->pos = (d->pos + AVMD_P) & s->b.mask;
+	}
 
-	d = (struct avmd_detector*) arg;
-	s = d->s;
-	pos = s->pos;
-	while (1) {
-		switch_mutex_lock(d->mutex);
-		while ((d->flag_processing_done == 1) && (d->flag_should_exit == 0)) {
-			switch_thread_cond_wait(d->cond_start_processing, d->mutex);
+	if (s->settings.sample_n_to_skip > 0) {
+		return AVMD_DETECT_NONE;
+	}
+
+	e = avmd_estimates_get(s, d->pos, samples);
+
+	sample_n = 1;
+	while (sample_n <= samples) {
+		if (((sample_n + offset) % resolution) == 0) {
+			res = avmd_process_sample(s, e, sample_n - 1, d);
+			if (res != AVMD_DETECT_NONE) {
+				break;
+			}
 		}
-		/* master set processing_done flag to 0 or thread should exit */
-		if (d->flag_should_exit == 1) {
-			d->flag_processing_done = 1;
-			goto end;
+		++sample_n;
+	}
+
+	return res;
+}
+
+/*! \brief Run all the detectors of a session over its current frame. */
+static void
+avmd_detect_frame(avmd_session_t *s) {
+	struct avmd_detector *d;
+	uint8_t idx = 0;
+
+	s->estimates.len = 0;
+	while (idx < (s->settings.detectors_n + s->settings.detectors_lagged_n)) {
+		d = &s->detectors[idx];
+		if (d->result == AVMD_DETECT_NONE) {
+			d->result = avmd_detector_run(s, d);
 		}
-		resolution = d->buffer.resolution;
-		offset = d->buffer.offset;
-		samples = d->samples;
-
-		if (d->lagged == 1) {
-			if (d->lag > 0) {
-				--d->lag;
-				goto done;
+		++idx;
+	}
+}
+
+/*! \brief Shared detector worker, takes frames of many sessions off the queue in batches. */
+static void* SWITCH_THREAD_FUNC
+avmd_worker_func(switch_thread_t *thread, void *arg) {
+	avmd_session_t *batch[AVMD_WORKER_BATCH_MAX];
+	void *pop = NULL;
+	uint32_t n, idx;
+	uint8_t done = 0;
+
+	while (!done) {
+		if (switch_queue_pop(avmd_globals.work_queue, &pop) != SWITCH_STATUS_SUCCESS) {
+			if (!avmd_globals.workers_running) {
+				break;
 			}
-			pos += AVMD_P;
+			continue;
+		}
+		if (pop == NULL) {
+			break;
 		}
 
-		switch_mutex_unlock(d->mutex);
-		sample_n = 1;
-		while (sample_n <= samples) {
-			if (((sample_n + offset) % resolution) == 0) {
-				res = avmd_process_sample(d->s, &s->b, sample_n, pos, d);
-				if (res != AVMD_DETECT_NONE) {
-					break;
-				}
+		n = 0;
+		batch[n++] = (avmd_session_t *) pop;
+		while (n < AVMD_WORKER_BATCH_MAX && switch_queue_trypop(avmd_globals.work_queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop == NULL) {
+				done = 1;
+				break;
 			}
-			++sample_n;
+			batch[n++] = (avmd_session_t *) pop;
 		}
-		switch_mutex_lock(d->mutex);
-done:
-		d->flag_processing_done = 1;
-		d->result = res;
-		switch_mutex_unlock(d->mutex);
 
-		switch_mutex_lock(s->mutex_detectors_done);
-		switch_thread_cond_signal(s->cond_detectors_done);
-		switch_mutex_unlock(s->mutex_detectors_done);
+		for (idx = 0; idx < n; ++idx) {
+			avmd_session_t *s = batch[idx];
+
+			avmd_detect_frame(s);
+
+			switch_mutex_lock(s->mutex_detectors_done);
+			s->detection_pending = 0;
+			switch_thread_cond_signal(s->cond_detectors_done);
+			switch_mutex_unlock(s->mutex_detectors_done);
+		}
 	}
-	return NULL;
 
-end:
-	switch_mutex_unlock(d->mutex);
 	return NULL;
 }
 
@@ -0,0 +1,398 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_avmd -- avmd estimator, detector pool and beep detection accuracy tests
+ *
+ */
+
+#include <switch.h>
+#include <test/switch_test.h>
+#include "../mod_avmd.c"
+
+#define AVMD_TEST_MAX_FRAME 960
+#define AVMD_TEST_SESSIONS 24
+
+/*
+ * The corpus mimics what the module sees on outbound campaigns: a greeting,
+ * a short pause, the beep, then line noise. Greetings are a voiced harmonic
+ * series with moving pitch and syllable envelope, and part of the corpus is
+ * passed through G.711 like audio coming off a real trunk.
+ */
+typedef struct {
+	const char *name;
+	uint32_t rate;
+	double beep_hz;
+	double beep_amp;
+	int beep_ms;
+	int speech_ms;
+	int gap_ms;
+	int tail_ms;
+	int noise;
+	int ulaw;
+	int beep;
+} avmd_corpus_t;
+
+static const avmd_corpus_t avmd_corpus[] = {
+	{ "1000hz",			8000, 1000.0,  8000.0, 500, 1500, 300, 1000,   50, 0, 1 },
+	{ "1000hz-ulaw",	8000, 1000.0,  8000.0, 500, 1500, 300, 1000,   50, 1, 1 },
+	{ "850hz-quiet",	8000,  850.0,  1500.0, 600, 2000, 200, 1000,   30, 1, 1 },
+	{ "1400hz-short",	8000, 1400.0,  6000.0, 250, 1200, 400, 1000,   50, 1, 1 },
+	{ "1200hz-noisy",	8000, 1200.0, 12000.0, 700, 1500, 300, 1000,  250, 1, 1 },
+	{ "500hz-long",		8000,  500.0,  6000.0, 900, 1000, 200, 1000,   50, 0, 1 },
+	{ "1000hz-16k",	   16000, 1000.0,  8000.0, 500, 1500, 300, 1000,   50, 0, 1 },
+	{ "greeting-only",	8000,	 0.0,	  0.0,   0, 4000,   0, 1000,   50, 1, 0 },
+	{ "line-noise",		8000,	 0.0,	  0.0,   0,	0,   0, 3000, 2000, 1, 0 },
+	{ "silence",		8000,	 0.0,	  0.0,   0,	0,   0, 3000,	0, 0, 0 }
+};
+
+static uint32_t avmd_test_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7fff;
+}
+
+static int16_t avmd_test_clip(double v)
+{
+	if (v > 32767.0) return 32767;
+	if (v < -32768.0) return -32768;
+	return (int16_t) v;
+}
+
+static size_t avmd_test_render(const avmd_corpus_t *c, int16_t **out)
+{
+	size_t speech = (size_t) c->speech_ms * c->rate / 1000;
+	size_t gap = (size_t) c->gap_ms * c->rate / 1000;
+	size_t beep = (size_t) c->beep_ms * c->rate / 1000;
+	size_t tail = (size_t) c->tail_ms * c->rate / 1000;
+	size_t total = speech + gap + beep + tail, i;
+	int16_t *audio = malloc(total * sizeof(int16_t));
+	uint32_t seed = 4711;
+	double phase = 0.0, f0 = 120.0;
+	int h;
+
+	for (i = 0; i < total; i++) {
+		double t = (double) i / c->rate, v = 0.0;
+
+		if (i < speech) {
+			/* a new syllable every 250ms with its own pitch */
+			if (i % (c->rate / 4) == 0) {
+				f0 = 100.0 + (avmd_test_rand(&seed) % 120);
+			}
+			phase += 2.0 * M_PI * (f0 + 15.0 * sin(2.0 * M_PI * 2.0 * t)) / c->rate;
+			for (h = 1; h <= 12; h++) {
+				v += (3000.0 / h) * sin(h * phase);
+			}
+			v *= fabs(sin(2.0 * M_PI * 2.0 * t));
+		} else if (i >= speech + gap && i < speech + gap + beep) {
+			v = c->beep_amp * sin(2.0 * M_PI * c->beep_hz * (double) (i - speech - gap) / c->rate);
+		}
+
+		if (c->noise) {
+			v += (double) ((int) (avmd_test_rand(&seed) % (2 * c->noise)) - c->noise);
+		}
+
+		audio[i] = avmd_test_clip(v);
+		if (c->ulaw) {
+			audio[i] = ulaw_to_linear(linear_to_ulaw(audio[i]));
+		}
+	}
+
+	*out = audio;
+	return total;
+}
+
+/* feed the audio through a fresh avmd session 20ms at a time, returns the frame the beep was reported in or -1,
+ * with the pool a frame's result is only collected when the next one arrives, so count from frame_n */
+static int avmd_test_run(switch_core_session_t *session, const int16_t *audio, size_t samples, uint32_t rate)
+{
+	avmd_session_t *s = switch_core_session_alloc(session, sizeof(avmd_session_t));
+	int16_t data[AVMD_TEST_MAX_FRAME];
+	switch_frame_t frame = { 0 };
+	size_t spf = rate / 50, off;
+	int detected = -1;
+
+	memcpy(&s->settings, &avmd_globals.settings, sizeof(struct avmd_settings));
+	s->settings.report_status = 0;
+	s->session = session;
+	if (init_avmd_session_data(s, session, NULL) != SWITCH_STATUS_SUCCESS) {
+		return -2;
+	}
+	s->rate = rate;
+	s->start_time = switch_micro_time_now();
+
+	for (off = 0; off + spf <= samples; off += spf) {
+		memcpy(data, audio + off, spf * sizeof(int16_t));
+		frame.data = data;
+		frame.samples = (uint32_t) spf;
+		frame.datalen = (uint32_t) (spf * sizeof(int16_t));
+
+		switch_mutex_lock(s->mutex);
+		avmd_process(s, &frame, AVMD_READ_REPLACE);
+		switch_mutex_unlock(s->mutex);
+
+		if (s->state.beep_state == BEEP_DETECTED) {
+			detected = (int) s->frame_n - 1;
+			break;
+		}
+	}
+
+	avmd_session_close(s);
+
+	if (detected == -1 && s->state.beep_state == BEEP_DETECTED) {
+		detected = (int) s->frame_n - 1;
+	}
+
+	return detected;
+}
+
+static void avmd_test_workers(uint16_t n)
+{
+	avmd_stop_workers();
+	avmd_globals.worker_threads_n = n;
+	avmd_start_workers(avmd_globals.pool);
+}
+
+typedef struct {
+	switch_core_session_t *session;
+	int16_t *audio;
+	size_t samples;
+	uint32_t rate;
+	int result;
+} avmd_test_job_t;
+
+static void *SWITCH_THREAD_FUNC avmd_test_thread(switch_thread_t *thread, void *obj)
+{
+	avmd_test_job_t *job = (avmd_test_job_t *) obj;
+
+	job->result = avmd_test_run(job->session, job->audio, job->samples, job->rate);
+
+	return NULL;
+}
+
+FST_CORE_BEGIN("./conf")
+{
+	FST_SUITE_BEGIN(avmd)
+	{
+		FST_SETUP_BEGIN()
+		{
+			if (!avmd_globals.mutex) {
+				memset(&avmd_globals, 0, sizeof(avmd_globals));
+				switch_core_new_memory_pool(&avmd_globals.pool);
+				switch_mutex_init(&avmd_globals.mutex, SWITCH_MUTEX_NESTED, avmd_globals.pool);
+				avmd_set_xml_default_configuration(NULL);
+				avmd_register_all_events();
+			}
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(desa2_block_matches_scalar)
+		{
+			circ_buffer_t b = { 0 };
+			double omega[400], amplitude[400], scratch[400 + AVMD_P];
+			uint32_t seed = 1;
+			size_t i, pos, k;
+			int mismatches = 0;
+
+			b.buf_len = 2048;
+			b.mask = b.buf_len - 1;
+			b.buf = switch_core_alloc(fst_pool, b.buf_len * sizeof(BUFF_TYPE));
+
+			/* tones, noise, zeros and clipped samples so the NaN/Inf paths are covered too */
+			for (i = 0; i < b.buf_len; i++) {
+				double v = (i % 3) ? 9000.0 * sin(i * 0.39) + 3000.0 * sin(i * 1.3) : (double) ((int) (avmd_test_rand(&seed) % 2000) - 1000);
+
+				if (i % 97 == 0 || (i > 700 && i < 720)) {
+					v = 0.0;
+				}
+				if (i > 1500 && i < 1510) {
+					v = 32767.0;
+				}
+				b.buf[i] = v;
+			}
+
+			for (pos = 0; pos < b.buf_len; pos += 37) {
+				avmd_desa2_tweaked_block(&b, pos, 333, omega, amplitude, scratch);
+				for (k = 0; k < 333; k++) {
+					double a = 0.0, o = avmd_desa2_tweaked(&b, pos + k, &a);
+
+					if (ISNAN(o) != ISNAN(omega[k]) || ISNAN(a) != ISNAN(amplitude[k])) {
+						mismatches++;
+					} else if (!ISNAN(o) && !ISNAN(a) && !ISINF(o) && !ISINF(a)) {
+						if (fabs(o - omega[k]) > 1e-12 * fmax(1.0, fabs(o)) || fabs(a - amplitude[k]) > 1e-12 * fmax(1.0, fabs(a))) {
+							mismatches++;
+						}
+					} else if (o != omega[k] && !ISNAN(o)) {
+						mismatches++;
+					}
+				}
+			}
+
+			fst_check_int_equals(mismatches, 0);
+		}
+		FST_TEST_END()
+
+		FST_SESSION_BEGIN(beep_corpus)
+		{
+			int results[2][sizeof(avmd_corpus) / sizeof(avmd_corpus[0])];
+			size_t c;
+			int pass;
+
+			for (pass = 0; pass < 2; pass++) {
+				/* first through the shared worker pool, then inline on the calling thread */
+				avmd_test_workers(pass == 0 ? 4 : 0);
+
+				for (c = 0; c < sizeof(avmd_corpus) / sizeof(avmd_corpus[0]); c++) {
+					const avmd_corpus_t *corpus = &avmd_corpus[c];
+					int16_t *audio = NULL;
+					size_t samples = avmd_test_render(corpus, &audio);
+					int onset = (corpus->speech_ms + corpus->gap_ms) / 20;
+					int end = (corpus->speech_ms + corpus->gap_ms + corpus->beep_ms) / 20;
+
+					results[pass][c] = avmd_test_run(fst_session, audio, samples, corpus->rate);
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "avmd corpus %s: beep in frame %d (expected %s)\n",
+									  corpus->name, results[pass][c], corpus->beep ? "yes" : "no");
+
+					if (corpus->beep) {
+						fst_xcheck(results[pass][c] >= onset && results[pass][c] <= end + 2, corpus->name);
+					} else {
+						fst_xcheck(results[pass][c] == -1, corpus->name);
+					}
+
+					free(audio);
+				}
+			}
+
+			/* the pool must not change a single decision */
+			for (c = 0; c < sizeof(avmd_corpus) / sizeof(avmd_corpus[0]); c++) {
+				fst_check_int_equals(results[0][c], results[1][c]);
+			}
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(worker_pool_many_sessions)
+		{
+			avmd_test_job_t jobs[AVMD_TEST_SESSIONS];
+			switch_thread_t *threads[AVMD_TEST_SESSIONS];
+			switch_threadattr_t *thd_attr = NULL;
+			switch_status_t status;
+			int16_t *audio[2];
+			size_t samples[2];
+			int expected[2];
+			int x;
+
+			avmd_test_workers(0);
+			samples[0] = avmd_test_render(&avmd_corpus[1], &audio[0]);
+			samples[1] = avmd_test_render(&avmd_corpus[7], &audio[1]);
+			expected[0] = avmd_test_run(fst_session, audio[0], samples[0], avmd_corpus[1].rate);
+			expected[1] = avmd_test_run(fst_session, audio[1], samples[1], avmd_corpus[7].rate);
+
+			/* many sessions feeding a small pool at once so the workers actually batch */
+			avmd_test_workers(2);
+			switch_threadattr_create(&thd_attr, fst_pool);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+			for (x = 0; x < AVMD_TEST_SESSIONS; x++) {
+				jobs[x].session = fst_session;
+				jobs[x].audio = audio[x % 2];
+				jobs[x].samples = samples[x % 2];
+				jobs[x].rate = 8000;
+				jobs[x].result = -3;
+				fst_requires(switch_thread_create(&threads[x], thd_attr, avmd_test_thread, &jobs[x], fst_pool) == SWITCH_STATUS_SUCCESS);
+			}
+			for (x = 0; x < AVMD_TEST_SESSIONS; x++) {
+				switch_thread_join(&status, threads[x]);
+				fst_check_int_equals(jobs[x].result, expected[x % 2]);
+			}
+
+			avmd_test_workers(0);
+			free(audio[0]);
+			free(audio[1]);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(worker_pool_stop_while_queued)
+		{
+			avmd_test_job_t jobs[AVMD_TEST_SESSIONS];
+			switch_thread_t *threads[AVMD_TEST_SESSIONS];
+			switch_threadattr_t *thd_attr = NULL;
+			switch_status_t status;
+			int16_t *audio = NULL;
+			size_t samples = avmd_test_render(&avmd_corpus[7], &audio);
+			int expected, x;
+
+			avmd_test_workers(0);
+			expected = avmd_test_run(fst_session, audio, samples, 8000);
+
+			/* stop a single worker while every session has frames queued behind it,
+			 * they must all carry on inline and reach the same decision */
+			avmd_test_workers(1);
+			switch_threadattr_create(&thd_attr, fst_pool);
+			switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+			for (x = 0; x < AVMD_TEST_SESSIONS; x++) {
+				jobs[x].session = fst_session;
+				jobs[x].audio = audio;
+				jobs[x].samples = samples;
+				jobs[x].rate = 8000;
+				jobs[x].result = -3;
+				fst_requires(switch_thread_create(&threads[x], thd_attr, avmd_test_thread, &jobs[x], fst_pool) == SWITCH_STATUS_SUCCESS);
+			}
+			switch_yield(20000);
+			avmd_test_workers(0);
+			for (x = 0; x < AVMD_TEST_SESSIONS; x++) {
+				switch_thread_join(&status, threads[x]);
+				fst_check_int_equals(jobs[x].result, expected);
+			}
+
+			free(audio);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(benchmark)
+		{
+			int16_t *audio = NULL;
+			size_t samples = avmd_test_render(&avmd_corpus[7], &audio);
+			switch_time_t start_ts, end_ts;
+			int x, runs = 20;
+
+			avmd_test_workers(0);
+			start_ts = switch_time_now();
+			for (x = 0; x < runs; x++) {
+				avmd_test_run(fst_session, audio, samples, 8000);
+			}
+			end_ts = switch_time_now();
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "avmd: %d x %" SWITCH_SIZE_T_FMT " samples in %" SWITCH_TIME_T_FMT "us, %.1f channels realtime per core\n",
+							  runs, samples, end_ts - start_ts, (double) runs * samples / 8000.0 * 1000000.0 / (double) (end_ts - start_ts + 1));
+
+			free(audio);
+		}
+		FST_SESSION_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -428,6 +428,7 @@ static struct {
 	char *dbname;
 	const char *cc_instance_id;
 	switch_bool_t reserve_agents;
+	switch_bool_t dispatch_snapshot;
 	switch_bool_t truncate_tiers;
 	switch_bool_t truncate_agents;
 	switch_bool_t global_database_lock;
@@ -1516,6 +1517,7 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 
 	switch_mutex_lock(globals.mutex);
 	globals.global_database_lock = SWITCH_TRUE;
+	globals.dispatch_snapshot = SWITCH_FALSE;
 	if ((settings = switch_xml_child(cfg, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
 			char *var = (char *) switch_xml_attr_soft(param, "name");
@@ -1535,6 +1537,8 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 				globals.truncate_agents = switch_true(val);
 			} else if (!strcasecmp(var, "global-database-lock")) {
 				globals.global_database_lock = switch_true(val);
+			} else if (!strcasecmp(var, "dispatch-snapshot")) {
+				globals.dispatch_snapshot = switch_true(val);
 			} else if (!strcasecmp(var, "cc-instance-id")) {
 				globals.cc_instance_id = switch_core_strdup(pool, val);
 			} else if (!strcasecmp(var, "agent-originate-timeout")) {
@@ -1558,6 +1562,10 @@ static switch_status_t load_config(switch_memory_pool_t *pool)
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Disabling global database lock\n");
 	}
 
+	if (globals.dispatch_snapshot) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Querying agents once per queue and dispatch pass\n");
+	}
+
 	if (!globals.agent_originate_timeout) globals.agent_originate_timeout = 60;
 
 	/* Initialize database */
@@ -2247,6 +2255,149 @@ done:
 	return NULL;
 }
 
+/* Available agents of a queue, read the first time a waiting member of that
+ * queue comes up in a dispatch pass instead of once per member. Rows carry
+ * the columns agents_callback() expects plus the ones the strategies sort on. */
+#define CC_SNAPSHOT_AGENT_COLUMNS 19
+
+struct cc_snapshot_agent {
+	char *argv[CC_SNAPSHOT_AGENT_COLUMNS];
+	const char *name;
+	int level;
+	int position;
+	long last_bridge_end;
+	long last_offered_call;
+	long talk_time;
+	long calls_answered;
+	uint32_t rnd;
+};
+typedef struct cc_snapshot_agent cc_snapshot_agent_t;
+
+struct cc_snapshot_queue {
+	switch_memory_pool_t *pool;
+	cc_snapshot_agent_t **agents;
+	uint32_t count;
+	uint32_t size;
+	/* tier of the agent offered a call most recently, whatever its status, for round-robin */
+	switch_bool_t has_last;
+	int last_level;
+	int last_position;
+};
+typedef struct cc_snapshot_queue cc_snapshot_queue_t;
+
+struct cc_snapshot {
+	switch_memory_pool_t *pool;
+	switch_hash_t *queues;
+	/* agents offered a call during this pass, whatever their row still says */
+	switch_hash_t *claimed;
+};
+typedef struct cc_snapshot cc_snapshot_t;
+
+static int cc_snapshot_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	cc_snapshot_queue_t *sq = (cc_snapshot_queue_t *) pArg;
+	cc_snapshot_agent_t *agent;
+	int i;
+
+	if (argc < CC_SNAPSHOT_AGENT_COLUMNS + 3 || zstr(argv[1])) {
+		return 0;
+	}
+
+	agent = switch_core_alloc(sq->pool, sizeof(*agent));
+	for (i = 0; i < CC_SNAPSHOT_AGENT_COLUMNS; i++) {
+		agent->argv[i] = switch_core_strdup(sq->pool, switch_str_nil(argv[i]));
+	}
+	agent->name = agent->argv[1];
+	agent->position = atoi(agent->argv[14]);
+	agent->level = atoi(agent->argv[15]);
+	agent->last_bridge_end = atol(agent->argv[10]);
+	agent->last_offered_call = atol(switch_str_nil(argv[19]));
+	agent->talk_time = atol(switch_str_nil(argv[20]));
+	agent->calls_answered = atol(switch_str_nil(argv[21]));
+	agent->rnd = (uint32_t) rand();
+
+	if (sq->count == sq->size) {
+		cc_snapshot_agent_t **agents;
+
+		sq->size = sq->size ? sq->size * 2 : 16;
+		agents = switch_core_alloc(sq->pool, sq->size * sizeof(*agents));
+		if (sq->count) {
+			memcpy(agents, sq->agents, sq->count * sizeof(*agents));
+		}
+		sq->agents = agents;
+	}
+	sq->agents[sq->count++] = agent;
+
+	return 0;
+}
+
+static int cc_snapshot_last_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	cc_snapshot_queue_t *sq = (cc_snapshot_queue_t *) pArg;
+
+	if (argc < 2 || zstr(argv[0]) || zstr(argv[1])) {
+		return 0;
+	}
+
+	sq->has_last = SWITCH_TRUE;
+	sq->last_level = atoi(argv[0]);
+	sq->last_position = atoi(argv[1]);
+
+	return 0;
+}
+
+/* Only queues that have a waiting member get here, and only their available
+ * agents are read, so a pass costs one query per busy queue. */
+static cc_snapshot_queue_t *cc_snapshot_load(cc_snapshot_t *snap, const char *queue_name, const char *strategy)
+{
+	cc_snapshot_queue_t *sq;
+	char *sql;
+
+	if (!snap->pool) {
+		switch_core_new_memory_pool(&snap->pool);
+		switch_core_hash_init(&snap->queues);
+		switch_core_hash_init(&snap->claimed);
+	}
+
+	if ((sq = switch_core_hash_find(snap->queues, queue_name))) {
+		return sq;
+	}
+
+	sq = switch_core_alloc(snap->pool, sizeof(*sq));
+	sq->pool = snap->pool;
+	switch_core_hash_insert(snap->queues, queue_name, sq);
+
+	sql = switch_mprintf("SELECT instance_id, name, status, contact, no_answer_count, max_no_answer, reject_delay_time, busy_delay_time, no_answer_delay_time, tiers.state, agents.last_bridge_end, agents.wrap_up_time, agents.state, agents.ready_time, tiers.position, tiers.level, agents.type, agents.uuid, external_calls_count,"
+			" agents.last_offered_call, agents.talk_time, agents.calls_answered FROM agents JOIN tiers ON (agents.name = tiers.agent)"
+			" WHERE tiers.queue = '%q'"
+			" AND (agents.status = '%q' OR agents.status = '%q' OR agents.status = '%q')",
+			queue_name,
+			cc_agent_status2str(CC_AGENT_STATUS_AVAILABLE), cc_agent_status2str(CC_AGENT_STATUS_ON_BREAK), cc_agent_status2str(CC_AGENT_STATUS_AVAILABLE_ON_DEMAND));
+	cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, cc_snapshot_callback, sq);
+	switch_safe_free(sql);
+
+	if (sq->count && !strcasecmp(strategy, "round-robin")) {
+		sql = switch_mprintf("SELECT tiers.level, tiers.position FROM agents LEFT JOIN tiers ON (agents.name = tiers.agent)"
+				" WHERE tiers.queue = '%q' AND agents.last_offered_call > 0 ORDER BY agents.last_offered_call DESC LIMIT 1", queue_name);
+		cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, cc_snapshot_last_callback, sq);
+		switch_safe_free(sql);
+	}
+
+	return sq;
+}
+
+static void cc_snapshot_reset(cc_snapshot_t *snap)
+{
+	if (!snap->pool) {
+		return;
+	}
+
+	switch_core_hash_destroy(&snap->queues);
+	switch_core_hash_destroy(&snap->claimed);
+	switch_core_destroy_memory_pool(&snap->pool);
+	memset(snap, 0, sizeof(*snap));
+}
+
 struct agent_callback {
 	const char *queue_name;
 	const char *system;
@@ -2269,6 +2420,8 @@ struct agent_callback {
 
 	int tier;
 	int tier_agent_available;
+
+	cc_snapshot_t *snapshot;
 };
 typedef struct agent_callback agent_callback_t;
 
@@ -2456,6 +2609,10 @@ static int agents_callback(void *pArg, int argc, char **argv, char **columnNames
 				switch_threadattr_detach_set(thd_attr, 1);
 				switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 				switch_thread_create(&thread, thd_attr, outbound_agent_thread_run, h, h->pool);
+
+				if (cbt->snapshot) {
+					switch_core_hash_insert(cbt->snapshot->claimed, agent_name, cbt->snapshot);
+				}
 			}
 
 			if (!strcasecmp(cbt->strategy,"ring-all")) {
@@ -2468,6 +2625,134 @@ static int agents_callback(void *pArg, int argc, char **argv, char **columnNames
 	}
 }
 
+/* ORDER BY clauses of the per member agent queries, see members_callback() */
+#define CC_SNAPSHOT_CMP_LONG(_a, _b) if ((_a) != (_b)) return (_a) < (_b) ? -1 : 1
+
+static int cc_snapshot_cmp_level_position(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->position, b->position);
+	return 0;
+}
+
+static int cc_snapshot_cmp_sequential(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->position, b->position);
+	CC_SNAPSHOT_CMP_LONG(a->last_offered_call, b->last_offered_call);
+	return 0;
+}
+
+static int cc_snapshot_cmp_longest_idle(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->last_bridge_end, b->last_bridge_end);
+	CC_SNAPSHOT_CMP_LONG(a->position, b->position);
+	return 0;
+}
+
+static int cc_snapshot_cmp_least_talk_time(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->talk_time, b->talk_time);
+	CC_SNAPSHOT_CMP_LONG(a->position, b->position);
+	return 0;
+}
+
+static int cc_snapshot_cmp_fewest_calls(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->calls_answered, b->calls_answered);
+	CC_SNAPSHOT_CMP_LONG(a->position, b->position);
+	return 0;
+}
+
+static int cc_snapshot_cmp_random(const void *pa, const void *pb)
+{
+	const cc_snapshot_agent_t *a = *(cc_snapshot_agent_t * const *) pa, *b = *(cc_snapshot_agent_t * const *) pb;
+	CC_SNAPSHOT_CMP_LONG(a->level, b->level);
+	CC_SNAPSHOT_CMP_LONG(a->rnd, b->rnd);
+	return 0;
+}
+
+/* Offer the member to the queue's agents from the snapshot, in the order the
+ * strategy's sql would have returned them. top-down and round-robin first go
+ * through the agents after the last one offered (dyn_order 1), then the rest. */
+static void cc_snapshot_dispatch(cc_snapshot_t *snap, agent_callback_t *cbt, const char *strategy, int last_level, int last_position)
+{
+	cc_snapshot_queue_t *sq;
+	cc_snapshot_agent_t **order;
+	int (*cmp)(const void *, const void *) = cc_snapshot_cmp_sequential;
+	uint32_t i, n = 0, first = 0;
+	switch_bool_t two_pass = SWITCH_FALSE;
+
+	if (!(sq = cc_snapshot_load(snap, cbt->queue_name, strategy)) || !sq->count) {
+		return;
+	}
+
+	if (!strcasecmp(strategy, "round-robin")) {
+		/* without a last offered agent, the first pass is empty and every agent goes in the second */
+		two_pass = SWITCH_TRUE;
+		if (sq->has_last) {
+			last_level = sq->last_level;
+			last_position = sq->last_position;
+		} else {
+			last_position = INT_MAX;
+		}
+	} else if (!strcasecmp(strategy, "top-down")) {
+		two_pass = SWITCH_TRUE;
+	} else if (!strcasecmp(strategy, "longest-idle-agent")) {
+		cmp = cc_snapshot_cmp_longest_idle;
+	} else if (!strcasecmp(strategy, "agent-with-least-talk-time")) {
+		cmp = cc_snapshot_cmp_least_talk_time;
+	} else if (!strcasecmp(strategy, "agent-with-fewest-calls")) {
+		cmp = cc_snapshot_cmp_fewest_calls;
+	} else if (!strcasecmp(strategy, "ring-all") || !strcasecmp(strategy, "ring-progressively")) {
+		cmp = cc_snapshot_cmp_level_position;
+	} else if (!strcasecmp(strategy, "random")) {
+		cmp = cc_snapshot_cmp_random;
+	}
+
+	order = malloc(sizeof(*order) * sq->count * (two_pass ? 2 : 1));
+	switch_assert(order);
+
+	if (two_pass) {
+		for (i = 0; i < sq->count; i++) {
+			cc_snapshot_agent_t *agent = sq->agents[i];
+			if (agent->level == last_level && agent->position > last_position) {
+				order[n++] = agent;
+			}
+		}
+		qsort(order, n, sizeof(*order), cmp);
+		first = n;
+	}
+
+	for (i = 0; i < sq->count; i++) {
+		cc_snapshot_agent_t *agent = sq->agents[i];
+		/* top-down only moves on to the next levels, round-robin starts over from the top */
+		if (strcasecmp(strategy, "top-down") || agent->level > last_level) {
+			order[n++] = agent;
+		}
+	}
+	qsort(order + first, n - first, sizeof(*order), cmp);
+
+	for (i = 0; i < n; i++) {
+		if (switch_core_hash_find(snap->claimed, order[i]->name)) {
+			continue;
+		}
+		if (agents_callback(cbt, CC_SNAPSHOT_AGENT_COLUMNS, order[i]->argv, NULL)) {
+			break;
+		}
+	}
+
+	free(order);
+}
+
 static int members_callback(void *pArg, int argc, char **argv, char **columnNames)
 {
 	cc_queue_t *queue = NULL;
@@ -2487,6 +2772,8 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 	const char *member_abandoned_epoch = NULL;
 	const char *serving_agent = NULL;
 	const char *last_originated_call = NULL;
+	cc_snapshot_t *snapshot = (cc_snapshot_t *) pArg;
+	int last_level = 0, last_position = 0;
 	memset(&cbt, 0, sizeof(cbt));
 
 	cbt.queue_name = argv[0];
@@ -2628,6 +2915,8 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 			}
 			switch_core_session_rwunlock(member_session);
 		}
+		last_level = level;
+		last_position = position;
 
 		sql = switch_mprintf("SELECT instance_id, name, status, contact, no_answer_count, max_no_answer, reject_delay_time, busy_delay_time, no_answer_delay_time, tiers.state, agents.last_bridge_end, agents.wrap_up_time, agents.state, agents.ready_time, tiers.position as tiers_position, tiers.level as tiers_level, agents.type, agents.uuid, external_calls_count, agents.last_offered_call as agents_last_offered_call, 1 as dyn_order FROM agents LEFT JOIN tiers ON (agents.name = tiers.agent)"
 				" WHERE tiers.queue = '%q'"
@@ -2719,7 +3008,12 @@ static int members_callback(void *pArg, int argc, char **argv, char **columnName
 		}
 	}
 
-	cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, agents_callback, &cbt /* Call back variables */);
+	if (snapshot) {
+		cbt.snapshot = snapshot;
+		cc_snapshot_dispatch(snapshot, &cbt, queue_strategy, last_level, last_position);
+	} else {
+		cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, agents_callback, &cbt /* Call back variables */);
+	}
 
 	switch_safe_free(sql);
 
@@ -2760,6 +3054,7 @@ static int AGENT_DISPATCH_THREAD_STARTED = 0;
 void *SWITCH_THREAD_FUNC cc_agent_dispatch_thread_run(switch_thread_t *thread, void *obj)
 {
 	int done = 0;
+	cc_snapshot_t snapshot = { 0 };
 
 	switch_mutex_lock(globals.mutex);
 	if (!AGENT_DISPATCH_THREAD_RUNNING) {
@@ -2783,8 +3078,9 @@ void *SWITCH_THREAD_FUNC cc_agent_dispatch_thread_run(switch_thread_t *thread, v
 				local_epoch_time_now(NULL),
 				cc_member_state2str(CC_MEMBER_STATE_WAITING), cc_member_state2str(CC_MEMBER_STATE_ABANDONED), cc_member_state2str(CC_MEMBER_STATE_TRYING), cc_member_state2str(CC_MEMBER_STATE_TRYING), globals.cc_instance_id);
 
-		cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, members_callback, NULL /* Call back variables */);
+		cc_execute_sql_callback(NULL /* queue */, NULL /* mutex */, sql, members_callback, globals.dispatch_snapshot ? &snapshot : NULL /* Call back variables */);
 		switch_safe_free(sql);
+		cc_snapshot_reset(&snapshot);
 		switch_yield(100000);
 	}
 
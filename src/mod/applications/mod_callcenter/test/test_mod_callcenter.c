@@ -0,0 +1,211 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_callcenter -- mod_callcenter dispatch order with and without the agent snapshot
+ *
+ */
+
+#include <test/switch_test.h>
+
+#define CC_TEST_QUEUE "fst@default"
+#define CC_TEST_AGENTS 3
+
+/* the order agents are offered in, at most CC_TEST_AGENTS of them */
+static struct {
+	switch_mutex_t *mutex;
+	char offered[CC_TEST_AGENTS][64];
+	int count;
+} cc_test;
+
+static const char *cc_test_strategy = "";
+static const char *cc_test_snapshot = "";
+
+/* Three agents on one level, listed out of position order. Their contact is always busy and
+   busy-delay-time keeps each one out of the rest of the test, so every offer goes to the next
+   agent the strategy picks. */
+static switch_xml_t cc_test_config_search(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+										  switch_event_t *params, void *user_data)
+{
+	switch_xml_t xml;
+	char *text;
+
+	if (!key_value || strcmp(key_value, "callcenter.conf")) {
+		return NULL;
+	}
+
+	text = switch_mprintf("<document type=\"freeswitch/xml\"><section name=\"configuration\">"
+						  "<configuration name=\"callcenter.conf\"><settings>"
+						  "<param name=\"dbname\" value=\"fst_callcenter\"/>"
+						  "<param name=\"truncate-agents-on-load\" value=\"true\"/>"
+						  "<param name=\"truncate-tiers-on-load\" value=\"true\"/>"
+						  "<param name=\"dispatch-snapshot\" value=\"%s\"/>"
+						  "</settings><queues><queue name=\"" CC_TEST_QUEUE "\">"
+						  "<param name=\"strategy\" value=\"%s\"/>"
+						  "<param name=\"moh-sound\" value=\"silence_stream://-1\"/>"
+						  "</queue></queues><agents>"
+						  "<agent name=\"c1\" type=\"callback\" contact=\"error/user_busy\" status=\"Available\" max-no-answer=\"10\" busy-delay-time=\"60\"/>"
+						  "<agent name=\"c2\" type=\"callback\" contact=\"error/user_busy\" status=\"Available\" max-no-answer=\"10\" busy-delay-time=\"60\"/>"
+						  "<agent name=\"c3\" type=\"callback\" contact=\"error/user_busy\" status=\"Available\" max-no-answer=\"10\" busy-delay-time=\"60\"/>"
+						  "</agents><tiers>"
+						  "<tier agent=\"c1\" queue=\"" CC_TEST_QUEUE "\" level=\"1\" position=\"3\"/>"
+						  "<tier agent=\"c2\" queue=\"" CC_TEST_QUEUE "\" level=\"1\" position=\"1\"/>"
+						  "<tier agent=\"c3\" queue=\"" CC_TEST_QUEUE "\" level=\"1\" position=\"2\"/>"
+						  "</tiers></configuration></section></document>", cc_test_snapshot, cc_test_strategy);
+	xml = switch_xml_parse_str_dup(text);
+	switch_safe_free(text);
+
+	return xml;
+}
+
+static void cc_test_event_handler(switch_event_t *event)
+{
+	const char *action = switch_event_get_header(event, "CC-Action");
+	const char *agent = switch_event_get_header(event, "CC-Agent");
+
+	if (!action || strcmp(action, "agent-offering") || !agent) {
+		return;
+	}
+
+	switch_mutex_lock(cc_test.mutex);
+	if (cc_test.count < CC_TEST_AGENTS) {
+		switch_copy_string(cc_test.offered[cc_test.count++], agent, sizeof(cc_test.offered[0]));
+	}
+	switch_mutex_unlock(cc_test.mutex);
+}
+
+static int cc_test_offered(void)
+{
+	int count;
+
+	switch_mutex_lock(cc_test.mutex);
+	count = cc_test.count;
+	switch_mutex_unlock(cc_test.mutex);
+
+	return count;
+}
+
+/* loads mod_callcenter with the given strategy and snapshot setting, puts one caller in the queue and
+   hands back the agents in the order they were offered the call, comma separated */
+static char *cc_test_dispatch(const char *strategy, const char *snapshot)
+{
+	switch_stream_handle_t stream = { 0 };
+	char uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	const char *err = NULL;
+	char path[1024];
+	char *args, *order = NULL;
+	int i;
+
+	sprintf(path, "%s%s%s", SWITCH_TEST_BASE_DIR_OVERRIDE, SWITCH_PATH_SEPARATOR, "../.libs/");
+
+	cc_test_strategy = strategy;
+	cc_test_snapshot = snapshot;
+	memset(cc_test.offered, 0, sizeof(cc_test.offered));
+	cc_test.count = 0;
+
+	switch_xml_bind_search_function(cc_test_config_search, switch_xml_parse_section_string("configuration"), NULL);
+	if (switch_loadable_module_load_module(path, (char *) "mod_callcenter", SWITCH_TRUE, &err) != SWITCH_STATUS_SUCCESS) {
+		switch_xml_unbind_search_function_ptr(cc_test_config_search);
+		return NULL;
+	}
+
+	switch_uuid_str(uuid, sizeof(uuid));
+	args = switch_mprintf("{origination_uuid=%s}null/+15553334444 &callcenter(" CC_TEST_QUEUE ")", uuid);
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("originate", args, NULL, &stream);
+	switch_safe_free(stream.data);
+	switch_safe_free(args);
+
+	for (i = 0; i < 100 && cc_test_offered() < CC_TEST_AGENTS; i++) {
+		switch_yield(100000);
+	}
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("uuid_kill", uuid, NULL, &stream);
+	switch_safe_free(stream.data);
+	switch_yield(500000);
+
+	switch_loadable_module_unload_module(path, (char *) "mod_callcenter", SWITCH_FALSE, &err);
+	switch_xml_unbind_search_function_ptr(cc_test_config_search);
+
+	switch_mutex_lock(cc_test.mutex);
+	order = switch_mprintf("%s,%s,%s", cc_test.offered[0], cc_test.offered[1], cc_test.offered[2]);
+	switch_mutex_unlock(cc_test.mutex);
+
+	return order;
+}
+
+FST_CORE_BEGIN("conf")
+{
+	FST_SUITE_BEGIN(mod_callcenter_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+			switch_mutex_init(&cc_test.mutex, SWITCH_MUTEX_NESTED, fst_pool);
+			switch_event_bind("test_mod_callcenter", SWITCH_EVENT_CUSTOM, "callcenter::info", cc_test_event_handler, NULL);
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+			switch_event_unbind_callback(cc_test_event_handler);
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(sequential_order)
+		{
+			const char *snapshot[] = { "false", "true" };
+			int i;
+
+			/* the snapshot has to offer the agents in the order the per member query does */
+			for (i = 0; i < 2; i++) {
+				char *order = cc_test_dispatch("sequentially-by-agent-order", snapshot[i]);
+
+				fst_requires(order);
+				fst_check_string_equals(order, "c2,c3,c1");
+				switch_safe_free(order);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(top_down_order)
+		{
+			const char *snapshot[] = { "false", "true" };
+			int i;
+
+			/* top-down carries on after the last agent offered, which takes the two segment query */
+			for (i = 0; i < 2; i++) {
+				char *order = cc_test_dispatch("top-down", snapshot[i]);
+
+				fst_requires(order);
+				fst_check_string_equals(order, "c2,c3,c1");
+				switch_safe_free(order);
+			}
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
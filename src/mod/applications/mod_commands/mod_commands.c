@@ -691,6 +691,57 @@ SWITCH_STANDARD_API(pool_stats_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define DTLS_STATS_SYNTAX "[reset]"
+SWITCH_STANDARD_API(dtls_stats_function)
+{
+	switch_rtp_dtls_stats_t stats;
+	int i;
+
+	if (!zstr(cmd) && strcasecmp(cmd, "reset")) {
+		stream->write_function(stream, "-USAGE: %s\n", DTLS_STATS_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_rtp_get_dtls_stats(&stats, !zstr(cmd) ? SWITCH_TRUE : SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR RTP not initialized\n");
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	stream->write_function(stream, "Workers: %u%s\n", stats.workers, stats.workers ? "" : " (inline)");
+	stream->write_function(stream, "Handshakes: %" SWITCH_UINT64_T_FMT " failed: %" SWITCH_UINT64_T_FMT " resumed: %" SWITCH_UINT64_T_FMT
+						   " verify cache hits: %" SWITCH_UINT64_T_FMT " cached sessions: %u\n",
+						   stats.handshakes, stats.failures, stats.resumed, stats.verify_cache_hits, stats.cached_sessions);
+	stream->write_function(stream, "Offloaded steps: %" SWITCH_UINT64_T_FMT "\n", stats.offloaded);
+	stream->write_function(stream, "Latency (ms): avg %" SWITCH_UINT64_T_FMT " max %" SWITCH_UINT64_T_FMT "\n",
+						   stats.handshakes ? stats.total_usec / stats.handshakes / 1000 : 0, stats.max_usec / 1000);
+
+	for (i = 0; i < SWITCH_RTP_DTLS_HIST_BUCKETS; i++) {
+		if (stats.hist_bound_ms[i]) {
+			stream->write_function(stream, "  < %5u: %" SWITCH_UINT64_T_FMT "\n", stats.hist_bound_ms[i], stats.hist[i]);
+		} else {
+			stream->write_function(stream, "  >=%5u: %" SWITCH_UINT64_T_FMT "\n", i ? stats.hist_bound_ms[i - 1] : 0, stats.hist[i]);
+			break;
+		}
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define RTP_TELEMETRY_SYNTAX "[reset]"
+SWITCH_STANDARD_API(rtp_telemetry_function)
+{
+	if (!zstr(cmd) && strcasecmp(cmd, "reset")) {
+		stream->write_function(stream, "-USAGE: %s\n", RTP_TELEMETRY_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (switch_rtp_telemetry_write(stream, !zstr(cmd) ? SWITCH_TRUE : SWITCH_FALSE) != SWITCH_STATUS_SUCCESS) {
+		stream->write_function(stream, "-ERR RTP not initialized\n");
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(db_cache_function)
 {
 	int argc;
@@ -1728,6 +1779,46 @@ SWITCH_STANDARD_API(module_exists_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_STANDARD_API(module_timeline_function)
+{
+	cJSON *json = switch_loadable_module_load_timeline();
+	char *out = cJSON_Print(json);
+
+	stream->write_function(stream, "%s\n", out);
+
+	switch_safe_free(out);
+	cJSON_Delete(json);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+#define FILE_CACHE_SYNTAX "[stats|flush]"
+SWITCH_STANDARD_API(file_cache_function)
+{
+	cJSON *json;
+	char *out;
+
+	if (!zstr(cmd) && !strcasecmp(cmd, "flush")) {
+		stream->write_function(stream, "+OK %u entries flushed\n", switch_core_file_cache_flush());
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!zstr(cmd) && strcasecmp(cmd, "stats")) {
+		stream->write_function(stream, "-USAGE: %s\n", FILE_CACHE_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	json = switch_core_file_cache_stats();
+	out = cJSON_Print(json);
+
+	stream->write_function(stream, "%s\n", out);
+
+	switch_safe_free(out);
+	cJSON_Delete(json);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(domain_exists_function)
 {
 	switch_xml_t root = NULL, domain = NULL;
@@ -5753,10 +5844,10 @@ SWITCH_STANDARD_API(show_function)
 		switch_snprintfv(sql, sizeof(sql), "select type, name, ikey from interfaces where hostname='%q' and type = '%q' order by type,name", switch_core_get_hostname(), command);
 	} else if (!strncasecmp(command, "module", 6)) {
 		if (argv[1] && strcasecmp(argv[1], "as")) {
-			switch_snprintfv(sql, sizeof(sql), "select distinct type, name, ikey, filename from interfaces where hostname='%q' and ikey = '%q' order by type,name",
+			switch_snprintfv(sql, sizeof(sql), "select distinct type, name, ikey, filename, load_ms from interfaces where hostname='%q' and ikey = '%q' order by type,name",
 					switch_core_get_hostname(), argv[1]);
 		} else {
-			switch_snprintfv(sql, sizeof(sql), "select distinct type, name, ikey, filename from interfaces where hostname='%q' order by type,name", switch_core_get_hostname());
+			switch_snprintfv(sql, sizeof(sql), "select distinct type, name, ikey, filename, load_ms from interfaces where hostname='%q' order by type,name", switch_core_get_hostname());
 		}
 	} else if (!strcasecmp(command, "interfaces")) {
 		switch_snprintfv(sql, sizeof(sql), "select type, name, ikey from interfaces where hostname='%q' order by type,name", switch_core_get_hostname());
@@ -6749,6 +6840,51 @@ SWITCH_STANDARD_API(xml_flush_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define REGEX_CACHE_SYNTAX "[flush|size <max>]"
+SWITCH_STANDARD_API(regex_cache_function)
+{
+	switch_regex_cache_stats_t stats;
+	char *mycmd = NULL, *argv[2] = { 0 };
+	int argc = 0;
+
+	if (!zstr(cmd) && (mycmd = strdup(cmd))) {
+		argc = switch_split(mycmd, ' ', argv);
+	}
+
+	if (argc > 0 && !strcasecmp(argv[0], "flush")) {
+		uint32_t r = switch_regex_cache_flush();
+		stream->write_function(stream, "+OK cleared %u entr%s\n", r, r == 1 ? "y" : "ies");
+		goto done;
+	}
+
+	if (argc > 1 && !strcasecmp(argv[0], "size") && switch_is_number(argv[1])) {
+		int size = atoi(argv[1]);
+		switch_regex_cache_set_size(size > 0 ? size : 0);
+		stream->write_function(stream, "+OK\n");
+		goto done;
+	}
+
+	if (argc > 0) {
+		stream->write_function(stream, "-USAGE: %s\n", REGEX_CACHE_SYNTAX);
+		goto done;
+	}
+
+	switch_regex_cache_get_stats(&stats);
+
+	stream->write_function(stream, "Entries: %u/%u\n", stats.entries, stats.max_entries);
+	stream->write_function(stream, "Memory: %" SWITCH_SIZE_T_FMT " bytes\n", stats.bytes);
+	stream->write_function(stream, "Hits: %" SWITCH_UINT64_T_FMT "\n", stats.hits);
+	stream->write_function(stream, "Misses: %" SWITCH_UINT64_T_FMT "\n", stats.misses);
+	stream->write_function(stream, "Evictions: %" SWITCH_UINT64_T_FMT "\n", stats.evictions);
+	stream->write_function(stream, "Hit rate: %.2f%%\n",
+						   (stats.hits + stats.misses) ? (double) stats.hits * 100 / (double) (stats.hits + stats.misses) : 0.0);
+	stream->write_function(stream, "JIT: %s\n", stats.jit ? "yes" : "no");
+
+  done:
+	switch_safe_free(mycmd);
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_STANDARD_API(escape_function)
 {
 	int len;
@@ -7602,6 +7738,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "db_cache", "Manage db cache", db_cache_function, "status");
 	SWITCH_ADD_API(commands_api_interface, "domain_data", "Find domain data", domain_data_function, "<domain> [var|param|attr] <name>");
 	SWITCH_ADD_API(commands_api_interface, "domain_exists", "Check if a domain exists", domain_exists_function, "<domain>");
+	SWITCH_ADD_API(commands_api_interface, "dtls_stats", "Show DTLS handshake stats", dtls_stats_function, DTLS_STATS_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "echo", "Echo", echo_function, "<data>");
 	SWITCH_ADD_API(commands_api_interface, "event_channel_broadcast", "Broadcast", event_channel_broadcast_api_function, "<channel> <json>");
 	SWITCH_ADD_API(commands_api_interface, "escape", "Escape a string", escape_function, "<data>");
@@ -7635,6 +7772,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "log", "Log", log_function, LOG_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "md5", "Return md5 hash", md5_function, "<data>");
 	SWITCH_ADD_API(commands_api_interface, "module_exists", "Check if module exists", module_exists_function, "<module>");
+	SWITCH_ADD_API(commands_api_interface, "module_timeline", "Show how long each module took to load at startup", module_timeline_function, "");
+	SWITCH_ADD_API(commands_api_interface, "file_cache", "Decoded prompt cache stats", file_cache_function, FILE_CACHE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "msleep", "Sleep N milliseconds", msleep_function, "<milliseconds>");
 	SWITCH_ADD_API(commands_api_interface, "nat_map", "Manage NAT", nat_map_function, "[status|republish|reinit] | [add|del] <port> [tcp|udp] [static]");
 	SWITCH_ADD_API(commands_api_interface, "originate", "Originate a call", originate_function, ORIGINATE_SYNTAX);
@@ -7642,10 +7781,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	SWITCH_ADD_API(commands_api_interface, "pool_stats", "Core pool memory usage", pool_stats_function, "Core pool memory usage.");
 	SWITCH_ADD_API(commands_api_interface, "quote_shell_arg", "Quote/escape a string for use on shell command line", quote_shell_arg_function, "<data>");
 	SWITCH_ADD_API(commands_api_interface, "regex", "Evaluate a regex", regex_function, "<data>|<pattern>[|<subst string>][n|b]");
+	SWITCH_ADD_API(commands_api_interface, "regex_cache", "Show or manage the compiled regex cache", regex_cache_function, REGEX_CACHE_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "reloadacl", "Reload XML", reload_acl_function, "");
 	SWITCH_ADD_API(commands_api_interface, "reload", "Reload module", reload_function, UNLOAD_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "reloadxml", "Reload XML", reload_xml_function, "");
 	SWITCH_ADD_API(commands_api_interface, "replace", "Replace a string", replace_function, "<data>|<string1>|<string2>");
+	SWITCH_ADD_API(commands_api_interface, "rtp_telemetry", "Show RTP quality histograms in Prometheus format", rtp_telemetry_function, RTP_TELEMETRY_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "say_string", "", say_string_function, SAY_STRING_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_api", "Schedule an api command", sched_api_function, SCHED_SYNTAX);
 	SWITCH_ADD_API(commands_api_interface, "sched_broadcast", "Schedule a broadcast event to a running call", sched_broadcast_function, SCHED_BROADCAST_SYNTAX);
@@ -7752,6 +7893,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add complete add");
 	switch_console_set_complete("add complete del");
 	switch_console_set_complete("add db_cache status");
+	switch_console_set_complete("add dtls_stats reset");
+	switch_console_set_complete("add file_cache stats");
+	switch_console_set_complete("add file_cache flush");
 	switch_console_set_complete("add fsctl api_expansion on");
 	switch_console_set_complete("add fsctl api_expansion off");
 	switch_console_set_complete("add fsctl debug_level");
@@ -7815,8 +7959,10 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_commands_load)
 	switch_console_set_complete("add nat_map reinit");
 	switch_console_set_complete("add nat_map republish");
 	switch_console_set_complete("add nat_map status");
+	switch_console_set_complete("add regex_cache ::[flush:size");
 	switch_console_set_complete("add reload ::console::list_loaded_modules");
 	switch_console_set_complete("add reloadacl reloadxml");
+	switch_console_set_complete("add rtp_telemetry reset");
 	switch_console_set_complete("add show aliases");
 	switch_console_set_complete("add show api");
 	switch_console_set_complete("add show application");
@@ -407,6 +407,14 @@ struct fifo_node {
 	int default_lag;
 	char *domain_name;
 	int retry_delay;
+	/* dispatch generation and time until which find_consumers() is known to come back empty */
+	uint32_t outbound_gen;
+	time_t outbound_next_check;
+	/* caller push to consumer bridge */
+	uint32_t bridge_count;
+	switch_time_t latency_total;
+	switch_time_t latency_max;
+	switch_time_t latency_last;
 	struct fifo_node *next;
 };
 
@@ -503,6 +511,30 @@ static int node_caller_count(fifo_node_t *node)
 	return len;
 }
 
+/*!\brief Account the time a caller waited between being queued and
+ * being bridged to a consumer
+ */
+static void node_record_latency(fifo_node_t *node, switch_channel_t *caller_channel, switch_time_t now)
+{
+	const char *var;
+	switch_time_t pushed, latency;
+
+	if (!(var = switch_channel_get_variable(caller_channel, "fifo_push_time")) || !(pushed = (switch_time_t) atoll(var)) || pushed > now) {
+		return;
+	}
+
+	latency = now - pushed;
+
+	switch_mutex_lock(node->update_mutex);
+	node->bridge_count++;
+	node->latency_total += latency;
+	node->latency_last = latency;
+	if (latency > node->latency_max) {
+		node->latency_max = latency;
+	}
+	switch_mutex_unlock(node->update_mutex);
+}
+
 static void node_remove_uuid(fifo_node_t *node, const char *uuid)
 {
 	int i = 0;
@@ -668,8 +700,39 @@ static struct {
 	switch_bool_t delete_all_members_on_startup;
 	outbound_strategy_t default_strategy;
 	int disable_dtmf_moh_key;
+	int outbound_recheck_interval;
+	switch_mutex_t *dispatch_mutex;
+	switch_thread_cond_t *dispatch_cond;
+	uint32_t dispatch_gen;
 } globals;
 
+/*!\brief Wake up the node thread
+ *
+ * Called when something happened that may let a waiting caller be
+ * delivered: a caller was queued, an outbound member was freed or
+ * finished ringing, or the member list changed.
+ */
+static void fifo_kick_dispatch(void)
+{
+	if (!globals.dispatch_mutex) return;
+
+	switch_mutex_lock(globals.dispatch_mutex);
+	globals.dispatch_gen++;
+	switch_thread_cond_signal(globals.dispatch_cond);
+	switch_mutex_unlock(globals.dispatch_mutex);
+}
+
+static uint32_t fifo_dispatch_gen(void)
+{
+	uint32_t gen;
+
+	switch_mutex_lock(globals.dispatch_mutex);
+	gen = globals.dispatch_gen;
+	switch_mutex_unlock(globals.dispatch_mutex);
+
+	return gen;
+}
+
 
 /*!\brief Handler for consumer DTMF
  *
@@ -739,6 +802,8 @@ static int fifo_dec_use_count(const char *outbound_id)
 	}
 	switch_mutex_unlock(globals.use_mutex);
 
+	fifo_kick_dispatch();
+
 	return r;
 }
 
@@ -1739,6 +1804,7 @@ static void *SWITCH_THREAD_FUNC outbound_ringall_thread_run(switch_thread_t *thr
 		node->busy = 0;
 		switch_mutex_unlock(node->update_mutex);
 		switch_thread_rwlock_unlock(node->rwlock);
+		fifo_kick_dispatch();
 	}
 
 	for (i = 0; i < cbh->rowcount; i++) {
@@ -1918,6 +1984,7 @@ static void *SWITCH_THREAD_FUNC outbound_enterprise_thread_run(switch_thread_t *
 		node->busy = 0;
 		switch_mutex_unlock(node->update_mutex);
 		switch_thread_rwlock_unlock(node->rwlock);
+		fifo_kick_dispatch();
 	}
 	switch_core_destroy_memory_pool(&h->pool);
 
@@ -2079,6 +2146,38 @@ static int find_consumers(fifo_node_t *node)
 	return ret;
 }
 
+/*!\brief Work out until when a node with no available outbound
+ * members can be left alone
+ *
+ * Nothing local changes the outcome of `find_consumers()` without
+ * kicking the node thread, except members coming out of their lag or
+ * retry delay, so we look up the earliest `next_avail` still ahead of
+ * us.  `outbound-recheck-interval` caps the wait for changes made by
+ * other boxes sharing the database.
+ */
+static time_t node_next_outbound_check(fifo_node_t *node, time_t now)
+{
+	char next_avail[80] = "";
+	callback_t cbt = { 0 };
+	char *sql;
+	time_t next = now + globals.outbound_recheck_interval;
+	time_t avail;
+
+	cbt.buf = next_avail;
+	cbt.len = sizeof(next_avail);
+	sql = switch_mprintf("select min(next_avail) from fifo_outbound "
+						 "where taking_calls = 1 and fifo_name = '%q' and next_avail > %ld",
+						 node->name, (long) now);
+	fifo_execute_sql_callback(globals.sql_mutex, sql, sql2str_callback, &cbt);
+	switch_safe_free(sql);
+
+	if ((avail = (time_t) atol(next_avail)) > now && avail < next) {
+		next = avail;
+	}
+
+	return next;
+}
+
 /*\brief Continuously attempt to deliver calls to outbound members
  *
  * For each outbound priority level 1-10, find fifo nodes with a
@@ -2087,9 +2186,12 @@ static int find_consumers(fifo_node_t *node)
  * delivered and not enough ready and waiting inbound consumers.
  *
  * In the event of nothing needing to be done, each cycle starts at
- * priority 1 and ends at priority 10, yielding for one second
- * afterward.  We also yield after initiating outbound calls, starting
- * again where we left off on the next node.
+ * priority 1 and ends at priority 10, then waits up to one second for
+ * `fifo_kick_dispatch()`.  We also yield after initiating outbound
+ * calls, starting again where we left off on the next node.
+ *
+ * A node whose last `find_consumers()` found nobody is skipped until
+ * something kicks the thread or its next member becomes available.
  *
  * We also take care of cleaning up after nodes queued for deletion.
  */
@@ -2097,11 +2199,17 @@ static void *SWITCH_THREAD_FUNC node_thread_run(switch_thread_t *thread, void *o
 {
 	fifo_node_t *node, *last, *this_node;
 	int cur_priority = 1;
+	uint32_t cycle_gen = 0;
 
 	globals.node_thread_running = 1;
 
 	while (globals.node_thread_running == 1) {
 		int ppl_waiting, consumer_total, idle_consumers, need_sleep = 0;
+		uint32_t gen;
+
+		if (cur_priority == 1) {
+			cycle_gen = fifo_dispatch_gen();
+		}
 
 		switch_mutex_lock(globals.mutex);
 
@@ -2166,8 +2274,21 @@ static void *SWITCH_THREAD_FUNC node_thread_run(switch_thread_t *thread, void *o
 				}
 
 				if ((ppl_waiting - this_node->ring_consumer_count > 0) && (!consumer_total || !idle_consumers)) {
-					if (find_consumers(this_node)) {
+					time_t now = switch_epoch_time_now(NULL);
+
+					gen = fifo_dispatch_gen();
+
+					if (this_node->outbound_next_check && this_node->outbound_gen == gen && now < this_node->outbound_next_check) {
+						if (globals.debug > 1) {
+							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s no outbound member available for %ld more seconds\n",
+											  this_node->name, (long) (this_node->outbound_next_check - now));
+						}
+					} else if (find_consumers(this_node)) {
+						this_node->outbound_next_check = 0;
 						need_sleep++;
+					} else {
+						this_node->outbound_gen = gen;
+						this_node->outbound_next_check = node_next_outbound_check(this_node, now);
 					}
 				}
 			}
@@ -2179,8 +2300,14 @@ static void *SWITCH_THREAD_FUNC node_thread_run(switch_thread_t *thread, void *o
 
 		switch_mutex_unlock(globals.mutex);
 
-		if (cur_priority == 1 || need_sleep) {
+		if (need_sleep) {
 			switch_yield(1000000);
+		} else if (cur_priority == 1) {
+			switch_mutex_lock(globals.dispatch_mutex);
+			if (globals.dispatch_gen == cycle_gen && globals.node_thread_running == 1) {
+				switch_thread_cond_timedwait(globals.dispatch_cond, globals.dispatch_mutex, 1000000);
+			}
+			switch_mutex_unlock(globals.dispatch_mutex);
 		}
 	}
 
@@ -2204,6 +2331,7 @@ static int stop_node_thread(void)
 	switch_status_t st = SWITCH_STATUS_SUCCESS;
 
 	globals.node_thread_running = -1;
+	fifo_kick_dispatch();
 	switch_thread_join(&st, globals.node_thread);
 
 	return 0;
@@ -2340,6 +2468,8 @@ static uint32_t fifo_add_outbound(const char *node_name, const char *url, uint32
 
 	switch_thread_rwlock_unlock(node->rwlock);
 
+	fifo_kick_dispatch();
+
 	return i;
 }
 
@@ -2751,6 +2881,7 @@ SWITCH_STANDARD_APP(fifo_function)
 		switch_event_create(&call_event, SWITCH_EVENT_CHANNEL_DATA);
 		switch_channel_event_set_data(channel, call_event);
 
+		switch_channel_set_variable_printf(channel, "fifo_push_time", "%" SWITCH_TIME_T_FMT, switch_micro_time_now());
 		fifo_queue_push(node->fifo_list[p], call_event);
 		fifo_caller_add(node, session);
 		in_table = 1;
@@ -2766,6 +2897,8 @@ SWITCH_STANDARD_APP(fifo_function)
 
 		switch_mutex_unlock(node->update_mutex);
 
+		fifo_kick_dispatch();
+
 		ts = switch_micro_time_now();
 		switch_time_exp_lt(&tm, ts);
 		switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
@@ -3336,6 +3469,7 @@ SWITCH_STANDARD_APP(fifo_function)
 				originatee_cp->caller_id_number = switch_core_strdup(originatee_cp->pool, originator_cp->caller_id_number);
 
 				ts = switch_micro_time_now();
+				node_record_latency(node, other_channel, ts);
 				switch_time_exp_lt(&tm, ts);
 				epoch_start = (long)switch_epoch_time_now(NULL);
 				switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d %T", &tm);
@@ -4105,6 +4239,17 @@ static void list_node(fifo_node_t *node, switch_xml_t x_report, int *off, int ve
 
 	switch_xml_set_attr_d(x_fifo, "outbound_strategy", print_strategy(node->outbound_strategy));
 
+	switch_mutex_lock(node->update_mutex);
+	switch_snprintf(tmp, sizeof(buffer), "%u", node->bridge_count);
+	switch_xml_set_attr_d(x_fifo, "bridge_count", tmp);
+	switch_snprintf(tmp, sizeof(buffer), "%" SWITCH_TIME_T_FMT, node->bridge_count ? (node->latency_total / node->bridge_count) / 1000 : 0);
+	switch_xml_set_attr_d(x_fifo, "latency_avg_ms", tmp);
+	switch_snprintf(tmp, sizeof(buffer), "%" SWITCH_TIME_T_FMT, node->latency_max / 1000);
+	switch_xml_set_attr_d(x_fifo, "latency_max_ms", tmp);
+	switch_snprintf(tmp, sizeof(buffer), "%" SWITCH_TIME_T_FMT, node->latency_last / 1000);
+	switch_xml_set_attr_d(x_fifo, "latency_last_ms", tmp);
+	switch_mutex_unlock(node->update_mutex);
+
 	cc_off = xml_outbound(x_fifo, node, "outbound", "member", cc_off, verbose);
 	cc_off = xml_caller(x_fifo, node, "callers", "caller", cc_off, verbose);
 	cc_off = xml_hash(x_fifo, node->consumer_hash, "consumers", "consumer", cc_off, verbose);
@@ -4215,6 +4360,7 @@ SWITCH_STANDARD_API(fifo_api_function)
 
 	if (!strcasecmp(argv[0], "reparse")) {
 		load_config(1, argv[1] && !strcasecmp(argv[1], "del_all"));
+		fifo_kick_dispatch();
 		stream->write_function(stream, "+OK\n");
 		goto done;
 	}
@@ -4421,6 +4567,11 @@ static switch_status_t read_config_file(switch_xml_t *xml, switch_xml_t *cfg) {
 				globals.delete_all_members_on_startup = switch_true(val);
 			} else if (!strcasecmp(var, "disable-dtmf-moh-key") && !zstr(val)) {
 				globals.disable_dtmf_moh_key = switch_true(val);
+			} else if (!strcasecmp(var, "outbound-recheck-interval") && !zstr(val)) {
+				int tmp = atoi(val);
+				if (tmp > 0) {
+					globals.outbound_recheck_interval = tmp;
+				}
 			}
 		}
 	}
@@ -4452,6 +4603,7 @@ static switch_status_t load_config(int reload, int del_all)
 	globals.dbname = "fifo";
 	globals.default_strategy = NODE_STRATEGY_RINGALL;
 	globals.delete_all_members_on_startup = SWITCH_FALSE;
+	globals.outbound_recheck_interval = 5;
 
 	if ((status = read_config_file(&xml, &cfg)) != SWITCH_STATUS_SUCCESS) return status;
 
@@ -4720,6 +4872,8 @@ static void fifo_member_add(char *fifo_name, char *originate_string, int simo_co
 		node->has_outbound = 0;
 	}
 	switch_safe_free(sql);
+
+	fifo_kick_dispatch();
 }
 
 static void fifo_member_del(char *fifo_name, char *originate_string)
@@ -4760,6 +4914,8 @@ static void fifo_member_del(char *fifo_name, char *originate_string)
 		node->has_outbound = 0;
 	}
 	switch_safe_free(sql);
+
+	fifo_kick_dispatch();
 }
 
 #define FIFO_MEMBER_API_SYNTAX "[add <fifo_name> <originate_string> [<simo_count>] [<timeout>] [<lag>] [<expires>] [<taking_calls>] | del <fifo_name> <originate_string>]"
@@ -4878,6 +5034,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_fifo_load)
 	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
 	switch_mutex_init(&globals.use_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 	switch_mutex_init(&globals.sql_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.dispatch_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_thread_cond_create(&globals.dispatch_cond, globals.pool);
 
 	globals.running = 1;
 
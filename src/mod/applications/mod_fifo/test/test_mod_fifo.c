@@ -0,0 +1,178 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_fifo -- mod_fifo event driven outbound dispatch
+ *
+ */
+
+#include <test/switch_test.h>
+
+#define FIFO_TEST_NODE "fst@default"
+#define FIFO_TEST_DIALS 8
+
+/* the enterprise pre-dial and post-dial events seen for FIFO_TEST_NODE, in order */
+static struct {
+	switch_mutex_t *mutex;
+	char member[FIFO_TEST_DIALS][8];
+	int dials;
+	int failures;
+} fifo_test;
+
+static void fifo_test_event_handler(switch_event_t *event)
+{
+	const char *name = switch_event_get_header(event, "FIFO-Name");
+	const char *action = switch_event_get_header(event, "FIFO-Action");
+	const char *originate_string = switch_event_get_header(event, "originate_string");
+	const char *member;
+
+	if (!name || strcmp(name, FIFO_TEST_NODE) || !action || !originate_string) {
+		return;
+	}
+
+	member = strstr(originate_string, "fifo_test_member=");
+
+	switch_mutex_lock(fifo_test.mutex);
+	if (!strcmp(action, "pre-dial")) {
+		if (fifo_test.dials < FIFO_TEST_DIALS) {
+			switch_copy_string(fifo_test.member[fifo_test.dials], member ? member + strlen("fifo_test_member=") : "", 2);
+		}
+		fifo_test.dials++;
+	} else if (!strcmp(action, "post-dial")) {
+		fifo_test.failures++;
+	}
+	switch_mutex_unlock(fifo_test.mutex);
+}
+
+static int fifo_test_dials(void)
+{
+	int dials;
+
+	switch_mutex_lock(fifo_test.mutex);
+	dials = fifo_test.dials;
+	switch_mutex_unlock(fifo_test.mutex);
+
+	return dials;
+}
+
+static int fifo_test_failures(void)
+{
+	int failures;
+
+	switch_mutex_lock(fifo_test.mutex);
+	failures = fifo_test.failures;
+	switch_mutex_unlock(fifo_test.mutex);
+
+	return failures;
+}
+
+/* waits up to ms for the dial count to reach dials and returns how long it took, -1 on timeout */
+static int fifo_test_wait_dials(int dials, int ms)
+{
+	switch_time_t start = switch_time_now();
+
+	while (fifo_test_dials() < dials) {
+		if (switch_time_now() - start > ms * 1000) {
+			return -1;
+		}
+		switch_yield(50000);
+	}
+
+	return (int) ((switch_time_now() - start) / 1000);
+}
+
+static void fifo_test_api(const char *cmd, const char *args)
+{
+	switch_stream_handle_t stream = { 0 };
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute(cmd, args, NULL, &stream);
+	switch_safe_free(stream.data);
+}
+
+FST_CORE_BEGIN("conf")
+{
+	FST_MODULE_BEGIN(mod_fifo, mod_fifo_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_fifo");
+			switch_mutex_init(&fifo_test.mutex, SWITCH_MUTEX_NESTED, fst_pool);
+			switch_event_bind("test_mod_fifo", SWITCH_EVENT_CUSTOM, "fifo::info", fifo_test_event_handler, NULL);
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+			switch_event_unbind_callback(fifo_test_event_handler);
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(kicked_dispatch)
+		{
+			char uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
+			char *args;
+			int i, took;
+
+			/* members with a 60 second lag, so one that failed stays out of the rest of the test and
+			   the node would otherwise sit out the full 30 second outbound-recheck-interval */
+			fifo_test_api("fifo_member", "add " FIFO_TEST_NODE " {fifo_test_member=a}error/user_busy 1 10 60");
+			switch_yield(1000000);
+			fst_check_int_equals(fifo_test_dials(), 0);
+
+			/* a caller joining the queue kicks the node thread straight away */
+			switch_uuid_str(uuid, sizeof(uuid));
+			args = switch_mprintf("{origination_uuid=%s,fifo_music=silence_stream://-1}null/+15553334444 &fifo(" FIFO_TEST_NODE " in)", uuid);
+			fifo_test_api("originate", args);
+			switch_safe_free(args);
+
+			took = fifo_test_wait_dials(1, 3000);
+			fst_check(took >= 0);
+			fst_check_string_equals(fifo_test.member[0], "a");
+
+			for (i = 0; i < 30 && fifo_test_failures() < 1; i++) {
+				switch_yield(100000);
+			}
+			fst_check_int_equals(fifo_test_failures(), 1);
+
+			/* nobody left to dial, the node is parked until the recheck and must not spin on it */
+			switch_yield(2000000);
+			fst_check_int_equals(fifo_test_dials(), 1);
+
+			/* adding a member kicks the parked node rather than waiting out the recheck */
+			fifo_test_api("fifo_member", "add " FIFO_TEST_NODE " {fifo_test_member=b}error/user_busy 1 10 60");
+			took = fifo_test_wait_dials(2, 3000);
+			fst_check(took >= 0);
+			fst_check_string_equals(fifo_test.member[1], "b");
+
+			fifo_test_api("uuid_kill", uuid);
+			fifo_test_api("fifo_member", "del " FIFO_TEST_NODE " {fifo_test_member=a}error/user_busy");
+			fifo_test_api("fifo_member", "del " FIFO_TEST_NODE " {fifo_test_member=b}error/user_busy");
+			switch_yield(500000);
+		}
+		FST_TEST_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
@@ -43,15 +43,9 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown);
 SWITCH_MODULE_DEFINITION(mod_hash, mod_hash_load, mod_hash_shutdown, NULL);
 
 /* CORE STUFF */
-static struct {
-	switch_memory_pool_t *pool;
-	switch_thread_rwlock_t *limit_hash_rwlock;
-	switch_hash_t *limit_hash;
-	switch_thread_rwlock_t *db_hash_rwlock;
-	switch_hash_t *db_hash;
-	switch_thread_rwlock_t *remote_hash_rwlock;
-	switch_hash_t *remote_hash;
-} globals;
+#define LIMIT_HASH_SHARDS 64		/* < Must be a power of 2 */
+#define LIMIT_RATE_BUCKETS 8
+#define LIMIT_HASH_TOMBSTONES 4096
 
 typedef struct {
 	uint32_t total_usage;	/* < Total */
@@ -59,8 +53,38 @@ typedef struct {
 	time_t last_check;		/* < Last rate check */
 	uint32_t interval;		/* < Interval used on last rate check */
 	switch_time_t last_update;	/* < Last updated timestamp (rate or total) */
+	uint32_t seq;			/* < Sync sequence of the last local change */
+	time_t bucket_start;	/* < Start of buckets[0] */
+	uint32_t buckets[LIMIT_RATE_BUCKETS];	/* < Rate hits per slice of the interval, newest first */
 } limit_hash_item_t;
 
+typedef struct {
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t *hash;
+} limit_hash_shard_t;
+
+typedef struct {
+	char *key;
+	uint32_t seq;
+} limit_hash_tombstone_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	limit_hash_shard_t limit_shards[LIMIT_HASH_SHARDS];
+	switch_thread_rwlock_t *db_hash_rwlock;
+	switch_hash_t *db_hash;
+	switch_thread_rwlock_t *remote_hash_rwlock;
+	switch_hash_t *remote_hash;
+
+	/* incremental sync state, see hash_dump limit_delta */
+	switch_mutex_t *sync_mutex;
+	uint32_t sync_instance;
+	switch_atomic_t sync_seq;
+	uint32_t sync_floor;
+	limit_hash_tombstone_t tombstones[LIMIT_HASH_TOMBSTONES];
+	uint32_t tombstone_pos;
+} globals;
+
 struct callback {
 	char *buf;
 	size_t len;
@@ -111,6 +135,11 @@ typedef struct {
 	switch_thread_t *thread;
 
 	limit_remote_state_t state;
+
+	/* incremental sync position, see hash_dump limit_delta */
+	switch_bool_t delta;
+	uint32_t sync_instance;
+	uint32_t sync_seq;
 } limit_remote_t;
 
 static limit_hash_item_t get_remote_usage(const char *key);
@@ -118,6 +147,102 @@ void limit_remote_destroy(limit_remote_t **r);
 static void do_config(switch_bool_t reload);
 
 
+static inline limit_hash_shard_t *limit_shard(const char *key)
+{
+	switch_ssize_t klen = (switch_ssize_t) strlen(key);
+	uint32_t h = switch_hashfunc_default(key, &klen);
+
+	/* keep the shard choice apart from the bucket choice of the shard tables */
+	h = ((h >> 16) ^ h) * 0x45d9f3b;
+	h = (h >> 16) ^ h;
+
+	return &globals.limit_shards[h & (LIMIT_HASH_SHARDS - 1)];
+}
+
+/* !\brief Stamps an entry as changed for the incremental sync, call with its shard write locked
+ *
+ * Lock free, the entry just takes the sequence the next delta will report.
+ * limit_dump_delta() moves the sequence on before it walks the shards, so an
+ * entry changed while it walks is sent again next time instead of missed.
+ */
+static inline void limit_item_changed(limit_hash_item_t *item)
+{
+	item->seq = switch_atomic_read(&globals.sync_seq) + 1;
+}
+
+/* !\brief Remembers a deleted entry so the next delta tells the remotes to drop it */
+static void limit_item_deleted(const char *key)
+{
+	limit_hash_tombstone_t *ts;
+
+	switch_mutex_lock(globals.sync_mutex);
+	ts = &globals.tombstones[globals.tombstone_pos];
+	if (ts->key) {
+		/* a delta older than this can't be served anymore */
+		globals.sync_floor = ts->seq;
+		free(ts->key);
+	}
+	ts->key = strdup(key);
+	ts->seq = switch_atomic_read(&globals.sync_seq) + 1;
+	globals.tombstone_pos = (globals.tombstone_pos + 1) % LIMIT_HASH_TOMBSTONES;
+	switch_mutex_unlock(globals.sync_mutex);
+}
+
+/* !\brief Splits the rate interval in up to LIMIT_RATE_BUCKETS slices of whole seconds */
+static inline uint32_t limit_rate_slots(uint32_t interval, uint32_t *width)
+{
+	uint32_t slots = interval < LIMIT_RATE_BUCKETS ? interval : LIMIT_RATE_BUCKETS;
+
+	*width = (interval + slots - 1) / slots;
+	return (interval + *width - 1) / *width;
+}
+
+/* !\brief Sum of the hits still inside the sliding window, without touching the entry */
+static uint32_t limit_rate_peek(const limit_hash_item_t *item, time_t now)
+{
+	uint32_t width, slots, skip, i, sum = 0;
+
+	if (!item->interval) {
+		return item->rate_usage;
+	}
+
+	slots = limit_rate_slots(item->interval, &width);
+	skip = now > item->bucket_start ? (uint32_t) ((now - item->bucket_start) / width) : 0;
+
+	for (i = 0; i + skip < slots; i++) {
+		sum += item->buckets[i];
+	}
+
+	return sum;
+}
+
+/* !\brief Slides the rate window up to now and refreshes rate_usage, call with the shard write locked */
+static void limit_rate_advance(limit_hash_item_t *item, uint32_t interval, time_t now)
+{
+	uint32_t width, slots, shift;
+
+	if (item->interval != interval) {
+		memset(item->buckets, 0, sizeof(item->buckets));
+		item->interval = interval;
+		item->bucket_start = now;
+	}
+
+	slots = limit_rate_slots(interval, &width);
+
+	if (now >= item->bucket_start + (time_t) width) {
+		shift = (uint32_t) ((now - item->bucket_start) / width);
+		if (shift >= slots) {
+			memset(item->buckets, 0, sizeof(item->buckets));
+		} else {
+			memmove(item->buckets + shift, item->buckets, (slots - shift) * sizeof(item->buckets[0]));
+			memset(item->buckets, 0, shift * sizeof(item->buckets[0]));
+		}
+		item->bucket_start += (time_t) shift * width;
+	}
+
+	item->rate_usage = limit_rate_peek(item, now);
+}
+
 /* \brief Enforces limit_hash restrictions
  * \param session current session
  * \param realm limit realm
@@ -134,18 +259,12 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 	limit_hash_item_t *item = NULL;
 	time_t now = switch_epoch_time_now(NULL);
 	limit_hash_private_t *pvt = NULL;
+	limit_hash_shard_t *shard;
 	uint8_t increment = 1;
 	limit_hash_item_t remote_usage;
 
 	hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
-
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-	/* Check if that realm+resource has ever been checked */
-	if (!(item = (limit_hash_item_t *) switch_core_hash_find(globals.limit_hash, hashkey))) {
-		/* No, create an empty structure and add it, then continue like as if it existed */
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Creating new limit structure: key: %s\n", hashkey);
-		item = (limit_hash_item_t *)switch_core_hash_insert_alloc(globals.limit_hash, hashkey, sizeof(limit_hash_item_t));
-	}
+	shard = limit_shard(hashkey);
 
 	if (!(pvt = switch_channel_get_private(channel, "limit_hash"))) {
 		pvt = (limit_hash_private_t *) switch_core_session_alloc(session, sizeof(limit_hash_private_t));
@@ -158,23 +277,31 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 	increment = !switch_core_hash_find(pvt->hash, hashkey);
  	remote_usage = get_remote_usage(hashkey);
 
+	switch_thread_rwlock_wrlock(shard->rwlock);
+	/* Check if that realm+resource has ever been checked */
+	if (!(item = (limit_hash_item_t *) switch_core_hash_find(shard->hash, hashkey))) {
+		/* No, create an empty structure and add it, then continue like as if it existed */
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Creating new limit structure: key: %s\n", hashkey);
+		item = (limit_hash_item_t *)switch_core_hash_insert_alloc(shard->hash, hashkey, sizeof(limit_hash_item_t));
+	}
+
 	if (interval > 0) {
-		item->interval = interval;
-		if (item->last_check <= (now - interval)) {
-			item->rate_usage = 1;
-			item->last_check = now;
+		limit_rate_advance(item, interval, now);
+
+		/* Always increment rate when its checked as it doesnt depend on the channel */
+		item->buckets[0]++;
+		item->rate_usage++;
+		item->last_check = now;
+		limit_item_changed(item);
+
+		if (item->rate_usage == 1) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG10, "Usage for %s reset to 1\n",
 							  hashkey);
-		} else {
-			/* Always increment rate when its checked as it doesnt depend on the channel */
-			item->rate_usage++;
-
-			if ((max >= 0) && (item->rate_usage > (uint32_t) max)) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d/%ds, now at %d\n",
-								  hashkey, max, interval, item->rate_usage);
-				status = SWITCH_STATUS_GENERR;
-				goto end;
-			}
+		} else if ((max >= 0) && (item->rate_usage > (uint32_t) max)) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s exceeds maximum rate of %d/%ds, now at %d\n",
+							  hashkey, max, interval, item->rate_usage);
+			status = SWITCH_STATUS_GENERR;
+			goto end;
 		}
 	} else if ((max >= 0) && (item->total_usage + increment + remote_usage.total_usage > (uint32_t) max)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_INFO, "Usage for %s is already at max value (%d)\n", hashkey, item->total_usage);
@@ -184,6 +311,7 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 
 	if (increment) {
 		item->total_usage++;
+		limit_item_changed(item);
 
 		switch_core_hash_insert(pvt->hash, hashkey, item);
 
@@ -212,7 +340,7 @@ SWITCH_LIMIT_INCR(limit_incr_hash)
 	}
 
   end:
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+	switch_thread_rwlock_unlock(shard->rwlock);
 	return status;
 }
 
@@ -221,15 +349,16 @@ SWITCH_HASH_DELETE_FUNC(limit_hash_cleanup_delete_callback) {
 	limit_hash_item_t *item = (limit_hash_item_t *) val;
 	time_t now = switch_epoch_time_now(NULL);
 
-	/* reset to 0 if window has passed so we can clean it up */
-	if (item->rate_usage > 0 && (item->last_check <= (now - item->interval))) {
-		item->rate_usage = 0;
+	/* slide the window so we can clean it up once it is empty */
+	if (item->rate_usage > 0 && item->interval) {
+		limit_rate_advance(item, item->interval, now);
 	}
 
 	if (item->total_usage == 0 && item->rate_usage == 0) {
 		/* Noone is using this item anymore */
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Freeing limit item: %s\n", (const char *) key);
 
+		limit_item_deleted((const char *) key);
 		free(item);
 		return SWITCH_TRUE;
 	}
@@ -252,14 +381,33 @@ SWITCH_HASH_DELETE_FUNC(limit_hash_remote_cleanup_callback)
 /* !\brief Periodically checks for unused limit entries and frees them */
 SWITCH_STANDARD_SCHED_FUNC(limit_hash_cleanup_callback)
 {
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-	if (globals.limit_hash) {
-		switch_core_hash_delete_multi(globals.limit_hash, limit_hash_cleanup_delete_callback, NULL);
+	int i;
+
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
+
+		switch_thread_rwlock_wrlock(shard->rwlock);
+		if (shard->hash) {
+			switch_core_hash_delete_multi(shard->hash, limit_hash_cleanup_delete_callback, NULL);
+		}
+		switch_thread_rwlock_unlock(shard->rwlock);
 	}
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
-	if (globals.limit_hash) {
-		task->runtime = switch_epoch_time_now(NULL) + LIMIT_HASH_CLEANUP_INTERVAL;
+	task->runtime = switch_epoch_time_now(NULL) + LIMIT_HASH_CLEANUP_INTERVAL;
+}
+
+/* !\brief Drops one channel reference to an entry, call with its shard write locked */
+static void limit_release_item(switch_core_session_t *session, limit_hash_shard_t *shard, limit_hash_item_t *item, const char *key)
+{
+	item->total_usage--;
+	limit_item_changed(item);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", key, item->total_usage);
+
+	if (item->total_usage == 0 && limit_rate_peek(item, switch_epoch_time_now(NULL)) == 0) {
+		/* Noone is using this item anymore */
+		switch_core_hash_delete(shard->hash, key);
+		limit_item_deleted(key);
+		free(item);
 	}
 }
 
@@ -269,11 +417,9 @@ SWITCH_LIMIT_RELEASE(limit_release_hash)
 	switch_channel_t *channel = switch_core_session_get_channel(session);
 	limit_hash_private_t *pvt = switch_channel_get_private(channel, "limit_hash");
 	limit_hash_item_t *item = NULL;
-
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
+	limit_hash_shard_t *shard;
 
 	if (!pvt || !pvt->hash) {
-		switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 		return SWITCH_STATUS_SUCCESS;
 	}
 
@@ -289,14 +435,11 @@ SWITCH_LIMIT_RELEASE(limit_release_hash)
 			switch_core_hash_this(hi, &key, &keylen, &val);
 
 			item = (limit_hash_item_t *) val;
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", (const char *) key, item->total_usage);
+			shard = limit_shard((const char *) key);
 
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) key);
-				free(item);
-			}
+			switch_thread_rwlock_wrlock(shard->rwlock);
+			limit_release_item(session, shard, item, (const char *) key);
+			switch_thread_rwlock_unlock(shard->rwlock);
 
 			switch_core_hash_delete(pvt->hash, (const char *) key);
 		}
@@ -305,21 +448,16 @@ SWITCH_LIMIT_RELEASE(limit_release_hash)
 		char *hashkey = switch_core_session_sprintf(session, "%s_%s", realm, resource);
 
 		if ((item = (limit_hash_item_t *) switch_core_hash_find(pvt->hash, hashkey))) {
-			item->total_usage--;
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG, "Usage for %s is now %d\n", (const char *) hashkey, item->total_usage);
+			shard = limit_shard(hashkey);
 
 			switch_core_hash_delete(pvt->hash, hashkey);
 
-			if (item->total_usage == 0 && item->rate_usage == 0) {
-				/* Noone is using this item anymore */
-				switch_core_hash_delete(globals.limit_hash, (const char *) hashkey);
-				free(item);
-			}
+			switch_thread_rwlock_wrlock(shard->rwlock);
+			limit_release_item(session, shard, item, hashkey);
+			switch_thread_rwlock_unlock(shard->rwlock);
 		}
 	}
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
-
 	return SWITCH_STATUS_SUCCESS;
 }
 
@@ -327,24 +465,25 @@ SWITCH_LIMIT_USAGE(limit_usage_hash)
 {
 	char *hash_key = NULL;
 	limit_hash_item_t *item = NULL;
+	limit_hash_shard_t *shard;
 	int count = 0;
 	limit_hash_item_t remote_usage;
 
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
-
 	hash_key = switch_mprintf("%s_%s", realm, resource);
+	shard = limit_shard(hash_key);
 	remote_usage = get_remote_usage(hash_key);
 
 	count = remote_usage.total_usage;
 	*rcount = remote_usage.rate_usage;
 
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
+	switch_thread_rwlock_rdlock(shard->rwlock);
+	if ((item = switch_core_hash_find(shard->hash, hash_key))) {
 		count += item->total_usage;
-		*rcount += item->rate_usage;
+		*rcount += limit_rate_peek(item, switch_epoch_time_now(NULL));
 	}
+	switch_thread_rwlock_unlock(shard->rwlock);
 
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 
 	return count;
 }
@@ -358,39 +497,41 @@ SWITCH_LIMIT_INTERVAL_RESET(limit_interval_reset_hash)
 {
 	char *hash_key = NULL;
 	limit_hash_item_t *item = NULL;
-
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
+	limit_hash_shard_t *shard;
 
 	hash_key = switch_mprintf("%s_%s", realm, resource);
-	if ((item = switch_core_hash_find(globals.limit_hash, hash_key))) {
+	shard = limit_shard(hash_key);
+
+	switch_thread_rwlock_wrlock(shard->rwlock);
+	if ((item = switch_core_hash_find(shard->hash, hash_key))) {
+		memset(item->buckets, 0, sizeof(item->buckets));
 		item->rate_usage = 0;
-		item->last_check = switch_epoch_time_now(NULL);
+		item->last_check = item->bucket_start = switch_epoch_time_now(NULL);
+		limit_item_changed(item);
 	}
+	switch_thread_rwlock_unlock(shard->rwlock);
 
  	switch_safe_free(hash_key);
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	return SWITCH_STATUS_SUCCESS;
 }
 
 SWITCH_LIMIT_STATUS(limit_status_hash)
 {
-	/*
-	switch_hash_index_t *hi = NULL;
-	int count = 0;
-	char *ret = NULL;
+	int i, count = 0;
 
-	switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
 
-	for (hi = switch_core_hash_first(globals.limit_hash); hi; switch_core_hash_next(hi)) {
-		count++;
-	}
+		switch_hash_index_t *hi;
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+		switch_thread_rwlock_rdlock(shard->rwlock);
+		for (hi = switch_core_hash_first(shard->hash); hi; hi = switch_core_hash_next(&hi)) {
+			count++;
+		}
+		switch_thread_rwlock_unlock(shard->rwlock);
+	}
 
-	ret = switch_mprintf("There are %d elements being tracked.", count);
-	return ret;
-	*/
-	return strdup("-ERR not supported yet (locking problems).");
+	return switch_mprintf("There are %d elements being tracked.", count);
 }
 
 /* APP/API STUFF */
@@ -564,7 +705,86 @@ SWITCH_STANDARD_API(hash_api_function)
 	return SWITCH_STATUS_SUCCESS;
 }
 
-#define HASH_DUMP_SYNTAX "all|limit|db [<realm>]"
+typedef struct {
+	switch_stream_handle_t *stream;
+	uint32_t since;
+	time_t now;
+} limit_dump_helper_t;
+
+/* !\brief Writes the limit entries of every shard changed after helper->since
+ *
+ * Lines are L/key/usage/rate/interval/last_check, the rate being the
+ * hits still inside the sliding window.
+ */
+static void limit_dump(limit_dump_helper_t *helper)
+{
+	int i;
+
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
+		switch_hash_index_t *hi;
+
+		switch_thread_rwlock_rdlock(shard->rwlock);
+		for (hi = switch_core_hash_first(shard->hash); hi; hi = switch_core_hash_next(&hi)) {
+			void *val = NULL;
+			const void *key;
+			switch_ssize_t keylen;
+			limit_hash_item_t *item;
+			switch_core_hash_this(hi, &key, &keylen, &val);
+
+			item = (limit_hash_item_t *)val;
+
+			if (helper->since && item->seq <= helper->since) {
+				continue;
+			}
+
+			helper->stream->write_function(helper->stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, limit_rate_peek(item, helper->now),
+										   item->interval, item->last_check);
+		}
+		switch_thread_rwlock_unlock(shard->rwlock);
+	}
+}
+
+/* !\brief Incremental version of hash_dump limit, used by the remote sync
+ *
+ * The first line is S/<instance>/<seq>/<F|D>. With F the lines that
+ * follow are the full table, with D only the entries changed after
+ * <since> and an X/key line for each entry deleted since then.  The
+ * caller passes back the instance and seq it got to ask for the next
+ * delta; a restart, an unknown instance or a <since> too old for the
+ * kept tombstones gets a full dump instead.
+ */
+static void limit_dump_delta(switch_stream_handle_t *stream, uint32_t instance, uint32_t since)
+{
+	limit_dump_helper_t helper = { 0 };
+	uint32_t seq, i;
+	switch_bool_t full;
+
+	switch_mutex_lock(globals.sync_mutex);
+	/* close the current sequence, later changes are stamped past it */
+	switch_atomic_inc(&globals.sync_seq);
+	seq = switch_atomic_read(&globals.sync_seq);
+	full = (instance != globals.sync_instance || since > seq || since < globals.sync_floor) ? SWITCH_TRUE : SWITCH_FALSE;
+
+	stream->write_function(stream, "S/%u/%u/%s\n", globals.sync_instance, seq, full ? "F" : "D");
+
+	if (!full) {
+		for (i = 0; i < LIMIT_HASH_TOMBSTONES; i++) {
+			limit_hash_tombstone_t *ts = &globals.tombstones[i];
+			if (ts->key && ts->seq > since && ts->seq <= seq) {
+				stream->write_function(stream, "X/%s\n", ts->key);
+			}
+		}
+	}
+	switch_mutex_unlock(globals.sync_mutex);
+
+	helper.stream = stream;
+	helper.since = full ? 0 : since;
+	helper.now = switch_epoch_time_now(NULL);
+	limit_dump(&helper);
+}
+
+#define HASH_DUMP_SYNTAX "all|limit|db [<realm>]|limit_delta <instance> <seq>"
 SWITCH_STANDARD_API(hash_dump_function)
 {
 	int mode;
@@ -585,6 +805,11 @@ SWITCH_STANDARD_API(hash_dump_function)
 	argc = switch_separate_string(mydata, ' ', argv, (sizeof(argv) / sizeof(argv[0])));
 	cmd = argv[0];
 
+	if (!strcmp(cmd, "limit_delta")) {
+		limit_dump_delta(stream, argv[1] ? (uint32_t) strtoul(argv[1], NULL, 10) : 0, argv[2] ? (uint32_t) strtoul(argv[2], NULL, 10) : 0);
+		goto done;
+	}
+
 	if (argc == 2) {
 		realm = 1;
 		realmvalue = switch_mprintf("%s_", argv[1]);
@@ -602,19 +827,11 @@ SWITCH_STANDARD_API(hash_dump_function)
 	}
 
 	if (mode & 1) {
-		switch_thread_rwlock_rdlock(globals.limit_hash_rwlock);
-		for (hi = switch_core_hash_first(globals.limit_hash); hi; hi = switch_core_hash_next(&hi)) {
-			void *val = NULL;
-			const void *key;
-			switch_ssize_t keylen;
-			limit_hash_item_t *item;
-			switch_core_hash_this(hi, &key, &keylen, &val);
+		limit_dump_helper_t helper = { 0 };
 
-			item = (limit_hash_item_t *)val;
-
-			stream->write_function(stream, "L/%s/%d/%d/%d/%d\n", key, item->total_usage, item->rate_usage, item->interval, item->last_check);
-		}
-		switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
+		helper.stream = stream;
+		helper.now = switch_epoch_time_now(NULL);
+		limit_dump(&helper);
 	}
 
 	if (mode & 2) {
@@ -775,6 +992,7 @@ void limit_remote_destroy(limit_remote_t **r)
 static limit_hash_item_t get_remote_usage(const char *key) {
 	limit_hash_item_t usage = { 0 };
 	switch_hash_index_t *hi;
+	time_t now = switch_epoch_time_now(NULL);
 
 	switch_thread_rwlock_rdlock(globals.remote_hash_rwlock);
 	for (hi = switch_core_hash_first(globals.remote_hash); hi; hi = switch_core_hash_next(&hi)) {
@@ -793,7 +1011,10 @@ static limit_hash_item_t get_remote_usage(const char *key) {
 		switch_thread_rwlock_rdlock(remote->rwlock);
 		if ((item = switch_core_hash_find(remote->index, key))) {
 			usage.total_usage += item->total_usage;
-			usage.rate_usage += item->rate_usage;
+			/* deltas don't resend idle entries, so let the rate expire here */
+			if (!item->interval || item->last_check > now - (time_t) item->interval) {
+				usage.rate_usage += item->rate_usage;
+			}
 			if (!usage.last_check) {
 				usage.last_check = item->last_check;
 			}
@@ -816,12 +1037,22 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 					remote->name, remote->host, remote->port);
 
 				remote->state = REMOTE_UP;
+				remote->delta = SWITCH_TRUE;
+				remote->sync_instance = remote->sync_seq = 0;
 			} else {
 				esl_disconnect(&remote->handle);
 				memset(&remote->handle, 0, sizeof(remote->handle));
 			}
 		} else {
-			if (esl_send_recv_timed(&remote->handle, "api hash_dump limit", 5000) != ESL_SUCCESS) {
+			char cmd[128];
+
+			if (remote->delta) {
+				switch_snprintf(cmd, sizeof(cmd), "api hash_dump limit_delta %u %u", remote->sync_instance, remote->sync_seq);
+			} else {
+				switch_snprintf(cmd, sizeof(cmd), "api hash_dump limit");
+			}
+
+			if (esl_send_recv_timed(&remote->handle, cmd, 5000) != ESL_SUCCESS) {
 				esl_disconnect(&remote->handle);
 				memset(&remote->handle, 0, sizeof(remote->handle));
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Disconnected from remote FreeSWITCH (%s) at %s:%d\n",
@@ -833,13 +1064,27 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 				switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, NULL);
 				switch_thread_rwlock_unlock(remote->rwlock);
 			} else {
-				if (!zstr(remote->handle.last_sr_event->body)) {
-					char *data = strdup(remote->handle.last_sr_event->body);
+				const char *body = remote->handle.last_sr_event ? remote->handle.last_sr_event->body : NULL;
+				switch_bool_t full = SWITCH_TRUE;
+
+				if (remote->delta && (zstr(body) || strncmp(body, "S/", 2))) {
+					/* Older mod_hash on the other side, it only knows full dumps */
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Remote FreeSWITCH (%s) has no limit_delta, using full dumps\n", remote->name);
+					remote->delta = SWITCH_FALSE;
+					body = NULL;
+				}
+
+				if (!zstr(body)) {
+					char *data = strdup(body);
 					char *p = data, *p2;
 					switch_time_t now = switch_epoch_time_now(NULL);
+
+					switch_thread_rwlock_wrlock(remote->rwlock);
 					while (p && *p) {
 						/* We are getting the limit data as:
+							S/instance/seq/F|D (limit_delta only)
 							L/key/usage/rate/interval/last_checked
+							X/key (limit_delta only, deleted entry)
 						*/
 						if ((p2 = strchr(p, '\n'))) {
 							*p2++ = '\0';
@@ -847,7 +1092,19 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 
 						/* Now p points at the beginning of the current line,
 						p2 at the start of the next one */
-						if (*p == 'L') { /* Limit data */
+						if (*p == 'S') { /* Sync header */
+							char *argv[3];
+							int argc = switch_split(p+2, '/', argv);
+
+							if (argc < 3) {
+								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "[%s] Protocol error: missing argument in line: %s\n",
+									remote->name, p);
+							} else {
+								remote->sync_instance = (uint32_t) strtoul(argv[0], NULL, 10);
+								remote->sync_seq = (uint32_t) strtoul(argv[1], NULL, 10);
+								full = *argv[2] == 'F';
+							}
+						} else if (*p == 'L') { /* Limit data */
 							char *argv[5];
 							int argc = switch_split(p+2, '/', argv);
 
@@ -856,7 +1113,6 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 									remote->name, p);
 							} else {
 								limit_hash_item_t *item;
-								switch_thread_rwlock_wrlock(remote->rwlock);
 								if (!(item = switch_core_hash_find(remote->index, argv[0]))) {
 									switch_zmalloc(item, sizeof(*item));
 									switch_core_hash_insert_auto_free(remote->index, argv[0], item);
@@ -866,18 +1122,20 @@ static void *SWITCH_THREAD_FUNC limit_remote_thread(switch_thread_t *thread, voi
 								item->interval = atoi(argv[3]);
 								item->last_check = atoi(argv[4]);
 								item->last_update = now;
-								switch_thread_rwlock_unlock(remote->rwlock);
 							}
+						} else if (*p == 'X' && *(p+1) == '/') { /* Deleted entry */
+							switch_core_hash_delete(remote->index, p+2);
 						}
 
 						p = p2;
 					}
-					free(data);
 
-					/* Now free up anything that wasn't in this update since it means their usage is 0 */
-					switch_thread_rwlock_wrlock(remote->rwlock);
-					switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, (void*)(intptr_t)now);
+					if (full) {
+						/* Now free up anything that wasn't in this update since it means their usage is 0 */
+						switch_core_hash_delete_multi(remote->index, limit_hash_remote_cleanup_callback, (void*)(intptr_t)now);
+					}
 					switch_thread_rwlock_unlock(remote->rwlock);
+					free(data);
 				}
 			}
 		}
@@ -944,6 +1202,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 	switch_api_interface_t *commands_api_interface;
 	switch_limit_interface_t *limit_interface;
 	switch_status_t status;
+	int i;
 
 	memset(&globals, 0, sizeof(globals));
 	globals.pool = pool;
@@ -954,10 +1213,15 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_hash_load)
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_thread_rwlock_create(&globals.limit_hash_rwlock, globals.pool);
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		switch_thread_rwlock_create(&globals.limit_shards[i].rwlock, globals.pool);
+		switch_core_hash_init(&globals.limit_shards[i].hash);
+	}
+	switch_mutex_init(&globals.sync_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	/* tells the remotes a restart apart from a quiet table */
+	globals.sync_instance = (uint32_t) switch_micro_time_now();
 	switch_thread_rwlock_create(&globals.db_hash_rwlock, globals.pool);
 	switch_thread_rwlock_create(&globals.remote_hash_rwlock, globals.pool);
-	switch_core_hash_init(&globals.limit_hash);
 	switch_core_hash_init(&globals.db_hash);
 	switch_core_hash_init(&globals.remote_hash);
 
@@ -994,6 +1258,7 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 {
 	switch_hash_index_t *hi = NULL;
 	switch_bool_t remote_clean = SWITCH_TRUE;
+	int i;
 
 	switch_scheduler_del_task_group("mod_hash");
 
@@ -1021,17 +1286,30 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 		}
 	}
 
-	switch_thread_rwlock_wrlock(globals.limit_hash_rwlock);
-	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
+	for (i = 0; i < LIMIT_HASH_SHARDS; i++) {
+		limit_hash_shard_t *shard = &globals.limit_shards[i];
 
-	while ((hi = switch_core_hash_first_iter( globals.limit_hash, hi))) {
-		void *val = NULL;
-		const void *key;
-		switch_ssize_t keylen;
-		switch_core_hash_this(hi, &key, &keylen, &val);
-		free(val);
-		switch_core_hash_delete(globals.limit_hash, key);
+		switch_thread_rwlock_wrlock(shard->rwlock);
+		while ((hi = switch_core_hash_first_iter(shard->hash, hi))) {
+			void *val = NULL;
+			const void *key;
+			switch_ssize_t keylen;
+			switch_core_hash_this(hi, &key, &keylen, &val);
+			free(val);
+			switch_core_hash_delete(shard->hash, key);
+		}
+		switch_core_hash_destroy(&shard->hash);
+		switch_thread_rwlock_unlock(shard->rwlock);
+		switch_thread_rwlock_destroy(shard->rwlock);
+	}
+
+	switch_mutex_lock(globals.sync_mutex);
+	for (i = 0; i < LIMIT_HASH_TOMBSTONES; i++) {
+		switch_safe_free(globals.tombstones[i].key);
 	}
+	switch_mutex_unlock(globals.sync_mutex);
+
+	switch_thread_rwlock_wrlock(globals.db_hash_rwlock);
 
 	while ((hi = switch_core_hash_first_iter( globals.db_hash, hi))) {
 		void *val = NULL;
@@ -1042,15 +1320,12 @@ SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_hash_shutdown)
 		switch_core_hash_delete(globals.db_hash, key);
 	}
 
-	switch_core_hash_destroy(&globals.limit_hash);
 	switch_core_hash_destroy(&globals.db_hash);
 	switch_core_hash_destroy(&globals.remote_hash);
 
-	switch_thread_rwlock_unlock(globals.limit_hash_rwlock);
 	switch_thread_rwlock_unlock(globals.db_hash_rwlock);
 
 	switch_thread_rwlock_destroy(globals.db_hash_rwlock);
-	switch_thread_rwlock_destroy(globals.limit_hash_rwlock);
 	switch_thread_rwlock_destroy(globals.remote_hash_rwlock);
 
 
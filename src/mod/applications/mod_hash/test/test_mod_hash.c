@@ -0,0 +1,211 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_hash -- mod_hash limit backend tests
+ *
+ */
+
+#include <test/switch_test.h>
+
+static char *hash_api(const char *cmd, const char *args)
+{
+	switch_stream_handle_t stream = { 0 };
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute(cmd, args, NULL, &stream);
+
+	return (char *) stream.data;
+}
+
+/* Reads the instance and sequence out of the S/<instance>/<seq>/<F|D> header */
+static switch_bool_t parse_sync_header(const char *dump, uint32_t *instance, uint32_t *seq, char *mode)
+{
+	return (dump && sscanf(dump, "S/%u/%u/%c", instance, seq, mode) == 3) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+FST_CORE_BEGIN("conf")
+{
+	FST_MODULE_BEGIN(mod_hash, mod_hash_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			char *res;
+
+			fst_requires_module("mod_hash");
+
+			/* keep the loopback remote out of the way until limit_remote_sync brings it back */
+			res = hash_api("hash_remote", "kill self");
+			switch_safe_free(res);
+		}
+		FST_SETUP_END()
+
+		FST_SESSION_BEGIN(limit_usage)
+		{
+			uint32_t rcount = 0;
+			char resource[32];
+			int i;
+
+			/* enough resources to land in every shard */
+			for (i = 0; i < 500; i++) {
+				switch_snprintf(resource, sizeof(resource), "res%d", i);
+				fst_check(switch_limit_incr("hash", fst_session, "usage", resource, 1, 0) == SWITCH_STATUS_SUCCESS);
+			}
+
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res0", &rcount), 1);
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res499", &rcount), 1);
+
+			/* the same channel only counts once per resource */
+			fst_check(switch_limit_incr("hash", fst_session, "usage", "res7", 1, 0) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res7", &rcount), 1);
+
+			fst_check(switch_limit_release("hash", fst_session, "usage", "res7") == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res7", &rcount), 0);
+
+			fst_check(switch_limit_release("hash", fst_session, NULL, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res0", &rcount), 0);
+			fst_check_int_equals(switch_limit_usage("hash", "usage", "res499", &rcount), 0);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(limit_rate_window)
+		{
+			uint32_t rcount = 0;
+
+			fst_check(switch_limit_incr("hash", fst_session, "rate", "cps", 3, 2) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hash", fst_session, "rate", "cps", 3, 2) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hash", fst_session, "rate", "cps", 3, 2) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_limit_incr("hash", fst_session, "rate", "cps", 3, 2) != SWITCH_STATUS_SUCCESS);
+
+			switch_limit_usage("hash", "rate", "cps", &rcount);
+			fst_check_int_equals(rcount, 4);
+
+			/* once the interval went by, the window is empty again */
+			switch_sleep(2100000);
+			switch_limit_usage("hash", "rate", "cps", &rcount);
+			fst_check_int_equals(rcount, 0);
+			fst_check(switch_limit_incr("hash", fst_session, "rate", "cps", 3, 2) == SWITCH_STATUS_SUCCESS);
+
+			fst_check(switch_limit_interval_reset("hash", "rate", "cps") == SWITCH_STATUS_SUCCESS);
+			switch_limit_usage("hash", "rate", "cps", &rcount);
+			fst_check_int_equals(rcount, 0);
+
+			switch_limit_release("hash", fst_session, NULL, NULL);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(limit_delta_dump)
+		{
+			uint32_t instance = 0, seq = 0, seq2 = 0, instance2 = 0;
+			char mode = 0;
+			char *dump, *args;
+
+			dump = hash_api("hash_dump", "limit_delta 0 0");
+			fst_requires(parse_sync_header(dump, &instance, &seq, &mode));
+			fst_check(mode == 'F');
+			switch_safe_free(dump);
+
+			fst_check(switch_limit_incr("hash", fst_session, "delta", "d1", -1, 0) == SWITCH_STATUS_SUCCESS);
+
+			args = switch_mprintf("limit_delta %u %u", instance, seq);
+			dump = hash_api("hash_dump", args);
+			fst_requires(parse_sync_header(dump, &instance2, &seq2, &mode));
+			fst_check(mode == 'D');
+			fst_check(instance2 == instance);
+			fst_check(seq2 > seq);
+			fst_check(strstr(dump, "L/delta_d1/1/") != NULL);
+			switch_safe_free(dump);
+			switch_safe_free(args);
+
+			/* nothing changed, nothing sent */
+			args = switch_mprintf("limit_delta %u %u", instance, seq2);
+			dump = hash_api("hash_dump", args);
+			fst_check(strstr(dump, "delta_d1") == NULL);
+			switch_safe_free(dump);
+			switch_safe_free(args);
+
+			switch_limit_release("hash", fst_session, "delta", "d1");
+
+			args = switch_mprintf("limit_delta %u %u", instance, seq2);
+			dump = hash_api("hash_dump", args);
+			fst_check(strstr(dump, "X/delta_d1\n") != NULL);
+			switch_safe_free(dump);
+			switch_safe_free(args);
+
+			/* a different instance always gets the whole table */
+			args = switch_mprintf("limit_delta %u %u", instance + 1, seq2);
+			dump = hash_api("hash_dump", args);
+			fst_requires(parse_sync_header(dump, &instance2, &seq2, &mode));
+			fst_check(mode == 'F');
+			switch_safe_free(dump);
+			switch_safe_free(args);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(limit_remote_sync)
+		{
+			uint32_t rcount = 0;
+			int i, usage = 0;
+			char *list = NULL;
+
+			list = hash_api("hash_remote", "rescan");
+			switch_safe_free(list);
+
+			for (i = 0; i < 50; i++) {
+				list = hash_api("hash_remote", "list");
+				if (list && strstr(list, "self\t\t\tUp")) {
+					break;
+				}
+				switch_safe_free(list);
+				switch_sleep(100000);
+			}
+			fst_requires(list != NULL);
+			switch_safe_free(list);
+
+			/* the remote copy of our own usage shows up through the deltas */
+			fst_check(switch_limit_incr("hash", fst_session, "remote", "r1", -1, 0) == SWITCH_STATUS_SUCCESS);
+			for (i = 0; i < 50 && usage != 2; i++) {
+				switch_sleep(100000);
+				usage = switch_limit_usage("hash", "remote", "r1", &rcount);
+			}
+			fst_check_int_equals(usage, 2);
+
+			/* and goes away with the tombstone */
+			switch_limit_release("hash", fst_session, "remote", "r1");
+			for (i = 0; i < 50 && usage != 0; i++) {
+				switch_sleep(100000);
+				usage = switch_limit_usage("hash", "remote", "r1", &rcount);
+			}
+			fst_check_int_equals(usage, 0);
+		}
+		FST_SESSION_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
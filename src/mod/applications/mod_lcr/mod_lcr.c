@@ -34,7 +34,7 @@
 #include <switch.h>
 
 #define LCR_SYNTAX "lcr <digits> [<lcr profile>] [caller_id] [intrastate] [as xml]"
-#define LCR_ADMIN_SYNTAX "lcr_admin show profiles"
+#define LCR_ADMIN_SYNTAX "lcr_admin show profiles|reload rates [<profile>]|bench <profile> <digits> [<iterations>]"
 
 #define LCR_HEADERS_COUNT 7
 
@@ -100,6 +100,60 @@ typedef lcr_obj_t *lcr_route;
 typedef struct max_obj max_obj_t;
 typedef max_obj_t *max_len;
 
+/* in memory rate tables, see lcr_rates_load() */
+#define LCR_RATE_DEFAULT 0
+#define LCR_RATE_INTRASTATE 1
+#define LCR_RATE_INTRALATA 2
+#define LCR_RATE_FIELDS 3
+
+#define LCR_ORDER_RATE 0
+#define LCR_ORDER_QUALITY 1
+#define LCR_ORDER_RELIABILITY 2
+#define LCR_MAX_ORDER 8
+
+struct lcr_mem_route {
+	const char *digits;
+	size_t digit_len;
+	const char *carrier_name;
+	const char *rate_str[LCR_RATE_FIELDS];
+	float rate[LCR_RATE_FIELDS];
+	const char *gw_prefix;
+	const char *gw_suffix;
+	const char *lead_strip;
+	const char *trail_strip;
+	const char *prefix;
+	const char *suffix;
+	const char *codec;
+	const char *cid;
+	float quality;
+	float reliability;
+	switch_time_t date_start;
+	switch_time_t date_end;
+};
+typedef struct lcr_mem_route lcr_mem_route_t;
+
+/* one node per distinct digit prefix, children are packed and indexed
+ * through child_mask so a node costs the same whatever its fan out */
+struct lcr_trie_node {
+	uint16_t child_mask;
+	uint32_t route_count;
+	lcr_mem_route_t **routes;
+	struct lcr_trie_node *children;
+};
+typedef struct lcr_trie_node lcr_trie_node_t;
+
+struct lcr_rate_table {
+	switch_memory_pool_t *pool;
+	switch_thread_rwlock_t *rwlock;
+	/* [0] routes matched on the dialed digits, [1] routes flagged lrn */
+	lcr_trie_node_t root[2];
+	uint32_t route_count;
+	uint32_t node_count;
+	switch_time_t loaded;
+	switch_time_t load_usec;
+};
+typedef struct lcr_rate_table lcr_rate_table_t;
+
 struct profile_obj {
 	char *name;
 	uint16_t id;
@@ -120,6 +174,11 @@ struct profile_obj {
 	switch_bool_t single_bridge;
 	switch_bool_t info_in_headers;
 	switch_bool_t enable_sip_redir;
+
+	switch_bool_t in_memory;
+	int mem_order[LCR_MAX_ORDER];
+	int mem_order_cnt;
+	lcr_rate_table_t *rates;
 };
 typedef struct profile_obj profile_t;
 
@@ -892,6 +951,438 @@ static switch_status_t is_intrastatelata(callback_t *cb_struct)
 
 }
 
+/* column names handed to route_add_callback() for in memory routes, same as the default sql */
+#define LCR_MEM_COLUMNS 11
+static char *lcr_mem_columns[LCR_MEM_COLUMNS] = {
+	"lcr_digits",
+	"lcr_carrier_name",
+	"lcr_rate_field",
+	"lcr_gw_prefix",
+	"lcr_gw_suffix",
+	"lcr_lead_strip",
+	"lcr_trail_strip",
+	"lcr_prefix",
+	"lcr_suffix",
+	"lcr_codec",
+	"lcr_cid",
+};
+
+typedef struct {
+	lcr_rate_table_t *table;
+	profile_t *profile;
+	switch_hash_t *strings;
+	switch_hash_t *dates;
+	lcr_mem_route_t **routes[2];
+	uint32_t count[2];
+	uint32_t size[2];
+	uint32_t skipped;
+} lcr_rates_load_t;
+
+static const char *lcr_rates_intern(lcr_rates_load_t *ld, const char *str)
+{
+	char *val;
+
+	if (!str) {
+		return NULL;
+	}
+
+	if (!(val = switch_core_hash_find(ld->strings, str))) {
+		val = switch_core_strdup(ld->table->pool, str);
+		switch_core_hash_insert(ld->strings, str, val);
+	}
+
+	return val;
+}
+
+/* date_start and date_end are UTC, the clock lcr_query_now gives the sql lookups */
+static switch_time_t lcr_parse_utc(const char *str)
+{
+	switch_time_exp_t tm = { 0 };
+	switch_time_t t = 0;
+	int year = 0, mon = 0, mday = 0, hour = 0, min = 0, sec = 0;
+
+	if (sscanf(str, "%d-%d-%d%*c%d:%d:%d", &year, &mon, &mday, &hour, &min, &sec) < 3) {
+		return 0;
+	}
+
+	tm.tm_year = year - 1900;
+	tm.tm_mon = mon - 1;
+	tm.tm_mday = mday;
+	tm.tm_hour = hour;
+	tm.tm_min = min;
+	tm.tm_sec = sec;
+
+	if (switch_time_exp_gmt_get(&t, &tm) != SWITCH_STATUS_SUCCESS) {
+		return 0;
+	}
+
+	return t;
+}
+
+static void lcr_format_utc(char *buf, switch_size_t len, switch_time_t t)
+{
+	switch_time_exp_t tm;
+	switch_size_t retsize;
+
+	switch_time_exp_gmt(&tm, t);
+	switch_strftime_nocheck(buf, &retsize, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static switch_time_t lcr_rates_date(lcr_rates_load_t *ld, const char *str)
+{
+	switch_time_t *val;
+
+	if (zstr(str)) {
+		return 0;
+	}
+
+	/* rate decks share a handful of dates, don't run the parser for each row */
+	if (!(val = switch_core_hash_find(ld->dates, str))) {
+		val = switch_core_alloc(ld->table->pool, sizeof(*val));
+		*val = lcr_parse_utc(str);
+		switch_core_hash_insert(ld->dates, str, val);
+	}
+
+	return *val;
+}
+
+static int lcr_rates_load_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	lcr_rates_load_t *ld = (lcr_rates_load_t *) pArg;
+	lcr_mem_route_t *route;
+	const char *p;
+	int i, lrn;
+
+	if (argc < 18 || zstr(argv[0])) {
+		ld->skipped++;
+		return 0;
+	}
+
+	for (p = argv[0]; *p; p++) {
+		if (!switch_isdigit(*p)) {
+			ld->skipped++;
+			return 0;
+		}
+	}
+
+	route = switch_core_alloc(ld->table->pool, sizeof(*route));
+	route->digits = switch_core_strdup(ld->table->pool, argv[0]);
+	route->digit_len = strlen(argv[0]);
+	route->carrier_name = lcr_rates_intern(ld, switch_str_nil(argv[1]));
+	for (i = 0; i < LCR_RATE_FIELDS; i++) {
+		if (!zstr(argv[2 + i])) {
+			route->rate[i] = (float)atof(argv[2 + i]);
+			route->rate_str[i] = lcr_rates_intern(ld, argv[2 + i]);
+		}
+	}
+	route->gw_prefix = lcr_rates_intern(ld, switch_str_nil(argv[5]));
+	route->gw_suffix = lcr_rates_intern(ld, switch_str_nil(argv[6]));
+	route->lead_strip = lcr_rates_intern(ld, switch_str_nil(argv[7]));
+	route->trail_strip = lcr_rates_intern(ld, switch_str_nil(argv[8]));
+	route->prefix = lcr_rates_intern(ld, switch_str_nil(argv[9]));
+	route->suffix = lcr_rates_intern(ld, switch_str_nil(argv[10]));
+	route->codec = lcr_rates_intern(ld, argv[11]);
+	route->cid = lcr_rates_intern(ld, argv[12]);
+	route->quality = (float)atof(switch_str_nil(argv[13]));
+	route->reliability = (float)atof(switch_str_nil(argv[14]));
+	route->date_start = lcr_rates_date(ld, argv[15]);
+	route->date_end = lcr_rates_date(ld, argv[16]);
+
+	lrn = switch_true(argv[17]) ? 1 : 0;
+
+	if (ld->count[lrn] == ld->size[lrn]) {
+		ld->size[lrn] = ld->size[lrn] ? ld->size[lrn] * 2 : 1024;
+		ld->routes[lrn] = realloc(ld->routes[lrn], ld->size[lrn] * sizeof(lcr_mem_route_t *));
+		switch_assert(ld->routes[lrn]);
+	}
+	ld->routes[lrn][ld->count[lrn]++] = route;
+
+	return 0;
+}
+
+static int lcr_mem_route_cmp(const void *a, const void *b)
+{
+	return strcmp((*(lcr_mem_route_t * const *) a)->digits, (*(lcr_mem_route_t * const *) b)->digits);
+}
+
+/* routes are sorted by digits, so the ones ending at this depth come first
+ * and the rest fall into runs sharing the next digit */
+static void lcr_trie_build(lcr_rate_table_t *table, lcr_trie_node_t *node, lcr_mem_route_t **routes, uint32_t count, size_t depth)
+{
+	uint32_t i = 0, start, end;
+	int nchild = 0;
+
+	while (i < count && routes[i]->digit_len == depth) {
+		i++;
+	}
+
+	if (i) {
+		node->routes = switch_core_alloc(table->pool, i * sizeof(lcr_mem_route_t *));
+		memcpy(node->routes, routes, i * sizeof(lcr_mem_route_t *));
+		node->route_count = i;
+	}
+
+	for (start = i; start < count; start = end) {
+		char d = routes[start]->digits[depth];
+		for (end = start; end < count && routes[end]->digits[depth] == d; end++);
+		node->child_mask |= (uint16_t)(1 << (d - '0'));
+		nchild++;
+	}
+
+	if (!nchild) {
+		return;
+	}
+
+	node->children = switch_core_alloc(table->pool, nchild * sizeof(lcr_trie_node_t));
+	table->node_count += nchild;
+
+	for (start = i, nchild = 0; start < count; start = end, nchild++) {
+		char d = routes[start]->digits[depth];
+		for (end = start; end < count && routes[end]->digits[depth] == d; end++);
+		lcr_trie_build(table, &node->children[nchild], routes + start, end - start, depth + 1);
+	}
+}
+
+static lcr_trie_node_t *lcr_trie_child(lcr_trie_node_t *node, char c)
+{
+	uint16_t bit, below;
+	int idx = 0;
+
+	if (!switch_isdigit(c)) {
+		return NULL;
+	}
+
+	bit = (uint16_t)(1 << (c - '0'));
+	if (!(node->child_mask & bit)) {
+		return NULL;
+	}
+
+	for (below = node->child_mask & (bit - 1); below; below &= below - 1) {
+		idx++;
+	}
+
+	return &node->children[idx];
+}
+
+static void lcr_rates_destroy(lcr_rate_table_t **tablep)
+{
+	lcr_rate_table_t *table = *tablep;
+	switch_memory_pool_t *pool;
+
+	if (!table) {
+		return;
+	}
+
+	*tablep = NULL;
+
+	/* wait out any lookup still walking it */
+	switch_thread_rwlock_wrlock(table->rwlock);
+	switch_thread_rwlock_unlock(table->rwlock);
+
+	pool = table->pool;
+	switch_core_destroy_memory_pool(&pool);
+}
+
+/* Pull the whole rate deck of a profile into a fresh table and swap it in.
+ * Lookups keep using the old table until the swap, then it is freed once
+ * the last of them is done. Expired and not yet started routes are loaded
+ * too, each lookup checks date_start..date_end against its own clock. */
+static switch_status_t lcr_rates_load(profile_t *profile)
+{
+	switch_stream_handle_t sql_stream = { 0 };
+	switch_memory_pool_t *pool = NULL;
+	lcr_rates_load_t ld = { 0 };
+	lcr_rate_table_t *table, *old;
+	switch_time_t start = switch_micro_time_now();
+	switch_status_t status;
+	int i;
+
+	switch_core_new_memory_pool(&pool);
+	table = switch_core_alloc(pool, sizeof(*table));
+	table->pool = pool;
+	switch_thread_rwlock_create(&table->rwlock, pool);
+
+	ld.table = table;
+	ld.profile = profile;
+	switch_core_hash_init(&ld.strings);
+	switch_core_hash_init(&ld.dates);
+
+	SWITCH_STANDARD_STREAM(sql_stream);
+	sql_stream.write_function(&sql_stream,
+							  "SELECT l.digits, c.carrier_name, l.rate, %s, %s, cg.prefix, cg.suffix, l.lead_strip, l.trail_strip, "
+							  "l.prefix, l.suffix, cg.codec, l.cid, l.quality, l.reliability, l.date_start, l.date_end, l.lrn "
+							  "FROM lcr l JOIN carriers c ON l.carrier_id=c.id JOIN carrier_gateway cg ON c.id=cg.carrier_id "
+							  "WHERE c.enabled = '1' AND cg.enabled = '1' AND l.enabled = '1'",
+							  profile->profile_has_intrastate ? "l.intrastate_rate" : "NULL",
+							  profile->profile_has_intralata ? "l.intralata_rate" : "NULL");
+	if (profile->id > 0) {
+		sql_stream.write_function(&sql_stream, " AND lcr_profile=%d", profile->id);
+	}
+
+	status = lcr_execute_sql_callback((char *)sql_stream.data, lcr_rates_load_callback, &ld);
+	switch_safe_free(sql_stream.data);
+
+	switch_core_hash_destroy(&ld.strings);
+	switch_core_hash_destroy(&ld.dates);
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		for (i = 0; i < 2; i++) {
+			if (ld.count[i]) {
+				qsort(ld.routes[i], ld.count[i], sizeof(lcr_mem_route_t *), lcr_mem_route_cmp);
+				lcr_trie_build(table, &table->root[i], ld.routes[i], ld.count[i], 0);
+			}
+			table->route_count += ld.count[i];
+		}
+	}
+
+	switch_safe_free(ld.routes[0]);
+	switch_safe_free(ld.routes[1]);
+
+	if (status != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to load rates for profile %s\n", profile->name);
+		switch_core_destroy_memory_pool(&pool);
+		return status;
+	}
+
+	table->loaded = switch_micro_time_now();
+	table->load_usec = table->loaded - start;
+
+	switch_mutex_lock(globals.mutex);
+	old = profile->rates;
+	profile->rates = table;
+	switch_mutex_unlock(globals.mutex);
+
+	lcr_rates_destroy(&old);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded %u rates (%u skipped, %u nodes) for profile %s in %" SWITCH_TIME_T_FMT "ms\n",
+					  table->route_count, ld.skipped, table->node_count, profile->name, table->load_usec / 1000);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+typedef struct {
+	lcr_mem_route_t *route;
+	float rate;
+	uint32_t rnd;
+} lcr_mem_match_t;
+
+/* mirrors ORDER BY digits DESC, <profile order_by>, random() */
+static int lcr_mem_match_cmp(profile_t *profile, lcr_mem_match_t *a, lcr_mem_match_t *b)
+{
+	int i;
+
+	if (a->route->digit_len != b->route->digit_len) {
+		return a->route->digit_len > b->route->digit_len ? -1 : 1;
+	}
+
+	for (i = 0; i < profile->mem_order_cnt; i++) {
+		switch (profile->mem_order[i]) {
+		case LCR_ORDER_RATE:
+			if (a->rate != b->rate) {
+				return a->rate < b->rate ? -1 : 1;
+			}
+			break;
+		case LCR_ORDER_QUALITY:
+			if (a->route->quality != b->route->quality) {
+				return a->route->quality > b->route->quality ? -1 : 1;
+			}
+			break;
+		case LCR_ORDER_RELIABILITY:
+			if (a->route->reliability != b->route->reliability) {
+				return a->route->reliability > b->route->reliability ? -1 : 1;
+			}
+			break;
+		}
+	}
+
+	return a->rnd < b->rnd ? -1 : (a->rnd > b->rnd ? 1 : 0);
+}
+
+static void lcr_mem_collect(lcr_trie_node_t *node, const char *digits, int rate_index, switch_time_t now,
+							lcr_mem_match_t **matches, uint32_t *count, uint32_t *size)
+{
+	const char *p;
+	uint32_t i;
+
+	for (p = digits; *p && (node = lcr_trie_child(node, *p)); p++) {
+		for (i = 0; i < node->route_count; i++) {
+			lcr_mem_route_t *route = node->routes[i];
+
+			if ((route->date_start && now < route->date_start) || (route->date_end && now > route->date_end)) {
+				continue;
+			}
+
+			if (*count == *size) {
+				*size = *size ? *size * 2 : 32;
+				*matches = realloc(*matches, *size * sizeof(lcr_mem_match_t));
+				switch_assert(*matches);
+			}
+
+			(*matches)[*count].route = route;
+			(*matches)[*count].rate = route->rate[rate_index];
+			(*matches)[*count].rnd = (uint32_t) rand();
+			(*count)++;
+		}
+	}
+}
+
+static switch_status_t lcr_mem_lookup(callback_t *cb_struct, const char *digits, const char *lrn_digits, int rate_index, switch_time_t now)
+{
+	profile_t *profile = cb_struct->profile;
+	lcr_rate_table_t *table;
+	lcr_mem_match_t *matches = NULL;
+	uint32_t count = 0, size = 0, i, j;
+
+	switch_mutex_lock(globals.mutex);
+	if ((table = profile->rates)) {
+		switch_thread_rwlock_rdlock(table->rwlock);
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	if (!table) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(cb_struct->session), SWITCH_LOG_ERROR, "No rates loaded for profile %s\n", profile->name);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	lcr_mem_collect(&table->root[0], digits, rate_index, now, &matches, &count, &size);
+	lcr_mem_collect(&table->root[1], lrn_digits, rate_index, now, &matches, &count, &size);
+
+	/* a lookup only ever matches a handful of routes, insertion sort is plenty */
+	for (i = 1; i < count; i++) {
+		lcr_mem_match_t tmp = matches[i];
+		for (j = i; j > 0 && lcr_mem_match_cmp(profile, &tmp, &matches[j - 1]) < 0; j--) {
+			matches[j] = matches[j - 1];
+		}
+		matches[j] = tmp;
+	}
+
+	for (i = 0; i < count; i++) {
+		lcr_mem_route_t *route = matches[i].route;
+		char *argv[LCR_MEM_COLUMNS];
+
+		argv[0] = (char *) route->digits;
+		argv[1] = (char *) route->carrier_name;
+		argv[2] = (char *) route->rate_str[rate_index];
+		argv[3] = (char *) route->gw_prefix;
+		argv[4] = (char *) route->gw_suffix;
+		argv[5] = (char *) route->lead_strip;
+		argv[6] = (char *) route->trail_strip;
+		argv[7] = (char *) route->prefix;
+		argv[8] = (char *) route->suffix;
+		argv[9] = (char *) route->codec;
+		argv[10] = (char *) route->cid;
+
+		if (route_add_callback(cb_struct, LCR_MEM_COLUMNS, argv, lcr_mem_columns)) {
+			break;
+		}
+	}
+
+	switch_thread_rwlock_unlock(table->rwlock);
+	switch_safe_free(matches);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 {
 	switch_stream_handle_t sql_stream = { 0 };
@@ -906,9 +1397,15 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	char *safe_sql = NULL;
 	char *rate_field = NULL;
 	char *user_rate_field = NULL;
+	int rate_index = LCR_RATE_DEFAULT;
+	switch_time_t now = switch_micro_time_now();
+	char now_str[32] = "";
 
 	switch_assert(cb_struct->lookup_number != NULL);
 
+	/* both the sql and the in memory lookup compare the rate dates to this, in UTC */
+	lcr_format_utc(now_str, sizeof(now_str), now);
+
 	digits_copy = string_digitsonly(cb_struct->pool, digits);
 	if (zstr(digits_copy)) {
 		return SWITCH_STATUS_GENERR;
@@ -936,9 +1433,11 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 	if (cb_struct->intralata == SWITCH_TRUE && profile->profile_has_intralata == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intralata_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intralata_rate");
+		rate_index = LCR_RATE_INTRALATA;
 	} else if (cb_struct->intrastate == SWITCH_TRUE && profile->profile_has_intrastate == SWITCH_TRUE) {
 		rate_field = switch_core_strdup(cb_struct->pool, "intrastate_rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_intrastate_rate");
+		rate_index = LCR_RATE_INTRASTATE;
 	} else {
 		rate_field = switch_core_strdup(cb_struct->pool, "rate");
 		user_rate_field = switch_core_strdup(cb_struct->pool, "user_rate");
@@ -961,6 +1460,7 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 			switch_channel_set_variable_var_check(channel, "lcr_query_profile", id_str, SWITCH_FALSE);
 			switch_channel_set_variable_var_check(channel, "lcr_query_expanded_digits", digits_expanded, SWITCH_FALSE);
 			switch_channel_set_variable_var_check(channel, "lcr_query_expanded_lrn_digits", lrn_digits_expanded, SWITCH_FALSE);
+			switch_channel_set_variable_var_check(channel, "lcr_query_now", now_str, SWITCH_FALSE);
 			if ( cb_struct->lrn_number ) {
 				switch_channel_set_variable_var_check(channel, "lcr_lrn", cb_struct->lrn_number, SWITCH_FALSE);
 			}
@@ -975,11 +1475,18 @@ static switch_status_t lcr_do_lookup(callback_t *cb_struct)
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_profile", id_str);
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_expanded_digits", digits_expanded);
 		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_expanded_lrn_digits", lrn_digits_expanded);
+		switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_query_now", now_str);
 		if ( cb_struct->lrn_number ) {
 			switch_event_add_header_string(cb_struct->event, SWITCH_STACK_BOTTOM, "lcr_lrn", cb_struct->lrn_number);
 		}
 	}
 
+	if (profile->in_memory) {
+		lookup_status = lcr_mem_lookup(cb_struct, digits_copy, cb_struct->lrn_number ? cb_struct->lrn_number : digits_copy, rate_index, now);
+		switch_core_hash_destroy(&cb_struct->dedup_hash);
+		return lookup_status;
+	}
+
 	/* set up the query to be executed */
 	/* format the custom_sql */
 	safe_sql = format_custom_sql(profile->custom_sql, cb_struct, digits_copy);
@@ -1094,6 +1601,10 @@ static switch_status_t lcr_load_config()
 			char *custom_sql = NULL;
 			char *export_fields = NULL;
 			char *limit_type = NULL;
+			char *in_memory = NULL;
+			int mem_order[LCR_MAX_ORDER];
+			int mem_order_cnt = 0;
+			switch_bool_t mem_order_ok = SWITCH_TRUE;
 			int argc, x = 0;
 			char *argv[32] = { 0 };
 
@@ -1112,15 +1623,24 @@ static switch_status_t lcr_load_config()
 						for (x=0; x<argc; x++) {
 							switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d/%d is %s\n", x, argc, argv[x]);
 							if (!zstr(argv[x])) {
+								int order = -1;
 								if (!strcasecmp(argv[x], "quality")) {
 									thisorder->write_function(thisorder, "%s quality DESC", comma);
+									order = LCR_ORDER_QUALITY;
 								} else if (!strcasecmp(argv[x], "reliability")) {
 									thisorder->write_function(thisorder, "%s reliability DESC", comma);
+									order = LCR_ORDER_RELIABILITY;
 								} else if (!strcasecmp(argv[x], "rate")) {
 									thisorder->write_function(thisorder, "%s ${lcr_rate_field}", comma);
+									order = LCR_ORDER_RATE;
 								} else {
 									thisorder->write_function(thisorder, "%s %s", comma, argv[x]);
 								}
+								if (order < 0 || mem_order_cnt >= LCR_MAX_ORDER) {
+									mem_order_ok = SWITCH_FALSE;
+								} else {
+									mem_order[mem_order_cnt++] = order;
+								}
 							} else {
 								switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "arg #%d is empty\n", x);
 							}
@@ -1128,10 +1648,13 @@ static switch_status_t lcr_load_config()
 					} else {
 						if (!strcasecmp(val, "quality")) {
 							thisorder->write_function(thisorder, "%s quality DESC", comma);
+							mem_order[mem_order_cnt++] = LCR_ORDER_QUALITY;
 						} else if (!strcasecmp(val, "reliability")) {
 							thisorder->write_function(thisorder, "%s reliability DESC", comma);
+							mem_order[mem_order_cnt++] = LCR_ORDER_RELIABILITY;
 						} else {
 							thisorder->write_function(thisorder, "%s %s", comma, val);
+							mem_order_ok = SWITCH_FALSE;
 						}
 					}
 				} else if (!strcasecmp(var, "id") && !zstr(val)) {
@@ -1153,6 +1676,8 @@ static switch_status_t lcr_load_config()
 					limit_type = val;
 				} else if (!strcasecmp(var, "enable_sip_redir") && !zstr(val)) {
 					enable_sip_redir = val;
+				} else if (!strcasecmp(var, "in_memory") && !zstr(val)) {
+					in_memory = val;
 				}
 			}
 
@@ -1226,7 +1751,7 @@ static switch_status_t lcr_load_config()
 															 (digits IN (${lcr_query_expanded_digits})     AND lrn = false) OR	\
 															 (digits IN (${lcr_query_expanded_lrn_digits}) AND lrn = true)");
 
-					sql_stream.write_function(&sql_stream, ") AND CURRENT_TIMESTAMP BETWEEN date_start AND date_end ");
+					sql_stream.write_function(&sql_stream, ") AND '${lcr_query_now}' BETWEEN date_start AND date_end ");
 					if (profile->id > 0) {
 						sql_stream.write_function(&sql_stream, "AND lcr_profile=%d ", profile->id);
 					}
@@ -1313,6 +1838,24 @@ static switch_status_t lcr_load_config()
 					profile->limit_type = "db";
 				}
 
+				if (switch_true(in_memory)) {
+					if (custom_sql != (char *) sql_stream.data) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "in_memory can't be used with custom_sql, profile %s stays on the database.\n", profile->name);
+					} else if (!mem_order_ok) {
+						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "in_memory only supports ordering by rate, quality and reliability, profile %s stays on the database.\n", profile->name);
+					} else {
+						if (!mem_order_cnt) {
+							/* same as the default order_by */
+							mem_order[mem_order_cnt++] = LCR_ORDER_RATE;
+						}
+						memcpy(profile->mem_order, mem_order, sizeof(mem_order));
+						profile->mem_order_cnt = mem_order_cnt;
+						if (lcr_rates_load(profile) == SWITCH_STATUS_SUCCESS) {
+							profile->in_memory = SWITCH_TRUE;
+						}
+					}
+				}
+
 				switch_core_hash_insert(globals.profile_hash, profile->name, profile);
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Loaded lcr profile %s.\n", profile->name);
 				/* test the profile */
@@ -1330,6 +1873,7 @@ static switch_status_t lcr_load_config()
 				} else {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Removing INVALID Profile %s.\n", profile->name);
 					switch_core_hash_delete(globals.profile_hash, profile->name);
+					lcr_rates_destroy(&profile->rates);
 				}
 
 			}
@@ -2062,12 +2606,75 @@ SWITCH_STANDARD_API(dialplan_lcr_admin_function)
 				stream->write_function(stream, " Sip Redirection Mode:\t%s\n", profile->enable_sip_redir ? "enabled" : "disabled");
 				stream->write_function(stream, " Import fields:\t%s\n", profile->export_fields_str ? profile->export_fields_str : "(null)");
 				stream->write_function(stream, " Limit type:\t%s\n", profile->limit_type);
+				if (profile->in_memory) {
+					switch_mutex_lock(globals.mutex);
+					if (profile->rates) {
+						stream->write_function(stream, " In memory:\t%u rates, %u nodes, loaded in %" SWITCH_TIME_T_FMT "ms\n",
+											   profile->rates->route_count, profile->rates->node_count, profile->rates->load_usec / 1000);
+					}
+					switch_mutex_unlock(globals.mutex);
+				}
 				stream->write_function(stream, "\n");
 			}
+		} else if (!strcasecmp(argv[0], "reload") && !strcasecmp(argv[1], "rates")) {
+			int loaded = 0;
+			for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+				switch_core_hash_this(hi, NULL, NULL, &val);
+				profile = (profile_t *) val;
+
+				if (!profile->in_memory || (argc > 2 && strcasecmp(argv[2], profile->name))) {
+					continue;
+				}
+
+				if (lcr_rates_load(profile) == SWITCH_STATUS_SUCCESS) {
+					stream->write_function(stream, "+OK %s: %u rates\n", profile->name, profile->rates->route_count);
+				} else {
+					stream->write_function(stream, "-ERR %s: reload failed, keeping the old rates\n", profile->name);
+				}
+				loaded++;
+			}
+			if (!loaded) {
+				stream->write_function(stream, "-ERR no in memory profile to reload\n");
+			}
+		} else if (!strcasecmp(argv[0], "bench") && argc > 2) {
+			callback_t routes = { 0 };
+			switch_memory_pool_t *pool = NULL;
+			int iterations = argc > 3 ? atoi(argv[3]) : 1000;
+			int i, matches = 0;
+			switch_time_t start, elapsed;
+
+			if (!(profile = locate_profile(argv[1]))) {
+				stream->write_function(stream, "-ERR Unknown profile: %s\n", argv[1]);
+				goto end;
+			}
+
+			if (iterations < 1) {
+				iterations = 1;
+			}
+
+			start = switch_micro_time_now();
+			for (i = 0; i < iterations; i++) {
+				memset(&routes, 0, sizeof(routes));
+				switch_core_new_memory_pool(&pool);
+				routes.pool = pool;
+				routes.profile = profile;
+				routes.lookup_number = argv[2];
+				routes.cid = "";
+				lcr_do_lookup(&routes);
+				matches = routes.matches;
+				lcr_destroy(routes.head);
+				switch_core_destroy_memory_pool(&pool);
+			}
+			elapsed = switch_micro_time_now() - start;
+
+			stream->write_function(stream, "%d lookups of %s on %s (%s), %d routes each, %0.2f lookups/sec\n",
+								   iterations, argv[2], profile->name, profile->in_memory ? "memory" : "database", matches,
+								   elapsed > 0 ? (double) iterations * 1000000 / elapsed : 0.0);
 		} else {
 			goto usage;
 		}
 	}
+end:
 	switch_safe_free(mydata);
 	return SWITCH_STATUS_SUCCESS;
 usage:
@@ -2112,6 +2719,13 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_lcr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_lcr_shutdown)
 {
+	switch_hash_index_t *hi;
+	void *val;
+
+	for (hi = switch_core_hash_first(globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		lcr_rates_destroy(&((profile_t *) val)->rates);
+	}
 
 	switch_core_hash_destroy(&globals.profile_hash);
 
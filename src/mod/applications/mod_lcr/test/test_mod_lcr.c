@@ -0,0 +1,330 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_lcr -- mod_lcr lookups against a sqlite rate deck, in memory and through sql
+ *
+ */
+
+#include <test/switch_test.h>
+
+/* same dsn as lcr.conf in test/conf */
+#define LCR_TEST_DSN "sqlite://fst_lcr"
+
+static const char *lcr_test_schema[] = {
+	"DROP TABLE IF EXISTS lcr",
+	"DROP TABLE IF EXISTS carrier_gateway",
+	"DROP TABLE IF EXISTS carriers",
+	"CREATE TABLE carriers (id INTEGER PRIMARY KEY, carrier_name VARCHAR(255) NOT NULL, enabled BOOLEAN NOT NULL DEFAULT 1)",
+	"CREATE TABLE carrier_gateway (id INTEGER PRIMARY KEY, carrier_id INTEGER, prefix VARCHAR(128) NOT NULL DEFAULT '', "
+	"suffix VARCHAR(128) NOT NULL DEFAULT '', codec VARCHAR(128) NOT NULL DEFAULT '', enabled BOOLEAN NOT NULL DEFAULT 1)",
+	"CREATE TABLE lcr (id INTEGER PRIMARY KEY, digits VARCHAR(20), rate NUMERIC(11,5), intrastate_rate NUMERIC(11,5), "
+	"intralata_rate NUMERIC(11,5), carrier_id INTEGER NOT NULL, lead_strip INTEGER NOT NULL DEFAULT 0, "
+	"trail_strip INTEGER NOT NULL DEFAULT 0, prefix VARCHAR(16) NOT NULL DEFAULT '', suffix VARCHAR(16) NOT NULL DEFAULT '', "
+	"lcr_profile INTEGER NOT NULL DEFAULT 0, date_start TIMESTAMP NOT NULL DEFAULT '1970-01-01 00:00:00', "
+	"date_end TIMESTAMP NOT NULL DEFAULT '2099-12-31 00:00:00', quality NUMERIC(10,6) NOT NULL DEFAULT 0, "
+	"reliability NUMERIC(10,6) NOT NULL DEFAULT 0, cid VARCHAR(32) NOT NULL DEFAULT '', enabled BOOLEAN NOT NULL DEFAULT 1, "
+	"lrn BOOLEAN NOT NULL DEFAULT 0)",
+	"INSERT INTO carriers (id, carrier_name) VALUES (1, 'alpha')",
+	"INSERT INTO carriers (id, carrier_name) VALUES (2, 'beta')",
+	"INSERT INTO carrier_gateway (carrier_id, prefix) VALUES (1, 'sofia/gateway/alpha/')",
+	"INSERT INTO carrier_gateway (carrier_id, prefix) VALUES (2, 'sofia/gateway/beta/')",
+	/* beta has the longer prefix so it wins although alpha is cheaper */
+	"INSERT INTO lcr (digits, rate, carrier_id) VALUES ('1555', 0.01, 1)",
+	"INSERT INTO lcr (digits, rate, carrier_id) VALUES ('15551', 0.05, 2)",
+	/* alpha is cheaper interstate, beta intrastate */
+	"INSERT INTO lcr (digits, rate, intrastate_rate, carrier_id) VALUES ('1666', 0.01, 0.09, 1)",
+	"INSERT INTO lcr (digits, rate, intrastate_rate, carrier_id) VALUES ('1666', 0.05, 0.02, 2)",
+	/* alpha's rate has expired, beta's starts long after anyone runs this */
+	"INSERT INTO lcr (digits, rate, carrier_id, date_end) VALUES ('1777', 0.01, 1, '2000-01-01 00:00:00')",
+	"INSERT INTO lcr (digits, rate, carrier_id, date_start) VALUES ('1777', 0.05, 2, '2090-01-01 00:00:00')",
+	/* only routable through the LRN, the non lrn row for the same prefix must not match it */
+	"INSERT INTO lcr (digits, rate, carrier_id, lrn) VALUES ('1444', 0.05, 2, 1)",
+	"INSERT INTO lcr (digits, rate, carrier_id, lrn) VALUES ('1444', 0.01, 1, 0)",
+	NULL
+};
+
+static switch_bool_t lcr_test_execute(const char **sql)
+{
+	switch_cache_db_handle_t *dbh = NULL;
+	switch_bool_t ok = SWITCH_TRUE;
+	int i;
+
+	if (switch_cache_db_get_db_handle_dsn(&dbh, LCR_TEST_DSN) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_FALSE;
+	}
+
+	for (i = 0; sql[i]; i++) {
+		if (switch_cache_db_execute_sql(dbh, (char *) sql[i], NULL) != SWITCH_STATUS_SUCCESS) {
+			ok = SWITCH_FALSE;
+		}
+	}
+
+	switch_cache_db_release_db_handle(&dbh);
+
+	return ok;
+}
+
+static char *lcr_api(const char *cmd, const char *args)
+{
+	switch_stream_handle_t stream = { 0 };
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute(cmd, args, NULL, &stream);
+
+	return (char *) stream.data;
+}
+
+/* rate deck dates are UTC */
+static void lcr_test_utc(char *buf, switch_size_t len, int offset_sec)
+{
+	switch_time_exp_t tm;
+	switch_size_t retsize;
+
+	switch_time_exp_gmt(&tm, switch_micro_time_now() + (switch_time_t) offset_sec * 1000000);
+	switch_strftime_nocheck(buf, &retsize, len, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+/* lcr <digits> <profile> [options], the caller frees the table */
+static char *lcr_test_lookup(const char *digits, const char *profile, const char *options)
+{
+	char *args = switch_mprintf("%s %s%s%s", digits, profile, options ? " " : "", switch_str_nil(options));
+	char *res = lcr_api("lcr", args);
+
+	switch_safe_free(args);
+
+	return res;
+}
+
+/* position of a carrier in the route table, -1 when it has no route */
+static int lcr_test_route_pos(const char *res, const char *carrier)
+{
+	const char *p;
+
+	if (!res || !(p = strstr(res, carrier))) {
+		return -1;
+	}
+
+	return (int) (p - res);
+}
+
+FST_CORE_BEGIN("conf")
+{
+	/* the rate deck has to be there before mod_lcr loads its profiles */
+	lcr_test_execute(lcr_test_schema);
+
+	FST_MODULE_BEGIN(mod_lcr, mod_lcr_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_lcr");
+		}
+		FST_SETUP_END()
+
+		FST_TEST_BEGIN(longest_prefix_first)
+		{
+			const char *profiles[] = { "mem", "sql" };
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				char *args = switch_mprintf("15551234567 %s", profiles[i]);
+				char *res = lcr_api("lcr", args);
+				char *alpha, *beta;
+
+				fst_requires(res);
+				alpha = strstr(res, "alpha");
+				beta = strstr(res, "beta");
+				fst_check(alpha != NULL);
+				fst_check(beta != NULL);
+				fst_check(beta < alpha);
+
+				switch_safe_free(res);
+				switch_safe_free(args);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(intrastate)
+		{
+			const char *profiles[] = { "mem", "sql" };
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				char *res = lcr_test_lookup("16665551234", profiles[i], NULL);
+
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+				fst_check(lcr_test_route_pos(res, "alpha") < lcr_test_route_pos(res, "beta"));
+				switch_safe_free(res);
+
+				/* same routes, ordered by intrastate_rate */
+				res = lcr_test_lookup("16665551234", profiles[i], "intrastate");
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "beta") >= 0);
+				fst_check(lcr_test_route_pos(res, "beta") < lcr_test_route_pos(res, "alpha"));
+				fst_check_string_has(res, "0.02");
+				switch_safe_free(res);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(lrn)
+		{
+			const char *profiles[] = { "mem", "sql" };
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				char *res = lcr_test_lookup("13215550000", profiles[i], NULL);
+
+				/* nothing routes the dialed digits themselves */
+				fst_requires(res);
+				fst_check_string_has(res, "No Routes To Display");
+				switch_safe_free(res);
+
+				/* the LRN picks the lrn row, the plain row on the same prefix stays out */
+				res = lcr_test_lookup("13215550000", profiles[i], "lrn 14445550000");
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "beta") >= 0);
+				fst_check(lcr_test_route_pos(res, "alpha") < 0);
+				switch_safe_free(res);
+
+				/* with an LRN the dialed digits no longer pick lrn rows */
+				res = lcr_test_lookup("14445550000", profiles[i], "lrn 13215550000");
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+				fst_check(lcr_test_route_pos(res, "beta") < 0);
+				switch_safe_free(res);
+
+				/* without one the dialed digits stand in for it, so both rows match */
+				res = lcr_test_lookup("14445550000", profiles[i], NULL);
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+				fst_check(lcr_test_route_pos(res, "beta") >= 0);
+				switch_safe_free(res);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(date_window)
+		{
+			const char *profiles[] = { "mem", "sql" };
+			int i;
+
+			for (i = 0; i < 2; i++) {
+				char *res = lcr_test_lookup("17775551234", profiles[i], NULL);
+
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") < 0);
+				fst_check(lcr_test_route_pos(res, "beta") < 0);
+				switch_safe_free(res);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(date_window_at_lookup)
+		{
+			const char *profiles[] = { "mem", "sql" };
+			char soon[32], end_sql[256], start_sql[256];
+			const char *sql[] = { end_sql, start_sql, NULL };
+			char *res;
+			int i;
+
+			/* alpha's rate runs out and beta's starts a few seconds from now, after the rates are loaded */
+			lcr_test_utc(soon, sizeof(soon), 4);
+			switch_snprintf(end_sql, sizeof(end_sql), "INSERT INTO lcr (digits, rate, carrier_id, date_end) VALUES ('1888', 0.01, 1, '%s')", soon);
+			switch_snprintf(start_sql, sizeof(start_sql), "INSERT INTO lcr (digits, rate, carrier_id, date_start) VALUES ('1888', 0.05, 2, '%s')", soon);
+			fst_requires(lcr_test_execute(sql));
+
+			res = lcr_api("lcr_admin", "reload rates mem");
+			fst_requires(res);
+			fst_check_string_starts_with(res, "+OK mem:");
+			switch_safe_free(res);
+
+			for (i = 0; i < 2; i++) {
+				res = lcr_test_lookup("18885551234", profiles[i], NULL);
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+				fst_check(lcr_test_route_pos(res, "beta") < 0);
+				switch_safe_free(res);
+			}
+
+			switch_sleep(6000000);
+
+			/* no reload in between, each lookup checks the window itself */
+			for (i = 0; i < 2; i++) {
+				res = lcr_test_lookup("18885551234", profiles[i], NULL);
+				fst_requires(res);
+				fst_check(lcr_test_route_pos(res, "alpha") < 0);
+				fst_check(lcr_test_route_pos(res, "beta") >= 0);
+				switch_safe_free(res);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(reload)
+		{
+			const char *sql[] = { "INSERT INTO lcr (digits, rate, carrier_id) VALUES ('1999', 0.01, 1)", NULL };
+			char *res;
+
+			fst_requires(lcr_test_execute(sql));
+
+			/* sql sees the new row right away, the in memory deck only after a reload */
+			res = lcr_test_lookup("19995551234", "sql", NULL);
+			fst_requires(res);
+			fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+			switch_safe_free(res);
+
+			res = lcr_test_lookup("19995551234", "mem", NULL);
+			fst_requires(res);
+			fst_check(lcr_test_route_pos(res, "alpha") < 0);
+			switch_safe_free(res);
+
+			res = lcr_api("lcr_admin", "reload rates");
+			fst_requires(res);
+			fst_check_string_has(res, "+OK mem:");
+			switch_safe_free(res);
+
+			res = lcr_test_lookup("19995551234", "mem", NULL);
+			fst_requires(res);
+			fst_check(lcr_test_route_pos(res, "alpha") >= 0);
+			switch_safe_free(res);
+
+			/* the old table was swapped out, lookups on the rest of the deck are unchanged */
+			res = lcr_test_lookup("15551234567", "mem", NULL);
+			fst_requires(res);
+			fst_check(lcr_test_route_pos(res, "beta") >= 0);
+			fst_check(lcr_test_route_pos(res, "beta") < lcr_test_route_pos(res, "alpha"));
+			switch_safe_free(res);
+
+			/* a database profile has nothing to reload */
+			res = lcr_api("lcr_admin", "reload rates sql");
+			fst_requires(res);
+			fst_check_string_starts_with(res, "-ERR");
+			switch_safe_free(res);
+		}
+		FST_TEST_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
@@ -40,8 +40,16 @@
 
 #define SWITCH_OPUS_MIN_FEC_BITRATE 12400
 
+#define SWITCH_OPUS_MIN_COMPLEXITY 0
+#define SWITCH_OPUS_MAX_COMPLEXITY 10
+#define SWITCH_OPUS_COMPLEXITY_INTERVAL 1 /* seconds between cpu load samples */
+
+#define SWITCH_OPUS_ENC_HIST_BUCKETS 10
+#define SWITCH_OPUS_ENC_STATS_FLUSH 50 /* packets kept per encoder before merging into the global histogram */
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load);
-SWITCH_MODULE_DEFINITION(mod_opus, mod_opus_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_opus_shutdown);
+SWITCH_MODULE_DEFINITION(mod_opus, mod_opus_load, mod_opus_shutdown, NULL);
 
 /*! \brief Various codec settings */
 struct opus_codec_settings {
@@ -120,6 +128,17 @@ struct enc_stats {
 };
 typedef struct enc_stats enc_stats_t;
 
+/* upper bound in usec of each encode time bucket, the last one takes the rest */
+static const uint32_t enc_hist_bounds[SWITCH_OPUS_ENC_HIST_BUCKETS] = { 25, 50, 100, 200, 400, 800, 1600, 3200, 6400, 0 };
+
+struct enc_time_stats {
+	uint32_t hist[SWITCH_OPUS_ENC_HIST_BUCKETS];
+	uint32_t packets;
+	uint64_t usec;
+	switch_time_t max_usec;
+};
+typedef struct enc_time_stats enc_time_stats_t;
+
 struct codec_control_state {
 	int keep_fec;
 	opus_int32 current_bitrate;
@@ -144,6 +163,8 @@ struct opus_context {
 	enc_stats_t encoder_stats;
 	codec_control_state_t control_state;
 	switch_bool_t recreate_decoder;
+	int complexity;
+	enc_time_stats_t enc_time;
 };
 
 struct {
@@ -163,10 +184,23 @@ struct {
 	switch_bool_t use_jb_lookahead;
 	switch_mutex_t *mutex;
 	switch_bool_t mono;
+	switch_bool_t auto_complexity;
+	int complexity_min;
+	int complexity_max;
+	int complexity_idle_high;
+	int complexity_idle_low;
+	uint32_t complexity_sessions;
 } opus_prefs;
 
 static struct {
 	int debug;
+	volatile int complexity; /* target for encoders when auto-complexity is on */
+	switch_mutex_t *mutex;
+	/* encode time per packet, one histogram for each complexity level */
+	uint64_t enc_hist[SWITCH_OPUS_MAX_COMPLEXITY + 1][SWITCH_OPUS_ENC_HIST_BUCKETS];
+	uint64_t enc_packets[SWITCH_OPUS_MAX_COMPLEXITY + 1];
+	uint64_t enc_usec[SWITCH_OPUS_MAX_COMPLEXITY + 1];
+	switch_time_t enc_max_usec[SWITCH_OPUS_MAX_COMPLEXITY + 1];
 } globals;
 
 static switch_bool_t switch_opus_acceptable_rate(int rate)
@@ -519,6 +553,129 @@ static switch_status_t switch_opus_info(switch_core_session_t *session, void * e
 	return SWITCH_STATUS_SUCCESS;
 }
 
+/* complexity to run encoders at for a cpu idle percentage and session count, between the configured bounds */
+static int switch_opus_complexity_for_load(double idle, uint32_t sessions, int current)
+{
+	double load = 0, session_load = 0;
+	int target;
+
+	if (idle < opus_prefs.complexity_idle_high) {
+		load = (opus_prefs.complexity_idle_high - idle) / (double) (opus_prefs.complexity_idle_high - opus_prefs.complexity_idle_low);
+	}
+
+	if (opus_prefs.complexity_sessions) {
+		session_load = (double) sessions / opus_prefs.complexity_sessions;
+	}
+
+	if (session_load > load) {
+		load = session_load;
+	}
+
+	if (load > 1) {
+		load = 1;
+	}
+
+	target = opus_prefs.complexity_max - (int) ((opus_prefs.complexity_max - opus_prefs.complexity_min) * load + 0.5);
+
+	/* back off right away, but only climb one step per sample so encoders don't flap around the threshold */
+	if (target > current + 1) {
+		target = current + 1;
+	}
+
+	return target;
+}
+
+static int switch_opus_target_complexity(int current)
+{
+	return switch_opus_complexity_for_load(switch_core_idle_cpu(), switch_core_session_count(), current);
+}
+
+SWITCH_STANDARD_SCHED_FUNC(switch_opus_complexity_callback)
+{
+	int complexity = switch_opus_target_complexity(globals.complexity);
+
+	if (complexity != globals.complexity) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Opus encoder: complexity %d -> %d (idle cpu %.1f%%, %u sessions)\n",
+						  globals.complexity, complexity, switch_core_idle_cpu(), switch_core_session_count());
+		globals.complexity = complexity;
+	}
+
+	task->runtime = switch_epoch_time_now(NULL) + SWITCH_OPUS_COMPLEXITY_INTERVAL;
+}
+
+static void switch_opus_flush_enc_stats(struct opus_context *context)
+{
+	enc_time_stats_t *stats = &context->enc_time;
+	int level = context->complexity;
+	int i;
+
+	if (!stats->packets) {
+		return;
+	}
+
+	if (level < SWITCH_OPUS_MIN_COMPLEXITY || level > SWITCH_OPUS_MAX_COMPLEXITY) {
+		level = SWITCH_OPUS_MAX_COMPLEXITY;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	for (i = 0; i < SWITCH_OPUS_ENC_HIST_BUCKETS; i++) {
+		globals.enc_hist[level][i] += stats->hist[i];
+	}
+	globals.enc_packets[level] += stats->packets;
+	globals.enc_usec[level] += stats->usec;
+	if (stats->max_usec > globals.enc_max_usec[level]) {
+		globals.enc_max_usec[level] = stats->max_usec;
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	memset(stats->hist, 0, sizeof(stats->hist));
+	stats->packets = 0;
+	stats->usec = 0;
+}
+
+static void switch_opus_enc_time(struct opus_context *context, switch_time_t start)
+{
+	enc_time_stats_t *stats = &context->enc_time;
+	switch_time_t usec = switch_time_ref() - start;
+	int i;
+
+	for (i = 0; i < SWITCH_OPUS_ENC_HIST_BUCKETS - 1; i++) {
+		if (usec < enc_hist_bounds[i]) {
+			break;
+		}
+	}
+
+	stats->hist[i]++;
+	stats->usec += usec;
+	if (usec > stats->max_usec) {
+		stats->max_usec = usec;
+	}
+
+	if (++stats->packets >= SWITCH_OPUS_ENC_STATS_FLUSH) {
+		switch_opus_flush_enc_stats(context);
+	}
+}
+
+/* pick up a new complexity target on the encoding thread, opus encoder ctls are not thread safe */
+static void switch_opus_apply_complexity(switch_codec_t *codec, struct opus_context *context)
+{
+	int complexity = globals.complexity;
+
+	if (!opus_prefs.auto_complexity || complexity == context->complexity) {
+		return;
+	}
+
+	switch_opus_flush_enc_stats(context);
+	opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
+
+	if (globals.debug || context->debug) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(codec->session), SWITCH_LOG_DEBUG, "Opus encoder: complexity changed from %d to %d\n",
+						  context->complexity, complexity);
+	}
+
+	context->complexity = complexity;
+}
+
 static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag_t flags, const switch_codec_settings_t *codec_settings)
 {
 	struct opus_context *context = NULL;
@@ -585,7 +742,7 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 		/* come up with a way to specify these */
 		int bitrate_bps = OPUS_AUTO;
 		int use_vbr = opus_codec_settings.cbr ? 0 : opus_prefs.use_vbr  ;
-		int complexity = opus_prefs.complexity;
+		int complexity = opus_prefs.auto_complexity ? globals.complexity : opus_prefs.complexity;
 		int plpct = opus_prefs.plpct;
 		int err;
 		int enc_samplerate = opus_codec_settings.samplerate ? opus_codec_settings.samplerate : codec->implementation->actual_samples_per_second;
@@ -648,9 +805,10 @@ static switch_status_t switch_opus_init(switch_codec_t *codec, switch_codec_flag
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_VBR(0));
 		}
 
-		if (complexity) {
+		if (complexity || opus_prefs.auto_complexity) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_COMPLEXITY(complexity));
 		}
+		opus_encoder_ctl(context->encoder_object, OPUS_GET_COMPLEXITY(&context->complexity));
 
 		if (plpct) {
 			opus_encoder_ctl(context->encoder_object, OPUS_SET_PACKET_LOSS_PERC(plpct));
@@ -755,7 +913,11 @@ static switch_status_t switch_opus_destroy(switch_codec_t *codec)
 					switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG,
 							"Opus encoder stats: FEC frames (only for debug mode) [%d]\n", context->encoder_stats.fec_counter);
 				}
+
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG,
+						"Opus encoder stats: Complexity[%d] Max encode time us[%" SWITCH_TIME_T_FMT "]\n", context->complexity, context->enc_time.max_usec);
 			}
+			switch_opus_flush_enc_stats(context);
 			opus_encoder_destroy(context->encoder_object);
 			context->encoder_object = NULL;
 		}
@@ -775,12 +937,17 @@ static switch_status_t switch_opus_encode(switch_codec_t *codec,
 	struct opus_context *context = codec->private_info;
 	int bytes = 0;
 	int len = (int) *encoded_data_len;
+	switch_time_t start;
 
 	if (!context) {
 		return SWITCH_STATUS_FALSE;
 	}
 
+	switch_opus_apply_complexity(codec, context);
+
+	start = switch_time_ref();
 	bytes = opus_encode(context->encoder_object, (void *) decoded_data, context->enc_frame_size, (unsigned char *) encoded_data, len);
+	switch_opus_enc_time(context, start);
 
 	if (globals.debug || context->debug > 1) {
 		int samplerate = context->enc_frame_size * 1000 / (codec->implementation->microseconds_per_packet / 1000);
@@ -957,10 +1124,12 @@ static switch_status_t switch_opus_encode_repacketize(switch_codec_t *codec,
 	opus_int32 ret = 0;
 	opus_int32 total_len = 0;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_time_t start = switch_time_ref();
 
 	if (!context) {
 		switch_goto_status(SWITCH_STATUS_FALSE, end);
 	}
+	switch_opus_apply_complexity(codec, context);
 	opus_encoder_ctl(context->encoder_object, OPUS_GET_INBAND_FEC(&want_fec));
 	if (want_fec && context->codec_settings.useinbandfec) {
 		/* if FEC might be used , pack only 2 frames like: 80 ms = 2 x 40 ms , 120 ms = 2 x 60 ms  */
@@ -1028,6 +1197,7 @@ static switch_status_t switch_opus_encode_repacketize(switch_codec_t *codec,
 		opus_encoder_ctl(context->encoder_object, OPUS_SET_INBAND_FEC(want_fec)); /*restore FEC state*/
 	}
 	*encoded_data_len = (uint32_t) ret;
+	switch_opus_enc_time(context, start);
 
 end:
 	if (rp) {
@@ -1055,6 +1225,10 @@ static switch_status_t opus_load_config(switch_bool_t reload)
 	opus_prefs.plpct = 20;
 	opus_prefs.use_vbr = 0;
 	opus_prefs.fec_decode = 1;
+	opus_prefs.complexity_min = -1;
+	opus_prefs.complexity_max = -1;
+	opus_prefs.complexity_idle_high = 40;
+	opus_prefs.complexity_idle_low = 10;
 
 	if ((settings = switch_xml_child(cfg, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
@@ -1098,10 +1272,48 @@ static switch_status_t opus_load_config(switch_bool_t reload)
 				}
 			} else if (!strcasecmp(key, "mono")) {
 				opus_prefs.mono = switch_true(val);
+			} else if (!strcasecmp(key, "auto-complexity")) {
+				opus_prefs.auto_complexity = switch_true(val);
+			} else if (!strcasecmp(key, "complexity-min")) {
+				opus_prefs.complexity_min = atoi(val);
+			} else if (!strcasecmp(key, "complexity-max")) {
+				opus_prefs.complexity_max = atoi(val);
+			} else if (!strcasecmp(key, "complexity-idle-cpu-high")) {
+				opus_prefs.complexity_idle_high = atoi(val);
+			} else if (!strcasecmp(key, "complexity-idle-cpu-low")) {
+				opus_prefs.complexity_idle_low = atoi(val);
+			} else if (!strcasecmp(key, "complexity-max-sessions")) {
+				opus_prefs.complexity_sessions = (uint32_t) atoi(val);
 			}
 		}
 	}
 
+	if (opus_prefs.complexity < SWITCH_OPUS_MIN_COMPLEXITY || opus_prefs.complexity > SWITCH_OPUS_MAX_COMPLEXITY) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Opus complexity %d out of range, using the library default\n", opus_prefs.complexity);
+		opus_prefs.complexity = 0;
+	}
+
+	if (opus_prefs.auto_complexity) {
+		/* the fixed complexity, when set, is the ceiling */
+		if (opus_prefs.complexity_max < SWITCH_OPUS_MIN_COMPLEXITY || opus_prefs.complexity_max > SWITCH_OPUS_MAX_COMPLEXITY) {
+			opus_prefs.complexity_max = opus_prefs.complexity ? opus_prefs.complexity : SWITCH_OPUS_MAX_COMPLEXITY;
+		}
+		if (opus_prefs.complexity_min < SWITCH_OPUS_MIN_COMPLEXITY || opus_prefs.complexity_min > opus_prefs.complexity_max) {
+			opus_prefs.complexity_min = opus_prefs.complexity_max < 2 ? opus_prefs.complexity_max : 2;
+		}
+		if (opus_prefs.complexity_idle_high > 100) {
+			opus_prefs.complexity_idle_high = 100;
+		}
+		if (opus_prefs.complexity_idle_low < 0 || opus_prefs.complexity_idle_low >= opus_prefs.complexity_idle_high) {
+			opus_prefs.complexity_idle_low = 0;
+		}
+		if (opus_prefs.complexity_idle_high <= opus_prefs.complexity_idle_low) {
+			opus_prefs.complexity_idle_high = opus_prefs.complexity_idle_low + 1;
+		}
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Opus encoder: complexity scales %d-%d between %d%% and %d%% idle cpu\n",
+						  opus_prefs.complexity_min, opus_prefs.complexity_max, opus_prefs.complexity_idle_low, opus_prefs.complexity_idle_high);
+	}
+
 	switch_xml_free(xml);
 
 	return status;
@@ -1381,6 +1593,58 @@ SWITCH_STANDARD_API(mod_opus_debug)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+#define OPUS_STATS_SYNTAX "[reset]"
+SWITCH_STANDARD_API(mod_opus_stats)
+{
+	int level, i;
+
+	if (!zstr(cmd) && !strcasecmp(cmd, "reset")) {
+		switch_mutex_lock(globals.mutex);
+		memset(globals.enc_hist, 0, sizeof(globals.enc_hist));
+		memset(globals.enc_packets, 0, sizeof(globals.enc_packets));
+		memset(globals.enc_usec, 0, sizeof(globals.enc_usec));
+		memset(globals.enc_max_usec, 0, sizeof(globals.enc_max_usec));
+		switch_mutex_unlock(globals.mutex);
+		stream->write_function(stream, "+OK\n");
+		return SWITCH_STATUS_SUCCESS;
+	} else if (!zstr(cmd)) {
+		stream->write_function(stream, "-USAGE: %s\n", OPUS_STATS_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (opus_prefs.auto_complexity) {
+		stream->write_function(stream, "Complexity: auto %d (range %d-%d, idle cpu %.1f%%, %u sessions)\n",
+							   globals.complexity, opus_prefs.complexity_min, opus_prefs.complexity_max, switch_core_idle_cpu(), switch_core_session_count());
+	} else {
+		stream->write_function(stream, "Complexity: fixed %d\n", opus_prefs.complexity);
+	}
+
+	stream->write_function(stream, "Encode time per packet (usec):\n%-10s %12s %8s %8s", "complexity", "packets", "avg", "max");
+	for (i = 0; i < SWITCH_OPUS_ENC_HIST_BUCKETS; i++) {
+		if (enc_hist_bounds[i]) {
+			stream->write_function(stream, " %7s%-4u", "<", enc_hist_bounds[i]);
+		} else {
+			stream->write_function(stream, " %7s%-4u", ">=", enc_hist_bounds[i - 1]);
+		}
+	}
+	stream->write_function(stream, "\n");
+
+	switch_mutex_lock(globals.mutex);
+	for (level = SWITCH_OPUS_MIN_COMPLEXITY; level <= SWITCH_OPUS_MAX_COMPLEXITY; level++) {
+		if (!globals.enc_packets[level]) {
+			continue;
+		}
+		stream->write_function(stream, "%-10d %12" SWITCH_UINT64_T_FMT " %8" SWITCH_UINT64_T_FMT " %8" SWITCH_TIME_T_FMT, level, globals.enc_packets[level],
+							   globals.enc_usec[level] / globals.enc_packets[level], globals.enc_max_usec[level]);
+		for (i = 0; i < SWITCH_OPUS_ENC_HIST_BUCKETS; i++) {
+			stream->write_function(stream, " %11" SWITCH_UINT64_T_FMT, globals.enc_hist[level][i]);
+		}
+		stream->write_function(stream, "\n");
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 {
@@ -1400,6 +1664,14 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 		return status;
 	}
 
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, pool);
+
+	if (opus_prefs.auto_complexity) {
+		globals.complexity = opus_prefs.complexity_max;
+		switch_scheduler_add_task(switch_epoch_time_now(NULL) + SWITCH_OPUS_COMPLEXITY_INTERVAL, switch_opus_complexity_callback,
+								  "opus_complexity", "mod_opus", 0, NULL, SSHF_NONE);
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
@@ -1408,6 +1680,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 
 	switch_console_set_complete("add opus_debug on");
 	switch_console_set_complete("add opus_debug off");
+	SWITCH_ADD_API(commands_api_interface, "opus_stats", "Show OPUS encoder complexity and encode times", mod_opus_stats, OPUS_STATS_SYNTAX);
+	switch_console_set_complete("add opus_stats reset");
 
 	codec_interface->parse_fmtp = switch_opus_fmtp_parse;
 
@@ -1714,6 +1988,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_opus_load)
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_opus_shutdown)
+{
+	switch_scheduler_del_task_group("mod_opus");
+
+	return SWITCH_STATUS_SUCCESS;
+}
 
 /* For Emacs:
  * Local Variables:
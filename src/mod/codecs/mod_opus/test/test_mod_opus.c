@@ -0,0 +1,118 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2026, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_opus -- encoder complexity scaling tests
+ *
+ */
+
+#include <switch.h>
+#include <test/switch_test.h>
+#include "../mod_opus.c"
+
+typedef struct {
+	double idle;
+	uint32_t sessions;
+	uint32_t max_sessions;
+	int current;
+	int expected;
+} opus_complexity_case_t;
+
+/* bounds 2-10 between 10% and 40% idle cpu */
+static const opus_complexity_case_t opus_complexity_cases[] = {
+	/* idle cpu alone */
+	{ 90.0,   0, 100, 10, 10 },
+	{ 40.0,   0, 100, 10, 10 },
+	{ 34.0,   0, 100, 10,  8 },
+	{ 25.0,   0, 100, 10,  6 },
+	{ 10.0,   0, 100, 10,  2 },
+	{  0.0,   0, 100, 10,  2 },
+	/* session count alone */
+	{ 90.0,  50, 100, 10,  6 },
+	{ 90.0, 100, 100, 10,  2 },
+	{ 90.0, 500, 100, 10,  2 },
+	{ 90.0, 500,   0, 10, 10 },
+	/* the heavier of the two wins */
+	{ 30.0,  75, 100, 10,  4 },
+	{ 10.0,  10, 100, 10,  2 },
+	/* drops straight to the target, climbs one step per sample */
+	{ 25.0,   0, 100,  9,  6 },
+	{ 90.0,   0, 100,  2,  3 },
+	{ 90.0,   0, 100,  9, 10 },
+	{ 25.0,   0, 100,  2,  3 },
+	{ 25.0,   0, 100,  5,  6 },
+};
+
+FST_BEGIN()
+{
+	FST_SUITE_BEGIN(mod_opus)
+	{
+		FST_SETUP_BEGIN()
+		{
+			memset(&opus_prefs, 0, sizeof(opus_prefs));
+			opus_prefs.auto_complexity = SWITCH_TRUE;
+			opus_prefs.complexity_min = 2;
+			opus_prefs.complexity_max = 10;
+			opus_prefs.complexity_idle_high = 40;
+			opus_prefs.complexity_idle_low = 10;
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(complexity_for_load)
+		{
+			size_t i;
+
+			for (i = 0; i < sizeof(opus_complexity_cases) / sizeof(opus_complexity_cases[0]); i++) {
+				const opus_complexity_case_t *c = &opus_complexity_cases[i];
+
+				opus_prefs.complexity_sessions = c->max_sessions;
+				fst_check_int_equals(switch_opus_complexity_for_load(c->idle, c->sessions, c->current), c->expected);
+			}
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(complexity_stays_in_bounds)
+		{
+			int idle, current;
+
+			opus_prefs.complexity_sessions = 0;
+			for (idle = 0; idle <= 100; idle++) {
+				for (current = opus_prefs.complexity_min; current <= opus_prefs.complexity_max; current++) {
+					int target = switch_opus_complexity_for_load(idle, 0, current);
+
+					fst_xcheck(target >= opus_prefs.complexity_min && target <= opus_prefs.complexity_max, "complexity out of bounds");
+					fst_xcheck(target <= current + 1, "complexity climbed more than one step");
+				}
+			}
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_END()
@@ -35,7 +35,8 @@
 #include <fcntl.h>
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load);
-SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, NULL, NULL);
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown);
+SWITCH_MODULE_DEFINITION(mod_dialplan_xml, mod_dialplan_xml_load, mod_dialplan_xml_shutdown, NULL);
 
 typedef enum {
 	BREAK_ON_TRUE,
@@ -600,6 +601,288 @@ static int parse_exten(switch_core_session_t *session, switch_caller_profile_t *
 	return proceed;
 }
 
+/*
+ * Compiled contexts
+ *
+ * Contexts found in the static XML registry are compiled once per reloadxml.  For every extension we
+ * look at the first condition and, when it can only ever fail without side effects (a plain caller
+ * field tested against a constant expression, default break, no anti-actions, no time rules), we keep
+ * the literal the expression anchors on.  At hunt time a failed literal compare skips the extension
+ * without expanding variables or compiling any regex; everything else is evaluated by parse_exten()
+ * exactly as before.  Contexts served from bindings (mod_xml_curl etc.) are never compiled.
+ */
+
+typedef struct dp_exten_s {
+	switch_xml_t xexten;
+	const char *name;
+	const char *field;
+	char *literal;
+	switch_size_t literal_len;
+	switch_bool_t exact;
+	switch_atomic_t evaluated;
+	switch_atomic_t skipped;
+	switch_atomic_t matched;
+} dp_exten_t;
+
+typedef struct dp_context_s {
+	char *name;
+	switch_xml_t root;
+	switch_xml_t xcontext;
+	dp_exten_t *extens;
+	uint32_t nexten;
+	uint32_t nfiltered;
+	int refs;
+	switch_time_t compiled;
+	switch_memory_pool_t *pool;
+} dp_context_t;
+
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_hash_t *context_hash;
+} globals;
+
+static void dp_compile_expression(dp_context_t *dpc, dp_exten_t *dpe, const char *expression)
+{
+	char buf[256] = "";
+	switch_size_t n = 0;
+	const char *p;
+
+	if (zstr(expression) || *expression != '^' || strchr(expression, '|')) {
+		return;
+	}
+
+	for (p = expression + 1; *p && n < sizeof(buf) - 1; p++) {
+		if (*p == '\\' && p[1] && strchr("+*.#?()[]{}$^|\\/", p[1])) {
+			buf[n++] = *++p;
+		} else if (isalnum((unsigned char) *p) || *p == '#' || *p == '@' || *p == '_' || *p == '-' || *p == ':' || *p == '=' || *p == ',') {
+			buf[n++] = *p;
+		} else {
+			break;
+		}
+	}
+
+	if (*p == '?' || *p == '*' || *p == '+' || *p == '{') {
+		/* the last atom is optional or repeated, it is not part of the fixed prefix */
+		if (n) n--;
+	} else if (*p == '$' && !p[1]) {
+		dpe->exact = SWITCH_TRUE;
+	}
+
+	if (n) {
+		buf[n] = '\0';
+		dpe->literal = switch_core_strdup(dpc->pool, buf);
+		dpe->literal_len = n;
+		dpc->nfiltered++;
+	} else {
+		dpe->exact = SWITCH_FALSE;
+	}
+}
+
+static void dp_compile_exten(dp_context_t *dpc, dp_exten_t *dpe)
+{
+	switch_xml_t xcond, xexpression;
+	const char *field, *expression, *do_break;
+	int i;
+
+	if (!(xcond = switch_xml_child(dpe->xexten, "condition"))) {
+		return;
+	}
+
+	/* anything beyond field/expression/break (regex, time rules, require-nested...) is evaluated at runtime */
+	for (i = 0; xcond->attr && xcond->attr[i]; i += 2) {
+		if (strcasecmp(xcond->attr[i], "field") && strcasecmp(xcond->attr[i], "expression") && strcasecmp(xcond->attr[i], "break")) {
+			return;
+		}
+	}
+
+	if ((do_break = switch_xml_attr(xcond, "break")) &&
+		(!strcasecmp(do_break, "on-true") || !strcasecmp(do_break, "always") || !strcasecmp(do_break, "never"))) {
+		return;
+	}
+
+	if (switch_xml_child(xcond, "anti-action")) {
+		return;
+	}
+
+	if (zstr((field = switch_xml_attr(xcond, "field"))) || strchr(field, '$')) {
+		return;
+	}
+
+	if ((xexpression = switch_xml_child(xcond, "expression"))) {
+		expression = xexpression->txt;
+	} else {
+		expression = switch_xml_attr(xcond, "expression");
+	}
+
+	if (zstr(expression) || strchr(expression, '$')) {
+		return;
+	}
+
+	dp_compile_expression(dpc, dpe, expression);
+
+	if (dpe->literal) {
+		dpe->field = field;
+	}
+}
+
+static dp_context_t *dp_context_compile(switch_xml_t root, switch_xml_t xcontext, const char *name)
+{
+	switch_memory_pool_t *pool = NULL;
+	dp_context_t *dpc;
+	switch_xml_t xexten;
+	uint32_t i = 0;
+
+	switch_core_new_memory_pool(&pool);
+	dpc = switch_core_alloc(pool, sizeof(*dpc));
+	dpc->pool = pool;
+	dpc->name = switch_core_strdup(pool, name);
+	dpc->root = root;
+	dpc->xcontext = xcontext;
+	dpc->compiled = switch_micro_time_now();
+
+	for (xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next) {
+		dpc->nexten++;
+	}
+
+	if (dpc->nexten) {
+		dpc->extens = switch_core_alloc(pool, sizeof(dp_exten_t) * dpc->nexten);
+	}
+
+	for (xexten = switch_xml_child(xcontext, "extension"); xexten; xexten = xexten->next) {
+		dp_exten_t *dpe = &dpc->extens[i++];
+		const char *exten_name = switch_xml_attr(xexten, "name");
+
+		dpe->xexten = xexten;
+		dpe->name = exten_name ? exten_name : "UNKNOWN";
+		dp_compile_exten(dpc, dpe);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Compiled context %s: %u extensions, %u with literal prefilter\n",
+					  dpc->name, dpc->nexten, dpc->nfiltered);
+
+	return dpc;
+}
+
+/* must be called with globals.mutex held */
+static void dp_context_release_locked(dp_context_t *dpc)
+{
+	if (--dpc->refs == 0) {
+		switch_memory_pool_t *pool = dpc->pool;
+
+		switch_xml_free(dpc->root);
+		switch_core_destroy_memory_pool(&pool);
+	}
+}
+
+static void dp_context_release(dp_context_t *dpc)
+{
+	if (!dpc) {
+		return;
+	}
+
+	switch_mutex_lock(globals.mutex);
+	dp_context_release_locked(dpc);
+	switch_mutex_unlock(globals.mutex);
+}
+
+static dp_context_t *dp_context_get(switch_xml_t xml, switch_xml_t xcontext)
+{
+	dp_context_t *dpc = NULL;
+	switch_xml_t sroot;
+	const char *name = switch_xml_attr_soft(xcontext, "name");
+
+	/* only the static registry lives long enough to be worth compiling; its reference is held by the cache */
+	sroot = switch_xml_root();
+
+	if (sroot != xml) {
+		switch_xml_free(sroot);
+		return NULL;
+	}
+
+	switch_mutex_lock(globals.mutex);
+
+	if ((dpc = switch_core_hash_find(globals.context_hash, name)) && dpc->root == xml && dpc->xcontext == xcontext) {
+		dpc->refs++;
+		switch_xml_free(sroot);
+	} else {
+		if (dpc) {
+			switch_core_hash_delete(globals.context_hash, name);
+			dp_context_release_locked(dpc);
+		}
+
+		dpc = dp_context_compile(sroot, xcontext, name);
+		dpc->refs = 2;
+		switch_core_hash_insert(globals.context_hash, name, dpc);
+	}
+
+	switch_mutex_unlock(globals.mutex);
+
+	return dpc;
+}
+
+static void dp_context_flush(void)
+{
+	switch_hash_index_t *hi = NULL;
+	const void *var;
+	void *val;
+
+	switch_mutex_lock(globals.mutex);
+	while ((hi = switch_core_hash_first_iter(globals.context_hash, hi))) {
+		switch_core_hash_this(hi, &var, NULL, &val);
+		switch_core_hash_delete(globals.context_hash, var);
+		dp_context_release_locked((dp_context_t *) val);
+	}
+	switch_mutex_unlock(globals.mutex);
+}
+
+static void dp_reloadxml_event_handler(switch_event_t *event)
+{
+	dp_context_flush();
+}
+
+static dp_exten_t *dp_context_find_exten(dp_context_t *dpc, switch_xml_t xexten, uint32_t *pos)
+{
+	uint32_t i;
+
+	for (i = *pos; i < dpc->nexten; i++) {
+		if (dpc->extens[i].xexten == xexten) {
+			*pos = i + 1;
+			return &dpc->extens[i];
+		}
+	}
+
+	return NULL;
+}
+
+static switch_bool_t dp_exten_can_skip(dp_exten_t *dpe, switch_caller_profile_t *caller_profile)
+{
+	const char *field_data;
+	switch_size_t len;
+
+	if (!dpe->literal) {
+		return SWITCH_FALSE;
+	}
+
+	if (!(field_data = switch_caller_get_field_by_name(caller_profile, dpe->field))) {
+		field_data = "";
+	}
+
+	if (strncmp(field_data, dpe->literal, dpe->literal_len)) {
+		return SWITCH_TRUE;
+	}
+
+	if (dpe->exact) {
+		len = strlen(field_data);
+		/* pcre lets $ match before a final newline */
+		if (!(len == dpe->literal_len || (len == dpe->literal_len + 1 && field_data[len - 1] == '\n'))) {
+			return SWITCH_TRUE;
+		}
+	}
+
+	return SWITCH_FALSE;
+}
+
 static switch_status_t dialplan_xml_locate(switch_core_session_t *session, switch_caller_profile_t *caller_profile, switch_xml_t *root,
 										   switch_xml_t *node)
 {
@@ -624,6 +907,8 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	switch_xml_t alt_root = NULL, cfg, xml = NULL, xcontext, xexten = NULL;
 	char *alt_path = (char *) arg;
 	const char *hunt = NULL;
+	dp_context_t *dpc = NULL;
+	uint32_t dpos = 0;
 
 	if (!caller_profile) {
 		if (!(caller_profile = switch_channel_get_caller_profile(channel))) {
@@ -679,15 +964,26 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 		xexten = switch_xml_child(xcontext, "extension");
 	}
 
+	if (!alt_root && !switch_false(switch_channel_get_variable(channel, "dialplan_xml_compiled"))) {
+		dpc = dp_context_get(xml, xcontext);
+	}
+
 	while (xexten) {
 		int proceed = 0;
 		const char *cont = switch_xml_attr(xexten, "continue");
 		const char *exten_name = switch_xml_attr(xexten, "name");
+		dp_exten_t *dpe = dpc ? dp_context_find_exten(dpc, xexten, &dpos) : NULL;
 
 		if (!exten_name) {
 			exten_name = "UNKNOWN";
 		}
 
+		if (dpe && dp_exten_can_skip(dpe, caller_profile)) {
+			switch_atomic_inc(&dpe->skipped);
+			xexten = xexten->next;
+			continue;
+		}
+
 		if ( switch_core_test_flag(SCF_DIALPLAN_TIMESTAMPS) ) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_DEBUG,
 						  "Dialplan: %s parsing [%s->%s] continue=%s\n",
@@ -700,6 +996,13 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 
 		proceed = parse_exten(session, caller_profile, xexten, &extension, exten_name, 0);
 
+		if (dpe) {
+			switch_atomic_inc(&dpe->evaluated);
+			if (proceed) {
+				switch_atomic_inc(&dpe->matched);
+			}
+		}
+
 		if (proceed && !switch_true(cont)) {
 			break;
 		}
@@ -707,6 +1010,8 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 		xexten = xexten->next;
 	}
 
+	dp_context_release(dpc);
+
 	switch_xml_free(xml);
 	xml = NULL;
 
@@ -715,18 +1020,75 @@ SWITCH_STANDARD_DIALPLAN(dialplan_hunt)
 	return extension;
 }
 
+#define DIALPLAN_XML_STATS_SYNTAX "[<context>]"
+SWITCH_STANDARD_API(dialplan_xml_stats_function)
+{
+	switch_hash_index_t *hi;
+	const void *var;
+	void *val;
+	uint32_t i;
+
+	stream->write_function(stream, "%-20s %-32s %-8s %12s %12s %12s\n", "context", "extension", "filter", "evaluated", "skipped", "matched");
+
+	switch_mutex_lock(globals.mutex);
+	for (hi = switch_core_hash_first(globals.context_hash); hi; hi = switch_core_hash_next(&hi)) {
+		dp_context_t *dpc;
+
+		switch_core_hash_this(hi, &var, NULL, &val);
+		dpc = (dp_context_t *) val;
+
+		if (!zstr(cmd) && strcasecmp(cmd, dpc->name)) {
+			continue;
+		}
+
+		for (i = 0; i < dpc->nexten; i++) {
+			dp_exten_t *dpe = &dpc->extens[i];
+
+			stream->write_function(stream, "%-20s %-32s %-8s %12u %12u %12u\n", dpc->name, dpe->name,
+								   dpe->literal ? (dpe->exact ? "exact" : "prefix") : "none",
+								   switch_atomic_read(&dpe->evaluated), switch_atomic_read(&dpe->skipped), switch_atomic_read(&dpe->matched));
+		}
+	}
+	switch_mutex_unlock(globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_dialplan_xml_load)
 {
 	switch_dialplan_interface_t *dp_interface;
 
+	switch_api_interface_t *api_interface;
+
+	memset(&globals, 0, sizeof(globals));
+	globals.pool = pool;
+	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_core_hash_init(&globals.context_hash);
+
+	if (switch_event_bind(modname, SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, dp_reloadxml_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+		return SWITCH_STATUS_GENERR;
+	}
+
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 	SWITCH_ADD_DIALPLAN(dp_interface, "XML", dialplan_hunt);
+	SWITCH_ADD_API(api_interface, "dialplan_xml_stats", "Show per extension match statistics of compiled XML dialplan contexts",
+				   dialplan_xml_stats_function, DIALPLAN_XML_STATS_SYNTAX);
 
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
 
+SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_dialplan_xml_shutdown)
+{
+	switch_event_unbind_callback(dp_reloadxml_event_handler);
+	dp_context_flush();
+	switch_core_hash_destroy(&globals.context_hash);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* For Emacs:
  * Local Variables:
  * mode:c
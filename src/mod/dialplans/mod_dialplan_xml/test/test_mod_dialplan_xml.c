@@ -0,0 +1,158 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_dialplan_xml -- compiled context prefilter tests
+ *
+ */
+
+#include <test/switch_test.h>
+
+/* Hunts the prefilter context and returns the data of the first application, or NULL when nothing matched */
+static const char *hunt(switch_core_session_t *session, const char *destination_number)
+{
+	switch_memory_pool_t *pool = switch_core_session_get_pool(session);
+	switch_dialplan_interface_t *dialplan_interface;
+	switch_caller_profile_t *caller_profile;
+	switch_caller_extension_t *extension;
+	const char *data = NULL;
+
+	caller_profile = switch_caller_profile_new(pool, "test", "XML", "test", "1234", "127.0.0.1", NULL, NULL, NULL, "test",
+											   "prefilter", destination_number);
+
+	if (!(dialplan_interface = switch_loadable_module_get_dialplan_interface("XML"))) {
+		return NULL;
+	}
+
+	if ((extension = dialplan_interface->hunt_function(session, NULL, caller_profile)) && extension->applications) {
+		data = switch_core_session_strdup(session, extension->applications->application_data);
+	}
+
+	UNPROTECT_INTERFACE(dialplan_interface);
+
+	return data;
+}
+
+/* Reads the filter kind and counters of one extension out of dialplan_xml_stats, returns -1 if it is not listed */
+static int exten_stats(const char *name, char *filter, uint32_t *evaluated, uint32_t *skipped, uint32_t *matched)
+{
+	switch_stream_handle_t stream = { 0 };
+	char *line, *next;
+	int found = -1;
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("dialplan_xml_stats", "prefilter", NULL, &stream);
+
+	for (line = (char *) stream.data; line && *line; line = next) {
+		char context[32], exten[64];
+
+		if ((next = strchr(line, '\n'))) {
+			*next++ = '\0';
+		}
+
+		if (sscanf(line, "%31s %63s %7s %u %u %u", context, exten, filter, evaluated, skipped, matched) == 6 && !strcmp(exten, name)) {
+			found = 0;
+			break;
+		}
+	}
+
+	switch_safe_free(stream.data);
+
+	return found;
+}
+
+FST_CORE_BEGIN("conf")
+{
+	FST_MODULE_BEGIN(mod_dialplan_xml, mod_dialplan_xml_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_dialplan_xml");
+		}
+		FST_SETUP_END()
+
+		FST_SESSION_BEGIN(prefilter_routes)
+		{
+			char filter[8];
+			uint32_t evaluated, skipped, matched;
+			const char *route;
+			const char *err = NULL;
+			int i;
+
+			/* routing is the same as without the prefilter, captures included */
+			fst_check_string_equals(hunt(fst_session, "1000"), "route=exact");
+			fst_check_string_equals(hunt(fst_session, "9555"), "route=prefix_555");
+			fst_check_string_equals(hunt(fst_session, "123"), "route=any_123");
+			fst_check(hunt(fst_session, "10000") == NULL);
+
+			fst_check_int_equals(exten_stats("exact_1000", filter, &evaluated, &skipped, &matched), 0);
+			fst_check_string_equals(filter, "exact");
+			fst_check_int_equals(evaluated, 1);
+			fst_check_int_equals(skipped, 3);
+			fst_check_int_equals(matched, 1);
+
+			fst_check_int_equals(exten_stats("prefix_9", filter, &evaluated, &skipped, &matched), 0);
+			fst_check_string_equals(filter, "prefix");
+			fst_check_int_equals(evaluated, 1);
+			fst_check_int_equals(skipped, 2);
+			fst_check_int_equals(matched, 1);
+
+			fst_check_int_equals(exten_stats("any_3", filter, &evaluated, &skipped, &matched), 0);
+			fst_check_string_equals(filter, "none");
+			fst_check_int_equals(evaluated, 2);
+			fst_check_int_equals(skipped, 0);
+			fst_check_int_equals(matched, 1);
+
+			/* with the prefilter off every extension is parsed and the counters stay put */
+			switch_channel_set_variable(fst_channel, "dialplan_xml_compiled", "false");
+			fst_check_string_equals(hunt(fst_session, "9555"), "route=prefix_555");
+			fst_check_int_equals(exten_stats("prefix_9", filter, &evaluated, &skipped, &matched), 0);
+			fst_check_int_equals(evaluated, 1);
+			fst_check_int_equals(skipped, 2);
+			switch_channel_set_variable(fst_channel, "dialplan_xml_compiled", NULL);
+
+			/* reloadxml drops the compiled context, the next hunt compiles it again from scratch */
+			fst_requires(switch_xml_reload(&err) == SWITCH_STATUS_SUCCESS);
+			for (i = 0; i < 50 && exten_stats("exact_1000", filter, &evaluated, &skipped, &matched) == 0; i++) {
+				switch_yield(100000);
+			}
+			fst_check_int_equals(exten_stats("exact_1000", filter, &evaluated, &skipped, &matched), -1);
+
+			route = hunt(fst_session, "1000");
+			fst_check_string_equals(route, "route=exact");
+			fst_check_int_equals(exten_stats("exact_1000", filter, &evaluated, &skipped, &matched), 0);
+			fst_check_int_equals(evaluated, 1);
+			fst_check_int_equals(skipped, 0);
+			fst_check_int_equals(matched, 1);
+		}
+		FST_SESSION_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
@@ -3629,6 +3629,7 @@ static switch_status_t cmd_profile(char **argv, int argc, switch_stream_handle_t
 			stream->write_function(stream, "+OK %s all registrations matching specified call_id\n", reboot ? "rebooting" : "flushing");
 		} else {
 			sofia_reg_check_expire(profile, 0, reboot);
+			sofia_reg_auth_cache_flush(profile, NULL, NULL);
 			stream->write_function(stream, "+OK %s all registrations\n", reboot ? "rebooting" : "flushing");
 		}
 
@@ -5345,6 +5346,26 @@ static int notify_callback(void *pArg, int argc, char **argv, char **columnNames
 void general_event_handler(switch_event_t *event)
 {
 	switch (event->event_id) {
+	case SWITCH_EVENT_RELOADXML:
+		{
+			sofia_profile_t *profile;
+			switch_hash_index_t *hi;
+			const void *var;
+			void *val;
+
+			/* directory contents may have changed, forget any cached credentials */
+			switch_mutex_lock(mod_sofia_globals.hash_mutex);
+			if (mod_sofia_globals.profile_hash) {
+				for (hi = switch_core_hash_first(mod_sofia_globals.profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+					switch_core_hash_this(hi, &var, NULL, &val);
+					if ((profile = (sofia_profile_t *) val) && !strcmp((char *) var, profile->name)) {
+						sofia_reg_auth_cache_flush(profile, NULL, NULL);
+					}
+				}
+			}
+			switch_mutex_unlock(mod_sofia_globals.hash_mutex);
+		}
+		break;
 	case SWITCH_EVENT_NOTIFY:
 		{
 			const char *profile_name = switch_event_get_header(event, "profile");
@@ -6667,13 +6688,11 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 
 	if (sofia_init() != SWITCH_STATUS_SUCCESS) {
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (config_sofia(SOFIA_CONFIG_LOAD, NULL) != SWITCH_STATUS_SUCCESS) {
 		mod_sofia_globals.running = 0;
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	sofia_msg_thread_start(0);
@@ -6689,70 +6708,64 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_sofia_load)
 	if (switch_event_bind(modname, SWITCH_EVENT_CONFERENCE_DATA, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_PRESENCE_IN, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_PRESENCE_OUT, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_PRESENCE_PROBE, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_ROSTER, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_MESSAGE_WAITING, SWITCH_EVENT_SUBCLASS_ANY, sofia_presence_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_TRAP, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_NOTIFY, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_PHONE_FEATURE, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_SEND_MESSAGE, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
 	}
 
 	if (switch_event_bind(modname, SWITCH_EVENT_SEND_INFO, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		switch_goto_status(SWITCH_STATUS_GENERR, err);
-		return SWITCH_STATUS_GENERR;
+	}
+
+	if (switch_event_bind(modname, SWITCH_EVENT_RELOADXML, SWITCH_EVENT_SUBCLASS_ANY, general_queue_event_handler, NULL) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
+		switch_goto_status(SWITCH_STATUS_GENERR, err);
 	}
 
 	/* connect my internal structure to the blank pointer passed to me */
@@ -715,6 +715,19 @@ struct sofia_profile {
 	switch_hash_t *chat_hash;
 	switch_hash_t *reg_nh_hash;
 	switch_hash_t *mwi_debounce_hash;
+	switch_hash_t *auth_cache_hash;
+	switch_mutex_t *auth_cache_mutex;
+	uint32_t auth_cache_ttl;
+	uint32_t auth_cache_negative_ttl;
+	uint32_t auth_cache_max;
+	uint32_t auth_cache_count;
+	struct sofia_auth_cache_entry_s *auth_cache_head;
+	struct sofia_auth_cache_entry_s *auth_cache_tail;
+	switch_memory_pool_t *ping_wheel_pool;
+	struct sofia_ping_contact_s **ping_wheel;
+	int ping_wheel_size;
+	time_t ping_wheel_loaded;
+	time_t ping_wheel_last;
 	//switch_core_db_t *master_db;
 	switch_thread_rwlock_t *rwlock;
 	switch_mutex_t *flag_mutex;
@@ -1077,7 +1090,15 @@ void sofia_glue_actually_execute_sql_trans(sofia_profile_t *profile, char *sql,
 void sofia_glue_execute_sql_now(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_glue_execute_sql_soon(sofia_profile_t *profile, char **sqlp, switch_bool_t sql_already_dynamic);
 void sofia_reg_check_expire(sofia_profile_t *profile, time_t now, int reboot);
+switch_status_t sofia_reg_auth_cache_locate(sofia_profile_t *profile, const char *user, const char *domain, const char *ip, switch_xml_t *x_user);
+void sofia_reg_auth_cache_store(sofia_profile_t *profile, const char *user, const char *domain, const char *ip, switch_xml_t x_user);
+uint32_t sofia_reg_auth_cache_flush(sofia_profile_t *profile, const char *user, const char *domain);
+void sofia_reg_auth_cache_expire(sofia_profile_t *profile, time_t now);
 void sofia_reg_check_ping_expire(sofia_profile_t *profile, time_t now, int interval);
+void sofia_reg_ping_wheel_reset(sofia_profile_t *profile, int interval, time_t now);
+void sofia_reg_ping_wheel_add(sofia_profile_t *profile, long ping_expires, const char *call_id, const char *user, const char *host, const char *contact);
+uint32_t sofia_reg_ping_wheel_run(sofia_profile_t *profile, time_t now, switch_core_db_callback_func_t callback, void *pArg);
+void sofia_reg_ping_wheel_destroy(sofia_profile_t *profile);
 void sofia_reg_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_sub_check_gateway(sofia_profile_t *profile, time_t now);
 void sofia_reg_unregister(sofia_profile_t *profile);
@@ -2994,6 +2994,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 				if (++ireg_loops >= (uint32_t)profile->ireg_seconds) {
 					time_t now = switch_epoch_time_now(NULL);
 					sofia_reg_check_expire(profile, now, 0);
+					sofia_reg_auth_cache_expire(profile, now);
 					ireg_loops = 0;
 				}
 
@@ -3035,6 +3036,7 @@ void *SWITCH_THREAD_FUNC sofia_profile_worker_thread_run(switch_thread_t *thread
 
 	}
 
+	sofia_reg_ping_wheel_destroy(profile);
 	sofia_clear_pflag_locked(profile, PFLAG_WORKER_RUNNING);
 
 	return NULL;
@@ -3590,6 +3592,8 @@ void *SWITCH_THREAD_FUNC sofia_profile_thread_run(switch_thread_t *thread, void
 	switch_core_hash_destroy(&profile->chat_hash);
 	switch_core_hash_destroy(&profile->reg_nh_hash);
 	switch_core_hash_destroy(&profile->mwi_debounce_hash);
+	sofia_reg_auth_cache_flush(profile, NULL, NULL);
+	switch_core_hash_destroy(&profile->auth_cache_hash);
 
 	switch_thread_rwlock_unlock(profile->rwlock);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Write unlock %s\n", profile->name);
@@ -4640,6 +4644,9 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 					switch_core_hash_init(&profile->chat_hash);
 					switch_core_hash_init(&profile->reg_nh_hash);
 					switch_core_hash_init(&profile->mwi_debounce_hash);
+					switch_core_hash_init(&profile->auth_cache_hash);
+					switch_mutex_init(&profile->auth_cache_mutex, SWITCH_MUTEX_NESTED, profile->pool);
+					profile->auth_cache_max = 10000;
 					switch_thread_rwlock_create(&profile->rwlock, profile->pool);
 					switch_mutex_init(&profile->flag_mutex, SWITCH_MUTEX_NESTED, profile->pool);
 					profile->dtmf_duration = 100;
@@ -5608,6 +5615,15 @@ switch_status_t config_sofia(sofia_config_t reload, char *profile_name)
 						profile->nonce_ttl = atoi(val);
 					} else if (!strcasecmp(var, "max-auth-validity") && !zstr(val)) {
 						profile->max_auth_validity = atoi(val);
+					} else if (!strcasecmp(var, "auth-cache-ttl") && !zstr(val)) {
+						int ttl = atoi(val);
+						profile->auth_cache_ttl = ttl > 0 ? ttl : 0;
+					} else if (!strcasecmp(var, "auth-cache-negative-ttl") && !zstr(val)) {
+						int ttl = atoi(val);
+						profile->auth_cache_negative_ttl = ttl > 0 ? ttl : 0;
+					} else if (!strcasecmp(var, "auth-cache-max-entries") && !zstr(val)) {
+						int max = atoi(val);
+						profile->auth_cache_max = max > 0 ? max : 0;
 					} else if (!strcasecmp(var, "auth-require-user")) {
 						if (switch_true(val)) {
 							sofia_set_pflag(profile, PFLAG_AUTH_REQUIRE_USER);
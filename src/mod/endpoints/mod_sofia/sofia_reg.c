@@ -797,6 +797,8 @@ void sofia_reg_expire_call_id(sofia_profile_t *profile, const char *call_id, int
 	sql = switch_mprintf("delete from sip_registrations where call_id='%q' %s", call_id, sqlextra);
 	sofia_glue_execute_sql_now(profile, &sql, SWITCH_TRUE);
 
+	sofia_reg_auth_cache_flush(profile, user, host);
+
 	switch_safe_free(sqlextra);
 	switch_safe_free(sql);
 	switch_safe_free(dup);
@@ -890,73 +892,164 @@ long sofia_reg_uniform_distribution(int max)
 	return (long) result;
 }
 
+typedef struct sofia_ping_contact_s {
+	char *call_id;
+	char *user;
+	char *host;
+	char *contact;
+	struct sofia_ping_contact_s *next;
+} sofia_ping_contact_t;
+
+/*
+ * The ping wheel has one slot per second of the ping interval.  Every registration sits in the slot given by
+ * its ping_expires modulo the interval, a phase picked at random when the contact registers, so each second
+ * only the contacts of one slot are pinged.  The wheel is filled from the database once per revolution and
+ * only the worker thread touches it.
+ */
+void sofia_reg_ping_wheel_reset(sofia_profile_t *profile, int interval, time_t now)
+{
+	if (interval < 1) {
+		interval = 1;
+	}
+
+	if (profile->ping_wheel_pool) {
+		switch_core_destroy_memory_pool(&profile->ping_wheel_pool);
+	}
+
+	switch_core_new_memory_pool(&profile->ping_wheel_pool);
+	profile->ping_wheel = switch_core_alloc(profile->ping_wheel_pool, sizeof(sofia_ping_contact_t *) * interval);
+
+	if (!profile->ping_wheel_last || profile->ping_wheel_size != interval) {
+		profile->ping_wheel_last = now - 1;
+	}
+
+	profile->ping_wheel_size = interval;
+	profile->ping_wheel_loaded = now;
+}
+
+void sofia_reg_ping_wheel_add(sofia_profile_t *profile, long ping_expires, const char *call_id, const char *user, const char *host, const char *contact)
+{
+	sofia_ping_contact_t *pc;
+	int slot;
+
+	if (!profile->ping_wheel || zstr(call_id) || zstr(contact)) {
+		return;
+	}
+
+	slot = (int) (ping_expires % profile->ping_wheel_size);
+
+	pc = switch_core_alloc(profile->ping_wheel_pool, sizeof(*pc));
+	pc->call_id = switch_core_strdup(profile->ping_wheel_pool, call_id);
+	pc->user = switch_core_strdup(profile->ping_wheel_pool, switch_str_nil(user));
+	pc->host = switch_core_strdup(profile->ping_wheel_pool, switch_str_nil(host));
+	pc->contact = switch_core_strdup(profile->ping_wheel_pool, contact);
+	pc->next = profile->ping_wheel[slot];
+	profile->ping_wheel[slot] = pc;
+}
+
+uint32_t sofia_reg_ping_wheel_run(sofia_profile_t *profile, time_t now, switch_core_db_callback_func_t callback, void *pArg)
+{
+	sofia_ping_contact_t *pc;
+	time_t t;
+	uint32_t sent = 0;
+
+	if (!profile->ping_wheel) {
+		return 0;
+	}
+
+	/* after a stall every slot is due once, not once per missed second */
+	if (now - profile->ping_wheel_last > profile->ping_wheel_size) {
+		profile->ping_wheel_last = now - profile->ping_wheel_size;
+	}
+
+	for (t = profile->ping_wheel_last + 1; t <= now; t++) {
+		for (pc = profile->ping_wheel[t % profile->ping_wheel_size]; pc; pc = pc->next) {
+			char *argv[4];
+
+			argv[0] = pc->call_id;
+			argv[1] = pc->user;
+			argv[2] = pc->host;
+			argv[3] = pc->contact;
+			callback(pArg, 4, argv, NULL);
+			sent++;
+		}
+	}
+
+	if (now > profile->ping_wheel_last) {
+		profile->ping_wheel_last = now;
+	}
+
+	return sent;
+}
+
+void sofia_reg_ping_wheel_destroy(sofia_profile_t *profile)
+{
+	if (profile->ping_wheel_pool) {
+		switch_core_destroy_memory_pool(&profile->ping_wheel_pool);
+	}
+
+	profile->ping_wheel = NULL;
+	profile->ping_wheel_size = 0;
+	profile->ping_wheel_loaded = 0;
+	profile->ping_wheel_last = 0;
+}
+
+static int sofia_reg_ping_wheel_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	sofia_profile_t *profile = (sofia_profile_t *) pArg;
+
+	sofia_reg_ping_wheel_add(profile, atol(argv[4]), argv[0], argv[1], argv[2], argv[3]);
+
+	return 0;
+}
+
 void sofia_reg_check_ping_expire(sofia_profile_t *profile, time_t now, int interval)
 {
 	char *sql;
-	long next;
-	char buf[32] = "";
-	int count;
 
-	if (now) {
+	if (!now) {
+		return;
+	}
+
+	if (interval < 1) {
+		interval = 1;
+	}
+
+	/* refill the wheel once per revolution so new and removed registrations are picked up within one interval */
+	if (!profile->ping_wheel || profile->ping_wheel_size != interval || now - profile->ping_wheel_loaded >= interval) {
+		sofia_reg_ping_wheel_reset(profile, interval, now);
+
 		if (sofia_test_pflag(profile, PFLAG_ALL_REG_OPTIONS_PING)) {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-								 "expires,user_agent,server_user,server_host,profile_name "
+			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,ping_expires "
 								 "from sip_registrations where hostname='%q' and "
 								 "profile_name='%q' and orig_hostname='%q' and "
-								 "ping_expires > 0 and ping_expires <= %ld",
-								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname, (long) now);
-
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
+								 "ping_expires > 0",
+								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname);
 		} else if (sofia_test_pflag(profile, PFLAG_UDP_NAT_OPTIONS_PING)) {
-			sql = switch_mprintf(" select call_id,sip_user,sip_host,contact,status,rpid, "
-								 " expires,user_agent,server_user,server_host,profile_name "
+			sql = switch_mprintf(" select call_id,sip_user,sip_host,contact,ping_expires "
 								 " from sip_registrations where (status like '%%UDP-NAT%%' or force_ping=1)"
-								 " and hostname='%q' and profile_name='%q' and ping_expires > 0 and ping_expires <= %ld ",
-								 mod_sofia_globals.hostname, profile->name, (long) now);
-
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
+								 " and hostname='%q' and profile_name='%q' and ping_expires > 0 ",
+								 mod_sofia_globals.hostname, profile->name);
 		} else if (sofia_test_pflag(profile, PFLAG_NAT_OPTIONS_PING)) {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-								 "expires,user_agent,server_user,server_host,profile_name "
+			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,ping_expires "
 								 "from sip_registrations where (status like '%%NAT%%' "
 								 "or contact like '%%fs_nat=yes%%' or force_ping=1) and hostname='%q' "
 								 "and profile_name='%q' and orig_hostname='%q' and "
-								 "ping_expires > 0 and ping_expires <= %ld",
-								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname, (long) now);
-
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
+								 "ping_expires > 0",
+								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname);
 		} else {
-			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,status,rpid,"
-								 "expires,user_agent,server_user,server_host,profile_name "
+			sql = switch_mprintf("select call_id,sip_user,sip_host,contact,ping_expires "
 								 "from sip_registrations where force_ping=1 and hostname='%q' "
 								 "and profile_name='%q' and orig_hostname='%q' and "
-								 "ping_expires > 0 and ping_expires <= %ld",
-								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname, (long) now);
-
-			sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_nat_callback, profile);
-			switch_safe_free(sql);
+								 "ping_expires > 0",
+								 mod_sofia_globals.hostname, profile->name, mod_sofia_globals.hostname);
 		}
 
-		sql = switch_mprintf("select count(*) from sip_registrations where hostname='%q' and profile_name='%q' and ping_expires <= %ld",
-							 mod_sofia_globals.hostname, profile->name, (long) now);
-
-		sofia_glue_execute_sql2str(profile, profile->dbh_mutex, sql, buf, sizeof(buf));
+		sofia_glue_execute_sql_callback(profile, profile->dbh_mutex, sql, sofia_reg_ping_wheel_callback, profile);
 		switch_safe_free(sql);
-		count = atoi(buf);
-
-		/* only update if needed */
-		if (count) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG9, "Updating ping expires for profile %s\n", profile->name);
-			next = (long) now + interval;
-
-			sql = switch_mprintf("update sip_registrations set ping_expires = %ld where hostname='%q' and profile_name='%q' and ping_expires <= %ld ",
-								 next, mod_sofia_globals.hostname, profile->name, (long) now);
-			sofia_glue_execute_sql(profile, &sql, SWITCH_TRUE);
-		}
 	}
+
+	sofia_reg_ping_wheel_run(profile, now, sofia_reg_nat_callback, profile);
 }
 
 
@@ -2964,6 +3057,182 @@ switch_status_t sofia_make_digest(sofia_auth_algs_t use_alg, char **digest, cons
 	return status;
 }
 
+typedef struct sofia_auth_cache_entry_s {
+	char *key;
+	char *user;
+	char *domain;
+	switch_xml_t x_user;
+	time_t expires;
+	struct sofia_auth_cache_entry_s *prev;
+	struct sofia_auth_cache_entry_s *next;
+} sofia_auth_cache_entry_t;
+
+/* the list runs from most to least recently used, caller holds auth_cache_mutex */
+static void sofia_reg_auth_cache_unlink(sofia_profile_t *profile, sofia_auth_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		profile->auth_cache_head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		profile->auth_cache_tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void sofia_reg_auth_cache_link(sofia_profile_t *profile, sofia_auth_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = profile->auth_cache_head;
+
+	if (entry->next) {
+		entry->next->prev = entry;
+	} else {
+		profile->auth_cache_tail = entry;
+	}
+
+	profile->auth_cache_head = entry;
+}
+
+static void sofia_reg_auth_cache_remove(sofia_profile_t *profile, sofia_auth_cache_entry_t *entry)
+{
+	switch_core_hash_delete(profile->auth_cache_hash, entry->key);
+	sofia_reg_auth_cache_unlink(profile, entry);
+	profile->auth_cache_count--;
+
+	if (entry->x_user) {
+		switch_xml_free(entry->x_user);
+	}
+
+	switch_safe_free(entry->key);
+	switch_safe_free(entry->user);
+	switch_safe_free(entry->domain);
+	free(entry);
+}
+
+/* The directory can match users on the source ip as well as the name, so the ip is part of the key. */
+static void sofia_reg_auth_cache_key(char *key, size_t len, const char *user, const char *domain, const char *ip)
+{
+	switch_snprintf(key, len, "%s@%s/%s", user, domain, switch_str_nil(ip));
+}
+
+/* Look up cached directory credentials for user@domain from ip.
+   Returns SWITCH_STATUS_SUCCESS with a private copy of the merged user node,
+   SWITCH_STATUS_NOTFOUND on a negative hit or SWITCH_STATUS_FALSE on a miss. */
+switch_status_t sofia_reg_auth_cache_locate(sofia_profile_t *profile, const char *user, const char *domain, const char *ip, switch_xml_t *x_user)
+{
+	sofia_auth_cache_entry_t *entry;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	char key[512];
+
+	if (!profile->auth_cache_ttl) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	sofia_reg_auth_cache_key(key, sizeof(key), user, domain, ip);
+
+	switch_mutex_lock(profile->auth_cache_mutex);
+	if ((entry = switch_core_hash_find(profile->auth_cache_hash, key))) {
+		if (entry->expires <= switch_epoch_time_now(NULL)) {
+			sofia_reg_auth_cache_remove(profile, entry);
+		} else {
+			sofia_reg_auth_cache_unlink(profile, entry);
+			sofia_reg_auth_cache_link(profile, entry);
+
+			if (entry->x_user) {
+				*x_user = switch_xml_dup(entry->x_user);
+				status = SWITCH_STATUS_SUCCESS;
+			} else {
+				status = SWITCH_STATUS_NOTFOUND;
+			}
+		}
+	}
+	switch_mutex_unlock(profile->auth_cache_mutex);
+
+	return status;
+}
+
+/* Remember the result of a directory lookup, a NULL x_user records a user the directory said does not exist.
+   The least recently used entry makes room once auth-cache-max-entries is reached. */
+void sofia_reg_auth_cache_store(sofia_profile_t *profile, const char *user, const char *domain, const char *ip, switch_xml_t x_user)
+{
+	sofia_auth_cache_entry_t *entry, *old;
+	uint32_t ttl = x_user ? profile->auth_cache_ttl : profile->auth_cache_negative_ttl;
+	char key[512];
+
+	if (!profile->auth_cache_ttl || !ttl || !profile->auth_cache_max) {
+		return;
+	}
+
+	sofia_reg_auth_cache_key(key, sizeof(key), user, domain, ip);
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->key = strdup(key);
+	entry->user = strdup(user);
+	entry->domain = strdup(domain);
+	entry->x_user = x_user ? switch_xml_dup(x_user) : NULL;
+	entry->expires = switch_epoch_time_now(NULL) + ttl;
+
+	switch_mutex_lock(profile->auth_cache_mutex);
+	if ((old = switch_core_hash_find(profile->auth_cache_hash, key))) {
+		sofia_reg_auth_cache_remove(profile, old);
+	}
+
+	while (profile->auth_cache_count >= profile->auth_cache_max && profile->auth_cache_tail) {
+		sofia_reg_auth_cache_remove(profile, profile->auth_cache_tail);
+	}
+
+	switch_core_hash_insert(profile->auth_cache_hash, key, entry);
+	sofia_reg_auth_cache_link(profile, entry);
+	profile->auth_cache_count++;
+	switch_mutex_unlock(profile->auth_cache_mutex);
+}
+
+uint32_t sofia_reg_auth_cache_flush(sofia_profile_t *profile, const char *user, const char *domain)
+{
+	sofia_auth_cache_entry_t *entry, *next;
+	uint32_t count = 0;
+
+	switch_mutex_lock(profile->auth_cache_mutex);
+	for (entry = profile->auth_cache_head; entry; entry = next) {
+		next = entry->next;
+
+		if (!zstr(domain) && (strcasecmp(entry->domain, domain) || (!zstr(user) && strcasecmp(entry->user, user)))) {
+			continue;
+		}
+
+		sofia_reg_auth_cache_remove(profile, entry);
+		count++;
+	}
+	switch_mutex_unlock(profile->auth_cache_mutex);
+
+	return count;
+}
+
+void sofia_reg_auth_cache_expire(sofia_profile_t *profile, time_t now)
+{
+	sofia_auth_cache_entry_t *entry, *next;
+
+	if (!profile->auth_cache_ttl || !now) {
+		return;
+	}
+
+	switch_mutex_lock(profile->auth_cache_mutex);
+	for (entry = profile->auth_cache_head; entry; entry = next) {
+		next = entry->next;
+
+		if (entry->expires <= now) {
+			sofia_reg_auth_cache_remove(profile, entry);
+		}
+	}
+	switch_mutex_unlock(profile->auth_cache_mutex);
+}
+
 auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 								sip_authorization_t const *authorization,
 								sip_t const *sip,
@@ -3001,6 +3270,7 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 	char client_port[16];
 	uint8_t use_alg;
 	unsigned int digest_outputlen;
+	switch_status_t auth_cache_status;
 
 	snprintf(client_port, 15, "%d", network_port);
 
@@ -3206,7 +3476,20 @@ auth_res_t sofia_reg_parse_auth(sofia_profile_t *profile,
 		domain_name = realm;
 	}
 
-	if (switch_xml_locate_user_merged("id", zstr(username) ? "nobody" : username, domain_name, ip, &user, params) != SWITCH_STATUS_SUCCESS) {
+	if ((auth_cache_status = sofia_reg_auth_cache_locate(profile, zstr(username) ? "nobody" : username, domain_name, ip, &user)) == SWITCH_STATUS_FALSE) {
+		switch_bool_t not_found = SWITCH_FALSE;
+
+		auth_cache_status = switch_xml_locate_user_merged_ex("id", zstr(username) ? "nobody" : username, domain_name, ip, &user, params, &not_found);
+
+		/* a directory that failed to answer (xml_curl timeout, http error) is not a user that does not exist */
+		if (auth_cache_status == SWITCH_STATUS_SUCCESS || not_found) {
+			sofia_reg_auth_cache_store(profile, zstr(username) ? "nobody" : username, domain_name, ip, user);
+		}
+	} else if (profile->debug) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Using cached credentials for [%s@%s]\n", username, domain_name);
+	}
+
+	if (auth_cache_status != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Can't find user [%s@%s] from %s\n"
 						  "You must define a domain called '%s' in your directory and add a user with the id=\"%s\" attribute\n"
 						  "and you must configure your device to use the proper domain in its authentication credentials.\n", username, domain_name,
@@ -31,6 +31,7 @@
 
 #include <switch.h>
 #include <test/switch_test.h>
+#include "mod_sofia.h"
 
 int protect_dest_uri(switch_caller_profile_t *cp);
 
@@ -103,6 +104,102 @@ FST_TEST_BEGIN(test_protect_url)
 }
 FST_TEST_END()
 
+FST_TEST_BEGIN(test_auth_cache)
+{
+	sofia_profile_t *profile = switch_core_alloc(fst_pool, sizeof(*profile));
+	switch_xml_t node = switch_xml_parse_str_dup("<user id=\"1000\"><params><param name=\"password\" value=\"x\"/></params></user>");
+	switch_xml_t found = NULL;
+
+	fst_requires(node);
+	switch_core_hash_init(&profile->auth_cache_hash);
+	switch_mutex_init(&profile->auth_cache_mutex, SWITCH_MUTEX_NESTED, fst_pool);
+	profile->auth_cache_ttl = 60;
+	profile->auth_cache_negative_ttl = 60;
+	profile->auth_cache_max = 2;
+
+	/* entries are keyed on the source ip too */
+	sofia_reg_auth_cache_store(profile, "1000", "test.local", "10.0.0.1", node);
+	fst_check(sofia_reg_auth_cache_locate(profile, "1000", "test.local", "10.0.0.1", &found) == SWITCH_STATUS_SUCCESS);
+	fst_requires(found);
+	fst_check_string_equals(switch_xml_attr(found, "id"), "1000");
+	switch_xml_free(found);
+	found = NULL;
+	fst_check(sofia_reg_auth_cache_locate(profile, "1000", "test.local", "10.0.0.2", &found) == SWITCH_STATUS_FALSE);
+
+	/* a user the directory does not have is a negative hit */
+	sofia_reg_auth_cache_store(profile, "nobody", "test.local", "10.0.0.1", NULL);
+	fst_check(sofia_reg_auth_cache_locate(profile, "nobody", "test.local", "10.0.0.1", &found) == SWITCH_STATUS_NOTFOUND);
+	fst_check(found == NULL);
+
+	/* at the cap the least recently used entry makes room: 1000 was just used, nobody goes */
+	fst_check(sofia_reg_auth_cache_locate(profile, "1000", "test.local", "10.0.0.1", &found) == SWITCH_STATUS_SUCCESS);
+	switch_xml_free(found);
+	found = NULL;
+	sofia_reg_auth_cache_store(profile, "1001", "test.local", "10.0.0.1", node);
+	fst_check_int_equals(profile->auth_cache_count, 2);
+	fst_check(sofia_reg_auth_cache_locate(profile, "nobody", "test.local", "10.0.0.1", &found) == SWITCH_STATUS_FALSE);
+
+	/* flush by user@domain, then expiry takes the rest */
+	fst_check_int_equals(sofia_reg_auth_cache_flush(profile, "1001", "test.local"), 1);
+	sofia_reg_auth_cache_expire(profile, switch_epoch_time_now(NULL) + 61);
+	fst_check_int_equals(profile->auth_cache_count, 0);
+	fst_check(profile->auth_cache_head == NULL && profile->auth_cache_tail == NULL);
+
+	switch_xml_free(node);
+	switch_core_hash_destroy(&profile->auth_cache_hash);
+}
+FST_TEST_END()
+
+static int ping_wheel_test_callback(void *pArg, int argc, char **argv, char **columnNames)
+{
+	char *seen = (char *) pArg;
+
+	switch_snprintf(seen + strlen(seen), 64 - strlen(seen), "%s,", argv[0]);
+
+	return 0;
+}
+
+FST_TEST_BEGIN(test_ping_wheel)
+{
+	sofia_profile_t *profile = switch_core_alloc(fst_pool, sizeof(*profile));
+	char seen[64] = "";
+	time_t now = 1000;
+
+	/* contacts land in the slot of their ping_expires phase: 1000 % 10 = 0, 1003 % 10 = 3 */
+	sofia_reg_ping_wheel_reset(profile, 10, now);
+	sofia_reg_ping_wheel_add(profile, 1000, "a", "1000", "test.local", "sip:1000@10.0.0.1");
+	sofia_reg_ping_wheel_add(profile, 1003, "b", "1001", "test.local", "sip:1001@10.0.0.2");
+	sofia_reg_ping_wheel_add(profile, 1013, "c", "1002", "test.local", "sip:1002@10.0.0.3");
+
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now, ping_wheel_test_callback, seen), 1);
+	fst_check_string_equals(seen, "a,");
+
+	/* seconds 1001 and 1002 are empty, 1003 fires both contacts of slot 3 */
+	*seen = '\0';
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 2, ping_wheel_test_callback, seen), 0);
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 3, ping_wheel_test_callback, seen), 2);
+	fst_check_string_equals(seen, "c,b,");
+
+	/* running the same second again sends nothing */
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 3, ping_wheel_test_callback, seen), 0);
+
+	/* after a long stall every contact is pinged once, not once per missed revolution */
+	*seen = '\0';
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 100, ping_wheel_test_callback, seen), 3);
+
+	/* a refill keeps the position on the wheel */
+	sofia_reg_ping_wheel_reset(profile, 10, now + 100);
+	sofia_reg_ping_wheel_add(profile, 1001, "d", "1003", "test.local", "sip:1003@10.0.0.4");
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 100, ping_wheel_test_callback, seen), 0);
+	*seen = '\0';
+	fst_check_int_equals(sofia_reg_ping_wheel_run(profile, now + 101, ping_wheel_test_callback, seen), 1);
+	fst_check_string_equals(seen, "d,");
+
+	sofia_reg_ping_wheel_destroy(profile);
+	fst_check(profile->ping_wheel == NULL);
+}
+FST_TEST_END()
+
 FST_TEST_BEGIN(originate_test)
 {
 	switch_core_session_t *session = NULL;
@@ -36,6 +36,8 @@
 
 #define MAX_URLS 20
 #define MAX_ERR_DIRS 20
+#define MAX_WORKERS 16
+#define MAX_BATCH_SIZE 1000
 
 #define ENCODING_NONE 0
 #define ENCODING_DEFAULT 1
@@ -46,6 +48,7 @@ static struct {
 	char *urls[MAX_URLS];
 	int url_count;
 	int url_index;
+	switch_mutex_t *url_index_mutex;
 	switch_thread_rwlock_t *log_path_lock;
 	char *base_log_dir;
 	char *base_err_log_dir[MAX_ERR_DIRS];
@@ -75,7 +78,18 @@ static struct {
 	switch_event_node_t *node;
 	int encode_values;
 	switch_queue_t *queue;
-	switch_thread_t *thread;
+	uint32_t queue_capacity;
+	int worker_count;
+	switch_thread_t *workers[MAX_WORKERS];
+	uint32_t batch_size;
+	switch_bool_t batch_ndjson;
+	uint32_t spool_replay_interval;
+	switch_thread_t *replay_thread;
+	switch_mutex_t *stats_mutex;
+	uint64_t posted;
+	uint64_t spooled;
+	uint64_t dropped;
+	uint64_t replayed;
 } globals;
 
 typedef struct {
@@ -194,11 +208,46 @@ static switch_status_t set_json_cdr_log_dirs()
 	return status;
 }
 
+#define STAT_ADD(_stat, _n) do { switch_mutex_lock(globals.stats_mutex); globals._stat += (_n); switch_mutex_unlock(globals.stats_mutex); } while (0)
+
+static switch_bool_t write_json_file(const char *uuid, const char *path, const char *json_text)
+{
+	int fd = -1;
+#ifdef _MSC_VER
+	mode_t mode = S_IRUSR | S_IWUSR;
+#else
+	mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
+#endif
+
+	if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode)) > -1) {
+		switch_size_t json_len = strlen(json_text);
+		switch_ssize_t wrote = 0, x;
+		do { x = write(fd, json_text, json_len);
+		} while (!(x<0) && json_len > (wrote += x));
+		if (!(x<0)) do { x = write(fd, "\n", 1);
+			} while (!(x<0) && x<1);
+		close(fd);
+		if (x < 0) {
+			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Error writing [%s]\n",path);
+			if (0 > unlink(path))
+				switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Error unlinking [%s]\n",path);
+			return SWITCH_FALSE;
+		}
+		return SWITCH_TRUE;
+	} else {
+		char ebuf[512] = { 0 };
+		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Can't open %s! [%s]\n",
+						  path, switch_strerror_r(errno, ebuf, sizeof(ebuf)));
+	}
+
+	return SWITCH_FALSE;
+}
+
 static void backup_cdr(cdr_data_t *data)
 {
 	if (globals.log_errors_to_disk) {
-		int fd = -1, err_dir_index;
-		char *path = NULL;
+		int err_dir_index;
+		char *path = NULL, *tmp_path = NULL;
 		const char *json_text = data->json_text_escaped ? data->json_text_escaped : data->json_text;
 
 		for (err_dir_index = 0; err_dir_index < globals.err_dir_count; err_dir_index++) {
@@ -208,38 +257,29 @@ static void backup_cdr(cdr_data_t *data)
 
 			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_INFO, "Backup file %s\n", path);
 			if (path) {
-#ifdef _MSC_VER
-				mode_t mode = S_IRUSR | S_IWUSR;
-#else
-				mode_t mode = S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH;
-#endif
-				if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, mode)) > -1) {
-					switch_size_t json_len = strlen(json_text);
-					switch_ssize_t wrote = 0, x;
-					do { x = write(fd, json_text, json_len);
-					} while (!(x<0) && json_len > (wrote += x));
-					if (!(x<0)) do { x = write(fd, "\n", 1);
-						} while (!(x<0) && x<1);
-					close(fd);
-					if (x < 0) {
-						switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error writing [%s]\n",path);
-						if (0 > unlink(path))
-							switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error unlinking [%s]\n",path);
+				/* write aside and rename so the spool replay never picks up a half written file */
+				tmp_path = switch_mprintf("%s.tmp", path);
+				switch_assert(tmp_path);
+
+				if (write_json_file(data->uuid, tmp_path, json_text)) {
+					if (rename(tmp_path, path) == 0) {
+						STAT_ADD(spooled, 1);
+						switch_safe_free(tmp_path);
+						switch_safe_free(path);
+						return;
 					}
-					switch_safe_free(path);
-					break;
-				} else {
-					char ebuf[512] = { 0 };
-					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Can't open %s! [%s]\n",
-									  path, switch_strerror_r(errno, ebuf, sizeof(ebuf)));
-
+					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error renaming [%s]\n", tmp_path);
+					unlink(tmp_path);
 				}
+				switch_safe_free(tmp_path);
 				switch_safe_free(path);
 			}
 		}
 	} else {
 		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_NOTICE, "Not writing to file\n");
 	}
+
+	STAT_ADD(dropped, 1);
 }
 
 
@@ -253,187 +293,264 @@ void destroy_cdr_data(cdr_data_t *data)
 	switch_safe_free(data);
 }
 
-static void process_cdr(cdr_data_t *data)
+static void log_cdr_to_disk(cdr_data_t *data)
+{
+	if (!zstr(data->logdir) && (globals.log_http_and_disk || !globals.url_count)) {
+		char *path = switch_mprintf("%s%s%s", data->logdir, SWITCH_PATH_SEPARATOR, data->filename);
+		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_INFO, "Log to disk [%s]\n", path);
+		if (path) {
+			write_json_file(data->uuid, path, data->json_text);
+			switch_safe_free(path);
+		}
+	}
+}
+
+/* POST a body to the current url, walking the url list on failure.
+ * The handle belongs to the caller; the queue workers keep theirs for their
+ * whole life so libcurl can reuse the connection to the collector.
+ * A non-zero batch is the number of CDRs in the body. */
+static switch_bool_t post_cdr(switch_CURL *curl_handle, const char *uuid, const char *body, uint32_t batch, uint32_t tries)
 {
 	char *curl_json_text = NULL;
+	char *destUrl = NULL;
 	long httpRes;
-	CURL *curl_handle = NULL;
 	switch_curl_slist_t *headers = NULL;
-	switch_curl_slist_t *slist = NULL;
-	int fd = -1;
 	uint32_t cur_try;
+	int url_index;
+	switch_bool_t posted = SWITCH_FALSE;
 
-	switch_assert(data != NULL);
+	if (globals.encode) {
+		if (globals.encode == ENCODING_DEFAULT) {
+			headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
+		} else {
+			headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
+		}
 
-	if (globals.shutdown) {
-		goto end;
+		curl_json_text = switch_mprintf("cdr=%s", body);
+		switch_assert(curl_json_text != NULL);
+
+	} else {
+		if (batch && globals.batch_ndjson) {
+			headers = switch_curl_slist_append(headers, "Content-Type: application/x-ndjson");
+		} else {
+			headers = switch_curl_slist_append(headers, "Content-Type: application/json");
+		}
+		curl_json_text = (char *)body;
 	}
 
-	switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_INFO, "Process [%s]\n", data->filename);
+	if (globals.disable100continue) {
+		headers = switch_curl_slist_append(headers, "Expect:");
+	}
 
-	if (!zstr(data->logdir) && (globals.log_http_and_disk || !globals.url_count)) {
-		char *path = switch_mprintf("%s%s%s", data->logdir, SWITCH_PATH_SEPARATOR, data->filename);
-		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_INFO, "Log to disk [%s]\n", path);
-		if (path) {
-#ifdef _MSC_VER
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
-#else
-			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR | S_IRGRP | S_IWGRP | S_IROTH | S_IWOTH)) > -1) {
-#endif
-				switch_size_t json_len = strlen(data->json_text);
-				switch_ssize_t wrote = 0, x;
-				do { x = write(fd, data->json_text, json_len);
-				} while (!(x<0) && json_len > (wrote += x));
-				if (!(x<0)) do { x = write(fd, "\n", 1);
-					} while (!(x<0) && x<1);
-				close(fd);
-				if (x < 0) {
-					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error writing [%s]\n",path);
-					if (0 > unlink(path))
-						switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error unlinking [%s]\n",path);
-				}
-			} else {
-				char ebuf[512] = { 0 };
-				switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Error writing [%s][%s]\n",
-								  path, switch_strerror_r(errno, ebuf, sizeof(ebuf)));
-			}
-			switch_safe_free(path);
-		}
+	if (!zstr(globals.cred)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
+		switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
 	}
 
-	/* try to post it to the web server */
-	if (globals.url_count) {
-		char *destUrl = NULL;
-		curl_handle = switch_curl_easy_init();
+	switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, curl_json_text);
+	switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-json/1.0");
+	switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
 
-		if (globals.encode) {
-			if (globals.encode == ENCODING_DEFAULT) {
-				headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-urlencoded");
-			} else {
-				headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
-			}
+	if (!zstr(globals.ssl_cert_file)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
+	}
 
-			curl_json_text = switch_mprintf("cdr=%s", data->json_text_escaped);
-			switch_assert(curl_json_text != NULL);
+	if (!zstr(globals.ssl_key_file)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
+	}
 
-		} else {
-			headers = switch_curl_slist_append(headers, "Content-Type: application/json");
-			curl_json_text = (char *)data->json_text;
+	if (!zstr(globals.ssl_key_password)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
+	}
+
+	if (!zstr(globals.ssl_version)) {
+		if (!strcasecmp(globals.ssl_version, "SSLv3")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
+		} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
 		}
+	}
+
+	if (!zstr(globals.ssl_cacert_file)) {
+		switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
+	}
+
+	// tcp timeout
+	switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, globals.timeout);
 
-		if (!zstr(globals.cred)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPAUTH, globals.auth_scheme);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_USERPWD, globals.cred);
+	/* these were used for testing, optionally they may be enabled if someone desires
+	   switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
+	 */
+
+	for (cur_try = 0; cur_try < tries; cur_try++) {
+		if (cur_try > 0) {
+			switch_yield(globals.delay * 1000000);
 		}
 
-		switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, headers);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_POST, 1);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_POSTFIELDS, curl_json_text);
-		switch_curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, "freeswitch-json/1.0");
-		switch_curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, httpCallBack);
+		switch_mutex_lock(globals.url_index_mutex);
+		url_index = globals.url_index;
+		switch_mutex_unlock(globals.url_index_mutex);
 
-		if (globals.disable100continue) {
-			slist = switch_curl_slist_append(slist, "Expect:");
-			switch_curl_easy_setopt(curl_handle, CURLOPT_HTTPHEADER, slist);
+		if (batch) {
+			destUrl = switch_mprintf("%s?batch=%u", globals.urls[url_index], batch);
+		} else {
+			destUrl = switch_mprintf("%s?uuid=%s", globals.urls[url_index], uuid);
 		}
+		switch_curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
 
-		if (!zstr(globals.ssl_cert_file)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLCERT, globals.ssl_cert_file);
+		if (!strncasecmp(destUrl, "https", 5)) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
 		}
 
-		if (!zstr(globals.ssl_key_file)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEY, globals.ssl_key_file);
+		if (globals.enable_cacert_check) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
 		}
 
-		if (!zstr(globals.ssl_key_password)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_SSLKEYPASSWD, globals.ssl_key_password);
+		if (globals.enable_ssl_verifyhost) {
+			switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
 		}
 
-		if (!zstr(globals.ssl_version)) {
-			if (!strcasecmp(globals.ssl_version, "SSLv3")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_SSLv3);
-			} else if (!strcasecmp(globals.ssl_version, "TLSv1")) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSLVERSION, CURL_SSLVERSION_TLSv1);
+		httpRes = 0;
+		switch_curl_easy_perform(curl_handle);
+		switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
+		switch_safe_free(destUrl);
+		if (httpRes >= 200 && httpRes < 300) {
+			posted = SWITCH_TRUE;
+			break;
+		} else {
+			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
+							  httpRes, globals.urls[url_index]);
+			switch_assert(globals.url_count <= MAX_URLS);
+
+			/* only advance if nobody else already moved on from this url */
+			switch_mutex_lock(globals.url_index_mutex);
+			if (globals.url_index == url_index) {
+				if (++globals.url_index >= globals.url_count) {
+					globals.url_index = 0;
+				} else {
+					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
+				}
 			}
+			switch_mutex_unlock(globals.url_index_mutex);
 		}
+	}
 
-		if (!zstr(globals.ssl_cacert_file)) {
-			switch_curl_easy_setopt(curl_handle, CURLOPT_CAINFO, globals.ssl_cacert_file);
-		}
+	switch_curl_slist_free_all(headers);
+	if (curl_json_text != body) {
+		switch_safe_free(curl_json_text);
+	}
 
-		// tcp timeout
-		switch_curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, globals.timeout);
+	return posted;
+}
 
-		/* these were used for testing, optionally they may be enabled if someone desires
-		   switch_curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 1); // 302 recursion level
-		 */
+/* curl_handle is NULL when called straight from the reporting state handler */
+static void process_cdr(cdr_data_t *data, switch_CURL *curl_handle)
+{
+	switch_CURL *own_handle = NULL;
 
-		for (cur_try = 0; cur_try < globals.retries; cur_try++) {
-			if (cur_try > 0) {
-				switch_yield(globals.delay * 1000000);
-			}
+	switch_assert(data != NULL);
 
-			destUrl = switch_mprintf("%s?uuid=%s", globals.urls[globals.url_index], data->uuid);
-			switch_curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
+	switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_INFO, "Process [%s]\n", data->filename);
 
-			if (!strncasecmp(destUrl, "https", 5)) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, 0);
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 0);
-			}
+	log_cdr_to_disk(data);
 
-			if (globals.enable_cacert_check) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYPEER, TRUE);
-			}
+	/* try to post it to the web server */
+	if (globals.url_count) {
+		if (globals.shutdown) {
+			/* don't hold up shutdown retrying the collector, spool it for later */
+			backup_cdr(data);
+			goto end;
+		}
 
-			if (globals.enable_ssl_verifyhost) {
-				switch_curl_easy_setopt(curl_handle, CURLOPT_SSL_VERIFYHOST, 2);
-			}
+		if (!curl_handle) {
+			curl_handle = own_handle = switch_curl_easy_init();
+		}
 
-			switch_curl_easy_perform(curl_handle);
-			switch_curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &httpRes);
-			switch_safe_free(destUrl);
-			if (httpRes >= 200 && httpRes < 300) {
-				goto end;
-			} else {
-				switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Got error [%ld] posting to web server [%s]\n",
-								  httpRes, globals.urls[globals.url_index]);
-				globals.url_index++;
-				switch_assert(globals.url_count <= MAX_URLS);
-				if (globals.url_index >= globals.url_count) {
-					globals.url_index = 0;
-				} else {
-					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Retry will be with url [%s]\n", globals.urls[globals.url_index]);
-					}
-			}
+		if (post_cdr(curl_handle, data->uuid, data->json_text_escaped ? data->json_text_escaped : data->json_text, 0, globals.retries)) {
+			STAT_ADD(posted, 1);
+		} else {
+			/* if we are here the web post failed for some reason */
+			switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Unable to post to web server\n");
+			backup_cdr(data);
 		}
-		switch_curl_easy_cleanup(curl_handle);
-		switch_curl_slist_free_all(headers);
-		switch_curl_slist_free_all(slist);
-		slist = NULL;
-		headers = NULL;
-		curl_handle = NULL;
+	}
 
-		/* if we are here the web post failed for some reason */
-		switch_log_printf(SWITCH_CHANNEL_UUID_LOG(data->uuid), SWITCH_LOG_ERROR, "Unable to post to web server\n");
-		backup_cdr(data);
+  end:
+	if (own_handle) {
+		switch_curl_easy_cleanup(own_handle);
 	}
 
-	end:
-	if (curl_handle) {
-		switch_curl_easy_cleanup(curl_handle);
+	destroy_cdr_data(data);
+}
+
+/* Send several queued CDRs in one POST, either as a JSON array or as
+ * newline delimited JSON. Only used with batch-size > 1 and no encoding. */
+static void process_cdr_batch(cdr_data_t **batch, uint32_t count, switch_CURL *curl_handle)
+{
+	switch_size_t len = 3;
+	char *body, *p;
+	uint32_t i;
+
+	if (count == 1) {
+		process_cdr(batch[0], curl_handle);
+		return;
 	}
-	if (headers) {
-		switch_curl_slist_free_all(headers);
+
+	for (i = 0; i < count; i++) {
+		log_cdr_to_disk(batch[i]);
+		len += strlen(batch[i]->json_text) + 1;
 	}
-	if (slist) {
-		switch_curl_slist_free_all(slist);
+
+	if (globals.shutdown) {
+		for (i = 0; i < count; i++) {
+			backup_cdr(batch[i]);
+		}
+		goto end;
 	}
-	if (curl_json_text != data->json_text) {
-		switch_safe_free(curl_json_text);
+
+	body = p = malloc(len);
+	switch_assert(body);
+
+	if (!globals.batch_ndjson) {
+		*p++ = '[';
 	}
+	for (i = 0; i < count; i++) {
+		switch_size_t json_len = strlen(batch[i]->json_text);
+
+		memcpy(p, batch[i]->json_text, json_len);
+		p += json_len;
+		if (globals.batch_ndjson) {
+			*p++ = '\n';
+		} else if (i + 1 < count) {
+			*p++ = ',';
+		}
+	}
+	if (!globals.batch_ndjson) {
+		*p++ = ']';
+	}
+	*p = '\0';
 
-	destroy_cdr_data(data);
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Process batch of %u cdrs\n", count);
+
+	if (post_cdr(curl_handle, NULL, body, count, globals.retries)) {
+		STAT_ADD(posted, count);
+	} else {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to post batch of %u cdrs to web server\n", count);
+		for (i = 0; i < count; i++) {
+			backup_cdr(batch[i]);
+		}
+	}
+
+	free(body);
+
+  end:
+	for (i = 0; i < count; i++) {
+		destroy_cdr_data(batch[i]);
+	}
 }
 
 static switch_status_t my_on_reporting(switch_core_session_t *session)
@@ -506,7 +623,7 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 			destroy_cdr_data(cdr_data);
 		}
 	} else {
-		process_cdr(cdr_data);
+		process_cdr(cdr_data, NULL);
 	}
 
 	cJSON_Delete(json_cdr);
@@ -517,10 +634,21 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 static void *SWITCH_THREAD_FUNC cdr_thread(switch_thread_t *t, void *obj)
 {
 	void *pop = NULL;
+	cdr_data_t **batch;
+	switch_CURL *curl_handle = NULL;
+	int running = 1;
+
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Cdr thread started.\n");
 
-	while (!globals.shutdown) {
-		cdr_data_t *data = NULL;
+	batch = malloc(sizeof(*batch) * globals.batch_size);
+	switch_assert(batch);
+
+	if (globals.url_count) {
+		curl_handle = switch_curl_easy_init();
+	}
+
+	while (running) {
+		uint32_t count = 0;
 
 		if (switch_queue_pop(globals.queue, &pop) != SWITCH_STATUS_SUCCESS) {
 			break;
@@ -530,13 +658,24 @@ static void *SWITCH_THREAD_FUNC cdr_thread(switch_thread_t *t, void *obj)
 			break;
 		}
 
-		data = (cdr_data_t *) pop;
-		process_cdr(data);
+		batch[count++] = (cdr_data_t *) pop;
+
+		/* take whatever else is already waiting, without blocking, up to a full batch */
+		while (count < globals.batch_size && switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (!pop) {
+				running = 0;
+				break;
+			}
+			batch[count++] = (cdr_data_t *) pop;
+		}
+
+		process_cdr_batch(batch, count, curl_handle);
 	}
 
-	while (switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
-		destroy_cdr_data((cdr_data_t *) pop);
+	if (curl_handle) {
+		switch_curl_easy_cleanup(curl_handle);
 	}
+	free(batch);
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Cdr thread ended.\n");
 	switch_thread_exit(t, SWITCH_STATUS_SUCCESS);
@@ -544,6 +683,151 @@ static void *SWITCH_THREAD_FUNC cdr_thread(switch_thread_t *t, void *obj)
 	return NULL;
 }
 
+static char *read_spool_file(const char *path)
+{
+	struct stat st;
+	char *buf;
+	int fd;
+	switch_ssize_t got = 0, x;
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return NULL;
+	}
+
+	if (fstat(fd, &st) || st.st_size <= 0) {
+		close(fd);
+		return NULL;
+	}
+
+	buf = malloc(st.st_size + 1);
+	switch_assert(buf);
+
+	while (got < st.st_size && (x = read(fd, buf + got, st.st_size - got)) > 0) {
+		got += x;
+	}
+	close(fd);
+
+	if (got != st.st_size) {
+		free(buf);
+		return NULL;
+	}
+
+	while (got > 0 && (buf[got - 1] == '\n' || buf[got - 1] == '\r')) {
+		got--;
+	}
+	buf[got] = '\0';
+
+	return buf;
+}
+
+/* Re-post the CDRs backup_cdr() left in the error directories. A file the
+ * collector refuses stays for the next pass, the rest are still tried. */
+static void replay_spool(switch_CURL *curl_handle)
+{
+	int err_dir_index;
+
+	for (err_dir_index = 0; err_dir_index < globals.err_dir_count && !globals.shutdown; err_dir_index++) {
+		switch_memory_pool_t *pool = NULL;
+		switch_dir_t *dir = NULL;
+		char *dir_path;
+		char fbuf[512];
+		const char *fname;
+
+		switch_thread_rwlock_rdlock(globals.log_path_lock);
+		dir_path = switch_safe_strdup(globals.err_log_dir[err_dir_index]);
+		/* the same directory holds the regular disk CDRs, posting those would duplicate them */
+		if (dir_path && globals.log_http_and_disk && globals.log_dir && !strcmp(dir_path, globals.log_dir)) {
+			switch_safe_free(dir_path);
+		}
+		switch_thread_rwlock_unlock(globals.log_path_lock);
+
+		if (!dir_path) {
+			continue;
+		}
+
+		switch_core_new_memory_pool(&pool);
+
+		if (switch_dir_open(&dir, dir_path, pool) == SWITCH_STATUS_SUCCESS) {
+			while (!globals.shutdown && (fname = switch_dir_next_file(dir, fbuf, sizeof(fbuf)))) {
+				switch_size_t flen = strlen(fname);
+				char *path, *body, *uuid;
+
+				if (flen <= 9 || strcmp(fname + flen - 9, ".cdr.json")) {
+					continue;
+				}
+
+				path = switch_mprintf("%s%s%s", dir_path, SWITCH_PATH_SEPARATOR, fname);
+				switch_assert(path);
+
+				if (!(body = read_spool_file(path))) {
+					switch_safe_free(path);
+					continue;
+				}
+
+				uuid = strdup(!strncmp(fname, "a_", 2) ? fname + 2 : fname);
+				switch_assert(uuid);
+				uuid[strlen(uuid) - 9] = '\0';
+
+				if (post_cdr(curl_handle, uuid, body, 0, 1)) {
+					switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_INFO, "Replayed %s\n", path);
+					if (unlink(path) < 0) {
+						switch_log_printf(SWITCH_CHANNEL_UUID_LOG(uuid), SWITCH_LOG_ERROR, "Error unlinking [%s]\n", path);
+					}
+					STAT_ADD(replayed, 1);
+				}
+
+				free(uuid);
+				free(body);
+				free(path);
+			}
+			switch_dir_close(dir);
+		}
+
+		switch_core_destroy_memory_pool(&pool);
+		free(dir_path);
+	}
+}
+
+static void *SWITCH_THREAD_FUNC replay_thread(switch_thread_t *t, void *obj)
+{
+	switch_CURL *curl_handle = switch_curl_easy_init();
+	switch_time_t next = switch_epoch_time_now(NULL) + globals.spool_replay_interval;
+
+	while (!globals.shutdown) {
+		switch_yield(1000000);
+
+		if (switch_epoch_time_now(NULL) < next) {
+			continue;
+		}
+
+		replay_spool(curl_handle);
+		next = switch_epoch_time_now(NULL) + globals.spool_replay_interval;
+	}
+
+	switch_curl_easy_cleanup(curl_handle);
+
+	return NULL;
+}
+
+#define JSON_CDR_SYNTAX "status"
+SWITCH_STANDARD_API(json_cdr_function)
+{
+	if (zstr(cmd) || !strcasecmp(cmd, "status")) {
+		switch_mutex_lock(globals.stats_mutex);
+		stream->write_function(stream, "workers: %d\nqueue-capacity: %u\nqueued: %u\nbatch-size: %u\n",
+							   globals.worker_count, globals.queue ? globals.queue_capacity : 0,
+							   globals.queue ? switch_queue_size(globals.queue) : 0, globals.batch_size);
+		stream->write_function(stream, "posted: %" SWITCH_UINT64_T_FMT "\nspooled: %" SWITCH_UINT64_T_FMT
+							   "\ndropped: %" SWITCH_UINT64_T_FMT "\nreplayed: %" SWITCH_UINT64_T_FMT "\n",
+							   globals.posted, globals.spooled, globals.dropped, globals.replayed);
+		switch_mutex_unlock(globals.stats_mutex);
+	} else {
+		stream->write_function(stream, "-USAGE: %s\n", JSON_CDR_SYNTAX);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 static void event_handler(switch_event_t *event)
 {
 	const char *sig = switch_event_get_header(event, "Trapped-Signal");
@@ -574,6 +858,8 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 	char *cf = "json_cdr.conf";
 	switch_xml_t cfg, xml, settings, param;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_api_interface_t *api_interface;
+	int worker_index;
 
 	memset(&globals, 0, sizeof(globals));
 
@@ -584,8 +870,12 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 	globals.pool = pool;
 	globals.auth_scheme = CURLAUTH_BASIC;
 	globals.encode_values = ENCODING_DEFAULT;
+	globals.worker_count = 1;
+	globals.batch_size = 1;
 
 	switch_thread_rwlock_create(&globals.log_path_lock, pool);
+	switch_mutex_init(&globals.url_index_mutex, SWITCH_MUTEX_NESTED, globals.pool);
+	switch_mutex_init(&globals.stats_mutex, SWITCH_MUTEX_NESTED, globals.pool);
 
 	/* parse the config */
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
@@ -697,15 +987,26 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 				globals.encode_values = switch_true(val) ? ENCODING_DEFAULT : ENCODING_NONE;
 			} else if (!strcasecmp(var, "queue-capacity") && !zstr(val)) {
 				int capacity = atoi(val);
-				if (capacity > 0) {
-					switch_threadattr_t *thd_attr;
-
-					switch_queue_create(&globals.queue, capacity, globals.pool);
-
-					switch_threadattr_create(&thd_attr, globals.pool);
-					switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
-					switch_thread_create(&globals.thread, thd_attr, cdr_thread, NULL, globals.pool);
+				globals.queue_capacity = capacity > 0 ? (uint32_t) capacity : 0;
+			} else if (!strcasecmp(var, "queue-workers") && !zstr(val)) {
+				int workers = atoi(val);
+				if (workers < 1 || workers > MAX_WORKERS) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "queue-workers must be between 1 and %d\n", MAX_WORKERS);
+				} else {
+					globals.worker_count = workers;
+				}
+			} else if (!strcasecmp(var, "batch-size") && !zstr(val)) {
+				int size = atoi(val);
+				if (size < 1 || size > MAX_BATCH_SIZE) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "batch-size must be between 1 and %d\n", MAX_BATCH_SIZE);
+				} else {
+					globals.batch_size = (uint32_t) size;
 				}
+			} else if (!strcasecmp(var, "batch-format") && !zstr(val)) {
+				globals.batch_ndjson = !strcasecmp(val, "ndjson") ? SWITCH_TRUE : SWITCH_FALSE;
+			} else if (!strcasecmp(var, "spool-replay-interval") && !zstr(val)) {
+				int interval = atoi(val);
+				globals.spool_replay_interval = interval > 0 ? (uint32_t) interval : 0;
 			}
 		}
 
@@ -727,6 +1028,33 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 
 	set_json_cdr_log_dirs();
 
+	if (globals.batch_size > 1 && (!globals.url_count || globals.encode || !globals.queue_capacity)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "batch-size needs a url, the queue and no encode, sending cdrs one at a time\n");
+		globals.batch_size = 1;
+	}
+
+	if (globals.queue_capacity) {
+		switch_threadattr_t *thd_attr;
+
+		switch_queue_create(&globals.queue, globals.queue_capacity, globals.pool);
+
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_thread_create(&globals.workers[worker_index], thd_attr, cdr_thread, NULL, globals.pool);
+		}
+	} else {
+		globals.worker_count = 0;
+	}
+
+	if (globals.spool_replay_interval && globals.url_count && globals.log_errors_to_disk) {
+		switch_threadattr_t *thd_attr;
+
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_thread_create(&globals.replay_thread, thd_attr, replay_thread, NULL, globals.pool);
+	}
+
 	if (switch_event_bind_removable(modname, SWITCH_EVENT_TRAP, SWITCH_EVENT_SUBCLASS_ANY, event_handler, NULL, &globals.node) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't bind!\n");
 		return SWITCH_STATUS_GENERR;
@@ -737,6 +1065,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
+	SWITCH_ADD_API(api_interface, "json_cdr", "json_cdr controls", json_cdr_function, JSON_CDR_SYNTAX);
+	switch_console_set_complete("add json_cdr status");
+
 	switch_xml_free(xml);
 	return status;
 }
@@ -744,14 +1075,34 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_json_cdr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_json_cdr_shutdown)
 {
-	int err_dir_index = 0;
+	int err_dir_index = 0, worker_index;
 	switch_status_t status;
+	void *pop = NULL;
 
 	globals.shutdown = 1;
 
+	if (globals.replay_thread) {
+		switch_thread_join(&status, globals.replay_thread);
+	}
+
 	if (globals.queue) {
-		switch_queue_push(globals.queue, NULL);
-		switch_thread_join(&status, globals.thread);
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_queue_push(globals.queue, NULL);
+		}
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_thread_join(&status, globals.workers[worker_index]);
+		}
+
+		/* anything still queued was pushed behind the workers' backs, keep it on disk */
+		while (switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop) {
+				cdr_data_t *data = (cdr_data_t *) pop;
+				if (globals.url_count) {
+					backup_cdr(data);
+				}
+				destroy_cdr_data(data);
+			}
+		}
 	}
 
 	switch_safe_free(globals.log_dir);
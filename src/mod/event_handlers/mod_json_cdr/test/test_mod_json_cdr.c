@@ -0,0 +1,641 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_json_cdr -- mod_json_cdr posting, spooling and replay against a local collector
+ *
+ */
+
+#include <test/switch_test.h>
+
+#define COLLECTOR_PORT 18088
+#define SPOOL_DIR "/tmp/fst_json_cdr"
+#define COLLECTOR_HOLD_MS 2000
+
+/* stands in for the CDR collector, answers every post with status unless it is for fail_uuid.
+   While hold is set a request is kept waiting for up to COLLECTOR_HOLD_MS, which keeps a queue
+   worker busy so the CDRs behind it pile up in the queue. */
+static struct {
+	switch_memory_pool_t *pool;
+	switch_mutex_t *mutex;
+	switch_thread_t *thread;
+	switch_socket_t *sock;
+	switch_stream_handle_t requests;
+	char *batch_body;
+	int status;
+	char fail_uuid[SWITCH_UUID_FORMATTED_LENGTH + 1];
+	int hold;
+	int held;
+	int running;
+} collector;
+
+static void collector_serve(switch_socket_t *inbound)
+{
+	char buf[65536] = "";
+	switch_size_t used = 0, len;
+	char *body = NULL, *p;
+	switch_size_t content_length = 0;
+	char reply[128];
+	int status;
+
+	switch_socket_timeout_set(inbound, 2000000);
+
+	/* headers first, then whatever Content-Length says is left */
+	while (used < sizeof(buf) - 1) {
+		len = sizeof(buf) - 1 - used;
+		if (switch_socket_recv(inbound, buf + used, &len) != SWITCH_STATUS_SUCCESS || !len) {
+			break;
+		}
+		used += len;
+		buf[used] = '\0';
+
+		if (!body && (p = strstr(buf, "\r\n\r\n"))) {
+			const char *cl = switch_stristr("Content-Length:", buf);
+
+			body = p + 4;
+			if (cl && cl < body) {
+				content_length = (switch_size_t) atol(cl + 15);
+			}
+		}
+
+		if (body && (switch_size_t) (buf + used - body) >= content_length) {
+			break;
+		}
+	}
+
+	if (!body) {
+		return;
+	}
+
+	switch_mutex_lock(collector.mutex);
+	if (collector.hold) {
+		int waited;
+
+		collector.held++;
+		for (waited = 0; collector.hold && waited < COLLECTOR_HOLD_MS; waited += 10) {
+			switch_mutex_unlock(collector.mutex);
+			switch_yield(10000);
+			switch_mutex_lock(collector.mutex);
+		}
+		collector.held--;
+	}
+
+	status = collector.status;
+	if (*collector.fail_uuid && (p = strstr(buf, "uuid=")) && !strncmp(p + 5, collector.fail_uuid, strlen(collector.fail_uuid))) {
+		status = 500;
+	}
+	collector.requests.write_function(&collector.requests, "%s\n", buf);
+	if (strstr(buf, "?batch=")) {
+		switch_safe_free(collector.batch_body);
+		collector.batch_body = strdup(body);
+	}
+	switch_mutex_unlock(collector.mutex);
+
+	switch_snprintf(reply, sizeof(reply), "HTTP/1.1 %d X\r\nContent-Length: 0\r\nConnection: close\r\n\r\n", status);
+	len = strlen(reply);
+	switch_socket_send(inbound, reply, &len);
+}
+
+static void *SWITCH_THREAD_FUNC collector_thread(switch_thread_t *thread, void *obj)
+{
+	while (collector.running) {
+		switch_memory_pool_t *pool = NULL;
+		switch_socket_t *inbound = NULL;
+
+		switch_core_new_memory_pool(&pool);
+
+		/* the listening socket has a short timeout so teardown is noticed */
+		if (switch_socket_accept(&inbound, collector.sock, pool) == SWITCH_STATUS_SUCCESS) {
+			collector_serve(inbound);
+			switch_socket_shutdown(inbound, SWITCH_SHUTDOWN_READWRITE);
+			switch_socket_close(inbound);
+		}
+
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	return NULL;
+}
+
+static switch_bool_t collector_start(void)
+{
+	switch_sockaddr_t *sa = NULL;
+	switch_threadattr_t *thd_attr = NULL;
+
+	memset(&collector, 0, sizeof(collector));
+	collector.status = 200;
+	SWITCH_STANDARD_STREAM(collector.requests);
+
+	switch_core_new_memory_pool(&collector.pool);
+	switch_mutex_init(&collector.mutex, SWITCH_MUTEX_NESTED, collector.pool);
+
+	if (switch_sockaddr_info_get(&sa, "127.0.0.1", SWITCH_INET, COLLECTOR_PORT, 0, collector.pool) != SWITCH_STATUS_SUCCESS ||
+		switch_socket_create(&collector.sock, switch_sockaddr_get_family(sa), SOCK_STREAM, SWITCH_PROTO_TCP, collector.pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_FALSE;
+	}
+
+	switch_socket_opt_set(collector.sock, SWITCH_SO_REUSEADDR, 1);
+
+	if (switch_socket_bind(collector.sock, sa) != SWITCH_STATUS_SUCCESS || switch_socket_listen(collector.sock, 5) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_FALSE;
+	}
+
+	switch_socket_timeout_set(collector.sock, 100000);
+
+	collector.running = 1;
+	switch_threadattr_create(&thd_attr, collector.pool);
+	switch_thread_create(&collector.thread, thd_attr, collector_thread, NULL, collector.pool);
+
+	return SWITCH_TRUE;
+}
+
+static void collector_stop(void)
+{
+	switch_status_t st;
+
+	collector.running = 0;
+	if (collector.thread) {
+		switch_thread_join(&st, collector.thread);
+	}
+	if (collector.sock) {
+		switch_socket_close(collector.sock);
+	}
+	switch_safe_free(collector.requests.data);
+	switch_safe_free(collector.batch_body);
+	switch_core_destroy_memory_pool(&collector.pool);
+}
+
+static void collector_set(int status, const char *fail_uuid)
+{
+	switch_mutex_lock(collector.mutex);
+	collector.status = status;
+	switch_copy_string(collector.fail_uuid, fail_uuid ? fail_uuid : "", sizeof(collector.fail_uuid));
+	switch_mutex_unlock(collector.mutex);
+}
+
+static void collector_hold(int hold)
+{
+	switch_mutex_lock(collector.mutex);
+	collector.hold = hold;
+	switch_mutex_unlock(collector.mutex);
+}
+
+/* waits until a worker's post is sitting in the collector */
+static switch_bool_t collector_wait_held(void)
+{
+	int i, held = 0;
+
+	for (i = 0; i < 50 && !held; i++) {
+		switch_mutex_lock(collector.mutex);
+		held = collector.held;
+		switch_mutex_unlock(collector.mutex);
+		if (!held) {
+			switch_yield(100000);
+		}
+	}
+
+	return held ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static char *collector_batch_body(void)
+{
+	char *body;
+
+	switch_mutex_lock(collector.mutex);
+	body = collector.batch_body ? strdup(collector.batch_body) : NULL;
+	switch_mutex_unlock(collector.mutex);
+
+	return body;
+}
+
+static switch_bool_t collector_saw(const char *needle)
+{
+	switch_bool_t found;
+
+	switch_mutex_lock(collector.mutex);
+	found = (collector.requests.data && strstr((char *) collector.requests.data, needle)) ? SWITCH_TRUE : SWITCH_FALSE;
+	switch_mutex_unlock(collector.mutex);
+
+	return found;
+}
+
+/* originate a channel, hang it up and hand back its uuid, the CDR goes out in CS_REPORTING */
+static switch_bool_t place_call(char *uuid, switch_size_t uuid_len)
+{
+	switch_core_session_t *session = NULL;
+	switch_call_cause_t cause = SWITCH_CAUSE_NORMAL_CLEARING;
+
+	if (switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL) != SWITCH_STATUS_SUCCESS || !session) {
+		return SWITCH_FALSE;
+	}
+
+	switch_copy_string(uuid, switch_core_session_get_uuid(session), uuid_len);
+	switch_channel_hangup(switch_core_session_get_channel(session), SWITCH_CAUSE_NORMAL_CLEARING);
+	switch_core_session_rwunlock(session);
+
+	return SWITCH_TRUE;
+}
+
+static switch_bool_t wait_posted(const char *uuid)
+{
+	char needle[128];
+	int i;
+
+	switch_snprintf(needle, sizeof(needle), "uuid=%s", uuid);
+	for (i = 0; i < 50 && !collector_saw(needle); i++) {
+		switch_yield(100000);
+	}
+
+	return collector_saw(needle);
+}
+
+/* json_cdr.conf as served while the binding is up, the static one in test/conf plus extra params */
+static const char *json_cdr_extra_params = "";
+
+static switch_xml_t json_cdr_config_search(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+										   switch_event_t *params, void *user_data)
+{
+	switch_xml_t xml;
+	char *text;
+
+	if (!key_value || strcmp(key_value, "json_cdr.conf")) {
+		return NULL;
+	}
+
+	text = switch_mprintf("<document type=\"freeswitch/xml\"><section name=\"configuration\">"
+						  "<configuration name=\"json_cdr.conf\"><settings>"
+						  "<param name=\"url\" value=\"http://127.0.0.1:%d/cdr\"/>"
+						  "<param name=\"encode\" value=\"false\"/>"
+						  "<param name=\"disable-100-continue\" value=\"true\"/>"
+						  "<param name=\"retries\" value=\"0\"/>"
+						  "<param name=\"timeout\" value=\"5\"/>"
+						  "<param name=\"err-log-dir\" value=\"%s\"/>"
+						  "<param name=\"spool-replay-interval\" value=\"1\"/>"
+						  "%s</settings></configuration></section></document>", COLLECTOR_PORT, SPOOL_DIR, json_cdr_extra_params);
+	xml = switch_xml_parse_str_dup(text);
+	switch_safe_free(text);
+
+	return xml;
+}
+
+/* unload mod_json_cdr and load it again with extra_params added to its settings */
+static switch_bool_t json_cdr_reload(const char *extra_params)
+{
+	const char *err = NULL;
+	char path[1024];
+	switch_status_t status;
+
+	sprintf(path, "%s%s%s", SWITCH_TEST_BASE_DIR_OVERRIDE, SWITCH_PATH_SEPARATOR, "../.libs/");
+
+	if (switch_loadable_module_unload_module(path, (char *) "mod_json_cdr", SWITCH_FALSE, &err) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_FALSE;
+	}
+
+	json_cdr_extra_params = extra_params;
+	switch_xml_bind_search_function(json_cdr_config_search, switch_xml_parse_section_string("configuration"), NULL);
+	status = switch_loadable_module_load_module(path, (char *) "mod_json_cdr", SWITCH_TRUE, &err);
+	switch_xml_unbind_search_function_ptr(json_cdr_config_search);
+
+	return status == SWITCH_STATUS_SUCCESS;
+}
+
+static uint32_t json_cdr_stat(const char *name)
+{
+	switch_stream_handle_t stream = { 0 };
+	char *prefix = switch_mprintf("%s: ", name);
+	const char *p;
+	uint32_t value = 0;
+
+	SWITCH_STANDARD_STREAM(stream);
+	switch_api_execute("json_cdr", "status", NULL, &stream);
+	if (stream.data && (p = strstr((char *) stream.data, prefix))) {
+		value = (uint32_t) atol(p + strlen(prefix));
+	}
+	switch_safe_free(stream.data);
+	switch_safe_free(prefix);
+
+	return value;
+}
+
+static switch_bool_t wait_queued(uint32_t queued)
+{
+	int i;
+
+	for (i = 0; i < 50 && json_cdr_stat("queued") < queued; i++) {
+		switch_yield(100000);
+	}
+
+	return json_cdr_stat("queued") >= queued;
+}
+
+/* holds the collector on one CDR so the next three queue up behind it, then lets them go as one batch */
+static switch_bool_t place_batch(char uuids[4][SWITCH_UUID_FORMATTED_LENGTH + 1])
+{
+	int i;
+
+	collector_hold(1);
+	if (!place_call(uuids[0], sizeof(uuids[0])) || !collector_wait_held()) {
+		collector_hold(0);
+		return SWITCH_FALSE;
+	}
+
+	for (i = 1; i < 4; i++) {
+		place_call(uuids[i], sizeof(uuids[i]));
+	}
+
+	if (!wait_queued(3)) {
+		collector_hold(0);
+		return SWITCH_FALSE;
+	}
+
+	collector_hold(0);
+
+	for (i = 0; i < 50 && !collector_saw("/cdr?batch=3 "); i++) {
+		switch_yield(100000);
+	}
+
+	return collector_saw("/cdr?batch=3 ");
+}
+
+static char *spool_path(const char *uuid)
+{
+	return switch_mprintf("%s%s%s.cdr.json", SPOOL_DIR, SWITCH_PATH_SEPARATOR, uuid);
+}
+
+static switch_bool_t spooled(const char *uuid)
+{
+	char *path = spool_path(uuid);
+	switch_bool_t exists = switch_file_exists(path, NULL) == SWITCH_STATUS_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+
+	switch_safe_free(path);
+
+	return exists;
+}
+
+static void spool_write(const char *uuid)
+{
+	char *path = spool_path(uuid);
+	FILE *fp;
+
+	if ((fp = fopen(path, "w"))) {
+		fprintf(fp, "{\"core-uuid\":\"test\",\"variables\":{\"uuid\":\"%s\"}}", uuid);
+		fclose(fp);
+	}
+
+	switch_safe_free(path);
+}
+
+/* the replay thread runs every second, give it a few passes */
+static switch_bool_t wait_unspooled(const char *uuid)
+{
+	int i;
+
+	for (i = 0; i < 50 && spooled(uuid); i++) {
+		switch_yield(100000);
+	}
+
+	return !spooled(uuid);
+}
+
+FST_CORE_BEGIN("conf")
+{
+	/* up before the module so nothing it posts is refused by a closed port */
+	collector_start();
+
+	FST_MODULE_BEGIN(mod_json_cdr, mod_json_cdr_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires(collector.running);
+			fst_requires_module("mod_loopback");
+			fst_requires_module("mod_json_cdr");
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+			collector_hold(0);
+			collector_set(200, NULL);
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(post_on_hangup)
+		{
+			char uuid[SWITCH_UUID_FORMATTED_LENGTH + 1] = "";
+			char needle[128];
+			int i;
+
+			fst_requires(place_call(uuid, sizeof(uuid)));
+
+			/* no queue configured, the channel posts it itself before it is destroyed */
+			switch_snprintf(needle, sizeof(needle), "uuid=%s", uuid);
+			for (i = 0; i < 50 && !collector_saw(needle); i++) {
+				switch_yield(100000);
+			}
+
+			fst_check(collector_saw(needle));
+			fst_check(collector_saw("Content-Type: application/json"));
+			fst_check(!spooled(uuid));
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(spool_on_error_then_replay)
+		{
+			char uuid[SWITCH_UUID_FORMATTED_LENGTH + 1] = "";
+			int i;
+
+			collector_set(500, NULL);
+			fst_requires(place_call(uuid, sizeof(uuid)));
+
+			for (i = 0; i < 50 && !spooled(uuid); i++) {
+				switch_yield(100000);
+			}
+			fst_check(spooled(uuid));
+
+			/* still failing, the replay leaves it alone */
+			switch_yield(1500000);
+			fst_check(spooled(uuid));
+
+			collector_set(200, NULL);
+			fst_check(wait_unspooled(uuid));
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(replay_continues_past_failure)
+		{
+			const char *stuck = "00000000-0000-4000-8000-000000000000";
+			const char *others[] = {
+				"00000000-0000-4000-8000-000000000001",
+				"00000000-0000-4000-8000-000000000002",
+				"00000000-0000-4000-8000-000000000003",
+				"00000000-0000-4000-8000-000000000004"
+			};
+			int i;
+
+			collector_set(200, stuck);
+
+			spool_write(stuck);
+			for (i = 0; i < 4; i++) {
+				spool_write(others[i]);
+			}
+
+			/* whatever order the directory lists them in, one refused file holds up nothing */
+			for (i = 0; i < 4; i++) {
+				fst_check(wait_unspooled(others[i]));
+			}
+			fst_check(spooled(stuck));
+
+			collector_set(200, NULL);
+			fst_check(wait_unspooled(stuck));
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(queue_workers)
+		{
+			char uuids[4][SWITCH_UUID_FORMATTED_LENGTH + 1];
+			int i;
+
+			fst_requires(json_cdr_reload("<param name=\"queue-capacity\" value=\"100\"/><param name=\"queue-workers\" value=\"2\"/>"));
+			fst_check_int_equals(json_cdr_stat("workers"), 2);
+			fst_check_int_equals(json_cdr_stat("queue-capacity"), 100);
+
+			for (i = 0; i < 4; i++) {
+				fst_requires(place_call(uuids[i], sizeof(uuids[i])));
+			}
+
+			/* one post per CDR, handed over by the workers rather than the channels */
+			for (i = 0; i < 4; i++) {
+				fst_check(wait_posted(uuids[i]));
+				fst_check(!spooled(uuids[i]));
+			}
+			fst_check_int_equals(json_cdr_stat("posted"), 4);
+			fst_check_int_equals(json_cdr_stat("queued"), 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(batch_array)
+		{
+			char uuids[4][SWITCH_UUID_FORMATTED_LENGTH + 1];
+			char *body;
+			int i;
+
+			fst_requires(json_cdr_reload("<param name=\"queue-capacity\" value=\"100\"/><param name=\"batch-size\" value=\"10\"/>"
+										 "<param name=\"batch-format\" value=\"array\"/>"));
+			fst_check_int_equals(json_cdr_stat("batch-size"), 10);
+			fst_requires(place_batch(uuids));
+			fst_check(wait_posted(uuids[0]));
+
+			/* the three that queued up went out together as one JSON array */
+			body = collector_batch_body();
+			fst_requires(body);
+			fst_check(body[0] == '[');
+			fst_check(body[strlen(body) - 1] == ']');
+			fst_check_string_has(body, "},{");
+			for (i = 1; i < 4; i++) {
+				fst_check_string_has(body, uuids[i]);
+				fst_check(!spooled(uuids[i]));
+			}
+			fst_check(!strstr(body, uuids[0]));
+			switch_safe_free(body);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(batch_ndjson)
+		{
+			char uuids[4][SWITCH_UUID_FORMATTED_LENGTH + 1];
+			char *body, *p;
+			int i, lines = 0;
+
+			fst_requires(json_cdr_reload("<param name=\"queue-capacity\" value=\"100\"/><param name=\"batch-size\" value=\"10\"/>"
+										 "<param name=\"batch-format\" value=\"ndjson\"/>"));
+			fst_requires(place_batch(uuids));
+			fst_check(collector_saw("Content-Type: application/x-ndjson"));
+
+			/* one CDR object per line, each line terminated */
+			body = collector_batch_body();
+			fst_requires(body);
+			fst_check(body[0] == '{');
+			fst_check(body[strlen(body) - 1] == '\n');
+			for (p = body; (p = strchr(p, '\n')); p++) {
+				lines++;
+				fst_check(p[1] == '\0' || p[1] == '{');
+			}
+			fst_check_int_equals(lines, 3);
+			for (i = 1; i < 4; i++) {
+				fst_check_string_has(body, uuids[i]);
+			}
+			switch_safe_free(body);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(spool_on_shutdown)
+		{
+			char uuids[3][SWITCH_UUID_FORMATTED_LENGTH + 1];
+			const char *err = NULL;
+			char path[1024];
+			int i;
+
+			fst_requires(json_cdr_reload("<param name=\"queue-capacity\" value=\"100\"/>"));
+
+			/* the worker sits on the first CDR, the other two are still queued when the module goes away */
+			collector_hold(1);
+			fst_requires(place_call(uuids[0], sizeof(uuids[0])));
+			fst_requires(collector_wait_held());
+			fst_requires(place_call(uuids[1], sizeof(uuids[1])));
+			fst_requires(place_call(uuids[2], sizeof(uuids[2])));
+			fst_requires(wait_queued(2));
+
+			/* shutdown waits for the post in flight, the collector lets it go after COLLECTOR_HOLD_MS */
+			sprintf(path, "%s%s%s", SWITCH_TEST_BASE_DIR_OVERRIDE, SWITCH_PATH_SEPARATOR, "../.libs/");
+			fst_requires(switch_loadable_module_unload_module(path, (char *) "mod_json_cdr", SWITCH_FALSE, &err) == SWITCH_STATUS_SUCCESS);
+			collector_hold(0);
+
+			fst_check(!spooled(uuids[0]));
+			for (i = 1; i < 3; i++) {
+				char *spool = spool_path(uuids[i]);
+				FILE *fp = fopen(spool, "r");
+				char buf[8192] = "";
+
+				/* each spooled file is the complete CDR of its own call */
+				fst_requires(fp);
+				fst_check(fread(buf, 1, sizeof(buf) - 1, fp) > 0);
+				fclose(fp);
+				fst_check(buf[0] == '{');
+				fst_check_string_has(buf, uuids[i]);
+				switch_safe_free(spool);
+			}
+
+			/* back to the static config, its replay thread posts what shutdown left behind */
+			fst_requires(switch_loadable_module_load_module(path, (char *) "mod_json_cdr", SWITCH_TRUE, &err) == SWITCH_STATUS_SUCCESS);
+			for (i = 1; i < 3; i++) {
+				fst_check(wait_unspooled(uuids[i]));
+			}
+		}
+		FST_TEST_END()
+	}
+	FST_MODULE_END()
+
+	collector_stop();
+}
+FST_CORE_END()
@@ -30,12 +30,18 @@
  *
  */
 #include <switch.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load);
 SWITCH_MODULE_DEFINITION(mod_native_file, mod_native_file_load, NULL, NULL);
 
 struct native_file_context {
 	switch_file_t *fd;
+	uint8_t *map;
+	switch_size_t maplen;
+	switch_size_t mappos;
 };
 
 typedef struct native_file_context native_file_context;
@@ -70,7 +76,30 @@ static switch_status_t native_file_file_open(switch_file_handle_t *handle, const
 		flags |= SWITCH_FOPEN_READ;
 	}
 
-	if (switch_file_open(&context->fd, path, flags, SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, handle->memory_pool) != SWITCH_STATUS_SUCCESS) {
+#ifndef WIN32
+	if (flags == SWITCH_FOPEN_READ && handle->params && switch_true(switch_event_get_header(handle->params, "mmap"))) {
+		/* payloads are played as is, so reads can come straight out of the page cache; opt in only,
+		   since truncating a mapped file in place faults the reader */
+		struct stat st;
+		int fd;
+
+		if ((fd = open(path, O_RDONLY)) > -1) {
+			if (!fstat(fd, &st) && st.st_size > 0 &&
+				(context->map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED) {
+				context->maplen = (switch_size_t) st.st_size;
+				madvise(context->map, context->maplen, MADV_SEQUENTIAL);
+				madvise(context->map, context->maplen, MADV_WILLNEED);
+				handle->flags |= SWITCH_FILE_MAPPED;
+			} else {
+				context->map = NULL;
+			}
+			close(fd);
+		}
+	}
+
+#endif
+
+	if (!context->map && switch_file_open(&context->fd, path, flags, SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, handle->memory_pool) != SWITCH_STATUS_SUCCESS) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", path);
 		return SWITCH_STATUS_GENERR;
 	}
@@ -120,6 +149,13 @@ static switch_status_t native_file_file_close(switch_file_handle_t *handle)
 {
 	native_file_context *context = handle->private_info;
 
+#ifndef WIN32
+	if (context->map) {
+		munmap(context->map, context->maplen);
+		context->map = NULL;
+	}
+#endif
+
 	if (context->fd) {
 		switch_file_close(context->fd);
 		context->fd = NULL;
@@ -134,6 +170,26 @@ static switch_status_t native_file_file_seek(switch_file_handle_t *handle, unsig
 
 	native_file_context *context = handle->private_info;
 
+	if (context->map) {
+		if (whence == SEEK_CUR) {
+			samples += context->mappos;
+		} else if (whence == SEEK_END) {
+			samples += context->maplen;
+		}
+
+		if (samples < 0) {
+			samples = 0;
+		} else if (samples > (int64_t) context->maplen) {
+			samples = context->maplen;
+		}
+
+		context->mappos = (switch_size_t) samples;
+		handle->pos = samples;
+		*cur_sample = (unsigned int) samples;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	status = switch_file_seek(context->fd, whence, &samples);
 	if (status == SWITCH_STATUS_SUCCESS) {
 		handle->pos += samples;
@@ -147,6 +203,22 @@ static switch_status_t native_file_file_read(switch_file_handle_t *handle, void
 
 	native_file_context *context = handle->private_info;
 
+	if (context->map) {
+		if (*len > context->maplen - context->mappos) {
+			*len = context->maplen - context->mappos;
+		}
+
+		if (!*len) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		memcpy(data, context->map + context->mappos, *len);
+		context->mappos += *len;
+		handle->pos += *len;
+
+		return SWITCH_STATUS_SUCCESS;
+	}
+
 	status = switch_file_read(context->fd, data, len);
 	if (status == SWITCH_STATUS_SUCCESS) {
 		handle->pos += *len;
@@ -171,9 +243,212 @@ static switch_status_t native_file_file_get_string(switch_file_handle_t *handle,
 	return SWITCH_STATUS_FALSE;
 }
 
+/* Pre-encoded prompt containers written by the playback store, one packet per read */
+
+struct native_prompt_context {
+	uint8_t *data;
+	switch_size_t datalen;
+	int mapped;
+	const switch_native_prompt_header_t *hdr;
+	const uint32_t *offsets;
+	const uint8_t *payload;
+	uint32_t frame;
+};
+
+typedef struct native_prompt_context native_prompt_context;
+
+/* Containers are small, so they are read into the handle pool unless the caller opts in to {mmap=true} */
+static switch_status_t native_prompt_load(native_prompt_context *context, const char *path, switch_file_handle_t *handle)
+{
+	switch_memory_pool_t *pool = handle->memory_pool;
+	switch_file_t *fd;
+
+#ifndef WIN32
+	if (handle->params && switch_true(switch_event_get_header(handle->params, "mmap"))) {
+		struct stat st;
+		int mfd;
+
+		if ((mfd = open(path, O_RDONLY)) < 0) {
+			return SWITCH_STATUS_FALSE;
+		}
+
+		if (fstat(mfd, &st) || st.st_size < (off_t) sizeof(switch_native_prompt_header_t)) {
+			close(mfd);
+			return SWITCH_STATUS_FALSE;
+		}
+
+		context->datalen = (switch_size_t) st.st_size;
+		context->data = mmap(NULL, context->datalen, PROT_READ, MAP_SHARED, mfd, 0);
+		close(mfd);
+
+		if (context->data == MAP_FAILED) {
+			context->data = NULL;
+			return SWITCH_STATUS_FALSE;
+		}
+
+		context->mapped = 1;
+		madvise(context->data, context->datalen, MADV_SEQUENTIAL);
+		handle->flags |= SWITCH_FILE_MAPPED;
+		return SWITCH_STATUS_SUCCESS;
+	}
+#endif
+
+	if (switch_file_open(&fd, path, SWITCH_FOPEN_READ | SWITCH_FOPEN_BINARY, SWITCH_FPROT_OS_DEFAULT, pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	context->datalen = switch_file_get_size(fd);
+
+	/* a short read leaves datalen at what actually arrived, and the container checks run against that */
+	if (context->datalen < sizeof(switch_native_prompt_header_t) || !(context->data = switch_core_alloc(pool, context->datalen)) ||
+		switch_file_read(fd, context->data, &context->datalen) != SWITCH_STATUS_SUCCESS ||
+		context->datalen < sizeof(switch_native_prompt_header_t)) {
+		switch_file_close(fd);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_file_close(fd);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t native_prompt_file_close(switch_file_handle_t *handle)
+{
+	native_prompt_context *context = handle->private_info;
+
+#ifndef WIN32
+	if (context && context->mapped) {
+		munmap(context->data, context->datalen);
+		context->mapped = 0;
+	}
+#endif
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t native_prompt_file_open(switch_file_handle_t *handle, const char *path)
+{
+	native_prompt_context *context;
+	const switch_native_prompt_header_t *hdr;
+	switch_size_t need;
+	uint32_t x;
+
+	if (switch_test_flag(handle, SWITCH_FILE_FLAG_WRITE)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Prompt containers are read only [%s]\n", path);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	if ((context = switch_core_alloc(handle->memory_pool, sizeof(*context))) == 0) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	if (native_prompt_load(context, path, handle) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error opening %s\n", path);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	handle->private_info = context;
+	hdr = context->hdr = (const switch_native_prompt_header_t *) context->data;
+
+	/* compare the frame count against the index room first so need cannot wrap */
+	if (memcmp(hdr->magic, SWITCH_NATIVE_PROMPT_MAGIC, 4) || hdr->version != SWITCH_NATIVE_PROMPT_VERSION ||
+		!hdr->frames || !hdr->samples_per_packet || !hdr->channels ||
+		hdr->frames >= (context->datalen - sizeof(*hdr)) / sizeof(uint32_t)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Invalid prompt container %s\n", path);
+		native_prompt_file_close(handle);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	need = sizeof(*hdr) + ((switch_size_t) hdr->frames + 1) * sizeof(uint32_t);
+	context->offsets = (const uint32_t *) (context->data + sizeof(*hdr));
+	context->payload = context->data + need;
+
+	/* every packet has to start where the last one ended and stay inside the payload, so reads never leave the file */
+	for (x = 0; x < hdr->frames; x++) {
+		if (context->offsets[x + 1] < context->offsets[x]) {
+			break;
+		}
+	}
+
+	if (context->offsets[0] || x < hdr->frames || context->offsets[hdr->frames] > context->datalen - need) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Truncated prompt container %s\n", path);
+		native_prompt_file_close(handle);
+		return SWITCH_STATUS_GENERR;
+	}
+
+	handle->pos = 0;
+	handle->samples = hdr->frames * hdr->samples_per_packet;
+	handle->samplerate = hdr->actual_samples_per_second;
+	handle->channels = hdr->channels;
+	handle->format = 0;
+	handle->sections = 0;
+	handle->seekable = 1;
+	handle->speed = 0;
+	handle->pre_buffer_datalen = 0;
+	handle->flags |= SWITCH_FILE_NATIVE;
+	handle->flags |= SWITCH_FILE_NATIVE_FRAMED;
+	handle->flags |= SWITCH_FILE_NOMUX;
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Opening prompt [%s] %s %dhz %u packets\n",
+					  path, hdr->iananame, hdr->actual_samples_per_second, hdr->frames);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t native_prompt_file_seek(switch_file_handle_t *handle, unsigned int *cur_sample, int64_t samples, int whence)
+{
+	native_prompt_context *context = handle->private_info;
+	int64_t frame = samples / context->hdr->samples_per_packet;
+
+	if (whence == SEEK_CUR) {
+		frame += context->frame;
+	} else if (whence == SEEK_END) {
+		frame += context->hdr->frames;
+	}
+
+	if (frame < 0) {
+		frame = 0;
+	} else if (frame > context->hdr->frames) {
+		frame = context->hdr->frames;
+	}
+
+	context->frame = (uint32_t) frame;
+	handle->pos = frame * context->hdr->samples_per_packet;
+	*cur_sample = (unsigned int) handle->pos;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t native_prompt_file_read(switch_file_handle_t *handle, void *data, size_t *len)
+{
+	native_prompt_context *context = handle->private_info;
+	uint32_t start, bytes;
+
+	if (context->frame >= context->hdr->frames) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	start = context->offsets[context->frame];
+	bytes = context->offsets[context->frame + 1] - start;
+
+	if (bytes > *len) {
+		*len = 0;
+		return SWITCH_STATUS_FALSE;
+	}
+
+	memcpy(data, context->payload + start, bytes);
+	*len = bytes;
+	context->frame++;
+	handle->pos += context->hdr->samples_per_packet;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 /* Registration */
 
 static char *supported_formats[SWITCH_MAX_CODECS + 1] = { 0 };
+static char *prompt_formats[2] = { SWITCH_NATIVE_PROMPT_EXT, NULL };
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 {
@@ -204,6 +479,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_native_file_load)
 	file_interface->file_set_string = native_file_file_set_string;
 	file_interface->file_get_string = native_file_file_get_string;
 
+	file_interface = switch_loadable_module_create_interface(*module_interface, SWITCH_FILE_INTERFACE);
+	file_interface->interface_name = modname;
+	file_interface->extens = prompt_formats;
+	file_interface->file_open = native_prompt_file_open;
+	file_interface->file_close = native_prompt_file_close;
+	file_interface->file_read = native_prompt_file_read;
+	file_interface->file_seek = native_prompt_file_seek;
+	file_interface->file_set_string = native_file_file_set_string;
+	file_interface->file_get_string = native_file_file_get_string;
+
 	/* indicate that the module should continue to be loaded */
 	return SWITCH_STATUS_SUCCESS;
 }
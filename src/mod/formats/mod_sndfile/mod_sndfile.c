@@ -31,6 +31,9 @@
  */
 #include <switch.h>
 #include <sndfile.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_sndfile_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_sndfile_shutdown);
@@ -53,10 +56,97 @@ struct format_map {
 struct sndfile_context {
 	SF_INFO sfinfo;
 	SNDFILE *handle;
+	uint8_t *map;
+	switch_size_t maplen;
+	const int16_t *map_data;
+	sf_count_t map_frames;
+	sf_count_t map_pos;
 };
 
 typedef struct sndfile_context sndfile_context;
 
+#if !defined(WIN32) && SWITCH_BYTE_ORDER == __LITTLE_ENDIAN
+/* Find the sample data of a 16 bit PCM wav, or 0 if the file is anything fancier */
+static switch_size_t sndfile_wav_data_offset(const uint8_t *buf, switch_size_t len, switch_size_t *datalen)
+{
+	switch_size_t pos = 12;
+
+	if (len < 12 || memcmp(buf, "RIFF", 4) || memcmp(buf + 8, "WAVE", 4)) {
+		return 0;
+	}
+
+	while (pos + 8 <= len) {
+		uint32_t size = buf[pos + 4] | (buf[pos + 5] << 8) | (buf[pos + 6] << 16) | ((uint32_t) buf[pos + 7] << 24);
+
+		if (!memcmp(buf + pos, "data", 4)) {
+			pos += 8;
+			*datalen = size > len - pos ? len - pos : size;
+			return pos;
+		}
+
+		pos += 8 + size + (size & 1);
+	}
+
+	return 0;
+}
+
+/* Serve plain 16 bit PCM straight out of the page cache instead of through libsndfile.
+   Only on {mmap=true}: a file truncated in place while it is mapped faults the reader with SIGBUS,
+   so mapped prompts must be replaced by rename, never rewritten. */
+static void sndfile_map(sndfile_context *context, const char *path, switch_file_handle_t *handle)
+{
+	int major = context->sfinfo.format & SF_FORMAT_TYPEMASK;
+	int endian = context->sfinfo.format & SF_FORMAT_ENDMASK;
+	switch_size_t offset = 0, datalen = 0;
+	struct stat st;
+	int fd;
+
+	if ((context->sfinfo.format & SF_FORMAT_SUBMASK) != SF_FORMAT_PCM_16 || (major != SF_FORMAT_WAV && major != SF_FORMAT_RAW) ||
+		endian == SF_ENDIAN_BIG || !switch_test_flag(handle, SWITCH_FILE_DATA_SHORT) || context->sfinfo.channels < 1 ||
+		!handle->params || !switch_true(switch_event_get_header(handle->params, "mmap"))) {
+		return;
+	}
+
+	if ((fd = open(path, O_RDONLY)) < 0) {
+		return;
+	}
+
+	if (fstat(fd, &st) || st.st_size <= 0 ||
+		(context->map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		context->map = NULL;
+		close(fd);
+		return;
+	}
+
+	close(fd);
+	context->maplen = (switch_size_t) st.st_size;
+
+	if (major == SF_FORMAT_RAW) {
+		datalen = context->maplen;
+	} else if (!(offset = sndfile_wav_data_offset(context->map, context->maplen, &datalen))) {
+		goto fail;
+	}
+
+	if ((sf_count_t) (datalen / (2 * context->sfinfo.channels)) != context->sfinfo.frames) {
+		/* libsndfile sees something we do not, let it do the work */
+		goto fail;
+	}
+
+	context->map_data = (const int16_t *) (context->map + offset);
+	context->map_frames = context->sfinfo.frames;
+	context->map_pos = 0;
+	madvise(context->map, context->maplen, MADV_SEQUENTIAL);
+	madvise(context->map, context->maplen, MADV_WILLNEED);
+	handle->flags |= SWITCH_FILE_MAPPED;
+	return;
+
+  fail:
+	munmap(context->map, context->maplen);
+	context->map = NULL;
+	context->maplen = 0;
+}
+#endif
+
 static switch_status_t sndfile_perform_open(sndfile_context *context, const char *path, int mode, switch_file_handle_t *handle);
 
 static void reverse_channel_count(switch_file_handle_t *handle) {
@@ -316,6 +406,12 @@ static switch_status_t sndfile_file_open(switch_file_handle_t *handle, const cha
 		sf_command(context->handle,  SFC_SET_SCALE_FLOAT_INT_READ, NULL, SF_TRUE);
 	}
 
+#if !defined(WIN32) && SWITCH_BYTE_ORDER == __LITTLE_ENDIAN
+	if (mode == SFM_READ) {
+		sndfile_map(context, path, handle);
+	}
+#endif
+
   end:
 
 	switch_safe_free(alt_path);
@@ -356,6 +452,12 @@ static switch_status_t sndfile_file_close(switch_file_handle_t *handle)
 	sndfile_context *context = handle->private_info;
 
 	if (context) {
+#ifndef WIN32
+		if (context->map) {
+			munmap(context->map, context->maplen);
+			context->map = NULL;
+		}
+#endif
 		sf_close(context->handle);
 	}
 
@@ -373,6 +475,25 @@ static switch_status_t sndfile_file_seek(switch_file_handle_t *handle, unsigned
 		return SWITCH_STATUS_NOTIMPL;
 	}
 
+	if (context->map) {
+		if (whence == SEEK_CUR) {
+			samples += context->map_pos;
+		} else if (whence == SEEK_END) {
+			samples += context->map_frames;
+		}
+
+		if (samples < 0 || samples > context->map_frames) {
+			r = SWITCH_STATUS_BREAK;
+			samples = context->map_frames ? context->map_frames - 1 : 0;
+		}
+
+		context->map_pos = samples;
+		*cur_sample = (unsigned int) samples;
+		handle->pos = *cur_sample;
+
+		return r;
+	}
+
 	if ((count = sf_seek(context->handle, samples, whence)) == ((sf_count_t) -1)) {
 		r = SWITCH_STATUS_BREAK;
 		count = sf_seek(context->handle, -1, SEEK_END);
@@ -389,7 +510,17 @@ static switch_status_t sndfile_file_read(switch_file_handle_t *handle, void *dat
 	size_t inlen = *len;
 	sndfile_context *context = handle->private_info;
 
-	if (switch_test_flag(handle, SWITCH_FILE_DATA_RAW)) {
+	if (context->map) {
+		sf_count_t left = context->map_frames - context->map_pos;
+
+		if ((sf_count_t) inlen > left) {
+			inlen = (size_t) left;
+		}
+
+		memcpy(data, context->map_data + context->map_pos * context->sfinfo.channels, inlen * 2 * context->sfinfo.channels);
+		context->map_pos += inlen;
+		*len = inlen;
+	} else if (switch_test_flag(handle, SWITCH_FILE_DATA_RAW)) {
 		*len = (size_t) sf_read_raw(context->handle, data, inlen);
 	} else if (switch_test_flag(handle, SWITCH_FILE_DATA_INT)) {
 		*len = (size_t) sf_readf_int(context->handle, (int *) data, inlen);
@@ -31,6 +31,9 @@
  */
 
 #include <switch.h>
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load);
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_logfile_shutdown);
@@ -39,13 +42,25 @@ SWITCH_MODULE_DEFINITION(mod_logfile, mod_logfile_load, mod_logfile_shutdown, NU
 #define DEFAULT_LIMIT	 0xA00000	/* About 10 MB */
 #define WARM_FUZZY_OFFSET 256
 #define MAX_ROT 4096			/* why not */
+#define DEFAULT_QUEUE_SIZE 10000
+#define WRITE_BATCH_SIZE 65536	/* coalesce queued lines into writes of up to this many bytes */
+#define LOGFILE_RING_MAGIC 0x464c5247
+
+/* Header of the crash ring file.  Every queued line is also copied into the mapped ring, and the writer
+   thread moves flushed forward once the line is on disk, so lines still queued when the process dies
+   can be recovered from the page cache on the next load. */
+typedef struct {
+	uint32_t magic;
+	uint32_t size;
+	uint64_t head;
+	uint64_t flushed;
+} logfile_ring_t;
 
 static switch_memory_pool_t *module_pool = NULL;
 static switch_hash_t *profile_hash = NULL;
 
 static struct {
 	int rotate;
-	switch_mutex_t *mutex;
 	switch_event_node_t *node;
 } globals;
 
@@ -60,6 +75,21 @@ struct logfile_profile {
 	uint32_t all_level;
 	uint32_t suffix;			/* suffix of the highest logfile name */
 	switch_bool_t log_uuid;
+	switch_bool_t async;		/* hand lines to a writer thread instead of writing from the log thread */
+	uint32_t queue_size;
+	switch_queue_t *queue;
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;		/* guards this profile's file, rotation and pending flags */
+	switch_mutex_t *queue_mutex;	/* guards the queue pointer and the ring's head and flushed */
+	int running;
+	int rotate_pending;
+	int reopen_pending;
+	uint32_t ring_size;
+	char *ring_file;
+	logfile_ring_t *ring;
+	uint64_t bytes_written;
+	uint64_t lines_written;
+	uint64_t lines_dropped;
 };
 
 typedef struct logfile_profile logfile_profile_t;
@@ -127,7 +157,7 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 	switch_size_t retsize;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 
-	switch_mutex_lock(globals.mutex);
+	switch_mutex_lock(profile->mutex);
 
 	switch_time_exp_lt(&tm, switch_micro_time_now());
 	switch_strftime_nocheck(date, &retsize, sizeof(date), "%Y-%m-%d-%H-%M-%S", &tm);
@@ -222,45 +252,338 @@ static switch_status_t mod_logfile_rotate(logfile_profile_t *profile)
 		switch_core_destroy_memory_pool(&pool);
 	}
 
-	switch_mutex_unlock(globals.mutex);
+	switch_mutex_unlock(profile->mutex);
 
 	return status;
 }
 
 /* write to the actual logfile */
-static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, char *log_data)
+static switch_status_t mod_logfile_raw_write(logfile_profile_t *profile, const char *log_data, switch_size_t data_len)
 {
-	switch_size_t len;
+	switch_size_t len = data_len;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
-	len = strlen(log_data);
 
 	if (len <= 0 || !profile->log_afd) {
 		return SWITCH_STATUS_FALSE;
 	}
 
-	switch_mutex_lock(globals.mutex);
+	switch_mutex_lock(profile->mutex);
 
 	if (switch_file_write(profile->log_afd, log_data, &len) != SWITCH_STATUS_SUCCESS) {
 		switch_file_close(profile->log_afd);
 		if ((status = mod_logfile_openlogfile(profile, SWITCH_TRUE)) == SWITCH_STATUS_SUCCESS) {
-			len = strlen(log_data);
+			len = data_len;
 			switch_file_write(profile->log_afd, log_data, &len);
 		}
 	}
 
-	switch_mutex_unlock(globals.mutex);
-
 	if (status == SWITCH_STATUS_SUCCESS) {
 		profile->log_size += len;
+		profile->bytes_written += len;
 
 		if (profile->roll_size && profile->log_size >= profile->roll_size) {
 			mod_logfile_rotate(profile);
 		}
 	}
 
+	switch_mutex_unlock(profile->mutex);
+
 	return status;
 }
 
+static void mod_logfile_reopen(logfile_profile_t *profile)
+{
+	switch_mutex_lock(profile->mutex);
+	switch_file_close(profile->log_afd);
+	if (mod_logfile_openlogfile(profile, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error Re-opening Log!\n");
+	}
+	switch_mutex_unlock(profile->mutex);
+}
+
+static void mod_logfile_handle_pending(logfile_profile_t *profile)
+{
+	int rotate, reopen;
+
+	switch_mutex_lock(profile->mutex);
+	rotate = profile->rotate_pending;
+	reopen = profile->reopen_pending;
+	profile->rotate_pending = profile->reopen_pending = 0;
+	switch_mutex_unlock(profile->mutex);
+
+	if (rotate) {
+		mod_logfile_rotate(profile);
+	}
+
+	if (reopen) {
+		mod_logfile_reopen(profile);
+	}
+}
+
+/* caller holds profile->queue_mutex */
+static void mod_logfile_ring_put(logfile_profile_t *profile, const char *data, switch_size_t len)
+{
+	logfile_ring_t *ring = profile->ring;
+	char *base;
+	switch_size_t pos, first, skip = 0;
+
+	if (!ring) {
+		return;
+	}
+
+	base = (char *) (ring + 1);
+
+	if (len > ring->size) {
+		skip = len - ring->size;
+	}
+
+	pos = (switch_size_t) ((ring->head + skip) % ring->size);
+	first = ring->size - pos;
+
+	if (first > len - skip) {
+		first = len - skip;
+	}
+
+	memcpy(base + pos, data + skip, first);
+	memcpy(base, data + skip + first, len - skip - first);
+
+	ring->head += len;
+}
+
+/* append whatever the last run queued but never wrote, then start the ring over */
+static void mod_logfile_ring_recover(logfile_profile_t *profile, logfile_ring_t *ring)
+{
+	char *base = (char *) (ring + 1);
+	uint64_t pending;
+	switch_size_t pos, first;
+	char note[256];
+
+	if (ring->head <= ring->flushed) {
+		return;
+	}
+
+	pending = ring->head - ring->flushed;
+
+	if (pending > ring->size) {
+		pending = ring->size;
+	}
+
+	switch_snprintf(note, sizeof(note), "[mod_logfile] %" SWITCH_UINT64_T_FMT " bytes queued but not written before the last exit, recovered from %s\n",
+					pending, profile->ring_file);
+	mod_logfile_raw_write(profile, note, strlen(note));
+
+	pos = (switch_size_t) ((ring->head - pending) % ring->size);
+	first = ring->size - pos;
+
+	if (first > pending) {
+		first = (switch_size_t) pending;
+	}
+
+	mod_logfile_raw_write(profile, base + pos, first);
+
+	if (pending > first) {
+		mod_logfile_raw_write(profile, base, (switch_size_t) pending - first);
+	}
+}
+
+static void mod_logfile_ring_open(logfile_profile_t *profile)
+{
+#ifndef WIN32
+	switch_size_t len = sizeof(logfile_ring_t) + profile->ring_size;
+	struct stat st;
+	void *map;
+	int fd;
+
+	profile->ring_file = switch_core_sprintf(module_pool, "%s.ring", profile->logfile);
+
+	if ((fd = open(profile->ring_file, O_RDWR | O_CREAT, 0640)) < 0) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot open crash ring %s [%s]\n", profile->ring_file, strerror(errno));
+		return;
+	}
+
+	if (!fstat(fd, &st) && st.st_size >= (off_t) sizeof(logfile_ring_t) &&
+		(map = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_SHARED, fd, 0)) != MAP_FAILED) {
+		logfile_ring_t *old = (logfile_ring_t *) map;
+
+		if (old->magic == LOGFILE_RING_MAGIC && old->size && sizeof(logfile_ring_t) + old->size <= (uint64_t) st.st_size) {
+			mod_logfile_ring_recover(profile, old);
+		}
+
+		munmap(map, (size_t) st.st_size);
+	}
+
+	if (ftruncate(fd, (off_t) len) ||
+		(map = mmap(NULL, len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0)) == MAP_FAILED) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot map crash ring %s [%s]\n", profile->ring_file, strerror(errno));
+		close(fd);
+		return;
+	}
+
+	close(fd);
+
+	profile->ring = (logfile_ring_t *) map;
+	profile->ring->size = profile->ring_size;
+	profile->ring->head = profile->ring->flushed = 0;
+	profile->ring->magic = LOGFILE_RING_MAGIC;
+#else
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "crash-ring-size is not supported on this platform\n");
+#endif
+}
+
+static void mod_logfile_ring_close(logfile_profile_t *profile)
+{
+#ifndef WIN32
+	if (profile->ring) {
+		munmap(profile->ring, sizeof(logfile_ring_t) + profile->ring->size);
+		profile->ring = NULL;
+	}
+#endif
+}
+
+static void mod_logfile_ring_flushed(logfile_profile_t *profile, switch_size_t len)
+{
+	if (!profile->ring || !len) {
+		return;
+	}
+
+	switch_mutex_lock(profile->queue_mutex);
+	profile->ring->flushed += len;
+	switch_mutex_unlock(profile->queue_mutex);
+}
+
+/* Drain the profile queue, packing consecutive lines into one buffer so the disk sees a few large writes
+   instead of one per line. Rotation and re-opening happen here too, never on the core log thread. */
+static void *SWITCH_THREAD_FUNC mod_logfile_writer_thread(switch_thread_t *thread, void *obj)
+{
+	logfile_profile_t *profile = (logfile_profile_t *) obj;
+	char *batch = malloc(WRITE_BATCH_SIZE);
+	int done = 0;
+
+	switch_assert(batch);
+
+	while (!done) {
+		void *pop = NULL;
+		switch_size_t used = 0, unflushed = 0;
+
+		mod_logfile_handle_pending(profile);
+
+		if (switch_queue_pop_timeout(profile->queue, &pop, 500000) != SWITCH_STATUS_SUCCESS) {
+			if (!profile->running) {
+				break;
+			}
+			continue;
+		}
+
+		for (;;) {
+			char *line = (char *) pop;
+			switch_size_t len;
+
+			if (!line) {
+				done = 1;
+				break;
+			}
+
+			len = strlen(line);
+
+			if (used && used + len > WRITE_BATCH_SIZE) {
+				mod_logfile_raw_write(profile, batch, used);
+				mod_logfile_ring_flushed(profile, unflushed);
+				used = unflushed = 0;
+			}
+
+			if (len > WRITE_BATCH_SIZE) {
+				mod_logfile_raw_write(profile, line, len);
+				mod_logfile_ring_flushed(profile, len);
+			} else {
+				memcpy(batch + used, line, len);
+				used += len;
+				unflushed += len;
+			}
+
+			profile->lines_written++;
+			free(line);
+
+			pop = NULL;
+			if (switch_queue_trypop(profile->queue, &pop) != SWITCH_STATUS_SUCCESS) {
+				break;
+			}
+		}
+
+		if (used) {
+			mod_logfile_raw_write(profile, batch, used);
+			mod_logfile_ring_flushed(profile, unflushed);
+		}
+	}
+
+	free(batch);
+
+	return NULL;
+}
+
+static void mod_logfile_write(logfile_profile_t *profile, const char *log_data)
+{
+	char *dup;
+
+	switch_mutex_lock(profile->queue_mutex);
+
+	if (!profile->queue) {
+		switch_mutex_unlock(profile->queue_mutex);
+		if (mod_logfile_raw_write(profile, log_data, strlen(log_data)) == SWITCH_STATUS_SUCCESS) {
+			profile->lines_written++;
+		}
+		return;
+	}
+
+	dup = strdup(log_data);
+	switch_assert(dup);
+
+	if (switch_queue_trypush(profile->queue, dup) != SWITCH_STATUS_SUCCESS) {
+		profile->lines_dropped++;
+		free(dup);
+	} else {
+		mod_logfile_ring_put(profile, log_data, strlen(log_data));
+	}
+
+	switch_mutex_unlock(profile->queue_mutex);
+}
+
+static void mod_logfile_start_writer(logfile_profile_t *profile)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_queue_create(&profile->queue, profile->queue_size, module_pool);
+	profile->running = 1;
+
+	switch_threadattr_create(&thd_attr, module_pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	if (switch_thread_create(&profile->thread, thd_attr, mod_logfile_writer_thread, profile, module_pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Cannot start writer thread for %s, writing inline\n", profile->logfile);
+		profile->running = 0;
+		profile->queue = NULL;
+		profile->thread = NULL;
+	}
+}
+
+static void mod_logfile_stop_writer(logfile_profile_t *profile)
+{
+	switch_status_t st;
+
+	if (!profile->thread) {
+		return;
+	}
+
+	/* producers wait on queue_mutex until the writer is gone and then write inline, so no line is pushed
+	   to a queue nobody drains and none is written out of order with the ones still queued */
+	switch_mutex_lock(profile->queue_mutex);
+	profile->running = 0;
+	/* the NULL marks the end of the queue, everything queued before it still gets written */
+	switch_queue_push(profile->queue, NULL);
+	switch_thread_join(&st, profile->thread);
+	profile->thread = NULL;
+	profile->queue = NULL;
+	switch_mutex_unlock(profile->queue_mutex);
+}
+
 static switch_status_t process_node(const switch_log_node_t *node, switch_log_level_t level)
 {
 	switch_hash_index_t *hi;
@@ -304,13 +627,13 @@ static switch_status_t process_node(const switch_log_node_t *node, switch_log_le
 				argc = switch_split(dup, '\n', lines);
 				for (i = 0; i < argc; i++) {
 					switch_snprintf(buf, sizeof(buf), "%s %s\n", node->userdata, lines[i]);
-					mod_logfile_raw_write(profile, buf);
+					mod_logfile_write(profile, buf);
 				}
 
 				free(dup);
 
 			} else {
-				mod_logfile_raw_write(profile, node->data);
+				mod_logfile_write(profile, node->data);
 			}
 		}
 
@@ -328,6 +651,8 @@ static void cleanup_profile(void *ptr)
 {
 	logfile_profile_t *profile = (logfile_profile_t *) ptr;
 
+	mod_logfile_stop_writer(profile);
+	mod_logfile_ring_close(profile);
 	switch_core_hash_destroy(&profile->log_hash);
 	switch_file_close(profile->log_afd);
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Closing %s\n", profile->logfile);
@@ -344,10 +669,14 @@ static switch_status_t load_profile(switch_xml_t xml)
 	new_profile = switch_core_alloc(module_pool, sizeof(*new_profile));
 	memset(new_profile, 0, sizeof(*new_profile));
 	switch_core_hash_init(&(new_profile->log_hash));
+	switch_mutex_init(&new_profile->mutex, SWITCH_MUTEX_NESTED, module_pool);
+	switch_mutex_init(&new_profile->queue_mutex, SWITCH_MUTEX_NESTED, module_pool);
 	new_profile->name = switch_core_strdup(module_pool, switch_str_nil(name));
 
 	new_profile->suffix = 1;
 	new_profile->log_uuid = SWITCH_TRUE;
+	new_profile->async = SWITCH_FALSE;
+	new_profile->queue_size = DEFAULT_QUEUE_SIZE;
 
 	if ((settings = switch_xml_child(xml, "settings"))) {
 		for (param = switch_xml_child(settings, "param"); param; param = param->next) {
@@ -364,6 +693,16 @@ static switch_status_t load_profile(switch_xml_t xml)
 				}
 			} else if (!strcmp(var, "uuid")) {
 				new_profile->log_uuid = switch_true(val);
+			} else if (!strcmp(var, "async")) {
+				new_profile->async = switch_true(val);
+			} else if (!strcmp(var, "queue-size")) {
+				uint32_t queue_size = switch_atoui(val);
+
+				if (queue_size > 0) {
+					new_profile->queue_size = queue_size;
+				}
+			} else if (!strcmp(var, "crash-ring-size")) {
+				new_profile->ring_size = switch_atoui(val);
 			}
 		}
 	}
@@ -387,6 +726,13 @@ static switch_status_t load_profile(switch_xml_t xml)
 		return SWITCH_STATUS_GENERR;
 	}
 
+	if (new_profile->async) {
+		if (new_profile->ring_size) {
+			mod_logfile_ring_open(new_profile);
+		}
+		mod_logfile_start_writer(new_profile);
+	}
+
 	switch_core_hash_insert_destructor(profile_hash, new_profile->name, (void *) new_profile, cleanup_profile);
 	return SWITCH_STATUS_SUCCESS;
 }
@@ -401,36 +747,78 @@ static void event_handler(switch_event_t *event)
 	logfile_profile_t *profile;
 
 	if (sig && !strcmp(sig, "HUP")) {
-		if (globals.rotate) {
-			for (hi = switch_core_hash_first(profile_hash); hi; hi = switch_core_hash_next(&hi)) {
-				switch_core_hash_this(hi, &var, NULL, &val);
-				profile = val;
-				mod_logfile_rotate(profile);
-			}
-		} else {
-			switch_mutex_lock(globals.mutex);
-			for (hi = switch_core_hash_first(profile_hash); hi; hi = switch_core_hash_next(&hi)) {
-				switch_core_hash_this(hi, &var, NULL, &val);
-				profile = val;
-				switch_file_close(profile->log_afd);
-				if (mod_logfile_openlogfile(profile, SWITCH_TRUE) != SWITCH_STATUS_SUCCESS) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Error Re-opening Log!\n");
+		for (hi = switch_core_hash_first(profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+			switch_core_hash_this(hi, &var, NULL, &val);
+			profile = val;
+
+			/* async profiles are rotated by their writer thread */
+			if (profile->thread) {
+				switch_mutex_lock(profile->mutex);
+				if (globals.rotate) {
+					profile->rotate_pending = 1;
+				} else {
+					profile->reopen_pending = 1;
 				}
+				switch_mutex_unlock(profile->mutex);
+			} else if (globals.rotate) {
+				mod_logfile_rotate(profile);
+			} else {
+				mod_logfile_reopen(profile);
 			}
-			switch_mutex_unlock(globals.mutex);
 		}
 	}
 }
 
+#define LOGFILE_SYNTAX "status"
+SWITCH_STANDARD_API(logfile_api_function)
+{
+	switch_hash_index_t *hi;
+	void *val;
+	const void *var;
+	logfile_profile_t *profile;
+
+	if (!zstr(cmd) && strcasecmp(cmd, "status")) {
+		stream->write_function(stream, "-USAGE: %s\n", LOGFILE_SYNTAX);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	for (hi = switch_core_hash_first(profile_hash); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, &var, NULL, &val);
+		profile = val;
+
+		switch_mutex_lock(profile->mutex);
+		stream->write_function(stream, "Profile: %s\n", profile->name);
+		stream->write_function(stream, "  File:          %s\n", profile->logfile);
+		stream->write_function(stream, "  Mode:          %s\n", profile->thread ? "async" : "sync");
+		stream->write_function(stream, "  Size:          %" SWITCH_SIZE_T_FMT "\n", profile->log_size);
+		stream->write_function(stream, "  Bytes Written: %" SWITCH_UINT64_T_FMT "\n", profile->bytes_written);
+		stream->write_function(stream, "  Lines Written: %" SWITCH_UINT64_T_FMT "\n", profile->lines_written);
+		stream->write_function(stream, "  Lines Dropped: %" SWITCH_UINT64_T_FMT "\n", profile->lines_dropped);
+		switch_mutex_unlock(profile->mutex);
+
+		/* never nest queue_mutex inside mutex, stop_writer holds it while the writer still needs mutex */
+		switch_mutex_lock(profile->queue_mutex);
+		if (profile->queue) {
+			stream->write_function(stream, "  Queued:        %u/%u\n", switch_queue_size(profile->queue), profile->queue_size);
+		}
+		if (profile->ring) {
+			stream->write_function(stream, "  Crash Ring:    %s (%u bytes)\n", profile->ring_file, profile->ring->size);
+		}
+		switch_mutex_unlock(profile->queue_mutex);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 {
+	switch_api_interface_t *api_interface;
 	char *cf = "logfile.conf";
 	switch_xml_t cfg, xml, settings, param, profiles, xprofile;
 
 	module_pool = pool;
 
 	memset(&globals, 0, sizeof(globals));
-	switch_mutex_init(&globals.mutex, SWITCH_MUTEX_NESTED, module_pool);
 
 	if (profile_hash) {
 		switch_core_hash_destroy(&profile_hash);
@@ -445,6 +833,9 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_logfile_load)
 	/* connect my internal structure to the blank pointer passed to me */
 	*module_interface = switch_loadable_module_create_module_interface(pool, modname);
 
+	SWITCH_ADD_API(api_interface, "logfile", "mod_logfile status", logfile_api_function, LOGFILE_SYNTAX);
+	switch_console_set_complete("add logfile status");
+
 	if (!(xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Open of %s failed\n", cf);
 	} else {
@@ -0,0 +1,169 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2005-2018, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ * test_mod_logfile -- mod_logfile async writer start, write, rotate and stop
+ *
+ */
+
+#include <test/switch_test.h>
+
+/* same path and rotation as the fst profile in test/conf */
+#define LOGFILE_TEST_PATH "/tmp/fst_mod_logfile.log"
+#define LOGFILE_TEST_ROTATED LOGFILE_TEST_PATH ".1"
+#define LOGFILE_TEST_LINES 200
+
+static int logfile_test_count(const char *path, const char *marker)
+{
+	char line[2048];
+	int count = 0;
+	FILE *fp;
+
+	if (!(fp = fopen(path, "r"))) {
+		return 0;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		if (strstr(line, marker)) {
+			count++;
+		}
+	}
+
+	fclose(fp);
+
+	return count;
+}
+
+/* waits for the writer thread to get the lines to disk */
+static int logfile_test_wait_count(const char *path, const char *marker, int expected)
+{
+	int count = 0, i;
+
+	for (i = 0; i < 100; i++) {
+		if ((count = logfile_test_count(path, marker)) >= expected) {
+			break;
+		}
+		switch_sleep(50000);
+	}
+
+	return count;
+}
+
+static void logfile_test_hup(void)
+{
+	switch_event_t *event;
+
+	if (switch_event_create(&event, SWITCH_EVENT_TRAP) == SWITCH_STATUS_SUCCESS) {
+		switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Trapped-Signal", "HUP");
+		switch_event_fire(&event);
+	}
+}
+
+FST_CORE_BEGIN("conf")
+{
+	unlink(LOGFILE_TEST_PATH);
+	unlink(LOGFILE_TEST_ROTATED);
+
+	FST_MODULE_BEGIN(mod_logfile, mod_logfile_test)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_logfile");
+		}
+		FST_SETUP_END()
+
+		FST_TEST_BEGIN(writer_started)
+		{
+			switch_stream_handle_t stream = { 0 };
+
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("logfile", "status", NULL, &stream);
+			fst_requires(stream.data);
+			fst_check_string_has((char *) stream.data, "Profile: fst\n");
+			fst_check_string_has((char *) stream.data, "Mode:          async\n");
+			fst_check_string_has((char *) stream.data, "Queued:");
+			fst_check_string_has((char *) stream.data, "Crash Ring:");
+			switch_safe_free(stream.data);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(write)
+		{
+			int i;
+
+			for (i = 0; i < LOGFILE_TEST_LINES; i++) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "fst-write-marker %d\n", i);
+			}
+
+			fst_check_int_equals(logfile_test_wait_count(LOGFILE_TEST_PATH, "fst-write-marker", LOGFILE_TEST_LINES), LOGFILE_TEST_LINES);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(rotate)
+		{
+			int i;
+
+			logfile_test_hup();
+
+			/* the writer rotates on its next wakeup, at most one pop timeout later */
+			for (i = 0; i < 100 && switch_file_exists(LOGFILE_TEST_ROTATED, fst_pool) != SWITCH_STATUS_SUCCESS; i++) {
+				switch_sleep(50000);
+			}
+
+			fst_requires(switch_file_exists(LOGFILE_TEST_ROTATED, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(logfile_test_count(LOGFILE_TEST_ROTATED, "fst-write-marker"), LOGFILE_TEST_LINES);
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "fst-rotate-marker\n");
+			fst_check_int_equals(logfile_test_wait_count(LOGFILE_TEST_PATH, "fst-rotate-marker", 1), 1);
+			fst_check_int_equals(logfile_test_count(LOGFILE_TEST_PATH, "fst-write-marker"), 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(stop)
+		{
+			const char *err = NULL;
+			char path[1024];
+			int i;
+
+			for (i = 0; i < LOGFILE_TEST_LINES; i++) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "fst-stop-marker %d\n", i);
+			}
+
+			/* let the core log thread hand the lines over, then stop the writer while some may still be queued */
+			switch_sleep(100000);
+
+			sprintf(path, "%s%s%s", SWITCH_TEST_BASE_DIR_OVERRIDE, SWITCH_PATH_SEPARATOR, "../.libs/");
+			fst_requires(switch_loadable_module_unload_module(path, (char *) "mod_logfile", SWITCH_FALSE, &err) == SWITCH_STATUS_SUCCESS);
+
+			/* everything queued before the stop was drained to disk, nothing was lost */
+			fst_check_int_equals(logfile_test_count(LOGFILE_TEST_PATH, "fst-stop-marker"), LOGFILE_TEST_LINES);
+
+			unlink(LOGFILE_TEST_PATH);
+			unlink(LOGFILE_TEST_ROTATED);
+		}
+		FST_TEST_END()
+	}
+	FST_MODULE_END()
+}
+FST_CORE_END()
@@ -35,6 +35,7 @@
 #include <sys/stat.h>
 #include <switch_curl.h>
 #define MAX_URLS 20
+#define MAX_WORKERS 16
 
 #define ENCODING_NONE 0
 #define ENCODING_DEFAULT 1
@@ -73,6 +74,10 @@ static struct {
 	switch_memory_pool_t *pool;
 	switch_event_node_t *node;
 	char *cookie_file;
+	switch_queue_t *queue;
+	uint32_t queue_capacity;
+	int worker_count;
+	switch_thread_t *workers[MAX_WORKERS];
 } globals;
 
 SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load);
@@ -182,70 +187,41 @@ static switch_status_t set_xml_cdr_log_dirs(void)
 	return status;
 }
 
-static switch_status_t my_on_reporting(switch_core_session_t *session)
+typedef struct {
+	char *xml_text;
+	char *uuid;
+	const char *a_prefix;
+	char *logdir;
+} xml_cdr_data_t;
+
+static void destroy_cdr_data(xml_cdr_data_t *data)
 {
-	switch_xml_t cdr = NULL;
-	char *xml_text = NULL;
+	switch_safe_free(data->xml_text);
+	switch_safe_free(data->uuid);
+	switch_safe_free(data->logdir);
+	free(data);
+}
+
+/* curl_handle is NULL when called straight from the reporting state handler,
+ * the queue workers pass their own so the connection to the server is reused.
+ * With spool set the CDR goes straight to err-log-dir without a post. */
+static void process_cdr(xml_cdr_data_t *data, switch_CURL *curl_handle, switch_bool_t spool)
+{
+	char *xml_text = data->xml_text;
 	char *path = NULL;
 	char *curl_xml_text = NULL;
-	const char *logdir = NULL;
 	char *xml_text_escaped = NULL;
 	int fd = -1;
 	uint32_t cur_try;
 	long httpRes;
-	switch_CURL *curl_handle = NULL;
+	switch_CURL *own_handle = NULL;
 	switch_curl_slist_t *headers = NULL;
 	switch_curl_slist_t *slist = NULL;
-	switch_channel_t *channel = switch_core_session_get_channel(session);
-	switch_status_t status = SWITCH_STATUS_FALSE;
-	int is_b;
-	const char *a_prefix = "";
+	const char *a_prefix = data->a_prefix;
 	char url_joiner = '?';
-	int prefix_a;
-	const char *prefix_a_var = NULL;
-
-	if (globals.shutdown) {
-		return SWITCH_STATUS_SUCCESS;
-	}
-
-	is_b = channel && switch_channel_get_originator_caller_profile(channel);
-	if (!globals.log_b && is_b) {
-		const char *force_cdr = switch_channel_get_variable(channel, SWITCH_FORCE_PROCESS_CDR_VARIABLE);
-		if (!switch_true(force_cdr)) {
-			return SWITCH_STATUS_SUCCESS;
-		}
-	}
-
-	// channel variable can over-ride global setting "prefix-a-leg"
-	if ((prefix_a_var = switch_channel_get_variable(channel, "prefix-a-leg"))) {
-		prefix_a = switch_true(prefix_a_var);
-	} else {
-		prefix_a = globals.prefix_a;
-	}
-	if (!is_b && prefix_a)
-		a_prefix = "a_";
-
-	if (switch_ivr_generate_xml_cdr(session, &cdr) != SWITCH_STATUS_SUCCESS) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Generating Data!\n");
-		return SWITCH_STATUS_FALSE;
-	}
-
-	/* build the XML */
-	xml_text = switch_xml_toxml(cdr, SWITCH_TRUE);
-	if (!xml_text) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
-		goto error;
-	}
-
-	switch_thread_rwlock_rdlock(globals.log_path_lock);
 
-	if (!(logdir = switch_channel_get_variable(channel, "xml_cdr_base"))) {
-		logdir = globals.log_dir;
-	}
-
-	if (!zstr(logdir) && (globals.log_http_and_disk || !globals.url_count)) {
-		path = switch_mprintf("%s%s%s%s.cdr.xml", logdir, SWITCH_PATH_SEPARATOR, a_prefix, switch_core_session_get_uuid(session));
-		switch_thread_rwlock_unlock(globals.log_path_lock);
+	if (!zstr(data->logdir) && (globals.log_http_and_disk || !globals.url_count)) {
+		path = switch_mprintf("%s%s%s%s.cdr.xml", data->logdir, SWITCH_PATH_SEPARATOR, a_prefix, data->uuid);
 		if (path) {
 #ifdef _MSC_VER
 			if ((fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR)) > -1) {
@@ -263,8 +239,6 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 			}
 			switch_safe_free(path);
 		}
-	} else {
-		switch_thread_rwlock_unlock(globals.log_path_lock);
 	}
 
 	/* try to post it to the web server */
@@ -276,7 +250,14 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 		g_url_index = globals.url_index;
 		switch_mutex_unlock(globals.url_index_mutex);
 
-		curl_handle = switch_curl_easy_init();
+		if (globals.shutdown || spool) {
+			/* don't hold up shutdown or the hanging up channel posting to the server, it goes to err-log-dir below */
+			goto fail;
+		}
+
+		if (!curl_handle) {
+			curl_handle = own_handle = switch_curl_easy_init();
+		}
 
 		if (globals.encode == ENCODING_TEXTXML) {
 			headers = switch_curl_slist_append(headers, "Content-Type: text/xml");
@@ -293,8 +274,8 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 				headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-base64-encoded");
 				switch_b64_encode((unsigned char *) xml_text, need_bytes / 3, (unsigned char *) xml_text_escaped, need_bytes);
 			}
-			switch_safe_free(xml_text);
-			xml_text = xml_text_escaped;
+			switch_safe_free(data->xml_text);
+			data->xml_text = xml_text = xml_text_escaped;
 		} else {
 			headers = switch_curl_slist_append(headers, "Content-Type: application/x-www-form-plaintext");
 		}
@@ -366,7 +347,7 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 			if( strchr(globals.urls[g_url_index], '?') != NULL ) {
 				url_joiner = '&';
 			}
-			destUrl = switch_mprintf("%s%cuuid=%s%s", globals.urls[g_url_index], url_joiner, a_prefix, switch_core_session_get_uuid(session));
+			destUrl = switch_mprintf("%s%cuuid=%s%s", globals.urls[g_url_index], url_joiner, a_prefix, data->uuid);
 			switch_curl_easy_setopt(curl_handle, CURLOPT_URL, destUrl);
 
 			if (!strncasecmp(destUrl, "https", 5)) {
@@ -406,18 +387,17 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 				switch_mutex_unlock(globals.url_index_mutex);
 			}
 		}
-		switch_curl_easy_cleanup(curl_handle);
 		switch_curl_slist_free_all(headers);
 		switch_curl_slist_free_all(slist);
 		slist = NULL;
 		headers = NULL;
-		curl_handle = NULL;
 
 		/* if we are here the web post failed for some reason */
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Unable to post to web server, writing to file\n");
 
+	  fail:
 		switch_thread_rwlock_rdlock(globals.log_path_lock);
-		path = switch_mprintf("%s%s%s%s.cdr.xml", globals.err_log_dir, SWITCH_PATH_SEPARATOR, a_prefix, switch_core_session_get_uuid(session));
+		path = switch_mprintf("%s%s%s%s.cdr.xml", globals.err_log_dir, SWITCH_PATH_SEPARATOR, a_prefix, data->uuid);
 		switch_thread_rwlock_unlock(globals.log_path_lock);
 		if (path) {
 #ifdef _MSC_VER
@@ -438,11 +418,9 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	}
 
   success:
-	status = SWITCH_STATUS_SUCCESS;
-
   error:
-	if (curl_handle) {
-		switch_curl_easy_cleanup(curl_handle);
+	if (own_handle) {
+		switch_curl_easy_cleanup(own_handle);
 	}
 	if (headers) {
 		switch_curl_slist_free_all(headers);
@@ -453,11 +431,101 @@ static switch_status_t my_on_reporting(switch_core_session_t *session)
 	if (curl_xml_text != xml_text) {
 		switch_safe_free(curl_xml_text);
 	}
-	switch_safe_free(xml_text);
 	switch_safe_free(path);
+	destroy_cdr_data(data);
+}
+
+static switch_status_t my_on_reporting(switch_core_session_t *session)
+{
+	switch_xml_t cdr = NULL;
+	char *xml_text = NULL;
+	const char *logdir = NULL;
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	int is_b;
+	const char *a_prefix = "";
+	int prefix_a;
+	const char *prefix_a_var = NULL;
+	xml_cdr_data_t *data;
+
+	if (globals.shutdown) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	is_b = channel && switch_channel_get_originator_caller_profile(channel);
+	if (!globals.log_b && is_b) {
+		const char *force_cdr = switch_channel_get_variable(channel, SWITCH_FORCE_PROCESS_CDR_VARIABLE);
+		if (!switch_true(force_cdr)) {
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+	// channel variable can over-ride global setting "prefix-a-leg"
+	if ((prefix_a_var = switch_channel_get_variable(channel, "prefix-a-leg"))) {
+		prefix_a = switch_true(prefix_a_var);
+	} else {
+		prefix_a = globals.prefix_a;
+	}
+	if (!is_b && prefix_a)
+		a_prefix = "a_";
+
+	if (switch_ivr_generate_xml_cdr(session, &cdr) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error Generating Data!\n");
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* build the XML */
+	xml_text = switch_xml_toxml(cdr, SWITCH_TRUE);
 	switch_xml_free(cdr);
+	if (!xml_text) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Memory Error!\n");
+		return SWITCH_STATUS_FALSE;
+	}
 
-	return status;
+	data = malloc(sizeof(*data));
+	switch_assert(data);
+	data->xml_text = xml_text;
+	data->uuid = strdup(switch_core_session_get_uuid(session));
+	data->a_prefix = a_prefix;
+
+	switch_thread_rwlock_rdlock(globals.log_path_lock);
+
+	if (!(logdir = switch_channel_get_variable(channel, "xml_cdr_base"))) {
+		logdir = globals.log_dir;
+	}
+	data->logdir = switch_safe_strdup(logdir);
+
+	switch_thread_rwlock_unlock(globals.log_path_lock);
+
+	if (globals.queue) {
+		if (switch_queue_trypush(globals.queue, data) != SWITCH_STATUS_SUCCESS) {
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Unable to push cdr to queue, writing it to err-log-dir\n");
+			process_cdr(data, NULL, SWITCH_TRUE);
+		}
+	} else {
+		process_cdr(data, NULL, SWITCH_FALSE);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC cdr_thread(switch_thread_t *t, void *obj)
+{
+	void *pop = NULL;
+	switch_CURL *curl_handle = NULL;
+
+	if (globals.url_count) {
+		curl_handle = switch_curl_easy_init();
+	}
+
+	while (switch_queue_pop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS && pop) {
+		process_cdr((xml_cdr_data_t *) pop, curl_handle, SWITCH_FALSE);
+	}
+
+	if (curl_handle) {
+		switch_curl_easy_cleanup(curl_handle);
+	}
+
+	return NULL;
 }
 
 static void event_handler(switch_event_t *event)
@@ -490,6 +558,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 	char *cf = "xml_cdr.conf";
 	switch_xml_t cfg, xml, settings, param;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	int worker_index;
 
 	/* test global state handlers */
 	switch_core_add_state_handler(&state_handlers);
@@ -509,6 +578,7 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 	globals.disable100continue = 0;
 	globals.pool = pool;
 	globals.auth_scheme = CURLAUTH_BASIC;
+	globals.worker_count = 1;
 
 	switch_thread_rwlock_create(&globals.log_path_lock, pool);
 	switch_mutex_init(&globals.url_index_mutex, SWITCH_MUTEX_NESTED, globals.pool);
@@ -618,6 +688,16 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 				}
 			} else if (!strcasecmp(var, "cookie-file")) {
 				globals.cookie_file = switch_core_strdup(globals.pool, val);
+			} else if (!strcasecmp(var, "queue-capacity") && !zstr(val)) {
+				int capacity = atoi(val);
+				globals.queue_capacity = capacity > 0 ? (uint32_t) capacity : 0;
+			} else if (!strcasecmp(var, "queue-workers") && !zstr(val)) {
+				int workers = atoi(val);
+				if (workers < 1 || workers > MAX_WORKERS) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "queue-workers must be between 1 and %d\n", MAX_WORKERS);
+				} else {
+					globals.worker_count = workers;
+				}
 			}
 		}
 
@@ -640,6 +720,20 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 
 	set_xml_cdr_log_dirs();
 
+	if (globals.queue_capacity) {
+		switch_threadattr_t *thd_attr;
+
+		switch_queue_create(&globals.queue, globals.queue_capacity, globals.pool);
+
+		switch_threadattr_create(&thd_attr, globals.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_thread_create(&globals.workers[worker_index], thd_attr, cdr_thread, NULL, globals.pool);
+		}
+	} else {
+		globals.worker_count = 0;
+	}
+
 	switch_xml_free(xml);
 
 	return status;
@@ -647,9 +741,28 @@ SWITCH_MODULE_LOAD_FUNCTION(mod_xml_cdr_load)
 
 SWITCH_MODULE_SHUTDOWN_FUNCTION(mod_xml_cdr_shutdown)
 {
+	int worker_index;
+	switch_status_t status;
+	void *pop = NULL;
 
 	globals.shutdown = 1;
 
+	if (globals.queue) {
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_queue_push(globals.queue, NULL);
+		}
+		for (worker_index = 0; worker_index < globals.worker_count; worker_index++) {
+			switch_thread_join(&status, globals.workers[worker_index]);
+		}
+
+		/* shutdown is set, so these only get written to disk */
+		while (switch_queue_trypop(globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+			if (pop) {
+				process_cdr((xml_cdr_data_t *) pop, NULL, SWITCH_TRUE);
+			}
+		}
+	}
+
 	switch_safe_free(globals.log_dir);
 	switch_safe_free(globals.err_log_dir);
 
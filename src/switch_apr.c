@@ -454,6 +454,11 @@ SWITCH_DECLARE(switch_status_t) switch_file_remove(const char *path, switch_memo
 	return fspr_file_remove(path, pool);
 }
 
+SWITCH_DECLARE(switch_status_t) switch_file_mtime_set(const char *fname, switch_time_t mtime, switch_memory_pool_t *pool)
+{
+	return fspr_file_mtime_set(fname, mtime, pool);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_file_read(switch_file_t *thefile, void *buf, switch_size_t *nbytes)
 {
 	return fspr_file_read(thefile, buf, nbytes);
@@ -802,6 +807,74 @@ SWITCH_DECLARE(switch_status_t) switch_socket_sendto(switch_socket_t *sock, swit
 	return fspr_socket_sendto(sock, where, flags, buf, len);
 }
 
+#define SWITCH_SOCKET_BATCH_MAX 32
+
+SWITCH_DECLARE(switch_status_t) switch_socket_sendto_batch(switch_socket_t *sock, switch_sockaddr_t *where, int32_t flags, const char * const *bufs,
+														   const switch_size_t *lens, uint32_t count, uint32_t *sent)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	uint32_t i = 0;
+
+	if (!sock || !where || !bufs || !lens) {
+		return SWITCH_STATUS_GENERR;
+	}
+
+#if defined(HAVE_SENDMMSG) && !defined(WIN32)
+	{
+		struct mmsghdr msgs[SWITCH_SOCKET_BATCH_MAX];
+		struct iovec iov[SWITCH_SOCKET_BATCH_MAX];
+		switch_os_socket_t fd = SWITCH_SOCK_INVALID;
+
+		if (fspr_os_sock_get(&fd, sock) != SWITCH_STATUS_SUCCESS || fd == SWITCH_SOCK_INVALID) {
+			return SWITCH_STATUS_GENERR;
+		}
+
+		while (i < count) {
+			uint32_t x, n = count - i > SWITCH_SOCKET_BATCH_MAX ? SWITCH_SOCKET_BATCH_MAX : count - i;
+			int r;
+
+			memset(msgs, 0, sizeof(msgs[0]) * n);
+			for (x = 0; x < n; x++) {
+				iov[x].iov_base = (void *) bufs[i + x];
+				iov[x].iov_len = lens[i + x];
+				msgs[x].msg_hdr.msg_name = &where->sa;
+				msgs[x].msg_hdr.msg_namelen = where->salen;
+				msgs[x].msg_hdr.msg_iov = &iov[x];
+				msgs[x].msg_hdr.msg_iovlen = 1;
+			}
+
+			if ((r = sendmmsg(fd, msgs, n, flags)) > 0) {
+				i += (uint32_t) r;
+			} else if (r < 0 && errno == EINTR) {
+				continue;
+			} else {
+				/* let the regular path deal with a full buffer or report the error, then carry on batching */
+				switch_size_t len = lens[i];
+
+				if ((status = fspr_socket_sendto(sock, where, flags, bufs[i], &len)) != SWITCH_STATUS_SUCCESS) {
+					break;
+				}
+				i++;
+			}
+		}
+	}
+#else
+	for (; i < count; i++) {
+		switch_size_t len = lens[i];
+
+		if ((status = fspr_socket_sendto(sock, where, flags, bufs[i], &len)) != SWITCH_STATUS_SUCCESS) {
+			break;
+		}
+	}
+#endif
+
+	if (sent) {
+		*sent = i;
+	}
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_socket_recv(switch_socket_t *sock, char *buf, switch_size_t *len)
 {
 	int r;
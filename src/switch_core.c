@@ -1897,6 +1897,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_thread_rwlock_create(&runtime.global_var_rwlock, runtime.memory_pool);
 	switch_core_set_globals();
 	switch_core_session_init(runtime.memory_pool);
+	switch_core_file_init(runtime.memory_pool);
 	switch_event_create_plain(&runtime.global_vars, SWITCH_EVENT_CHANNEL_DATA);
 	switch_core_hash_init_case(&runtime.mime_types, SWITCH_FALSE);
 	switch_core_hash_init_case(&runtime.mime_type_exts, SWITCH_FALSE);
@@ -1948,6 +1949,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_init(switch_core_flag_t flags, switc
 	switch_console_init(runtime.memory_pool);
 	switch_event_init(runtime.memory_pool);
 	switch_channel_global_init(runtime.memory_pool);
+	switch_core_regex_init();
 
 	if (switch_xml_init(runtime.memory_pool, err) != SWITCH_STATUS_SUCCESS) {
 		/* allow missing configuration if MINIMAL */
@@ -2056,6 +2058,8 @@ static void switch_load_core_config(const char *file)
 
 	if ((xml = switch_xml_open_cfg(file, &cfg, NULL))) {
 		switch_xml_t settings, param;
+		switch_size_t file_cache_size = 0, file_cache_entry_size = 0;
+		int file_cache = 0;
 
 		if ((settings = switch_xml_child(cfg, "default-ptimes"))) {
 			for (param = switch_xml_child(settings, "codec"); param; param = param->next) {
@@ -2234,6 +2238,9 @@ static void switch_load_core_config(const char *file)
 					switch_time_set_matrix(switch_true(val));
 				} else if (!strcasecmp(var, "max-sessions") && !zstr(val)) {
 					switch_core_session_limit(atoi(val));
+				} else if (!strcasecmp(var, "regex-cache-size") && !zstr(val)) {
+					int size = atoi(val);
+					switch_regex_cache_set_size(size > 0 ? size : 0);
 				} else if (!strcasecmp(var, "verbose-channel-events") && !zstr(val)) {
 					int v = switch_true(val);
 					if (v) {
@@ -2316,6 +2323,13 @@ static void switch_load_core_config(const char *file)
 					switch_rtp_set_start_port((switch_port_t) atoi(val));
 				} else if (!strcasecmp(var, "rtp-end-port") && !zstr(val)) {
 					switch_rtp_set_end_port((switch_port_t) atoi(val));
+				} else if (!strcasecmp(var, "rtp-ice-agent") && !zstr(val)) {
+					switch_rtp_set_ice_agent(switch_true(val) ? SWITCH_TRUE : SWITCH_FALSE);
+				} else if (!strcasecmp(var, "rtp-telemetry-interval") && !zstr(val)) {
+					int tmp = atoi(val);
+					switch_rtp_set_telemetry_interval(tmp > 0 ? (uint32_t) tmp : 0);
+				} else if (!strcasecmp(var, "rtp-dtls-workers") && !zstr(val)) {
+					switch_rtp_set_dtls_workers(!strcasecmp(val, "auto") ? -1 : atoi(val));
 				} else if (!strcasecmp(var, "rtp-port-usage-robustness") && switch_true(val)) {
 					runtime.port_alloc_flags |= SPF_ROBUST_UDP;
 				} else if (!strcasecmp(var, "core-db-name") && !zstr(val)) {
@@ -2378,10 +2392,23 @@ static void switch_load_core_config(const char *file)
 					}
 				} else if (!strcasecmp(var, "max-audio-channels") && !zstr(val)) {
 					switch_core_max_audio_channels(atoi(val));
+				} else if (!strcasecmp(var, "file-cache-size") && !zstr(val)) {
+					int mb = atoi(val);
+					file_cache_size = mb > 0 ? (switch_size_t) mb * 1024 * 1024 : 0;
+					file_cache = 1;
+				} else if (!strcasecmp(var, "file-cache-max-entry-size") && !zstr(val)) {
+					int kb = atoi(val);
+					if (kb > 0) {
+						file_cache_entry_size = (switch_size_t) kb * 1024;
+					}
 				}
 			}
 		}
 
+		if (file_cache) {
+			switch_core_file_cache_set_limit(file_cache_size, file_cache_entry_size);
+		}
+
 		if (runtime.event_channel_key_separator == NULL) {
 			runtime.event_channel_key_separator = switch_core_strdup(runtime.memory_pool, ".");
 		}
@@ -3056,8 +3083,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_destroy(void)
 
 	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Finalizing Shutdown.\n");
 	switch_log_shutdown();
+	switch_core_regex_destroy();
 
 	switch_core_session_uninit();
+	switch_core_file_uninit();
 	switch_core_unset_variables();
 	switch_core_memory_stop();
 
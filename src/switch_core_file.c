@@ -35,6 +35,7 @@
 
 #include <switch.h>
 #include "private/switch_core_pvt.h"
+#include <sys/stat.h>
 
 
 static switch_status_t get_file_size(switch_file_handle_t *fh, const char **string)
@@ -62,6 +63,505 @@ static switch_status_t get_file_size(switch_file_handle_t *fh, const char **stri
 	return status;
 }
 
+/* Decoded prompt cache: whole-file PCM at the rate and channel count a reader asked for,
+   shared by every handle that opens the same unchanged file with the same parameters. */
+
+#define FILE_CACHE_DEFAULT_MAX_ENTRY (4 * 1024 * 1024)
+
+/* mtime alone has one second resolution, a prompt rewritten within the same
+ * second keeps it, so the nanoseconds, the change time and the inode go in the key too */
+#if defined(WIN32)
+#define FILE_CACHE_MTIME_NSEC(st) 0
+#define FILE_CACHE_CTIME_NSEC(st) 0
+#elif defined(__APPLE__)
+#define FILE_CACHE_MTIME_NSEC(st) ((long) (st)->st_mtimespec.tv_nsec)
+#define FILE_CACHE_CTIME_NSEC(st) ((long) (st)->st_ctimespec.tv_nsec)
+#else
+#define FILE_CACHE_MTIME_NSEC(st) ((long) (st)->st_mtim.tv_nsec)
+#define FILE_CACHE_CTIME_NSEC(st) ((long) (st)->st_ctim.tv_nsec)
+#endif
+
+typedef struct file_cache_entry_s {
+	char *key;
+	int16_t *data;
+	switch_size_t samples;
+	switch_size_t bytes;
+	uint32_t rate;
+	uint32_t channels;
+	int refs;
+	int evicted;
+	struct file_cache_entry_s *prev;
+	struct file_cache_entry_s *next;
+} file_cache_entry_t;
+
+typedef struct file_cache_handle_s {
+	file_cache_entry_t *entry;
+	switch_size_t pos;
+	char *key;
+	int16_t *data;
+	switch_size_t samples;
+	switch_size_t alloc;
+} file_cache_handle_t;
+
+static struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *entries;
+	switch_hash_t *pending;
+	int running;
+	uint32_t handles;
+	file_cache_entry_t *head;
+	file_cache_entry_t *tail;
+	switch_size_t bytes;
+	switch_size_t max_bytes;
+	switch_size_t max_entry_bytes;
+	uint32_t count;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t inserts;
+	uint64_t evictions;
+	uint64_t rejects;
+} FILE_CACHE;
+
+static void file_cache_unlink(file_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		FILE_CACHE.head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		FILE_CACHE.tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void file_cache_link(file_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = FILE_CACHE.head;
+
+	if (FILE_CACHE.head) {
+		FILE_CACHE.head->prev = entry;
+	} else {
+		FILE_CACHE.tail = entry;
+	}
+
+	FILE_CACHE.head = entry;
+}
+
+static void file_cache_free(file_cache_entry_t *entry)
+{
+	switch_safe_free(entry->data);
+	switch_safe_free(entry->key);
+	free(entry);
+}
+
+/* called locked; the hashes outlive switch_core_file_uninit() until the last handle lets go */
+static void file_cache_put_handle(void)
+{
+	if (!--FILE_CACHE.handles && !FILE_CACHE.running) {
+		switch_core_hash_destroy(&FILE_CACHE.entries);
+		switch_core_hash_destroy(&FILE_CACHE.pending);
+	}
+}
+
+static void file_cache_unclaim(const char *key)
+{
+	switch_mutex_lock(FILE_CACHE.mutex);
+	switch_core_hash_delete(FILE_CACHE.pending, key);
+	file_cache_put_handle();
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+/* called locked; entries still being played are freed by their last reader */
+static void file_cache_evict(file_cache_entry_t *entry)
+{
+	file_cache_unlink(entry);
+	switch_core_hash_delete(FILE_CACHE.entries, entry->key);
+	FILE_CACHE.bytes -= entry->bytes;
+	FILE_CACHE.count--;
+	FILE_CACHE.evictions++;
+
+	if (entry->refs) {
+		entry->evicted = 1;
+	} else {
+		file_cache_free(entry);
+	}
+}
+
+static char *file_cache_key(switch_file_handle_t *fh, const char *path, uint32_t rate, uint32_t channels)
+{
+	struct stat st;
+
+	if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+
+	return switch_core_sprintf(fh->memory_pool, "%s|%" SWITCH_UINT64_T_FMT "|%" SWITCH_INT64_T_FMT ".%09ld|%" SWITCH_INT64_T_FMT ".%09ld|%" SWITCH_INT64_T_FMT "|%u|%u",
+							   path, (uint64_t) st.st_ino, (int64_t) st.st_mtime, FILE_CACHE_MTIME_NSEC(&st),
+							   (int64_t) st.st_ctime, FILE_CACHE_CTIME_NSEC(&st), (int64_t) st.st_size, rate, channels);
+}
+
+/* Serve the handle from the cache if the prompt is there, otherwise claim the right to record it. */
+static switch_status_t file_cache_attach(switch_file_handle_t *fh, const char *key, switch_bool_t *record)
+{
+	file_cache_entry_t *entry;
+	file_cache_handle_t *cur;
+
+	*record = SWITCH_FALSE;
+
+	if (!FILE_CACHE.mutex) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+
+	if (!FILE_CACHE.running || !FILE_CACHE.max_bytes) {
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (!(entry = switch_core_hash_find(FILE_CACHE.entries, key))) {
+		FILE_CACHE.misses++;
+
+		if (!switch_core_hash_find(FILE_CACHE.pending, key)) {
+			switch_core_hash_insert(FILE_CACHE.pending, key, &FILE_CACHE);
+			FILE_CACHE.handles++;
+			*record = SWITCH_TRUE;
+		}
+
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	entry->refs++;
+	FILE_CACHE.handles++;
+	FILE_CACHE.hits++;
+	file_cache_unlink(entry);
+	file_cache_link(entry);
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	cur = switch_core_alloc(fh->memory_pool, sizeof(*cur));
+	cur->entry = entry;
+
+	if (fh->offset_pos && fh->offset_pos < entry->samples) {
+		cur->pos = fh->offset_pos;
+	}
+
+	fh->offset_pos = 0;
+	fh->pos = cur->pos;
+	fh->cache_info = cur;
+	fh->samples = (unsigned int) entry->samples;
+	fh->samplerate = fh->native_rate = entry->rate;
+	fh->channels = fh->real_channels = entry->channels;
+	fh->seekable = 1;
+	fh->sections = 0;
+	fh->speed = 0;
+	switch_set_flag_locked(fh, SWITCH_FILE_CACHED);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void file_cache_release(switch_file_handle_t *fh)
+{
+	file_cache_handle_t *cur = (file_cache_handle_t *) fh->cache_info;
+
+	if (!cur) {
+		return;
+	}
+
+	fh->cache_info = NULL;
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+
+	if (cur->entry) {
+		if (!--cur->entry->refs && cur->entry->evicted) {
+			file_cache_free(cur->entry);
+		}
+		cur->entry = NULL;
+	} else {
+		switch_core_hash_delete(FILE_CACHE.pending, cur->key);
+		switch_safe_free(cur->data);
+	}
+
+	file_cache_put_handle();
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	switch_clear_flag_locked(fh, SWITCH_FILE_CACHED);
+}
+
+/* Start capturing the output of a freshly opened handle so the first full playback fills the cache. */
+static void file_cache_record_start(switch_file_handle_t *fh, const char *key, uint32_t rate, uint32_t channels)
+{
+	file_cache_handle_t *cur;
+	switch_size_t expect = 0;
+
+	if (fh->native_rate && fh->samples) {
+		expect = (switch_size_t) ((uint64_t) fh->samples * rate / fh->native_rate) + rate;
+	}
+
+	if (switch_test_flag(fh, SWITCH_FILE_NATIVE) || switch_test_flag(fh, SWITCH_FILE_NOMUX) || fh->max_samples ||
+		fh->samplerate != rate || fh->channels != channels || !expect || expect * 2 * channels > FILE_CACHE.max_entry_bytes) {
+		file_cache_unclaim(key);
+		return;
+	}
+
+	cur = switch_core_alloc(fh->memory_pool, sizeof(*cur));
+	cur->key = switch_core_strdup(fh->memory_pool, key);
+	cur->alloc = expect;
+	switch_zmalloc(cur->data, cur->alloc * 2 * channels);
+	fh->cache_info = cur;
+}
+
+static void file_cache_record(switch_file_handle_t *fh, const void *data, switch_size_t len)
+{
+	file_cache_handle_t *cur = (file_cache_handle_t *) fh->cache_info;
+
+	if (cur->samples + len > cur->alloc) {
+		switch_size_t alloc = cur->alloc * 2;
+		void *mem;
+
+		if (alloc * 2 * fh->channels > FILE_CACHE.max_entry_bytes || !(mem = realloc(cur->data, alloc * 2 * fh->channels))) {
+			file_cache_release(fh);
+			return;
+		}
+
+		cur->data = mem;
+		cur->alloc = alloc;
+	}
+
+	memcpy(cur->data + cur->samples * fh->channels, data, len * 2 * fh->channels);
+	cur->samples += len;
+}
+
+static void file_cache_commit(switch_file_handle_t *fh)
+{
+	file_cache_handle_t *cur = (file_cache_handle_t *) fh->cache_info;
+	file_cache_entry_t *entry;
+	switch_size_t bytes = cur->samples * 2 * fh->channels;
+
+	fh->cache_info = NULL;
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	switch_core_hash_delete(FILE_CACHE.pending, cur->key);
+
+	if (!FILE_CACHE.running || !cur->samples || bytes > FILE_CACHE.max_entry_bytes || bytes > FILE_CACHE.max_bytes ||
+		switch_core_hash_find(FILE_CACHE.entries, cur->key)) {
+		FILE_CACHE.rejects++;
+		file_cache_put_handle();
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		switch_safe_free(cur->data);
+		return;
+	}
+
+	while (FILE_CACHE.tail && FILE_CACHE.bytes + bytes > FILE_CACHE.max_bytes) {
+		file_cache_evict(FILE_CACHE.tail);
+	}
+
+	switch_zmalloc(entry, sizeof(*entry));
+	entry->key = strdup(cur->key);
+	entry->data = cur->samples < cur->alloc ? realloc(cur->data, bytes) : cur->data;
+	if (!entry->data) {
+		entry->data = cur->data;
+	}
+	entry->samples = cur->samples;
+	entry->bytes = bytes;
+	entry->rate = fh->samplerate;
+	entry->channels = fh->channels;
+	cur->data = NULL;
+
+	switch_core_hash_insert(FILE_CACHE.entries, entry->key, entry);
+	file_cache_link(entry);
+	FILE_CACHE.bytes += bytes;
+	FILE_CACHE.count++;
+	FILE_CACHE.inserts++;
+	file_cache_put_handle();
+
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+static switch_status_t file_cache_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	file_cache_handle_t *cur = (file_cache_handle_t *) fh->cache_info;
+	file_cache_entry_t *entry = cur->entry;
+	switch_size_t n = entry->samples - cur->pos;
+
+	if (n > *len) {
+		n = *len;
+	}
+
+	if (fh->max_samples > 0) {
+		if (fh->samples_in >= (switch_size_t)fh->max_samples) {
+			n = 0;
+		} else if (fh->samples_in + n > (switch_size_t)fh->max_samples) {
+			n = fh->max_samples - fh->samples_in;
+		}
+	}
+
+	if (!(*len = n)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	/* the caller hands us the buffer to fill, so a hit still costs this one copy per frame,
+	   it is the decode and resample of every playback that the cache saves */
+	memcpy(data, entry->data + cur->pos * entry->channels, n * 2 * entry->channels);
+	cur->pos += n;
+	fh->pos = cur->pos;
+	fh->samples_in += n;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t file_cache_seek(switch_file_handle_t *fh, unsigned int *cur_pos, int64_t samples, int whence)
+{
+	file_cache_handle_t *cur = (file_cache_handle_t *) fh->cache_info;
+	int64_t target;
+
+	switch (whence) {
+	case SEEK_CUR:
+		target = (int64_t) cur->pos + samples;
+		break;
+	case SEEK_END:
+		target = (int64_t) cur->entry->samples + samples;
+		break;
+	default:
+		target = samples;
+		break;
+	}
+
+	if (target < 0) {
+		target = 0;
+	} else if (target > (int64_t) cur->entry->samples) {
+		target = cur->entry->samples;
+	}
+
+	cur->pos = (switch_size_t) target;
+	fh->pos = target;
+	*cur_pos = (unsigned int) target;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static switch_status_t file_seek(switch_file_handle_t *fh, unsigned int *cur_pos, int64_t samples, int whence)
+{
+	if (switch_test_flag(fh, SWITCH_FILE_CACHED)) {
+		return file_cache_seek(fh, cur_pos, samples, whence);
+	}
+
+	return fh->file_interface->file_seek(fh, cur_pos, samples, whence);
+}
+
+void switch_core_file_init(switch_memory_pool_t *pool)
+{
+	memset(&FILE_CACHE, 0, sizeof(FILE_CACHE));
+	switch_mutex_init(&FILE_CACHE.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&FILE_CACHE.entries);
+	switch_core_hash_init(&FILE_CACHE.pending);
+	FILE_CACHE.max_entry_bytes = FILE_CACHE_DEFAULT_MAX_ENTRY;
+	FILE_CACHE.running = 1;
+}
+
+/* Handles still playing from or recording into the cache keep using it after this,
+   so the mutex stays and the hashes go with the last of them. */
+void switch_core_file_uninit(void)
+{
+	if (!FILE_CACHE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+
+	if (FILE_CACHE.running) {
+		FILE_CACHE.running = 0;
+		FILE_CACHE.max_bytes = 0;
+
+		while (FILE_CACHE.tail) {
+			file_cache_evict(FILE_CACHE.tail);
+		}
+
+		if (!FILE_CACHE.handles) {
+			switch_core_hash_destroy(&FILE_CACHE.entries);
+			switch_core_hash_destroy(&FILE_CACHE.pending);
+		}
+	}
+
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+SWITCH_DECLARE(void) switch_core_file_cache_set_limit(switch_size_t max_bytes, switch_size_t max_entry_bytes)
+{
+	if (!FILE_CACHE.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+
+	FILE_CACHE.max_bytes = max_bytes;
+
+	if (max_entry_bytes) {
+		FILE_CACHE.max_entry_bytes = max_entry_bytes;
+	}
+
+	while (FILE_CACHE.tail && FILE_CACHE.bytes > FILE_CACHE.max_bytes) {
+		file_cache_evict(FILE_CACHE.tail);
+	}
+
+	switch_mutex_unlock(FILE_CACHE.mutex);
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_file_cache_flush(void)
+{
+	file_cache_entry_t *entry, *prev;
+	uint32_t dropped = 0;
+
+	if (!FILE_CACHE.mutex) {
+		return 0;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+
+	for (entry = FILE_CACHE.tail; entry; entry = prev) {
+		prev = entry->prev;
+
+		if (!entry->refs) {
+			file_cache_evict(entry);
+			dropped++;
+		}
+	}
+
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	return dropped;
+}
+
+SWITCH_DECLARE(cJSON *) switch_core_file_cache_stats(void)
+{
+	cJSON *json = cJSON_CreateObject();
+
+	if (!FILE_CACHE.mutex) {
+		return json;
+	}
+
+	switch_mutex_lock(FILE_CACHE.mutex);
+	cJSON_AddItemToObject(json, "enabled", cJSON_CreateBool(FILE_CACHE.max_bytes > 0));
+	cJSON_AddItemToObject(json, "entries", cJSON_CreateNumber(FILE_CACHE.count));
+	cJSON_AddItemToObject(json, "bytes", cJSON_CreateNumber((double) FILE_CACHE.bytes));
+	cJSON_AddItemToObject(json, "max_bytes", cJSON_CreateNumber((double) FILE_CACHE.max_bytes));
+	cJSON_AddItemToObject(json, "max_entry_bytes", cJSON_CreateNumber((double) FILE_CACHE.max_entry_bytes));
+	cJSON_AddItemToObject(json, "hits", cJSON_CreateNumber((double) FILE_CACHE.hits));
+	cJSON_AddItemToObject(json, "misses", cJSON_CreateNumber((double) FILE_CACHE.misses));
+	cJSON_AddItemToObject(json, "inserts", cJSON_CreateNumber((double) FILE_CACHE.inserts));
+	cJSON_AddItemToObject(json, "evictions", cJSON_CreateNumber((double) FILE_CACHE.evictions));
+	cJSON_AddItemToObject(json, "rejects", cJSON_CreateNumber((double) FILE_CACHE.rejects));
+	switch_mutex_unlock(FILE_CACHE.mutex);
+
+	return json;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file, const char *func, int line,
 															  switch_file_handle_t *fh,
 															  const char *file_path,
@@ -77,6 +577,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	int to = 0;
 	int force_channels = 0;
 	uint32_t core_channel_limit;
+	char *cache_key = NULL;
+	switch_bool_t cache_record = SWITCH_FALSE;
 
 	if (switch_test_flag(fh, SWITCH_FILE_OPEN)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Handle already open\n");
@@ -84,6 +586,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	}
 
 	fh->samples_in = 0;
+	fh->cache_info = NULL;
 
 	if (!(flags & SWITCH_FILE_FLAG_WRITE)) {
 		fh->samplerate = 0;
@@ -393,6 +896,20 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 
 	file_path = fh->spool_path ? fh->spool_path : fh->file_path;
 
+	if ((flags & SWITCH_FILE_FLAG_READ) && !(flags & SWITCH_FILE_FLAG_WRITE) && !is_stream && !force_channels && rate && channels &&
+		FILE_CACHE.max_bytes && !switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO) && !switch_test_flag(fh, SWITCH_FILE_NATIVE) &&
+		!(fh->params && switch_true(switch_event_get_header(fh->params, "no_cache"))) &&
+		(cache_key = file_cache_key(fh, file_path, rate, channels))) {
+		if (file_cache_attach(fh, cache_key, &cache_record) == SWITCH_STATUS_SUCCESS) {
+			if (to) {
+				fh->max_samples = (fh->samplerate / 1000) * to;
+			}
+
+			switch_set_flag_locked(fh, SWITCH_FILE_OPEN);
+			return SWITCH_STATUS_SUCCESS;
+		}
+	}
+
 	if ((status = fh->file_interface->file_open(fh, file_path)) != SWITCH_STATUS_SUCCESS) {
 		if (fh->spool_path) {
 			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Spool dir is set.  Make sure [%s] is also a valid path\n", fh->spool_path);
@@ -447,7 +964,8 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 		}
 	}
 
-	if (switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO)) {
+	if (switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO) || switch_test_flag(fh, SWITCH_FILE_MAPPED)) {
+		/* mapped files are already in memory, buffering them again only costs a copy */
 		fh->pre_buffer_datalen = 0;
 	}
 
@@ -463,6 +981,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "File has %d channels, muxing to %d channel%s will occur.\n", fh->real_channels, fh->channels, fh->channels == 1 ? "" : "s");
 	}
 
+	if (cache_record) {
+		file_cache_record_start(fh, cache_key, rate, channels);
+	}
+
 	switch_set_flag_locked(fh, SWITCH_FILE_OPEN);
 	return status;
 
@@ -470,6 +992,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 
 	switch_clear_flag_locked(fh, SWITCH_FILE_OPEN);
 
+	if (cache_record) {
+		file_cache_unclaim(cache_key);
+	}
+
 	if (fh->params) {
 		switch_event_destroy(&fh->params);
 	}
@@ -484,18 +1010,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_perform_file_open(const char *file,
 	return status;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+static switch_status_t core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_size_t want, orig_len = *len;
 
-	switch_assert(fh != NULL);
-	switch_assert(fh->file_interface != NULL);
-
-	if (!switch_test_flag(fh, SWITCH_FILE_OPEN)) {
-		return SWITCH_STATUS_FALSE;
-	}
-
   top:
 
 	if (fh->max_samples > 0 && fh->samples_in >= (switch_size_t)fh->max_samples) {
@@ -616,6 +1135,36 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh,
 	return status;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_core_file_read(switch_file_handle_t *fh, void *data, switch_size_t *len)
+{
+	switch_status_t status;
+
+	switch_assert(fh != NULL);
+	switch_assert(fh->file_interface != NULL);
+
+	if (!switch_test_flag(fh, SWITCH_FILE_OPEN)) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	if (switch_test_flag(fh, SWITCH_FILE_CACHED)) {
+		return file_cache_read(fh, data, len);
+	}
+
+	status = core_file_read(fh, data, len);
+
+	if (fh->cache_info) {
+		if (status == SWITCH_STATUS_SUCCESS) {
+			file_cache_record(fh, data, *len);
+		} else if (status == SWITCH_STATUS_FALSE && !*len) {
+			file_cache_commit(fh);
+		} else {
+			file_cache_release(fh);
+		}
+	}
+
+	return status;
+}
+
 SWITCH_DECLARE(switch_bool_t) switch_core_file_has_video(switch_file_handle_t *fh, switch_bool_t check_open)
 {
 	return ((!check_open || switch_test_flag(fh, SWITCH_FILE_OPEN)) && switch_test_flag(fh, SWITCH_FILE_FLAG_VIDEO)) ? SWITCH_TRUE : SWITCH_FALSE;
@@ -783,7 +1332,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 
 	switch_assert(fh != NULL);
 
-	if (!switch_test_flag(fh, SWITCH_FILE_OPEN) || !fh->file_interface->file_seek) {
+	if (!switch_test_flag(fh, SWITCH_FILE_OPEN) || (!fh->file_interface->file_seek && !switch_test_flag(fh, SWITCH_FILE_CACHED))) {
 		ok = 0;
 	} else if (switch_test_flag(fh, SWITCH_FILE_FLAG_WRITE)) {
 		if (!(switch_test_flag(fh, SWITCH_FILE_WRITE_APPEND) || switch_test_flag(fh, SWITCH_FILE_WRITE_OVER))) {
@@ -805,18 +1354,23 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_seek(switch_file_handle_t *fh,
 		switch_buffer_zero(fh->pre_buffer);
 	}
 
+	if (fh->cache_info && !switch_test_flag(fh, SWITCH_FILE_CACHED)) {
+		/* a partial playback is not worth caching */
+		file_cache_release(fh);
+	}
+
 	if (whence == SWITCH_SEEK_CUR) {
 		unsigned int cur = 0;
 
 		if (switch_test_flag(fh, SWITCH_FILE_FLAG_WRITE)) {
-			fh->file_interface->file_seek(fh, &cur, fh->samples_out, SEEK_SET);
+			file_seek(fh, &cur, fh->samples_out, SEEK_SET);
 		} else {
-			fh->file_interface->file_seek(fh, &cur, fh->offset_pos, SEEK_SET);
+			file_seek(fh, &cur, fh->offset_pos, SEEK_SET);
 		}
 	}
 
 	switch_set_flag_locked(fh, SWITCH_FILE_SEEK);
-	status = fh->file_interface->file_seek(fh, cur_pos, samples, whence);
+	status = file_seek(fh, cur_pos, samples, whence);
 
 	fh->offset_pos = *cur_pos;
 
@@ -836,7 +1390,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_set_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_set_string) {
+	if (!fh->file_interface->file_set_string || switch_test_flag(fh, SWITCH_FILE_CACHED)) {
 		return SWITCH_STATUS_FALSE;
 	}
 
@@ -854,7 +1408,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_get_string(switch_file_handle_t
 		return SWITCH_STATUS_FALSE;
 	}
 
-	if (!fh->file_interface->file_get_string) {
+	if (!fh->file_interface->file_get_string || switch_test_flag(fh, SWITCH_FILE_CACHED)) {
 		if (col == SWITCH_AUDIO_COL_STR_FILE_SIZE) {
 			return get_file_size(fh, string);
 		}
@@ -924,7 +1478,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_command(switch_file_handle_t *f
 		break;
 	}
 
-	if (fh->file_interface->file_command) {
+	if (fh->file_interface->file_command && !switch_test_flag(fh, SWITCH_FILE_CACHED)) {
 		switch_mutex_lock(fh->flag_mutex);
 		status = fh->file_interface->file_command(fh, command);
 		switch_mutex_unlock(fh->flag_mutex);
@@ -972,7 +1526,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_pre_close(switch_file_handle_t
 	switch_clear_flag_locked(fh, SWITCH_FILE_OPEN);
 	switch_set_flag_locked(fh, SWITCH_FILE_PRE_CLOSED);
 
-	if (fh->file_interface->file_pre_close) {
+	if (fh->file_interface->file_pre_close && !switch_test_flag(fh, SWITCH_FILE_CACHED)) {
 		status = fh->file_interface->file_pre_close(fh);
 	}
 
@@ -1023,6 +1577,18 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_handle_dup(switch_file_handle_t
 	DUP_CHECK(file_path);
 	DUP_CHECK(handler);
 	DUP_CHECK(spool_path);
+
+	fh->cache_info = NULL;
+	if (switch_test_flag(oldfh, SWITCH_FILE_CACHED)) {
+		file_cache_handle_t *cur = switch_core_alloc(pool, sizeof(*cur));
+
+		memcpy(cur, oldfh->cache_info, sizeof(*cur));
+		switch_mutex_lock(FILE_CACHE.mutex);
+		cur->entry->refs++;
+		FILE_CACHE.handles++;
+		switch_mutex_unlock(FILE_CACHE.mutex);
+		fh->cache_info = cur;
+	}
 	
 	fh->pre_buffer_data = NULL;
 	if (oldfh->pre_buffer_data) {
@@ -1060,7 +1626,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_file_close(switch_file_handle_t *fh)
 
 	switch_clear_flag_locked(fh, SWITCH_FILE_PRE_CLOSED);
 
-	fh->file_interface->file_close(fh);
+	if (!switch_test_flag(fh, SWITCH_FILE_CACHED)) {
+		fh->file_interface->file_close(fh);
+	}
+
+	file_cache_release(fh);
 
 	if (fh->params) {
 		switch_event_destroy(&fh->params);
@@ -372,6 +372,182 @@ SWITCH_DECLARE(void *) switch_core_inthash_find(switch_inthash_t *hash, uint32_t
 }
 
 
+#define CONCURRENT_HASH_DEFAULT_STRIPES 64
+#define CONCURRENT_HASH_MAX_STRIPES 4096
+
+typedef struct concurrent_hash_stripe_s {
+	switch_thread_rwlock_t *rwlock;
+	switch_hash_t *hash;
+} concurrent_hash_stripe_t;
+
+struct switch_concurrent_hash {
+	switch_memory_pool_t *pool;
+	switch_bool_t case_sensitive;
+	uint32_t mask;
+	concurrent_hash_stripe_t *stripes;
+};
+
+static inline concurrent_hash_stripe_t *concurrent_hash_stripe(switch_concurrent_hash_t *hash, const char *key)
+{
+	uint32_t h = hash->case_sensitive ? switch_hash_default((void *)key) : switch_hash_default_ci((void *)key);
+
+	/* the stripe tables index by the low bits of the same hash, so pick the stripe from a remix of it */
+	h = ((h >> 16) ^ h) * 0x45d9f3b;
+	h = (h >> 16) ^ h;
+
+	return &hash->stripes[h & hash->mask];
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_hash_init_concurrent(switch_concurrent_hash_t **hash, uint32_t stripes, switch_bool_t case_sensitive)
+{
+	switch_memory_pool_t *pool = NULL;
+	switch_concurrent_hash_t *new_hash;
+	uint32_t count = 1, i;
+
+	switch_assert(hash != NULL);
+
+	if (!stripes) {
+		stripes = CONCURRENT_HASH_DEFAULT_STRIPES;
+	} else if (stripes > CONCURRENT_HASH_MAX_STRIPES) {
+		stripes = CONCURRENT_HASH_MAX_STRIPES;
+	}
+
+	while (count < stripes) {
+		count <<= 1;
+	}
+
+	if (switch_core_new_memory_pool(&pool) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_STATUS_MEMERR;
+	}
+
+	new_hash = switch_core_alloc(pool, sizeof(*new_hash));
+	new_hash->pool = pool;
+	new_hash->case_sensitive = case_sensitive;
+	new_hash->mask = count - 1;
+	new_hash->stripes = switch_core_alloc(pool, sizeof(concurrent_hash_stripe_t) * count);
+
+	for (i = 0; i < count; i++) {
+		switch_thread_rwlock_create(&new_hash->stripes[i].rwlock, pool);
+		switch_core_hash_init_case(&new_hash->stripes[i].hash, case_sensitive);
+	}
+
+	*hash = new_hash;
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_concurrent_hash_destroy(switch_concurrent_hash_t **hash)
+{
+	switch_memory_pool_t *pool;
+	uint32_t i;
+
+	switch_assert(hash != NULL && *hash != NULL);
+
+	for (i = 0; i <= (*hash)->mask; i++) {
+		switch_core_hash_destroy(&(*hash)->stripes[i].hash);
+	}
+
+	pool = (*hash)->pool;
+	*hash = NULL;
+	switch_core_destroy_memory_pool(&pool);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_core_concurrent_hash_insert(switch_concurrent_hash_t *hash, const char *key, const void *data)
+{
+	concurrent_hash_stripe_t *stripe = concurrent_hash_stripe(hash, key);
+	switch_status_t status;
+
+	switch_thread_rwlock_wrlock(stripe->rwlock);
+	status = switch_core_hash_insert(stripe->hash, key, data);
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return status;
+}
+
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_delete(switch_concurrent_hash_t *hash, const char *key)
+{
+	concurrent_hash_stripe_t *stripe = concurrent_hash_stripe(hash, key);
+	void *val;
+
+	switch_thread_rwlock_wrlock(stripe->rwlock);
+	val = switch_core_hash_delete(stripe->hash, key);
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return val;
+}
+
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_find(switch_concurrent_hash_t *hash, const char *key)
+{
+	concurrent_hash_stripe_t *stripe = concurrent_hash_stripe(hash, key);
+	void *val;
+
+	switch_thread_rwlock_rdlock(stripe->rwlock);
+	val = switch_core_hash_find(stripe->hash, key);
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return val;
+}
+
+SWITCH_DECLARE(void *) switch_core_concurrent_hash_find_callback(switch_concurrent_hash_t *hash, const char *key,
+																 switch_hash_walk_callback_t callback, void *pData)
+{
+	concurrent_hash_stripe_t *stripe = concurrent_hash_stripe(hash, key);
+	void *val;
+
+	switch_thread_rwlock_rdlock(stripe->rwlock);
+	if ((val = switch_core_hash_find(stripe->hash, key)) && callback && !callback(key, val, pData)) {
+		val = NULL;
+	}
+	switch_thread_rwlock_unlock(stripe->rwlock);
+
+	return val;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_concurrent_hash_walk(switch_concurrent_hash_t *hash, switch_hash_walk_callback_t callback, void *pData)
+{
+	switch_hash_index_t *hi;
+	uint32_t i, visited = 0;
+	switch_bool_t keep_going = SWITCH_TRUE;
+
+	for (i = 0; keep_going && i <= hash->mask; i++) {
+		concurrent_hash_stripe_t *stripe = &hash->stripes[i];
+
+		switch_thread_rwlock_rdlock(stripe->rwlock);
+		for (hi = switch_core_hash_first(stripe->hash); hi; hi = switch_core_hash_next(&hi)) {
+			const void *key;
+			void *val;
+
+			switch_core_hash_this(hi, &key, NULL, &val);
+			visited++;
+
+			if (!callback(key, val, pData)) {
+				keep_going = SWITCH_FALSE;
+				free(hi);
+				break;
+			}
+		}
+		switch_thread_rwlock_unlock(stripe->rwlock);
+	}
+
+	return visited;
+}
+
+SWITCH_DECLARE(uint32_t) switch_core_concurrent_hash_count(switch_concurrent_hash_t *hash)
+{
+	uint32_t i, count = 0;
+
+	for (i = 0; i <= hash->mask; i++) {
+		switch_thread_rwlock_rdlock(hash->stripes[i].rwlock);
+		count += switch_hashtable_count(hash->stripes[i].hash);
+		switch_thread_rwlock_unlock(hash->stripes[i].rwlock);
+	}
+
+	return count;
+}
+
+
 /* For Emacs:
  * Local Variables:
  * mode:c
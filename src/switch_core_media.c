@@ -14885,6 +14885,11 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_write_video_frame(switch_cor
 
 	} while(status == SWITCH_STATUS_SUCCESS && encode_status == SWITCH_STATUS_MORE_DATA);
 
+	if (v_engine->rtp_session) {
+		/* a frame that ended without its marker packet must not sit in the send batch until the next one */
+		switch_rtp_flush_send_batch(v_engine->rtp_session);
+	}
+
  done:
 
 	if (smh->write_mutex[SWITCH_MEDIA_TYPE_VIDEO]) {
@@ -15008,6 +15013,47 @@ SWITCH_DECLARE(void) switch_core_session_passthru(switch_core_session_t *session
 
 }
 
+SWITCH_DECLARE(switch_status_t) switch_core_session_relay(switch_core_session_t *session, switch_core_session_t *peer_session,
+														  switch_media_type_t type, switch_bool_t on)
+{
+	switch_rtp_engine_t *engine, *peer_engine;
+
+	if (!session->media_handle) return SWITCH_STATUS_FALSE;
+
+	engine = &session->media_handle->engines[type];
+
+	if (!engine->rtp_session) {
+		return on ? SWITCH_STATUS_FALSE : SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!on) {
+		switch_rtp_relay_stop(engine->rtp_session);
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!peer_session || !peer_session->media_handle || session->bugs || peer_session->bugs ||
+		switch_core_session_transcoding(session, peer_session, type)) {
+		switch_rtp_relay_stop(engine->rtp_session);
+		return SWITCH_STATUS_FALSE;
+	}
+
+	peer_engine = &peer_session->media_handle->engines[type];
+
+	/* refusing leaves the peer's relay towards this session alone, it checks for itself */
+	if (!peer_engine->rtp_session) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	return switch_rtp_relay_start(engine->rtp_session, peer_engine->rtp_session);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_core_session_relaying(switch_core_session_t *session, switch_media_type_t type)
+{
+	if (!session->media_handle) return SWITCH_FALSE;
+
+	return switch_rtp_relaying(session->media_handle->engines[type].rtp_session);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_core_session_read_video_frame(switch_core_session_t *session, switch_frame_t **frame, switch_io_flag_t flags,
 																	 int stream_id)
 {
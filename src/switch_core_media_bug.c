@@ -1001,6 +1001,9 @@ SWITCH_DECLARE(switch_status_t) switch_core_media_bug_add(switch_core_session_t
 	switch_thread_rwlock_unlock(session->bug_rwlock);
 	*new_bug = bug;
 
+	/* the bug has to see the audio both ways, the bridge re-enters the relay once the bugs are gone */
+	switch_core_session_relay(session, NULL, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_FALSE);
+
 	if (tap_only) {
 		switch_set_flag(session, SSF_MEDIA_BUG_TAP_ONLY);
 	} else {
@@ -118,27 +118,35 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_codec_slin(switch_core_s
 }
 
 
+typedef struct {
+	const char *file;
+	const char *func;
+	int line;
+} session_locate_helper_t;
+
+/* Runs under the session table stripe lock, which keeps the session from being destroyed until the read lock is held */
+SWITCH_HASH_WALK_FUNC(session_locate_callback)
+{
+	switch_core_session_t *session = (switch_core_session_t *) val;
+#ifdef SWITCH_DEBUG_RWLOCKS
+	session_locate_helper_t *helper = (session_locate_helper_t *) pData;
+
+	/* Acquire a read lock on the session */
+	return switch_core_session_perform_read_lock(session, helper->file, helper->func, helper->line) == SWITCH_STATUS_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+#else
+	/* Acquire a read lock on the session */
+	return switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+#endif
+}
+
 SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_locate(const char *uuid_str, const char *file, const char *func, int line)
 {
 	switch_core_session_t *session = NULL;
+	session_locate_helper_t helper = { file, func, line };
 
 	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
-			/* Acquire a read lock on the session */
-#ifdef SWITCH_DEBUG_RWLOCKS
-			if (switch_core_session_perform_read_lock(session, file, func, line) != SWITCH_STATUS_SUCCESS) {
-#if EMACS_CC_MODE_IS_BUGGY
-			}
-#endif
-#else
-			if (switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
-#endif
-				/* not available, forget it */
-				session = NULL;
-			}
-		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+		/* not available, forget it */
+		session = switch_core_concurrent_hash_find_callback(session_manager.session_table, uuid_str, session_locate_callback, &helper);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -149,36 +157,41 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_locate(const
 
 
 
-SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_force_locate(const char *uuid_str, const char *file, const char *func, int line)
+SWITCH_HASH_WALK_FUNC(session_force_locate_callback)
 {
-	switch_core_session_t *session = NULL;
+	switch_core_session_t *session = (switch_core_session_t *) val;
 	switch_status_t status;
+#ifdef SWITCH_DEBUG_RWLOCKS
+	session_locate_helper_t *helper = (session_locate_helper_t *) pData;
+#endif
 
-	if (uuid_str) {
-		switch_mutex_lock(runtime.session_hash_mutex);
-		if ((session = switch_core_hash_find(session_manager.session_table, uuid_str))) {
-			/* Acquire a read lock on the session */
+	/* Acquire a read lock on the session */
 
-			if (switch_test_flag(session, SSF_DESTROYED)) {
-				status = SWITCH_STATUS_FALSE;
+	if (switch_test_flag(session, SSF_DESTROYED)) {
+		status = SWITCH_STATUS_FALSE;
 #ifdef SWITCH_DEBUG_RWLOCKS
-				switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, uuid_str, SWITCH_LOG_ERROR, "%s %s Read lock FAIL\n",
-								  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
+		switch_log_printf(SWITCH_CHANNEL_ID_LOG, helper->file, helper->func, helper->line, (const char *) key, SWITCH_LOG_ERROR, "%s %s Read lock FAIL\n",
+						  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
 #endif
-			} else {
-				status = (switch_status_t) switch_thread_rwlock_tryrdlock(session->rwlock);
+	} else {
+		status = (switch_status_t) switch_thread_rwlock_tryrdlock(session->rwlock);
 #ifdef SWITCH_DEBUG_RWLOCKS
-				switch_log_printf(SWITCH_CHANNEL_ID_LOG, file, func, line, uuid_str, SWITCH_LOG_ERROR, "%s %s Read lock ACQUIRED\n",
-								  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
+		switch_log_printf(SWITCH_CHANNEL_ID_LOG, helper->file, helper->func, helper->line, (const char *) key, SWITCH_LOG_ERROR, "%s %s Read lock ACQUIRED\n",
+						  switch_core_session_get_uuid(session), switch_channel_get_name(session->channel));
 #endif
-			}
+	}
 
-			if (status != SWITCH_STATUS_SUCCESS) {
-				/* not available, forget it */
-				session = NULL;
-			}
-		}
-		switch_mutex_unlock(runtime.session_hash_mutex);
+	return status == SWITCH_STATUS_SUCCESS ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+SWITCH_DECLARE(switch_core_session_t *) switch_core_session_perform_force_locate(const char *uuid_str, const char *file, const char *func, int line)
+{
+	switch_core_session_t *session = NULL;
+	session_locate_helper_t helper = { file, func, line };
+
+	if (uuid_str) {
+		/* not available, forget it */
+		session = switch_core_concurrent_hash_find_callback(session_manager.session_table, uuid_str, session_force_locate_callback, &helper);
 	}
 
 	/* if its not NULL, now it's up to you to rwunlock this */
@@ -208,40 +221,71 @@ struct str_node {
 	struct str_node *next;
 };
 
+typedef struct {
+	switch_memory_pool_t *pool;
+	struct str_node *head;
+	switch_console_callback_match_t *matches;
+	const switch_endpoint_interface_t *endpoint_interface;
+	switch_hup_type_t hup_type;
+} session_collect_helper_t;
+
+/* Collect the uuids of the live sessions matching the helper filters, the caller re-locates them after the walk */
+SWITCH_HASH_WALK_FUNC(session_collect_callback)
+{
+	session_collect_helper_t *helper = (session_collect_helper_t *) pData;
+	switch_core_session_t *session = (switch_core_session_t *) val;
+	struct str_node *np;
+
+	if (!session || switch_core_session_read_lock(session) != SWITCH_STATUS_SUCCESS) {
+		return SWITCH_TRUE;
+	}
+
+	if (helper->endpoint_interface && session->endpoint_interface != helper->endpoint_interface) {
+		goto end;
+	}
+
+	if (helper->hup_type) {
+		int ans = switch_channel_test_flag(switch_core_session_get_channel(session), CF_ANSWERED);
+
+		if (!((ans && (helper->hup_type & SHT_ANSWERED)) || (!ans && (helper->hup_type & SHT_UNANSWERED)))) {
+			goto end;
+		}
+	}
+
+	if (helper->pool) {
+		np = switch_core_alloc(helper->pool, sizeof(*np));
+		np->str = switch_core_strdup(helper->pool, session->uuid_str);
+		np->next = helper->head;
+		helper->head = np;
+	} else {
+		switch_console_push_match(&helper->matches, session->uuid_str);
+	}
+
+ end:
+
+	switch_core_session_rwunlock(session);
+
+	return SWITCH_TRUE;
+}
+
 SWITCH_DECLARE(uint32_t) switch_core_session_hupall_matching_vars_ans(switch_event_t *vars, switch_call_cause_t cause, switch_hup_type_t type)
 {
-	switch_hash_index_t *hi;
-	void *val;
 	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	struct str_node *np;
+	session_collect_helper_t helper = { 0 };
 	uint32_t r = 0;
 
-	switch_core_new_memory_pool(&pool);
-
-	if (!vars || !vars->headers)
+	if (!vars || !vars->headers || !type)
 		return r;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(&hi)) {
-		switch_core_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				int ans = switch_channel_test_flag(switch_core_session_get_channel(session), CF_ANSWERED);
-				if ((ans && (type & SHT_ANSWERED)) || (!ans && (type & SHT_UNANSWERED))) {
-					np = switch_core_alloc(pool, sizeof(*np));
-					np->str = switch_core_strdup(pool, session->uuid_str);
-					np->next = head;
-					head = np;
-				}
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	switch_core_new_memory_pool(&pool);
+
+	helper.pool = pool;
+	helper.hup_type = type;
+	switch_core_concurrent_hash_walk(session_manager.session_table, session_collect_callback, &helper);
 
-	for(np = head; np; np = np->next) {
+	for(np = helper.head; np; np = np->next) {
 		if ((session = switch_core_session_locate(np->str))) {
 			const char *this_value;
 			if (switch_channel_up_nosig(session->channel)) {
@@ -288,11 +332,10 @@ SWITCH_DECLARE(uint32_t) switch_core_session_hupall_matching_var_ans(const char
 
 SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall_matching_var(const char *var_name, const char *var_val)
 {
-	switch_hash_index_t *hi;
-	void *val;
 	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	struct str_node *np;
+	session_collect_helper_t helper = { 0 };
 	switch_console_callback_match_t *my_matches = NULL;
 	const char *like = NULL;
 
@@ -302,23 +345,10 @@ SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall_ma
 
 	switch_core_new_memory_pool(&pool);
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(&hi)) {
-		switch_core_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				np = switch_core_alloc(pool, sizeof(*np));
-				np->str = switch_core_strdup(pool, session->uuid_str);
-				np->next = head;
-				head = np;
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	helper.pool = pool;
+	switch_core_concurrent_hash_walk(session_manager.session_table, session_collect_callback, &helper);
 
-	for(np = head; np; np = np->next) {
+	for(np = helper.head; np; np = np->next) {
 		if ((session = switch_core_session_locate(np->str))) {
 			const char *this_val;
 			if (switch_channel_up_nosig(session->channel) &&
@@ -338,33 +368,18 @@ SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall_ma
 
 SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_interface_t *endpoint_interface, switch_call_cause_t cause)
 {
-	switch_hash_index_t *hi;
-	void *val;
 	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	struct str_node *np;
+	session_collect_helper_t helper = { 0 };
 
 	switch_core_new_memory_pool(&pool);
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(&hi)) {
-		switch_core_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				if (session->endpoint_interface == endpoint_interface) {
-					np = switch_core_alloc(pool, sizeof(*np));
-					np->str = switch_core_strdup(pool, session->uuid_str);
-					np->next = head;
-					head = np;
-				}
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	helper.pool = pool;
+	helper.endpoint_interface = endpoint_interface;
+	switch_core_concurrent_hash_walk(session_manager.session_table, session_collect_callback, &helper);
 
-	for(np = head; np; np = np->next) {
+	for(np = helper.head; np; np = np->next) {
 		if ((session = switch_core_session_locate(np->str))) {
 			switch_channel_hangup(session->channel, cause);
 			switch_core_session_rwunlock(session);
@@ -377,32 +392,17 @@ SWITCH_DECLARE(void) switch_core_session_hupall_endpoint(const switch_endpoint_i
 
 SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
 {
-	switch_hash_index_t *hi;
-	void *val;
 	switch_core_session_t *session;
 	switch_memory_pool_t *pool;
-	struct str_node *head = NULL, *np;
+	struct str_node *np;
+	session_collect_helper_t helper = { 0 };
 
 	switch_core_new_memory_pool(&pool);
 
+	helper.pool = pool;
+	switch_core_concurrent_hash_walk(session_manager.session_table, session_collect_callback, &helper);
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(&hi)) {
-		switch_core_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				np = switch_core_alloc(pool, sizeof(*np));
-				np->str = switch_core_strdup(pool, session->uuid_str);
-				np->next = head;
-				head = np;
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
-
-	for(np = head; np; np = np->next) {
+	for(np = helper.head; np; np = np->next) {
 		if ((session = switch_core_session_locate(np->str))) {
 			switch_channel_hangup(session->channel, cause);
 			switch_core_session_rwunlock(session);
@@ -416,25 +416,11 @@ SWITCH_DECLARE(void) switch_core_session_hupall(switch_call_cause_t cause)
 
 SWITCH_DECLARE(switch_console_callback_match_t *) switch_core_session_findall(void)
 {
-	switch_hash_index_t *hi;
-	void *val;
-	switch_core_session_t *session;
-	switch_console_callback_match_t *my_matches = NULL;
+	session_collect_helper_t helper = { 0 };
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	for (hi = switch_core_hash_first(session_manager.session_table); hi; hi = switch_core_hash_next(&hi)) {
-		switch_core_hash_this(hi, NULL, NULL, &val);
-		if (val) {
-			session = (switch_core_session_t *) val;
-			if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-				switch_console_push_match(&my_matches, session->uuid_str);
-				switch_core_session_rwunlock(session);
-			}
-		}
-	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
+	switch_core_concurrent_hash_walk(session_manager.session_table, session_collect_callback, &helper);
 
-	return my_matches;
+	return helper.matches;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_core_session_message_send(const char *uuid_str, switch_core_session_message_t *message)
@@ -442,17 +428,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_message_send(const char *uui
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up_nosig(session->channel)) {
-				status = switch_core_session_receive_message(session, message);
-			}
-			switch_core_session_rwunlock(session);
+	/* Acquire a read lock on the session or forget it the channel is dead */
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up_nosig(session->channel)) {
+			status = switch_core_session_receive_message(session, message);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -462,17 +444,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_event_send(const char *uuid_
 	switch_core_session_t *session = NULL;
 	switch_status_t status = SWITCH_STATUS_FALSE;
 
-	switch_mutex_lock(runtime.session_hash_mutex);
-	if ((session = switch_core_hash_find(session_manager.session_table, uuid_str)) != 0) {
-		/* Acquire a read lock on the session or forget it the channel is dead */
-		if (switch_core_session_read_lock(session) == SWITCH_STATUS_SUCCESS) {
-			if (switch_channel_up_nosig(session->channel)) {
-				status = switch_core_session_queue_event(session, event);
-			}
-			switch_core_session_rwunlock(session);
+	/* Acquire a read lock on the session or forget it the channel is dead */
+	if ((session = switch_core_session_locate(uuid_str))) {
+		if (switch_channel_up_nosig(session->channel)) {
+			status = switch_core_session_queue_event(session, event);
 		}
+		switch_core_session_rwunlock(session);
 	}
-	switch_mutex_unlock(runtime.session_hash_mutex);
 
 	return status;
 }
@@ -1561,9 +1539,9 @@ SWITCH_DECLARE(void) switch_core_session_perform_destroy(switch_core_session_t *
 	switch_scheduler_del_task_group((*session)->uuid_str);
 
 	switch_mutex_lock(runtime.session_hash_mutex);
-	switch_core_hash_delete(session_manager.session_table, (*session)->uuid_str);
+	switch_core_concurrent_hash_delete(session_manager.session_table, (*session)->uuid_str);
 	if ((*session)->external_id) {
-		switch_core_hash_delete(session_manager.session_table, (*session)->external_id);
+		switch_core_concurrent_hash_delete(session_manager.session_table, (*session)->external_id);
 	}
 	if (session_manager.session_count) {
 		session_manager.session_count--;
@@ -2029,7 +2007,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session
 
 
 	switch_mutex_lock(runtime.session_hash_mutex);
-	if (switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (switch_core_concurrent_hash_find(session_manager.session_table, use_uuid)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CRIT, "Duplicate UUID!\n");
 		switch_mutex_unlock(runtime.session_hash_mutex);
 		return SWITCH_STATUS_FALSE;
@@ -2050,9 +2028,10 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_uuid(switch_core_session
 
 	switch_event_create(&event, SWITCH_EVENT_CHANNEL_UUID);
 	switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "Old-Unique-ID", session->uuid_str);
-	switch_core_hash_delete(session_manager.session_table, session->uuid_str);
+	/* insert the new key first so readers that do not hold session_hash_mutex always find the session under one of its names */
+	switch_core_concurrent_hash_insert(session_manager.session_table, use_uuid, session);
+	switch_core_concurrent_hash_delete(session_manager.session_table, session->uuid_str);
 	switch_set_string(session->uuid_str, use_uuid);
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
 	switch_mutex_unlock(runtime.session_hash_mutex);
 	switch_channel_event_set_data(session->channel, event);
 	switch_event_fire(&event);
@@ -2071,7 +2050,7 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_external_id(switch_core_
 
 
 	switch_mutex_lock(runtime.session_hash_mutex);
-	if (strcmp(use_external_id, session->uuid_str) && switch_core_hash_find(session_manager.session_table, use_external_id)) {
+	if (strcmp(use_external_id, session->uuid_str) && switch_core_concurrent_hash_find(session_manager.session_table, use_external_id)) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_WARNING, "Duplicate External ID!\n");
 		switch_mutex_unlock(runtime.session_hash_mutex);
 		return SWITCH_STATUS_FALSE;
@@ -2080,13 +2059,13 @@ SWITCH_DECLARE(switch_status_t) switch_core_session_set_external_id(switch_core_
 	switch_channel_set_variable(session->channel, "session_external_id", use_external_id);
 
 	if (session->external_id && strcmp(session->external_id, session->uuid_str)) {
-		switch_core_hash_delete(session_manager.session_table, session->external_id);
+		switch_core_concurrent_hash_delete(session_manager.session_table, session->external_id);
 	}
 
 	session->external_id = switch_core_session_strdup(session, use_external_id);
 
 	if (strcmp(session->external_id, session->uuid_str)) {
-		switch_core_hash_insert(session_manager.session_table, session->external_id, session);
+		switch_core_concurrent_hash_insert(session_manager.session_table, session->external_id, session);
 	}
 	switch_mutex_unlock(runtime.session_hash_mutex);
 
@@ -2403,7 +2382,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	PROTECT_INTERFACE(endpoint_interface);
 
 	switch_mutex_lock(runtime.session_hash_mutex);
-	if (use_uuid && switch_core_hash_find(session_manager.session_table, use_uuid)) {
+	if (use_uuid && switch_core_concurrent_hash_find(session_manager.session_table, use_uuid)) {
 		switch_mutex_unlock(runtime.session_hash_mutex);
 		UNPROTECT_INTERFACE(endpoint_interface);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Duplicate UUID!\n");
@@ -2497,7 +2476,7 @@ SWITCH_DECLARE(switch_core_session_t *) switch_core_session_request_uuid(switch_
 	switch_queue_create(&session->private_event_queue, SWITCH_EVENT_QUEUE_LEN, session->pool);
 	switch_queue_create(&session->private_event_queue_pri, SWITCH_EVENT_QUEUE_LEN, session->pool);
 
-	switch_core_hash_insert(session_manager.session_table, session->uuid_str, session);
+	switch_core_concurrent_hash_insert(session_manager.session_table, session->uuid_str, session);
 	session->id = session_manager.session_id++;
 	session_manager.session_count++;
 
@@ -2628,7 +2607,7 @@ void switch_core_session_init(switch_memory_pool_t *pool)
 	session_manager.session_limit = 1000;
 	session_manager.session_id = 1;
 	session_manager.memory_pool = pool;
-	switch_core_hash_init(&session_manager.session_table);
+	switch_core_hash_init_concurrent(&session_manager.session_table, 0, SWITCH_TRUE);
 	switch_mutex_init(&session_manager.mutex, SWITCH_MUTEX_DEFAULT, session_manager.memory_pool);
 	switch_thread_cond_create(&session_manager.cond, session_manager.memory_pool);
 	switch_queue_create(&session_manager.thread_queue, 100000, session_manager.memory_pool);
@@ -2641,7 +2620,7 @@ void switch_core_session_uninit(void)
 	if (session_manager.running)
 		switch_thread_cond_timedwait(session_manager.cond, session_manager.mutex, 10000000);
 	switch_mutex_unlock(session_manager.mutex);
-	switch_core_hash_destroy(&session_manager.session_table);
+	switch_core_concurrent_hash_destroy(&session_manager.session_table);
 }
 
 SWITCH_DECLARE(switch_app_log_t *) switch_core_session_get_app_log(switch_core_session_t *session)
@@ -2752,11 +2752,12 @@ static void core_event_handler(switch_event_t *event)
 			const char *syntax = switch_event_get_header_nil(event, "syntax");
 			const char *key = switch_event_get_header_nil(event, "key");
 			const char *filename = switch_event_get_header_nil(event, "filename");
+			const char *load_ms = switch_event_get_header_nil(event, "load_ms");
 			if (!zstr(type) && !zstr(name)) {
 				new_sql() =
 					switch_mprintf
-					("insert into interfaces (type,name,description,syntax,ikey,filename,hostname) values('%q','%q','%q','%q','%q','%q','%q')", type, name,
-					 switch_str_nil(description), switch_str_nil(syntax), switch_str_nil(key), switch_str_nil(filename),
+					("insert into interfaces (type,name,description,syntax,ikey,filename,load_ms,hostname) values('%q','%q','%q','%q','%q','%q',%d,'%q')", type, name,
+					 switch_str_nil(description), switch_str_nil(syntax), switch_str_nil(key), switch_str_nil(filename), atoi(load_ms),
 					 switch_core_get_hostname()
 					 );
 			}
@@ -2952,6 +2953,7 @@ static char create_interfaces_sql[] =
 	"   ikey             VARCHAR(1024),\n"
 	"   filename         VARCHAR(4096),\n"
 	"   syntax           VARCHAR(4096),\n"
+	"   load_ms          INTEGER,\n"
 	"   hostname VARCHAR(256)\n"
 	");\n";
 
@@ -3664,7 +3666,7 @@ switch_status_t switch_core_sqldb_start(switch_memory_pool_t *pool, switch_bool_
 											  "DROP TABLE registrations", tmp);
 				free(tmp);
 			}
-			switch_cache_db_test_reactive(sql_manager.dbh, "select ikey from interfaces", "DROP TABLE interfaces", create_interfaces_sql);
+			switch_cache_db_test_reactive(sql_manager.dbh, "select ikey, load_ms from interfaces", "DROP TABLE interfaces", create_interfaces_sql);
 			switch_cache_db_test_reactive(sql_manager.dbh, "select task_id, task_desc, task_group, task_runtime, task_sql_manager, hostname from tasks",
 										  "DROP TABLE tasks", create_tasks_sql);
 
@@ -381,7 +381,8 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	struct vid_helper th = { 0 };
 	const char *banner_file = NULL;
 	int played_banner = 0, banner_counter = 0;
-	int pass_val = 0, last_pass_val = 0;
+	int pass_val = 0, last_pass_val = 0, media_relay = 0, relay_on = 0;
+	switch_time_t relay_check = 0;
 
 #ifdef SWITCH_VIDEO_IN_THREADS
 	struct vid_helper vh = { 0 };
@@ -504,6 +505,7 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 	}
 
 	bridge_filter_dtmf = switch_true(switch_channel_get_variable(chan_a, "bridge_filter_dtmf"));
+	media_relay = switch_channel_var_true(chan_a, "bridge_media_relay") || switch_channel_var_true(chan_b, "bridge_media_relay");
 
 
 	for (;;) {
@@ -520,6 +522,20 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 			switch_core_session_passthru(session_a, SWITCH_MEDIA_TYPE_AUDIO, pass_val == 2 ? SWITCH_TRUE : SWITCH_FALSE);
 			last_pass_val = pass_val;
 		}
+
+		if (media_relay && switch_micro_time_now() >= relay_check) {
+			/* hand the packets to the relay workers while nothing needs to see them, a media bug
+			   or an RFC2833 digit stops the relay on the spot and it is picked up again here */
+			relay_check = switch_micro_time_now() + 1000000;
+
+			if (pass_val == 2 && !switch_channel_test_flag(chan_a, CF_HOLD) && !switch_channel_test_flag(chan_b, CF_LEG_HOLDING) &&
+				!switch_channel_test_flag(chan_a, CF_BRIDGE_NOWRITE)) {
+				relay_on = switch_core_session_relay(session_a, session_b, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS;
+			} else if (relay_on) {
+				switch_core_session_relay(session_a, NULL, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_FALSE);
+				relay_on = 0;
+			}
+		}
 		
 		if (switch_channel_test_flag(chan_a, CF_TRANSFER)) {
 			data->clean_exit = 1;
@@ -801,6 +817,10 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 		if (SWITCH_READ_ACCEPTABLE(status)) {
 			read_frame_count++;
 			if (switch_test_flag(read_frame, SFF_CNG)) {
+				if (relay_on && switch_core_session_relaying(session_a, SWITCH_MEDIA_TYPE_AUDIO)) {
+					continue;
+				}
+
 				if (silence_val) {
 					switch_generate_sln_silence((int16_t *) silence_frame.data, silence_frame.samples,
 												read_impl.number_of_channels, silence_val);
@@ -829,6 +849,9 @@ static void *audio_bridge_thread(switch_thread_t *thread, void *obj)
 
   end_of_bridge_loop:
 
+	if (relay_on) {
+		switch_core_session_relay(session_a, NULL, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_FALSE);
+	}
 	switch_core_session_passthru(session_a, SWITCH_MEDIA_TYPE_AUDIO, SWITCH_FALSE);
 
 
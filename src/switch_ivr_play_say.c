@@ -1241,6 +1241,376 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_release_file_handle(switch_core_sessi
 #define FILE_BLOCKSIZE 1024 * 8
 #define FILE_BUFSIZE 1024 * 64
 
+/* Pre-encoded prompt store: the first playback of a prompt in a given codec schedules an encode of the
+   whole file into a container that mod_native_file plays back with no encoder in the loop. */
+
+#define NATIVE_PROMPT_CODECS "PCMU,PCMA,G722,opus"
+#define NATIVE_PROMPT_STALE_SEC 300
+#define NATIVE_PROMPT_RETRY_SEC 600
+#define NATIVE_PROMPT_TOUCH_SEC 60
+#define NATIVE_PROMPT_MAX_MB 256
+#define NATIVE_PROMPT_FAIL_EXT "fail"
+
+typedef struct native_prompt_job_s {
+	switch_memory_pool_t *pool;
+	switch_file_t *fd;
+	char *source;
+	char *dir;
+	char *path;
+	char *part;
+	char *fail;
+	switch_size_t max_bytes;
+	char *iananame;
+	char *fmtp;
+	uint32_t samples_per_second;
+	uint32_t actual_samples_per_second;
+	uint32_t microseconds_per_packet;
+	uint32_t samples_per_packet;
+	uint32_t channels;
+} native_prompt_job_t;
+
+/* a container's mtime is its last use, native_prompt_lookup() bumps it on a hit */
+typedef struct native_prompt_entry_s {
+	char *path;
+	time_t last_used;
+	switch_size_t size;
+} native_prompt_entry_t;
+
+static int native_prompt_entry_cmp(const void *a, const void *b)
+{
+	const native_prompt_entry_t *ea = (const native_prompt_entry_t *) a, *eb = (const native_prompt_entry_t *) b;
+
+	return ea->last_used < eb->last_used ? -1 : ea->last_used > eb->last_used;
+}
+
+/* Keeps the store under its size cap by removing the least recently played containers, never the one
+   just written, and drops failure markers whose backoff is over.
+   Players that still have a removed container open keep reading it until they close it. */
+static void native_prompt_evict(native_prompt_job_t *job)
+{
+	switch_dir_t *dir = NULL;
+	native_prompt_entry_t *entries = NULL;
+	switch_size_t total = 0;
+	uint32_t count = 0, alloced = 0, x;
+	char buf[256];
+	const char *name, *ext;
+	time_t now = switch_epoch_time_now(NULL);
+	struct stat st;
+
+	if (!job->max_bytes || switch_dir_open(&dir, job->dir, job->pool) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	while ((name = switch_dir_next_file(dir, buf, sizeof(buf)))) {
+		char *path;
+
+		if (!(ext = strrchr(name, '.'))) {
+			continue;
+		}
+
+		if (!strcasecmp(ext + 1, NATIVE_PROMPT_FAIL_EXT)) {
+			path = switch_core_sprintf(job->pool, "%s%s%s", job->dir, SWITCH_PATH_SEPARATOR, name);
+
+			if (!stat(path, &st) && now - st.st_mtime >= NATIVE_PROMPT_RETRY_SEC) {
+				switch_file_remove(path, job->pool);
+			}
+
+			continue;
+		}
+
+		if (strcasecmp(ext + 1, SWITCH_NATIVE_PROMPT_EXT)) {
+			continue;
+		}
+
+		path = switch_core_sprintf(job->pool, "%s%s%s", job->dir, SWITCH_PATH_SEPARATOR, name);
+
+		if (stat(path, &st) || !S_ISREG(st.st_mode)) {
+			continue;
+		}
+
+		total += (switch_size_t) st.st_size;
+
+		if (!strcmp(path, job->path)) {
+			continue;
+		}
+
+		if (count == alloced) {
+			native_prompt_entry_t *tmp;
+
+			alloced = alloced ? alloced * 2 : 64;
+
+			if (!(tmp = realloc(entries, alloced * sizeof(*entries)))) {
+				break;
+			}
+
+			entries = tmp;
+		}
+
+		entries[count].path = path;
+		entries[count].last_used = st.st_mtime;
+		entries[count].size = (switch_size_t) st.st_size;
+		count++;
+	}
+
+	switch_dir_close(dir);
+
+	if (total > job->max_bytes && count) {
+		qsort(entries, count, sizeof(*entries), native_prompt_entry_cmp);
+
+		for (x = 0; x < count && total > job->max_bytes; x++) {
+			if (switch_file_remove(entries[x].path, job->pool) == SWITCH_STATUS_SUCCESS) {
+				total -= entries[x].size;
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Evicted %s from the prompt store\n", entries[x].path);
+			}
+		}
+	}
+
+	switch_safe_free(entries);
+}
+
+static void *SWITCH_THREAD_FUNC native_prompt_build(switch_thread_t *thread, void *obj)
+{
+	native_prompt_job_t *job = (native_prompt_job_t *) obj;
+	switch_native_prompt_header_t hdr = { { 0 } };
+	switch_codec_t codec = { 0 };
+	switch_file_handle_t fh = { 0 };
+	switch_buffer_t *payload = NULL, *index = NULL;
+	uint8_t enc[SWITCH_RECOMMENDED_BUFFER_SIZE];
+	switch_size_t want = job->samples_per_packet, len;
+	int16_t *pcm = NULL;
+	uint32_t offset = 0;
+	int ok = 0;
+
+	if (switch_core_codec_init(&codec, job->iananame, NULL, job->fmtp, job->samples_per_second, job->microseconds_per_packet / 1000,
+							   job->channels, SWITCH_CODEC_FLAG_ENCODE, NULL, job->pool) != SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot init %s encoder for prompt %s\n", job->iananame, job->source);
+		goto end;
+	}
+
+	if (switch_core_file_open(&fh, job->source, job->channels, job->actual_samples_per_second,
+							  SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, job->pool) != SWITCH_STATUS_SUCCESS) {
+		goto end;
+	}
+
+	switch_zmalloc(pcm, want * 2 * job->channels);
+	switch_buffer_create_dynamic(&payload, FILE_BUFSIZE, FILE_BUFSIZE, 0);
+	switch_buffer_create_dynamic(&index, FILE_BLOCKSIZE, FILE_BLOCKSIZE, 0);
+	switch_buffer_write(index, &offset, sizeof(offset));
+
+	for (;;) {
+		uint32_t enclen = sizeof(enc), rate = job->actual_samples_per_second;
+		unsigned int flag = 0;
+		switch_size_t got = 0;
+
+		/* resampled reads can come back short, so fill a whole packet before encoding */
+		while (got < want) {
+			len = want - got;
+
+			if (switch_core_file_read(&fh, pcm + got * job->channels, &len) != SWITCH_STATUS_SUCCESS || !len) {
+				break;
+			}
+
+			got += len;
+		}
+
+		if (!got) {
+			break;
+		}
+
+		if (got < want) {
+			memset(pcm + got * job->channels, 0, (want - got) * 2 * job->channels);
+		}
+
+		if (switch_core_codec_encode(&codec, NULL, pcm, (uint32_t) (want * 2 * job->channels), job->actual_samples_per_second,
+									 enc, &enclen, &rate, &flag) != SWITCH_STATUS_SUCCESS || !enclen) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Encoding prompt %s to %s failed\n", job->source, job->iananame);
+			goto end;
+		}
+
+		switch_buffer_write(payload, enc, enclen);
+		offset += enclen;
+		switch_buffer_write(index, &offset, sizeof(offset));
+		hdr.frames++;
+
+		if (got < want) {
+			break;
+		}
+	}
+
+	if (hdr.frames) {
+		switch_size_t wlen;
+		const void *ptr;
+
+		memcpy(hdr.magic, SWITCH_NATIVE_PROMPT_MAGIC, sizeof(hdr.magic));
+		hdr.version = SWITCH_NATIVE_PROMPT_VERSION;
+		switch_copy_string(hdr.iananame, job->iananame, sizeof(hdr.iananame));
+		hdr.samples_per_second = job->samples_per_second;
+		hdr.actual_samples_per_second = job->actual_samples_per_second;
+		hdr.microseconds_per_packet = job->microseconds_per_packet;
+		hdr.samples_per_packet = job->samples_per_packet;
+		hdr.channels = job->channels;
+
+		wlen = sizeof(hdr);
+		ok = switch_file_write(job->fd, &hdr, &wlen) == SWITCH_STATUS_SUCCESS;
+
+		if (ok && (wlen = switch_buffer_peek_zerocopy(index, &ptr))) {
+			ok = switch_file_write(job->fd, ptr, &wlen) == SWITCH_STATUS_SUCCESS;
+		}
+
+		if (ok && (wlen = switch_buffer_peek_zerocopy(payload, &ptr))) {
+			ok = switch_file_write(job->fd, ptr, &wlen) == SWITCH_STATUS_SUCCESS;
+		}
+	}
+
+  end:
+
+	switch_file_close(job->fd);
+
+	if (ok && switch_file_rename(job->part, job->path, job->pool) == SWITCH_STATUS_SUCCESS) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Stored %s as %u %s packets in %s\n", job->source, hdr.frames, job->iananame, job->path);
+		switch_file_remove(job->fail, job->pool);
+		native_prompt_evict(job);
+	} else {
+		switch_file_t *fd;
+
+		switch_file_remove(job->part, job->pool);
+
+		/* the marker's mtime holds off the next attempt for NATIVE_PROMPT_RETRY_SEC */
+		if (switch_file_open(&fd, job->fail, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_TRUNCATE | SWITCH_FOPEN_BINARY,
+							 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, job->pool) == SWITCH_STATUS_SUCCESS) {
+			switch_file_close(fd);
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Cannot store %s as %s, not retrying for %d seconds\n",
+						  job->source, job->iananame, NATIVE_PROMPT_RETRY_SEC);
+	}
+
+	if (switch_test_flag((&fh), SWITCH_FILE_OPEN)) {
+		switch_core_file_close(&fh);
+	}
+
+	if (switch_core_codec_ready(&codec)) {
+		switch_core_codec_destroy(&codec);
+	}
+
+	switch_buffer_destroy(&payload);
+	switch_buffer_destroy(&index);
+	switch_safe_free(pcm);
+
+	return NULL;
+}
+
+/* Returns the stored container for this prompt in the session's codec, or schedules its encode and returns NULL. */
+static char *native_prompt_lookup(switch_core_session_t *session, const char *file, const switch_codec_implementation_t *impl)
+{
+	switch_channel_t *channel = switch_core_session_get_channel(session);
+	switch_codec_t *read_codec = switch_core_session_get_read_codec(session);
+	const char *codecs, *dir, *ext, *max_mb;
+	char *key, *path, *part, *fail;
+	time_t now;
+	switch_memory_pool_t *pool;
+	switch_thread_data_t *td;
+	native_prompt_job_t *job;
+	switch_file_t *fd;
+	struct stat st;
+
+	if (!switch_true(switch_channel_get_variable(channel, "native_prompt_store")) || !read_codec || zstr(impl->iananame) ||
+		impl->codec_type != SWITCH_CODEC_TYPE_AUDIO || *file == '{' || strstr(file, SWITCH_URL_SEPARATOR)) {
+		return NULL;
+	}
+
+	if (!(codecs = switch_channel_get_variable(channel, "native_prompt_store_codecs"))) {
+		codecs = NATIVE_PROMPT_CODECS;
+	}
+
+	if (!switch_stristr(impl->iananame, codecs)) {
+		return NULL;
+	}
+
+	if ((ext = strrchr(file, '.')) && (!strcasecmp(ext + 1, impl->iananame) || !strcasecmp(ext + 1, SWITCH_NATIVE_PROMPT_EXT))) {
+		return NULL;
+	}
+
+	if (stat(file, &st) || !S_ISREG(st.st_mode)) {
+		return NULL;
+	}
+
+	key = switch_core_session_sprintf(session, "%s|%" SWITCH_INT64_T_FMT "|%" SWITCH_INT64_T_FMT "|%s|%u|%u|%u|%s", file,
+									  (int64_t) st.st_mtime, (int64_t) st.st_size, impl->iananame, impl->actual_samples_per_second,
+									  impl->microseconds_per_packet, impl->number_of_channels, switch_str_nil(read_codec->fmtp_in));
+
+	if (!(dir = switch_channel_get_variable(channel, "native_prompt_store_dir"))) {
+		dir = switch_core_session_sprintf(session, "%s%snative_prompts", SWITCH_GLOBAL_dirs.cache_dir, SWITCH_PATH_SEPARATOR);
+	}
+
+	path = switch_core_session_sprintf(session, "%s%s%08x%08x.%s", dir, SWITCH_PATH_SEPARATOR,
+									   switch_hashfunc_default(file, NULL), switch_hashfunc_default(key, NULL), SWITCH_NATIVE_PROMPT_EXT);
+
+	now = switch_epoch_time_now(NULL);
+
+	if (!stat(path, &st)) {
+		/* at most one touch a minute per prompt, enough for eviction to tell recent from old */
+		if (now - st.st_mtime >= NATIVE_PROMPT_TOUCH_SEC) {
+			switch_file_mtime_set(path, switch_time_now(), switch_core_session_get_pool(session));
+		}
+
+		return path;
+	}
+
+	fail = switch_core_session_sprintf(session, "%s." NATIVE_PROMPT_FAIL_EXT, path);
+
+	if (!stat(fail, &st) && now - st.st_mtime < NATIVE_PROMPT_RETRY_SEC) {
+		/* the last encode failed, play the original until the backoff is over */
+		return NULL;
+	}
+
+	part = switch_core_session_sprintf(session, "%s.part", path);
+
+	if (!stat(part, &st)) {
+		if (now - st.st_mtime < NATIVE_PROMPT_STALE_SEC) {
+			/* someone else is encoding it */
+			return NULL;
+		}
+
+		switch_file_remove(part, switch_core_session_get_pool(session));
+	}
+
+	switch_core_new_memory_pool(&pool);
+	switch_dir_make_recursive(dir, SWITCH_DEFAULT_DIR_PERMS, pool);
+
+	if (switch_file_open(&fd, part, SWITCH_FOPEN_WRITE | SWITCH_FOPEN_CREATE | SWITCH_FOPEN_EXCL | SWITCH_FOPEN_BINARY,
+						 SWITCH_FPROT_UREAD | SWITCH_FPROT_UWRITE, pool) != SWITCH_STATUS_SUCCESS) {
+		switch_core_destroy_memory_pool(&pool);
+		return NULL;
+	}
+
+	job = switch_core_alloc(pool, sizeof(*job));
+	job->pool = pool;
+	job->fd = fd;
+	job->source = switch_core_strdup(pool, file);
+	job->dir = switch_core_strdup(pool, dir);
+	job->path = switch_core_strdup(pool, path);
+	job->max_bytes = (switch_size_t) ((max_mb = switch_channel_get_variable(channel, "native_prompt_store_max_mb")) ?
+									  switch_atoul(max_mb) : NATIVE_PROMPT_MAX_MB) * 1024 * 1024;
+	job->part = switch_core_strdup(pool, part);
+	job->fail = switch_core_strdup(pool, fail);
+	job->iananame = switch_core_strdup(pool, impl->iananame);
+	job->fmtp = read_codec->fmtp_in ? switch_core_strdup(pool, read_codec->fmtp_in) : NULL;
+	job->samples_per_second = impl->samples_per_second;
+	job->actual_samples_per_second = impl->actual_samples_per_second;
+	job->microseconds_per_packet = impl->microseconds_per_packet;
+	job->samples_per_packet = impl->samples_per_packet;
+	job->channels = impl->number_of_channels;
+
+	td = switch_core_alloc(pool, sizeof(*td));
+	td->func = native_prompt_build;
+	td->obj = job;
+	td->pool = pool;
+	switch_thread_pool_launch_thread(&td);
+
+	return NULL;
+}
+
 SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *session, switch_file_handle_t *fh, const char *file, switch_input_args_t *args)
 {
 	switch_channel_t *channel = switch_core_session_get_channel(session);
@@ -1285,6 +1655,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 	uint32_t test_native = 0, last_native = 0;
 	uint32_t buflen = 0;
 	int flags;
+	char *store_file = NULL;
+	int framed = 0;
 	int cumulative = 0;
 	int last_speed = -1;
 
@@ -1452,6 +1824,8 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 			}
 		}
 
+		store_file = backup_file ? NULL : native_prompt_lookup(session, file, &read_impl);
+
 		if ((prebuf = switch_channel_get_variable(channel, "stream_prebuffer"))) {
 			int maybe = atoi(prebuf);
 			if (maybe > 0) {
@@ -1474,13 +1848,15 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 
 		for(;;) {
 			if (switch_core_file_open(fh,
-									  file,
+									  store_file ? store_file : file,
 									  read_impl.number_of_channels,
 									  read_impl.actual_samples_per_second, flags, NULL) == SWITCH_STATUS_SUCCESS) {
 				break;
 			}
 
-			if (backup_file) {
+			if (store_file) {
+				store_file = NULL;
+			} else if (backup_file) {
 				file = backup_file;
 				backup_file = NULL;
 			} else {
@@ -1582,13 +1958,14 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 		}
 
 		test_native = switch_test_flag(fh, SWITCH_FILE_NATIVE);
+		framed = test_native && switch_test_flag(fh, SWITCH_FILE_NATIVE_FRAMED);
 
 		if (test_native) {
 			write_frame.codec = switch_core_session_get_read_codec(session);
 			samples = read_impl.samples_per_packet;
 			framelen = read_impl.encoded_bytes_per_packet;
 			channels = read_impl.number_of_channels;
-			if (framelen == 0) {
+			if (framelen == 0 && !framed) {
 				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_ERROR, "%s cannot play or record native files with variable length data\n", switch_channel_get_name(channel));
 
 				switch_core_session_io_write_lock(session);
@@ -1665,6 +2042,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 
 		for (;;) {
 			int do_speed = 1;
+			int idle = 0;
 			int f;
 
 			if (!switch_channel_ready(channel)) {
@@ -1740,7 +2118,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 				write_frame.buflen = buflen;
 			}
 
-			if (switch_test_flag(fh, SWITCH_FILE_PAUSE)) {
+			if (framed && switch_test_flag(fh, SWITCH_FILE_PAUSE)) {
+				/* there is no silence pattern for an arbitrary packet format, keep pacing but write nothing */
+				olen = 0;
+				idle = 1;
+				do_speed = 0;
+			} else if (switch_test_flag(fh, SWITCH_FILE_PAUSE)) {
 				if (framelen > FILE_STARTSAMPLES) {
 					framelen = FILE_STARTSAMPLES;
 				}
@@ -1778,6 +2161,26 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 				}
 
 				olen = switch_test_flag(fh, SWITCH_FILE_NATIVE) ? framelen : ilen;
+			} else if (framed) {
+				switch_status_t rstatus;
+
+				if (eof) {
+					break;
+				}
+
+				/* one stored packet per read, written as is */
+				olen = FILE_STARTSAMPLES;
+
+				if ((rstatus = switch_core_file_read(fh, abuf, &olen)) == SWITCH_STATUS_BREAK) {
+					continue;
+				}
+
+				if (rstatus != SWITCH_STATUS_SUCCESS || !olen) {
+					eof++;
+					continue;
+				}
+
+				fh->offset_pos += samples;
 			} else {
 				switch_status_t rstatus;
 
@@ -1829,7 +2232,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 
 			}
 
-			if (done || olen <= 0) {
+			if (done || (olen <= 0 && !idle)) {
 				break;
 			}
 
@@ -1894,7 +2297,7 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 				continue;
 			}
 
-			if (olen < llen) {
+			if (olen < llen && !framed) {
 				uint8_t *dp = (uint8_t *) write_frame.data;
 				memset(dp + (int) olen, 255, (int) (llen - olen));
 				olen = llen;
@@ -1942,7 +2345,12 @@ SWITCH_DECLARE(switch_status_t) switch_ivr_play_file(switch_core_session_t *sess
 			}
 
 			more_data = 0;
-			write_frame.samples = (uint32_t) olen;
+
+			if (idle) {
+				continue;
+			}
+
+			write_frame.samples = framed ? samples : (uint32_t) olen;
 
 			if (switch_test_flag(fh, SWITCH_FILE_NATIVE)) {
 				write_frame.datalen = (uint32_t) olen;
@@ -76,8 +76,32 @@ struct switch_loadable_module {
 	switch_thread_t *thread;
 	switch_bool_t shutting_down;
 	switch_loadable_module_type_t type;
+	switch_time_t load_time;
 };
 
+/* one <load> line of modules.conf, scheduled by switch_loadable_module_load_parallel() */
+typedef struct switch_module_load_entry_s {
+	const char *module;
+	const char *path;
+	switch_bool_t global;
+	switch_bool_t critical;
+	int phase;
+	char *deps[32];
+	int ndeps;
+	int state;
+	switch_status_t status;
+} switch_module_load_entry_t;
+
+typedef struct switch_module_timeline_s {
+	const char *module;
+	switch_loadable_module_type_t type;
+	int phase;
+	switch_time_t start;
+	switch_time_t end;
+	switch_status_t status;
+	struct switch_module_timeline_s *next;
+} switch_module_timeline_t;
+
 struct switch_loadable_module_container {
 	switch_hash_t *module_hash;
 	switch_hash_t *endpoint_hash;
@@ -101,6 +125,11 @@ struct switch_loadable_module_container {
 	switch_mutex_t *mutex;
 	switch_thread_rwlock_t *chat_rwlock;
 	switch_memory_pool_t *pool;
+	switch_time_t init_start;
+	switch_time_t init_end;
+	int load_threads;
+	switch_module_timeline_t *timeline;
+	switch_module_timeline_t *timeline_tail;
 };
 
 static struct switch_loadable_module_container loadable_modules;
@@ -153,6 +182,12 @@ static void switch_loadable_module_runtime(void)
 	switch_mutex_unlock(loadable_modules.mutex);
 }
 
+/* every MODULE_LOAD event carries how long the module's load function took, in whole ms */
+static void switch_loadable_module_add_load_ms(switch_event_t *event, switch_loadable_module_t *module)
+{
+	switch_event_add_header(event, SWITCH_STACK_BOTTOM, "load_ms", "%d", (int) (module->load_time / 1000));
+}
+
 static switch_status_t switch_loadable_module_process(char *key, switch_loadable_module_t *new_module, switch_hash_t *event_hash)
 {
 	switch_event_t *event;
@@ -176,6 +211,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 					
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -247,6 +283,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+						switch_loadable_module_add_load_ms(event, new_module);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "module", new_module->module_interface->module_name);
 
 						if (!event_hash) {
@@ -276,6 +313,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -304,6 +342,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -334,6 +373,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "syntax", switch_str_nil(ptr->syntax));
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -364,6 +404,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "syntax", switch_str_nil(ptr->syntax));
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -394,6 +435,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "syntax", switch_str_nil(ptr->syntax));
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -424,6 +466,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "syntax", switch_str_nil(ptr->syntax));
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -458,6 +501,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->extens[i]);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+						switch_loadable_module_add_load_ms(event, new_module);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "module", new_module->module_interface->module_name);
 
 						if (!event_hash) {
@@ -503,6 +547,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->prefixes[i]);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+						switch_loadable_module_add_load_ms(event, new_module);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "module", new_module->module_interface->module_name);
 
 						if (!event_hash) {
@@ -540,6 +585,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -568,6 +614,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -596,6 +643,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -624,6 +672,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -654,6 +703,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 					switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+					switch_loadable_module_add_load_ms(event, new_module);
 
 					if (!event_hash) {
 						switch_event_fire(&event);
@@ -688,6 +738,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->relative_oid);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+						switch_loadable_module_add_load_ms(event, new_module);
 
 						if (!event_hash) {
 							switch_event_fire(&event);
@@ -722,6 +773,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", ptr->interface_name);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 						switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+						switch_loadable_module_add_load_ms(event, new_module);
 
 						if (!event_hash) {
 							switch_event_fire(&event);
@@ -744,6 +796,7 @@ static switch_status_t switch_loadable_module_process(char *key, switch_loadable
 			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "name", new_module->key);
 			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "key", new_module->key);
 			switch_event_add_header_string(event, SWITCH_STACK_BOTTOM, "filename", new_module->filename);
+			switch_loadable_module_add_load_ms(event, new_module);
 
 			if (!event_hash) {
 				switch_event_fire(&event);
@@ -1788,6 +1841,7 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 	char *file, *dot;
 	switch_loadable_module_t *new_module = NULL;
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	switch_time_t start;
 
 #ifdef WIN32
 	const char *ext = ".dll";
@@ -1797,7 +1851,10 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 
 	*err = "";
 
+	/* modules.conf may be loaded from several threads, see switch_loadable_module_load_parallel() */
+	switch_mutex_lock(loadable_modules.mutex);
 	if ((file = switch_core_strdup(loadable_modules.pool, fname)) == 0) {
+		switch_mutex_unlock(loadable_modules.mutex);
 		*err = "allocation error";
 		return SWITCH_STATUS_FALSE;
 	}
@@ -1818,7 +1875,9 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 		path = (char *) switch_core_alloc(loadable_modules.pool, len);
 		switch_snprintf(path, len, "%s%s%s%s", switch_str_nil(dir), SWITCH_PATH_SEPARATOR, file, ext);
 	}
+	switch_mutex_unlock(loadable_modules.mutex);
 
+	start = switch_time_now();
 
 	if (switch_core_hash_find_locked(loadable_modules.module_hash, file, loadable_modules.mutex)) {
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Module %s Already Loaded!\n", file);
@@ -1826,6 +1885,7 @@ static switch_status_t switch_loadable_module_load_module_ex(const char *dir, co
 		status = SWITCH_STATUS_FALSE;
 	} else if ((status = switch_loadable_module_load_file(path, file, global, &new_module)) == SWITCH_STATUS_SUCCESS) {
 		new_module->type = type;
+		new_module->load_time = switch_time_now() - start;
 
 		if ((status = switch_loadable_module_process(file, new_module, event_hash)) == SWITCH_STATUS_SUCCESS && runtime) {
 			if (new_module->switch_module_runtime) {
@@ -2061,6 +2121,239 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_build_dynamic(char *filen
 	return switch_loadable_module_process((char *) module->filename, module, NULL);
 }
 
+static void switch_loadable_module_timeline_add(const char *module, switch_loadable_module_type_t type, int phase,
+												  switch_time_t start, switch_time_t end, switch_status_t status)
+{
+	switch_module_timeline_t *tl;
+
+	switch_mutex_lock(loadable_modules.mutex);
+	tl = switch_core_alloc(loadable_modules.pool, sizeof(*tl));
+	tl->module = switch_core_strdup(loadable_modules.pool, module);
+	tl->type = type;
+	tl->phase = phase;
+	tl->start = start;
+	tl->end = end;
+	tl->status = status;
+
+	if (loadable_modules.timeline_tail) {
+		loadable_modules.timeline_tail->next = tl;
+	} else {
+		loadable_modules.timeline = tl;
+	}
+	loadable_modules.timeline_tail = tl;
+	switch_mutex_unlock(loadable_modules.mutex);
+}
+
+static switch_status_t switch_loadable_module_load_timed(const char *dir, const char *fname, switch_bool_t global, const char **err,
+														 switch_loadable_module_type_t type, switch_hash_t *event_hash, int phase)
+{
+	switch_time_t start = switch_time_now();
+	switch_status_t status;
+
+	status = switch_loadable_module_load_module_ex(dir, fname, SWITCH_FALSE, global, err, type, event_hash);
+	switch_loadable_module_timeline_add(fname, type, phase, start, switch_time_now(), status);
+
+	return status;
+}
+
+SWITCH_DECLARE(cJSON *) switch_loadable_module_load_timeline(void)
+{
+	cJSON *json = cJSON_CreateObject(), *modules = cJSON_CreateArray();
+	switch_module_timeline_t *tl;
+
+	switch_mutex_lock(loadable_modules.mutex);
+	cJSON_AddItemToObject(json, "load_threads", cJSON_CreateNumber(loadable_modules.load_threads));
+	cJSON_AddItemToObject(json, "total_us", cJSON_CreateNumber((double) (loadable_modules.init_end - loadable_modules.init_start)));
+
+	for (tl = loadable_modules.timeline; tl; tl = tl->next) {
+		cJSON *item = cJSON_CreateObject();
+		const char *type = tl->type == SWITCH_LOADABLE_MODULE_TYPE_PRELOAD ? "preload" :
+			tl->type == SWITCH_LOADABLE_MODULE_TYPE_POSTLOAD ? "postload" : "common";
+		const char *status = tl->status == SWITCH_STATUS_SUCCESS ? "loaded" : tl->status == SWITCH_STATUS_FALSE ? "skipped" : "failed";
+
+		cJSON_AddItemToObject(item, "module", cJSON_CreateString(tl->module));
+		cJSON_AddItemToObject(item, "type", cJSON_CreateString(type));
+		cJSON_AddItemToObject(item, "phase", cJSON_CreateNumber(tl->phase));
+		cJSON_AddItemToObject(item, "start_us", cJSON_CreateNumber((double) (tl->start - loadable_modules.init_start)));
+		cJSON_AddItemToObject(item, "duration_us", cJSON_CreateNumber((double) (tl->end - tl->start)));
+		cJSON_AddItemToObject(item, "status", cJSON_CreateString(status));
+		cJSON_AddItemToArray(modules, item);
+	}
+	switch_mutex_unlock(loadable_modules.mutex);
+
+	cJSON_AddItemToObject(json, "modules", modules);
+
+	return json;
+}
+
+#define MODULE_LOAD_PENDING 0
+#define MODULE_LOAD_RUNNING 1
+#define MODULE_LOAD_DONE 2
+
+typedef struct {
+	switch_module_load_entry_t *entries;
+	int count;
+	int done;
+	int running;
+	switch_mutex_t *mutex;
+	switch_thread_cond_t *cond;
+} switch_module_load_queue_t;
+
+/* mod_sofia matches mod_sofia.so */
+static switch_bool_t module_name_eq(const char *a, const char *b)
+{
+	size_t alen = strcspn(a, "."), blen = strcspn(b, ".");
+
+	return (alen == blen && !strncasecmp(a, b, alen)) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static switch_module_load_entry_t *switch_module_load_find(switch_module_load_entry_t *entries, int count, const char *name)
+{
+	int i;
+
+	for (i = 0; i < count; i++) {
+		if (module_name_eq(entries[i].module, name)) {
+			return &entries[i];
+		}
+	}
+
+	return NULL;
+}
+
+static void switch_module_load_critical(switch_module_load_entry_t *entry, switch_status_t status)
+{
+	if (status == SWITCH_STATUS_GENERR && entry->critical) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", entry->module);
+		abort();
+	}
+}
+
+static void *SWITCH_THREAD_FUNC switch_loadable_module_load_worker(switch_thread_t *thread, void *obj)
+{
+	switch_module_load_queue_t *q = (switch_module_load_queue_t *) obj;
+
+	switch_mutex_lock(q->mutex);
+	while (q->done < q->count) {
+		switch_module_load_entry_t *entry = NULL;
+		const char *err = NULL;
+		int i, j, phase = INT_MAX;
+
+		/* a phase starts once everything in the previous one is done */
+		for (i = 0; i < q->count; i++) {
+			if (q->entries[i].state != MODULE_LOAD_DONE && q->entries[i].phase < phase) {
+				phase = q->entries[i].phase;
+			}
+		}
+
+		for (i = 0; i < q->count && !entry; i++) {
+			switch_module_load_entry_t *e = &q->entries[i];
+
+			if (e->state != MODULE_LOAD_PENDING || e->phase != phase) {
+				continue;
+			}
+
+			entry = e;
+			for (j = 0; j < e->ndeps; j++) {
+				switch_module_load_entry_t *dep = switch_module_load_find(q->entries, q->count, e->deps[j]);
+				if (dep && dep->state != MODULE_LOAD_DONE) {
+					entry = NULL;
+					break;
+				}
+			}
+		}
+
+		if (!entry) {
+			if (q->running) {
+				switch_thread_cond_wait(q->cond, q->mutex);
+				continue;
+			}
+
+			/* nothing runs and nothing is ready: the depends of this phase loop on each other */
+			for (i = 0; i < q->count; i++) {
+				if (q->entries[i].state == MODULE_LOAD_PENDING && q->entries[i].phase == phase) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Dependency loop in phase %d, loading %s regardless of its depends\n",
+									  phase, q->entries[i].module);
+					q->entries[i].ndeps = 0;
+					break;
+				}
+			}
+			continue;
+		}
+
+		entry->state = MODULE_LOAD_RUNNING;
+		q->running++;
+		switch_mutex_unlock(q->mutex);
+
+		entry->status = switch_loadable_module_load_timed(entry->path, entry->module, entry->global, &err,
+														  SWITCH_LOADABLE_MODULE_TYPE_COMMON, NULL, entry->phase);
+		switch_module_load_critical(entry, entry->status);
+
+		switch_mutex_lock(q->mutex);
+		entry->state = MODULE_LOAD_DONE;
+		q->running--;
+		q->done++;
+		switch_thread_cond_broadcast(q->cond);
+	}
+	switch_mutex_unlock(q->mutex);
+
+	return NULL;
+}
+
+/* Loads modules.conf on a pool of threads.  Phases load one after the
+ * other, inside a phase everything loads at once except what waits for
+ * its depends.
+ */
+static void switch_loadable_module_load_parallel(switch_module_load_entry_t *entries, int count, int threads)
+{
+	switch_module_load_queue_t q = { 0 };
+	switch_thread_t **thread;
+	switch_threadattr_t *thd_attr = NULL;
+	switch_status_t st;
+	int i, j;
+
+	for (i = 0; i < count; i++) {
+		switch_module_load_entry_t *e = &entries[i];
+
+		for (j = 0; j < e->ndeps; j++) {
+			switch_module_load_entry_t *dep = switch_module_load_find(entries, count, e->deps[j]);
+
+			if (!dep) {
+				if (switch_loadable_module_exists(e->deps[j]) != SWITCH_STATUS_SUCCESS) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s depends on %s which is not in modules.conf\n", e->module, e->deps[j]);
+				}
+			} else if (dep->phase > e->phase) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "%s (phase %d) depends on %s from the later phase %d, ignored\n",
+								  e->module, e->phase, dep->module, dep->phase);
+				e->deps[j] = e->deps[--e->ndeps];
+				j--;
+			}
+		}
+	}
+
+	if (threads > count) {
+		threads = count;
+	}
+
+	q.entries = entries;
+	q.count = count;
+	switch_mutex_init(&q.mutex, SWITCH_MUTEX_NESTED, loadable_modules.pool);
+	switch_thread_cond_create(&q.cond, loadable_modules.pool);
+
+	thread = switch_core_alloc(loadable_modules.pool, sizeof(*thread) * threads);
+	switch_threadattr_create(&thd_attr, loadable_modules.pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Loading %d modules on %d threads\n", count, threads);
+
+	for (i = 0; i < threads; i++) {
+		switch_thread_create(&thread[i], thd_attr, switch_loadable_module_load_worker, &q, loadable_modules.pool);
+	}
+
+	for (i = 0; i < threads; i++) {
+		switch_thread_join(&st, thread[i]);
+	}
+}
+
 #ifdef WIN32
 static void switch_loadable_module_path_init()
 {
@@ -2109,6 +2402,8 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 
 	memset(&loadable_modules, 0, sizeof(loadable_modules));
 	switch_core_new_memory_pool(&loadable_modules.pool);
+	loadable_modules.init_start = switch_time_now();
+	loadable_modules.load_threads = 1;
 
 
 #ifdef WIN32
@@ -2151,9 +2446,9 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 		Do not pre-load modules which may use databases,
 		use appropriate section.
 	*/
-	switch_loadable_module_load_module_ex("", "CORE_SOFTTIMER_MODULE", SWITCH_FALSE, SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash);
-	switch_loadable_module_load_module_ex("", "CORE_PCM_MODULE", SWITCH_FALSE, SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash);
-	switch_loadable_module_load_module_ex("", "CORE_SPEEX_MODULE", SWITCH_FALSE, SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash);
+	switch_loadable_module_load_timed("", "CORE_SOFTTIMER_MODULE", SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash, 0);
+	switch_loadable_module_load_timed("", "CORE_PCM_MODULE", SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash, 0);
+	switch_loadable_module_load_timed("", "CORE_SPEEX_MODULE", SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, event_hash, 0);
 
 	/*
 		Loading pre-load modules.
@@ -2178,7 +2473,7 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 				if (path && zstr(path)) {
 					path = SWITCH_GLOBAL_dirs.mod_dir;
 				}
-				if (switch_loadable_module_load_module_ex((char *)path, (char *)val, SWITCH_FALSE, global, &err, SWITCH_LOADABLE_MODULE_TYPE_PRELOAD, event_hash) == SWITCH_STATUS_GENERR) {
+				if (switch_loadable_module_load_timed(path, val, global, &err, SWITCH_LOADABLE_MODULE_TYPE_PRELOAD, event_hash, 0) == SWITCH_STATUS_GENERR) {
 					if (critical && switch_true(critical)) {
 						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", val);
 						switch_core_hash_destroy(&event_hash);
@@ -2227,29 +2522,62 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 	if ((xml = switch_xml_open_cfg(cf, &cfg, NULL))) {
 		switch_xml_t mods, ld;
 		if ((mods = switch_xml_child(cfg, "modules"))) {
+			switch_module_load_entry_t *entries;
+			const char *threads = switch_xml_attr(mods, "load-threads");
+			int n = 0, i;
+
 			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
-				switch_bool_t global = SWITCH_FALSE;
+				n++;
+			}
+			entries = switch_core_alloc(loadable_modules.pool, sizeof(*entries) * (n ? n : 1));
+			n = 0;
+
+			if (threads && (i = atoi(threads)) > 1) {
+				loadable_modules.load_threads = i > 64 ? 64 : i;
+			}
+
+			for (ld = switch_xml_child(mods, "load"); ld; ld = ld->next) {
+				switch_module_load_entry_t *entry = &entries[n];
 				const char *val = switch_xml_attr_soft(ld, "module");
 				const char *path = switch_xml_attr_soft(ld, "path");
-				const char *critical = switch_xml_attr_soft(ld, "critical");
-				const char *sglobal = switch_xml_attr_soft(ld, "global");
+				const char *depends = switch_xml_attr(ld, "depends");
+				const char *phase = switch_xml_attr(ld, "phase");
 				if (zstr(val) || (strchr(val, '.') && !strstr(val, ext) && !strstr(val, EXT))) {
 					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Invalid extension for %s\n", val);
 					continue;
 				}
-				global = switch_true(sglobal);
 
 				if (path && zstr(path)) {
 					path = SWITCH_GLOBAL_dirs.mod_dir;
 				}
-				if (switch_loadable_module_load_module_ex(path, val, SWITCH_FALSE, global, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, NULL) == SWITCH_STATUS_GENERR) {
-					if (critical && switch_true(critical)) {
-						switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CRIT, "Failed to load critical module '%s', abort()\n", val);
-						abort();
-					}
+
+				if (switch_module_load_find(entries, n, val)) {
+					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "Module %s is listed twice in %s\n", val, cf);
+					continue;
+				}
+
+				entry->module = val;
+				entry->path = path;
+				entry->global = switch_true(switch_xml_attr_soft(ld, "global"));
+				entry->critical = switch_true(switch_xml_attr_soft(ld, "critical"));
+				entry->phase = phase ? atoi(phase) : 0;
+				if (!zstr(depends)) {
+					entry->ndeps = switch_separate_string(switch_core_strdup(loadable_modules.pool, depends), ',', entry->deps,
+														  (sizeof(entry->deps) / sizeof(entry->deps[0])));
 				}
+				n++;
 				count++;
 			}
+
+			if (loadable_modules.load_threads > 1 && n > 1) {
+				switch_loadable_module_load_parallel(entries, n, loadable_modules.load_threads);
+			} else {
+				for (i = 0; i < n; i++) {
+					switch_status_t status = switch_loadable_module_load_timed(entries[i].path, entries[i].module, entries[i].global, &err,
+																			   SWITCH_LOADABLE_MODULE_TYPE_COMMON, NULL, entries[i].phase);
+					switch_module_load_critical(&entries[i], status);
+				}
+			}
 		}
 		switch_xml_free(xml);
 
@@ -2275,7 +2603,7 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 				if (path && zstr(path)) {
 					path = SWITCH_GLOBAL_dirs.mod_dir;
 				}
-				switch_loadable_module_load_module_ex(path, val, SWITCH_FALSE, global, &err, SWITCH_LOADABLE_MODULE_TYPE_POSTLOAD, NULL);
+				switch_loadable_module_load_timed(path, val, global, &err, SWITCH_LOADABLE_MODULE_TYPE_POSTLOAD, NULL, 0);
 				count++;
 			}
 		}
@@ -2315,11 +2643,15 @@ SWITCH_DECLARE(switch_status_t) switch_loadable_module_init(switch_bool_t autolo
 				continue;
 			}
 
-			switch_loadable_module_load_module(SWITCH_GLOBAL_dirs.mod_dir, fname, SWITCH_FALSE, &err);
+			switch_loadable_module_load_timed(SWITCH_GLOBAL_dirs.mod_dir, fname, SWITCH_FALSE, &err, SWITCH_LOADABLE_MODULE_TYPE_COMMON, NULL, 0);
 		}
 		fspr_dir_close(module_dir_handle);
 	}
 
+	loadable_modules.init_end = switch_time_now();
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Modules loaded in %" SWITCH_TIME_T_FMT " ms\n",
+					  (loadable_modules.init_end - loadable_modules.init_start) / 1000);
+
 	switch_loadable_module_runtime();
 
 	memset(&chat_globals, 0, sizeof(chat_globals));
@@ -59,9 +59,11 @@ static switch_memory_pool_t *LOG_POOL = NULL;
 static switch_log_binding_t *BINDINGS = NULL;
 static switch_mutex_t *BINDLOCK = NULL;
 static switch_queue_t *LOG_QUEUE = NULL;
-#ifdef SWITCH_LOG_RECYCLE
-static switch_queue_t *LOG_RECYCLE_QUEUE = NULL;
-#endif
+static switch_mutex_t *LOG_NODE_MUTEX = NULL;
+#define LOG_NODE_POOL_MAX 1024
+#define LOG_BATCH_MAX 64
+static switch_log_node_t *LOG_NODE_POOL[LOG_NODE_POOL_MAX];
+static uint32_t LOG_NODE_POOL_COUNT = 0;
 static int8_t THREAD_RUNNING = 0;
 static uint8_t MAX_LEVEL = 0;
 static int mods_loaded = 0;
@@ -249,18 +251,22 @@ SWITCH_DECLARE(cJSON *) switch_log_node_to_json(const switch_log_node_t *node, i
 static switch_log_node_t *switch_log_node_alloc(void)
 {
 	switch_log_node_t *node = NULL;
-#ifdef SWITCH_LOG_RECYCLE
-	void *pop = NULL;
+	switch_mutex_t *mutex;
 
-	if (switch_queue_trypop(LOG_RECYCLE_QUEUE, &pop) == SWITCH_STATUS_SUCCESS) {
-		node = (switch_log_node_t *) pop;
-	} else {
-#endif
+	/* LOG_NODE_MUTEX is cleared at shutdown, from then on nodes are plain malloc/free */
+	if ((mutex = LOG_NODE_MUTEX)) {
+		switch_mutex_lock(mutex);
+		if (LOG_NODE_MUTEX && LOG_NODE_POOL_COUNT) {
+			node = LOG_NODE_POOL[--LOG_NODE_POOL_COUNT];
+		}
+		switch_mutex_unlock(mutex);
+	}
+
+	if (!node) {
 		node = malloc(sizeof(*node));
 		switch_assert(node);
-#ifdef SWITCH_LOG_RECYCLE
 	}
-#endif
+
 	return node;
 }
 
@@ -300,6 +306,7 @@ SWITCH_DECLARE(switch_log_node_t *) switch_log_node_dup(const switch_log_node_t
 SWITCH_DECLARE(void) switch_log_node_free(switch_log_node_t **pnode)
 {
 	switch_log_node_t *node;
+	switch_mutex_t *mutex;
 
 	if (!pnode) {
 		return;
@@ -317,13 +324,18 @@ SWITCH_DECLARE(void) switch_log_node_free(switch_log_node_t **pnode)
 			cJSON_Delete(node->meta);
 			node->meta = NULL;
 		}
-#ifdef SWITCH_LOG_RECYCLE
-		if (switch_queue_trypush(LOG_RECYCLE_QUEUE, node) != SWITCH_STATUS_SUCCESS) {
-			free(node);
+
+		/* keep a bounded stash of nodes around so busy logging does not malloc/free a node per line */
+		if ((mutex = LOG_NODE_MUTEX)) {
+			switch_mutex_lock(mutex);
+			if (LOG_NODE_MUTEX && LOG_NODE_POOL_COUNT < LOG_NODE_POOL_MAX) {
+				LOG_NODE_POOL[LOG_NODE_POOL_COUNT++] = node;
+				node = NULL;
+			}
+			switch_mutex_unlock(mutex);
 		}
-#else
-		free(node);
-#endif
+
+		switch_safe_free(node);
 	}
 	*pnode = NULL;
 }
@@ -444,6 +456,17 @@ SWITCH_DECLARE(switch_status_t) switch_log_unbind_logger(switch_log_function_t f
 		}
 		last = ptr;
 	}
+
+	if (status == SWITCH_STATUS_SUCCESS) {
+		uint8_t max_level = 0;
+
+		for (ptr = BINDINGS; ptr; ptr = ptr->next) {
+			if ((uint8_t) ptr->level > max_level) {
+				max_level = (uint8_t) ptr->level;
+			}
+		}
+		MAX_LEVEL = max_level;
+	}
 	switch_mutex_unlock(BINDLOCK);
 
 	return status;
@@ -495,30 +518,52 @@ static void *SWITCH_THREAD_FUNC log_thread(switch_thread_t *t, void *obj)
 
 	while (THREAD_RUNNING == 1) {
 		void *pop = NULL;
-		switch_log_node_t *node = NULL;
+		switch_log_node_t *batch[LOG_BATCH_MAX];
 		switch_log_binding_t *binding;
+		int count = 0, i, done = 0;
 
 		if (switch_queue_pop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
 			break;
 		}
 
-		if (!pop) {
-			THREAD_RUNNING = -1;
-			break;
-		}
+		/* take whatever else is already queued so the bindings are walked under one BINDLOCK */
+		for (;;) {
+			if (!pop) {
+				done = 1;
+				break;
+			}
+
+			batch[count++] = (switch_log_node_t *) pop;
+			pop = NULL;
 
-		node = (switch_log_node_t *) pop;
-		switch_mutex_lock(BINDLOCK);
-		node->sequence = ++log_sequence;
-		for (binding = BINDINGS; binding; binding = binding->next) {
-			if (binding->level >= node->level) {
-				binding->function(node, node->level);
+			if (count == LOG_BATCH_MAX || switch_queue_trypop(LOG_QUEUE, &pop) != SWITCH_STATUS_SUCCESS) {
+				break;
 			}
 		}
-		switch_mutex_unlock(BINDLOCK);
 
-		switch_log_node_free(&node);
+		if (count) {
+			switch_mutex_lock(BINDLOCK);
+			for (i = 0; i < count; i++) {
+				switch_log_node_t *node = batch[i];
 
+				node->sequence = ++log_sequence;
+				for (binding = BINDINGS; binding; binding = binding->next) {
+					if (binding->level >= node->level) {
+						binding->function(node, node->level);
+					}
+				}
+			}
+			switch_mutex_unlock(BINDLOCK);
+
+			for (i = 0; i < count; i++) {
+				switch_log_node_free(&batch[i]);
+			}
+		}
+
+		if (done) {
+			THREAD_RUNNING = -1;
+			break;
+		}
 	}
 
 	THREAD_RUNNING = 0;
@@ -601,6 +646,11 @@ SWITCH_DECLARE(void) switch_log_meta_vprintf(switch_text_channel_t channel, cons
 		goto end;
 	}
 
+	/* the console fallback is off and no binding wants this level, skip the formatting entirely */
+	if (channel != SWITCH_CHANNEL_ID_EVENT && console_mods_loaded && do_mods && level > MAX_LEVEL) {
+		goto end;
+	}
+
 	switch_assert(level < SWITCH_LOG_INVALID);
 
 	handle = switch_core_data_channel(channel);
@@ -753,9 +803,7 @@ SWITCH_DECLARE(switch_status_t) switch_log_init(switch_memory_pool_t *pool, swit
 	switch_threadattr_create(&thd_attr, LOG_POOL);
 
 	switch_queue_create(&LOG_QUEUE, SWITCH_CORE_QUEUE_LEN, LOG_POOL);
-#ifdef SWITCH_LOG_RECYCLE
-	switch_queue_create(&LOG_RECYCLE_QUEUE, SWITCH_CORE_QUEUE_LEN, LOG_POOL);
-#endif
+	switch_mutex_init(&LOG_NODE_MUTEX, SWITCH_MUTEX_NESTED, LOG_POOL);
 	switch_mutex_init(&BINDLOCK, SWITCH_MUTEX_NESTED, LOG_POOL);
 	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
 	switch_thread_create(&thread, thd_attr, log_thread, NULL, LOG_POOL);
@@ -782,23 +830,29 @@ SWITCH_DECLARE(switch_status_t) switch_log_init(switch_memory_pool_t *pool, swit
 
 SWITCH_DECLARE(void) switch_core_memory_reclaim_logger(void)
 {
-#ifdef SWITCH_LOG_RECYCLE
-	void *pop;
-	int size = switch_queue_size(LOG_RECYCLE_QUEUE);
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(session), SWITCH_LOG_CONSOLE, "Returning %d recycled log node(s) %d bytes\n", size,
-					  (int) sizeof(switch_log_node_t) * size);
-	while (switch_queue_trypop(LOG_RECYCLE_QUEUE, &pop) == SWITCH_STATUS_SUCCESS) {
-		switch_log_node_free(&pop);
+	uint32_t size;
+
+	if (!LOG_NODE_MUTEX) {
+		return;
 	}
-#else
-	return;
-#endif
 
+	switch_mutex_lock(LOG_NODE_MUTEX);
+	size = LOG_NODE_POOL_COUNT;
+	while (LOG_NODE_POOL_COUNT) {
+		free(LOG_NODE_POOL[--LOG_NODE_POOL_COUNT]);
+	}
+	switch_mutex_unlock(LOG_NODE_MUTEX);
+
+	if (size) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_CONSOLE, "Returning %u recycled log node(s) %u bytes\n", size,
+						  size * (uint32_t) sizeof(switch_log_node_t));
+	}
 }
 
 SWITCH_DECLARE(switch_status_t) switch_log_shutdown(void)
 {
 	switch_status_t st;
+	switch_mutex_t *mutex;
 
 
 	switch_queue_push(LOG_QUEUE, NULL);
@@ -810,6 +864,17 @@ SWITCH_DECLARE(switch_status_t) switch_log_shutdown(void)
 
 	switch_core_memory_reclaim_logger();
 
+	/* the mutex lives in the core pool, which goes away after us: retire the node stash so late log
+	   lines from the rest of the shutdown never touch it */
+	if ((mutex = LOG_NODE_MUTEX)) {
+		switch_mutex_lock(mutex);
+		LOG_NODE_MUTEX = NULL;
+		while (LOG_NODE_POOL_COUNT) {
+			free(LOG_NODE_POOL[--LOG_NODE_POOL_COUNT]);
+		}
+		switch_mutex_unlock(mutex);
+	}
+
 	return SWITCH_STATUS_SUCCESS;
 }
 
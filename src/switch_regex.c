@@ -32,6 +32,462 @@
 
 #include <switch.h>
 #include <pcre.h>
+#include "private/switch_core_pvt.h"
+#include "switch_hashtable.h"
+
+#define REGEX_CACHE_DEFAULT_SIZE 1024
+#define REGEX_CACHE_SHARDS 16
+
+/*
+ * Compiled pattern cache
+ *
+ * switch_regex_perform() and switch_regex_match*() look patterns up here instead of compiling them on
+ * every call.  Compiled patterns are immutable and pcre_exec() is reentrant (the ovector is supplied by
+ * the caller), so a single copy is shared by all threads.  A pattern handed back to a caller through
+ * switch_regex_perform() holds a reference until the caller releases it with switch_regex_free(); an
+ * entry evicted from the LRU while referenced is only freed on its last release.
+ *
+ * The cache is split in shards so threads only meet on the same shard.  An entry lives in the shard of
+ * its expression for lookups and in the shard of its compiled pointer for releases, which only have the
+ * pointer; the pointer side owns the reference count.  Lock order is expression shard, then pointer shard.
+ */
+typedef struct regex_cache_entry_s {
+	char *key;
+	pcre *re;
+	pcre_extra *extra;
+	switch_size_t size;
+	uint32_t refs;
+	switch_bool_t evicted;
+	struct regex_cache_entry_s *prev;
+	struct regex_cache_entry_s *next;
+} regex_cache_entry_t;
+
+typedef struct {
+	switch_mutex_t *mutex;
+	switch_hash_t *hash;
+	regex_cache_entry_t *head;
+	regex_cache_entry_t *tail;
+	uint32_t count;
+	uint64_t hits;
+	uint64_t misses;
+	uint64_t evictions;
+	switch_size_t bytes;
+	switch_mutex_t *ptr_mutex;
+	switch_hashtable_t *ptr_hash;
+} regex_cache_shard_t;
+
+static struct {
+	regex_cache_shard_t shards[REGEX_CACHE_SHARDS];
+	uint32_t max;
+	uint32_t shard_max;
+	int running;
+	switch_memory_pool_t *pool;
+} regex_cache;
+
+static unsigned int regex_cache_ptr_hashfunc(void *ptr)
+{
+	uint64_t x = (uint64_t) (intptr_t) ptr;
+
+	x = (x ^ (x >> 31)) * 0x7fb5d329728ea185ULL;
+	x = (x ^ (x >> 27)) * 0x81dadef4bc2dd44dULL;
+
+	return (unsigned int) (x ^ (x >> 33));
+}
+
+static int regex_cache_ptr_equalkeys(void *a, void *b)
+{
+	return a == b;
+}
+
+static regex_cache_shard_t *regex_cache_ptr_shard(const pcre *re)
+{
+	return &regex_cache.shards[(regex_cache_ptr_hashfunc((void *) re) >> 8) & (REGEX_CACHE_SHARDS - 1)];
+}
+
+static regex_cache_shard_t *regex_cache_key_shard(const char *key)
+{
+	uint32_t h = 2166136261U;
+
+	for (; *key; key++) {
+		h = (h ^ (unsigned char) *key) * 16777619U;
+	}
+
+	return &regex_cache.shards[h & (REGEX_CACHE_SHARDS - 1)];
+}
+
+static void regex_free_compiled(pcre *re, pcre_extra *extra)
+{
+#ifdef PCRE_STUDY_JIT_COMPILE
+	if (extra) {
+		pcre_free_study(extra);
+	}
+#else
+	if (extra) {
+		pcre_free(extra);
+	}
+#endif
+	pcre_free(re);
+}
+
+static void regex_cache_entry_destroy(regex_cache_entry_t *entry)
+{
+	regex_free_compiled(entry->re, entry->extra);
+	free(entry->key);
+	free(entry);
+}
+
+static void regex_cache_unlink(regex_cache_shard_t *shard, regex_cache_entry_t *entry)
+{
+	if (entry->prev) {
+		entry->prev->next = entry->next;
+	} else {
+		shard->head = entry->next;
+	}
+
+	if (entry->next) {
+		entry->next->prev = entry->prev;
+	} else {
+		shard->tail = entry->prev;
+	}
+
+	entry->prev = entry->next = NULL;
+}
+
+static void regex_cache_link_head(regex_cache_shard_t *shard, regex_cache_entry_t *entry)
+{
+	entry->prev = NULL;
+	entry->next = shard->head;
+
+	if (shard->head) {
+		shard->head->prev = entry;
+	}
+
+	shard->head = entry;
+
+	if (!shard->tail) {
+		shard->tail = entry;
+	}
+}
+
+static void regex_cache_ref(regex_cache_entry_t *entry)
+{
+	regex_cache_shard_t *pshard = regex_cache_ptr_shard(entry->re);
+
+	switch_mutex_lock(pshard->ptr_mutex);
+	entry->refs++;
+	switch_mutex_unlock(pshard->ptr_mutex);
+}
+
+/* must be called with shard->mutex held */
+static void regex_cache_evict(regex_cache_shard_t *shard, regex_cache_entry_t *entry)
+{
+	regex_cache_shard_t *pshard = regex_cache_ptr_shard(entry->re);
+	switch_bool_t destroy = SWITCH_FALSE;
+
+	regex_cache_unlink(shard, entry);
+	switch_core_hash_delete(shard->hash, entry->key);
+	shard->count--;
+	shard->bytes -= entry->size;
+	shard->evictions++;
+
+	switch_mutex_lock(pshard->ptr_mutex);
+	entry->evicted = SWITCH_TRUE;
+	if (!entry->refs) {
+		switch_hashtable_remove(pshard->ptr_hash, entry->re);
+		destroy = SWITCH_TRUE;
+	}
+	switch_mutex_unlock(pshard->ptr_mutex);
+
+	if (destroy) {
+		regex_cache_entry_destroy(entry);
+	}
+}
+
+static pcre *regex_compile(const char *expression, int flags, switch_bool_t study, pcre_extra **extra, const char **error, int *erroffset,
+							switch_size_t *size)
+{
+	pcre *re;
+
+	*extra = NULL;
+
+	if (!(re = pcre_compile(expression, flags, error, erroffset, NULL)) || *error) {
+		if (re) {
+			pcre_free(re);
+		}
+		return NULL;
+	}
+
+	if (size) {
+		size_t bytes = 0;
+
+		pcre_fullinfo(re, NULL, PCRE_INFO_SIZE, &bytes);
+		*size = bytes;
+	}
+
+#ifdef PCRE_STUDY_JIT_COMPILE
+	if (study) {
+		const char *study_error = NULL;
+
+		if ((*extra = pcre_study(re, PCRE_STUDY_JIT_COMPILE, &study_error)) && size) {
+			size_t bytes = 0;
+
+			if (!pcre_fullinfo(re, *extra, PCRE_INFO_JITSIZE, &bytes)) {
+				*size += bytes;
+			}
+		}
+	}
+#endif
+
+	return re;
+}
+
+/* Returns a compiled pattern, shared from the cache when possible; release it with regex_cache_release(). */
+static pcre *regex_cache_get(const char *expression, int flags, pcre_extra **extra, const char **error, int *erroffset)
+{
+	regex_cache_entry_t *entry, *existing;
+	regex_cache_shard_t *shard, *pshard;
+	char key[1024];
+	pcre *re;
+
+	if (!regex_cache.running || !regex_cache.shard_max || strlen(expression) >= sizeof(key) - 16) {
+		/* uncached patterns are owned by the caller and freed with pcre_free(), so they are not studied */
+		return regex_compile(expression, flags, SWITCH_FALSE, extra, error, erroffset, NULL);
+	}
+
+	switch_snprintf(key, sizeof(key), "%d:%s", flags, expression);
+	shard = regex_cache_key_shard(key);
+
+	switch_mutex_lock(shard->mutex);
+	if ((entry = switch_core_hash_find(shard->hash, key))) {
+		shard->hits++;
+		regex_cache_ref(entry);
+
+		if (entry != shard->head) {
+			regex_cache_unlink(shard, entry);
+			regex_cache_link_head(shard, entry);
+		}
+
+		*extra = entry->extra;
+		re = entry->re;
+		switch_mutex_unlock(shard->mutex);
+
+		return re;
+	}
+	shard->misses++;
+	switch_mutex_unlock(shard->mutex);
+
+	switch_zmalloc(entry, sizeof(*entry));
+
+	if (!(entry->re = regex_compile(expression, flags, SWITCH_TRUE, &entry->extra, error, erroffset, &entry->size))) {
+		free(entry);
+		return NULL;
+	}
+
+	entry->key = strdup(key);
+	entry->refs = 1;
+
+	switch_mutex_lock(shard->mutex);
+	if ((existing = switch_core_hash_find(shard->hash, key))) {
+		/* another thread compiled the same pattern meanwhile, use its copy */
+		regex_cache_ref(existing);
+		*extra = existing->extra;
+		re = existing->re;
+		switch_mutex_unlock(shard->mutex);
+		regex_cache_entry_destroy(entry);
+	} else {
+		pshard = regex_cache_ptr_shard(entry->re);
+		switch_mutex_lock(pshard->ptr_mutex);
+		switch_hashtable_insert(pshard->ptr_hash, entry->re, entry, HASHTABLE_FLAG_NONE);
+		switch_mutex_unlock(pshard->ptr_mutex);
+
+		switch_core_hash_insert(shard->hash, entry->key, entry);
+		regex_cache_link_head(shard, entry);
+		shard->count++;
+		shard->bytes += entry->size;
+
+		while (shard->count > regex_cache.shard_max && shard->tail && shard->tail != entry) {
+			regex_cache_evict(shard, shard->tail);
+		}
+
+		*extra = entry->extra;
+		re = entry->re;
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	return re;
+}
+
+/* Drops a reference taken by regex_cache_get(), freeing patterns that are not (or no longer) cached.
+   Once switch_core_regex_destroy() has torn the pointer maps down a late release frees the pattern itself. */
+static void regex_cache_release(pcre *re, pcre_extra *extra)
+{
+	regex_cache_entry_t *entry = NULL;
+	regex_cache_shard_t *pshard;
+	switch_bool_t destroy = SWITCH_FALSE;
+
+	if (!re) {
+		return;
+	}
+
+	pshard = regex_cache_ptr_shard(re);
+
+	if (pshard->ptr_mutex) {
+		switch_mutex_lock(pshard->ptr_mutex);
+		if ((entry = switch_hashtable_search(pshard->ptr_hash, re))) {
+			if (entry->refs) {
+				entry->refs--;
+			}
+
+			if (entry->evicted && !entry->refs) {
+				switch_hashtable_remove(pshard->ptr_hash, re);
+				destroy = SWITCH_TRUE;
+			}
+		}
+		switch_mutex_unlock(pshard->ptr_mutex);
+	}
+
+	if (destroy) {
+		regex_cache_entry_destroy(entry);
+	} else if (!entry) {
+		regex_free_compiled(re, extra);
+	}
+}
+
+void switch_core_regex_init(void)
+{
+	int i;
+
+	memset(&regex_cache, 0, sizeof(regex_cache));
+
+	/* the cache owns its pool so its locks do not depend on the order the core tears its pools down in */
+	switch_core_new_memory_pool(&regex_cache.pool);
+
+	for (i = 0; i < REGEX_CACHE_SHARDS; i++) {
+		regex_cache_shard_t *shard = &regex_cache.shards[i];
+
+		switch_core_hash_init(&shard->hash);
+		switch_mutex_init(&shard->mutex, SWITCH_MUTEX_NESTED, regex_cache.pool);
+		switch_create_hashtable(&shard->ptr_hash, 16, regex_cache_ptr_hashfunc, regex_cache_ptr_equalkeys);
+		switch_mutex_init(&shard->ptr_mutex, SWITCH_MUTEX_NESTED, regex_cache.pool);
+	}
+
+	regex_cache.running = 1;
+	switch_regex_cache_set_size(REGEX_CACHE_DEFAULT_SIZE);
+}
+
+void switch_core_regex_destroy(void)
+{
+	switch_hashtable_iterator_t *hi;
+	int i;
+
+	if (!regex_cache.running) {
+		return;
+	}
+
+	/* new patterns are compiled uncached from here on */
+	regex_cache.running = 0;
+	switch_regex_cache_flush();
+
+	for (i = 0; i < REGEX_CACHE_SHARDS; i++) {
+		regex_cache_shard_t *shard = &regex_cache.shards[i];
+		switch_mutex_t *ptr_mutex = shard->ptr_mutex;
+
+		switch_mutex_lock(shard->mutex);
+		switch_core_hash_destroy(&shard->hash);
+		switch_mutex_unlock(shard->mutex);
+
+		/* what is left is evicted but still held by a caller: drop the bookkeeping and leave the compiled
+		   pattern to its holder, whose switch_regex_free() no longer finds a map and frees it directly */
+		switch_mutex_lock(ptr_mutex);
+		for (hi = switch_hashtable_first(shard->ptr_hash); hi; hi = switch_hashtable_next(&hi)) {
+			void *val;
+			regex_cache_entry_t *entry;
+
+			switch_hashtable_this(hi, NULL, NULL, &val);
+			entry = (regex_cache_entry_t *) val;
+			free(entry->key);
+			free(entry);
+		}
+		switch_hashtable_destroy(&shard->ptr_hash);
+		shard->ptr_mutex = NULL;
+		switch_mutex_unlock(ptr_mutex);
+	}
+
+	switch_core_destroy_memory_pool(&regex_cache.pool);
+}
+
+SWITCH_DECLARE(void) switch_regex_cache_set_size(uint32_t max)
+{
+	int i;
+
+	if (!regex_cache.running) {
+		return;
+	}
+
+	regex_cache.max = max;
+	regex_cache.shard_max = max ? (max + REGEX_CACHE_SHARDS - 1) / REGEX_CACHE_SHARDS : 0;
+
+	for (i = 0; i < REGEX_CACHE_SHARDS; i++) {
+		regex_cache_shard_t *shard = &regex_cache.shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		while (shard->count > regex_cache.shard_max && shard->tail) {
+			regex_cache_evict(shard, shard->tail);
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+}
+
+SWITCH_DECLARE(uint32_t) switch_regex_cache_flush(void)
+{
+	uint32_t r = 0;
+	int i;
+
+	for (i = 0; i < REGEX_CACHE_SHARDS; i++) {
+		regex_cache_shard_t *shard = &regex_cache.shards[i];
+
+		if (!shard->mutex || !shard->hash) {
+			continue;
+		}
+
+		switch_mutex_lock(shard->mutex);
+		while (shard->tail) {
+			regex_cache_evict(shard, shard->tail);
+			r++;
+		}
+		switch_mutex_unlock(shard->mutex);
+	}
+
+	return r;
+}
+
+SWITCH_DECLARE(void) switch_regex_cache_get_stats(switch_regex_cache_stats_t *stats)
+{
+	int i;
+
+	memset(stats, 0, sizeof(*stats));
+
+	if (!regex_cache.running) {
+		return;
+	}
+
+	stats->max_entries = regex_cache.max;
+
+	for (i = 0; i < REGEX_CACHE_SHARDS; i++) {
+		regex_cache_shard_t *shard = &regex_cache.shards[i];
+
+		switch_mutex_lock(shard->mutex);
+		stats->entries += shard->count;
+		stats->hits += shard->hits;
+		stats->misses += shard->misses;
+		stats->evictions += shard->evictions;
+		stats->bytes += shard->bytes;
+		switch_mutex_unlock(shard->mutex);
+	}
+#ifdef PCRE_STUDY_JIT_COMPILE
+	stats->jit = SWITCH_TRUE;
+#endif
+}
 
 SWITCH_DECLARE(switch_regex_t *) switch_regex_compile(const char *pattern,
 													  int options, const char **errorptr, int *erroroffset, const unsigned char *tables)
@@ -48,7 +504,7 @@ SWITCH_DECLARE(int) switch_regex_copy_substring(const char *subject, int *ovecto
 
 SWITCH_DECLARE(void) switch_regex_free(void *data)
 {
-	pcre_free(data);
+	regex_cache_release((pcre *) data, NULL);
 
 }
 
@@ -57,6 +513,7 @@ SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expressi
 	const char *error = NULL;
 	int erroffset = 0;
 	pcre *re = NULL;
+	pcre_extra *extra = NULL;
 	int match_count = 0;
 	char *tmp = NULL;
 	uint32_t flags = 0;
@@ -95,19 +552,18 @@ SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expressi
 		}
 	}
 
-	re = pcre_compile(expression,	/* the pattern */
-					  flags,	/* default options */
-					  &error,	/* for error message */
-					  &erroffset,	/* for error offset */
-					  NULL);	/* use default character tables */
-	if (error) {
-		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "COMPILE ERROR: %d [%s][%s]\n", erroffset, error, expression);
-		switch_regex_safe_free(re);
+	re = regex_cache_get(expression,	/* the pattern */
+						 flags,	/* default options */
+						 &extra,	/* study data, JIT code when available */
+						 &error,	/* for error message */
+						 &erroffset);	/* for error offset */
+	if (!re) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "COMPILE ERROR: %d [%s][%s]\n", erroffset, switch_str_nil(error), expression);
 		goto end;
 	}
 
 	match_count = pcre_exec(re,	/* result of pcre_compile() */
-							NULL,	/* we didn't study the pattern */
+							extra,	/* result of pcre_study() */
 							field,	/* the subject string */
 							(int) strlen(field),	/* the length of the subject string */
 							0,	/* start at offset 0 in the subject */
@@ -117,7 +573,8 @@ SWITCH_DECLARE(int) switch_regex_perform(const char *field, const char *expressi
 
 
 	if (match_count <= 0) {
-		switch_regex_safe_free(re);
+		regex_cache_release(re, extra);
+		re = NULL;
 		match_count = 0;
 	}
 
@@ -217,6 +674,7 @@ SWITCH_DECLARE(switch_status_t) switch_regex_match_partial(const char *target, c
 	const char *error = NULL;	/* Used to hold any errors                                           */
 	int error_offset = 0;		/* Holds the offset of an error                                      */
 	pcre *pcre_prepared = NULL;	/* Holds the compiled regex                                          */
+	pcre_extra *pcre_extra_data = NULL;	/* Holds the study data of the compiled regex                */
 	int match_count = 0;		/* Number of times the regex was matched                             */
 	int offset_vectors[255];	/* not used, but has to exist or pcre won't even try to find a match */
 	int pcre_flags = 0;
@@ -247,19 +705,14 @@ SWITCH_DECLARE(switch_status_t) switch_regex_match_partial(const char *target, c
 		}
 	}
 
-	/* Compile the expression */
-	pcre_prepared = pcre_compile(expression, flags, &error, &error_offset, NULL);
+	/* Compile the expression, or reuse it from the cache */
+	pcre_prepared = regex_cache_get(expression, flags, &pcre_extra_data, &error, &error_offset);
 
 	/* See if there was an error in the expression */
-	if (error != NULL) {
-		/* Clean up after ourselves */
-		if (pcre_prepared) {
-			pcre_free(pcre_prepared);
-			pcre_prepared = NULL;
-		}
+	if (!pcre_prepared) {
 		/* Note our error */
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR,
-						  "Regular Expression Error expression[%s] error[%s] location[%d]\n", expression, error, error_offset);
+						  "Regular Expression Error expression[%s] error[%s] location[%d]\n", expression, switch_str_nil(error), error_offset);
 
 		/* We definitely didn't match anything */
 		goto end;
@@ -271,13 +724,11 @@ SWITCH_DECLARE(switch_status_t) switch_regex_match_partial(const char *target, c
 
 	/* So far so good, run the regex */
 	match_count =
-		pcre_exec(pcre_prepared, NULL, target, (int) strlen(target), 0, pcre_flags, offset_vectors, sizeof(offset_vectors) / sizeof(offset_vectors[0]));
+		pcre_exec(pcre_prepared, pcre_extra_data, target, (int) strlen(target), 0, pcre_flags, offset_vectors, sizeof(offset_vectors) / sizeof(offset_vectors[0]));
 
 	/* Clean up */
-	if (pcre_prepared) {
-		pcre_free(pcre_prepared);
-		pcre_prepared = NULL;
-	}
+	regex_cache_release(pcre_prepared, pcre_extra_data);
+	pcre_prepared = NULL;
 
 	/* switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "number of matches: %d\n", match_count); */
 
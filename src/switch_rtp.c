@@ -243,7 +243,7 @@ struct switch_rtp_rfc2833_data {
 	uint8_t in_digit_queued;
 };
 
-typedef struct {
+typedef struct switch_rtp_ice_s {
 	char *ice_user;
 	char *user_ice;
 	char *luser_ice;
@@ -263,14 +263,26 @@ typedef struct {
 	char last_sent_id[13];
 	switch_time_t last_ok;
 	uint8_t cand_responsive;
+	/* linkage on the shared ICE agent timer wheel */
+	struct switch_rtp *rtp_session;
+	struct switch_rtp_ice_s *wheel_next;
+	struct switch_rtp_ice_s *wheel_prev;
+	switch_time_t wheel_due;
+	int wheel_slot;
+	uint8_t on_wheel;
 } switch_rtp_ice_t;
 
 struct switch_rtp;
 
-static void switch_rtp_dtls_init(void);
+static void switch_rtp_dtls_init(switch_memory_pool_t *pool);
 static void switch_rtp_dtls_destroy(void);
 
 #define MAX_DTLS_MTU 4096
+#define DTLS_MAX_WORKERS 16
+#define DTLS_WORKER_QUEUE_LEN 10000
+#define DTLS_PENDING_LEN 64
+#define DTLS_SESSION_CACHE_MAX 4096
+#define DTLS_SESSION_TIMEOUT 300
 
 typedef struct switch_dtls_s {
 	/* DTLS */
@@ -295,8 +307,49 @@ typedef struct switch_dtls_s {
 	char *pem;
 	struct switch_rtp *rtp_session;
 	int mtu;
+	/* handshake offload, ssl_mutex is held while the SSL object is driven, flag_mutex guards queued/closing, cond signals queued is clear */
+	switch_mutex_t *ssl_mutex;
+	switch_mutex_t *flag_mutex;
+	switch_thread_cond_t *cond;
+	switch_queue_t *pending;
+	uint8_t queued;
+	uint8_t closing;
+	uint8_t resume_attempt;
+	uint8_t stats_done;
+	switch_time_t hs_start;
+	char *fp_key;
 } switch_dtls_t;
 
+typedef struct {
+	switch_size_t bytes;
+	unsigned char data[1];
+} dtls_packet_t;
+
+typedef struct {
+	SSL_SESSION *session;
+	time_t expires;
+} dtls_cached_session_t;
+
+static const uint32_t dtls_hs_bounds_ms[SWITCH_RTP_DTLS_HIST_BUCKETS] = { 10, 25, 50, 100, 250, 500, 1000, 0 };
+
+static struct {
+	/* shared contexts indexed by [server][DTLSv1_2], rebuilt when the sha-256 of the local certificate changes */
+	SSL_CTX *ctx[2][2];
+	unsigned char ctx_cert[EVP_MAX_MD_SIZE];
+	unsigned int ctx_cert_len;
+	/* client sessions we verified, keyed by remote fingerprint */
+	switch_hash_t *sessions;
+	uint32_t session_count;
+	switch_queue_t *queue;
+	switch_thread_t *threads[DTLS_MAX_WORKERS];
+	int workers;
+	int running;
+	switch_mutex_t *mutex;
+	switch_rtp_dtls_stats_t stats;
+} dtls_globals;
+
+static int DTLS_WORKERS = -1;
+
 typedef int (*dtls_state_handler_t)(switch_rtp_t *, switch_dtls_t *);
 
 
@@ -307,6 +360,22 @@ static int dtls_state_fail(switch_rtp_t *rtp_session, switch_dtls_t *dtls);
 
 dtls_state_handler_t dtls_states[DS_INVALID] = {NULL, dtls_state_handshake, dtls_state_setup, dtls_state_ready, dtls_state_fail};
 
+/* packets of one locally encoded video frame, sent together once the marker packet is written */
+#define RTP_SEND_BATCH_MAX 16
+#define RTP_SEND_BATCH_SLOT 1500
+
+typedef struct rtp_send_batch_s {
+	char *buf;
+	const char *packets[RTP_SEND_BATCH_MAX];
+	switch_size_t lens[RTP_SEND_BATCH_MAX];
+	uint32_t count;
+	uint32_t ts;
+} rtp_send_batch_t;
+
+static switch_status_t rtp_send_batch_flush(switch_rtp_t *rtp_session);
+static void rtp_write_stats_add(switch_rtp_t *rtp_session, switch_payload_t pt, switch_size_t bytes);
+static int rtcp_stats(switch_rtp_t *rtp_session);
+
 typedef struct ts_normalize_s {
 	uint32_t last_ssrc;
 	uint32_t last_frame;
@@ -417,6 +486,16 @@ struct switch_rtp {
 	uint32_t jitter_lead;
 	double old_mean;
 	switch_time_t next_stat_check_time;
+	struct switch_rtp *telemetry_next;
+	struct switch_rtp *telemetry_prev;
+	struct rtp_telemetry_group_s *telemetry_group;
+	uint8_t on_telemetry;
+	switch_size_t telemetry_recved;
+	switch_size_t telemetry_flaws;
+	int64_t telemetry_jitter_n;
+	int64_t telemetry_jitter_addsq;
+	uint32_t telemetry_rtt_reports;
+	uint32_t rtt_reports;
 	switch_port_t local_port;
 	switch_port_t remote_port;
 	switch_port_t eff_remote_port;
@@ -491,6 +570,15 @@ struct switch_rtp {
 	uint32_t last_max_vb_frames;
 	int skip_timer;
 	uint32_t prev_nacks_inflight;
+	rtp_send_batch_t *send_batch;
+	struct rtp_relay_worker_s *relay_worker;
+	struct switch_rtp *relay_peer;
+	struct switch_rtp *relay_from;
+	switch_time_t relay_holdoff;
+	uint32_t relay_ts_offset;
+	uint16_t relay_last_seq;
+	uint8_t relay_synced;
+	uint8_t relay_fallback;
 };
 
 struct switch_rtcp_report_block {
@@ -854,7 +942,8 @@ static void calc_elapsed(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice)
 	}
 }
 
-static switch_status_t ice_out(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice, switch_bool_t force)
+/* caller holds the read lock or, from the ICE agent, the ice_mutex of a session still on the wheel */
+static switch_status_t ice_send_check(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice, switch_bool_t force)
 {
 	uint8_t buf[256] = { 0 };
 	switch_stun_packet_t *packet;
@@ -887,8 +976,6 @@ static switch_status_t ice_out(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice,
 	switch_assert(rtp_session != NULL);
 	switch_assert(ice->ice_user != NULL);
 
-	READ_INC(rtp_session);
-
 	if (rtp_session->last_stun) {
 		elapsed = (unsigned int) ((switch_micro_time_now() - rtp_session->last_stun) / 1000);
 
@@ -938,202 +1025,1234 @@ static switch_status_t ice_out(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice,
 
 	ice->sending = 3;
 
-	// end:
+	return status;
+}
+
+static switch_status_t ice_out(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice, switch_bool_t force)
+{
+	switch_status_t status;
+
+	READ_INC(rtp_session);
+	status = ice_send_check(rtp_session, ice, force);
 	READ_DEC(rtp_session);
 
 	return status;
 }
 
-int icecmp(const char *them, switch_rtp_ice_t *ice)
+/*
+ * Shared ICE agent: connectivity checks and consent keepalives for every non-lite ICE session run
+ * from one thread on a hashed timer wheel, so they keep going whether or not a media thread is
+ * reading the session (hold, proxy media, stalled bridges). Inbound STUN stays on the read path
+ * since that is where the socket is read.
+ */
+#define ICE_WHEEL_SLOTS 256
+#define ICE_WHEEL_TICK 10000
+#define ICE_AGENT_JITTER 200000
+
+static struct {
+	switch_rtp_ice_t *slots[ICE_WHEEL_SLOTS];
+	switch_time_t tick_time;
+	int cur;
+	uint32_t count;
+	int running;
+	switch_mutex_t *mutex;
+	switch_thread_t *thread;
+} ice_agent;
+
+static switch_bool_t ICE_AGENT = SWITCH_TRUE;
+
+/* caller holds ice_agent.mutex */
+static void ice_wheel_unlink(switch_rtp_ice_t *ice)
 {
-	if (strchr(them, ':')) {
-		return strcmp(them, ice->user_ice);
+	if (!ice->on_wheel) {
+		return;
 	}
 
-	return strcmp(them, ice->luser_ice);
+	if (ice->wheel_prev) {
+		ice->wheel_prev->wheel_next = ice->wheel_next;
+	} else {
+		ice_agent.slots[ice->wheel_slot] = ice->wheel_next;
+	}
+
+	if (ice->wheel_next) {
+		ice->wheel_next->wheel_prev = ice->wheel_prev;
+	}
+
+	ice->wheel_next = ice->wheel_prev = NULL;
+	ice->on_wheel = 0;
+	ice_agent.count--;
 }
 
-static void handle_ice(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice, void *data, switch_size_t len)
+/* caller holds ice_agent.mutex */
+static void ice_wheel_link(switch_rtp_ice_t *ice, switch_time_t due)
 {
-	switch_stun_packet_t *packet;
-	switch_stun_packet_attribute_t *attr;
-	void *end_buf;
-	char username[STUN_USERNAME_MAX_SIZE] = { 0 };
-	unsigned char buf[1500] = { 0 };
-	switch_size_t cpylen = len;
-	int xlen = 0;
-	int ok = 1;
-	uint32_t *pri = NULL;
-	int is_rtcp = ice == &rtp_session->rtcp_ice;
-	switch_channel_t *channel;
-	int i;
-	switch_sockaddr_t *from_addr = rtp_session->from_addr;
-	const char *from_host = NULL;
-	switch_port_t from_port = 0;
-	char faddr_buf[80] = "";
+	int64_t ticks;
 
-	if (is_rtcp) {
-		from_addr = rtp_session->rtcp_from_addr;
+	ice_wheel_unlink(ice);
+
+	ticks = (due - ice_agent.tick_time) / ICE_WHEEL_TICK;
+	if (ticks < 1) {
+		ticks = 1;
 	}
 
-	from_host = switch_get_addr(faddr_buf, sizeof(faddr_buf), from_addr);
-	from_port = switch_sockaddr_get_port(from_addr);
+	/* anything further out than one turn waits in its slot until it is really due */
+	ice->wheel_slot = (int) ((ice_agent.cur + ticks) % ICE_WHEEL_SLOTS);
+	ice->wheel_due = due;
+	ice->wheel_prev = NULL;
+	ice->wheel_next = ice_agent.slots[ice->wheel_slot];
+	if (ice->wheel_next) {
+		ice->wheel_next->wheel_prev = ice;
+	}
+	ice_agent.slots[ice->wheel_slot] = ice;
+	ice->on_wheel = 1;
+	ice_agent.count++;
+}
 
-	//if (rtp_session->flags[SWITCH_RTP_FLAG_VIDEO]) {
-	//	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "WTF OK %s CALL\n", rtp_type(rtp_session));
-	//}
+static void ice_agent_add(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice)
+{
+	if (!ice_agent.running) {
+		return;
+	}
 
-	if (!switch_rtp_ready(rtp_session) || zstr(ice->user_ice) || zstr(ice->ice_user)) {
+	switch_mutex_lock(ice_agent.mutex);
+	ice->rtp_session = rtp_session;
+	if ((ice->type & ICE_LITE)) {
+		ice_wheel_unlink(ice);
+	} else {
+		ice_wheel_link(ice, switch_micro_time_now());
+	}
+	switch_mutex_unlock(ice_agent.mutex);
+}
+
+static void ice_agent_del(switch_rtp_t *rtp_session)
+{
+	if (!ice_agent.mutex) {
 		return;
 	}
 
-	READ_INC(rtp_session);
-	WRITE_INC(rtp_session);
+	switch_mutex_lock(ice_agent.mutex);
+	ice_wheel_unlink(&rtp_session->ice);
+	ice_wheel_unlink(&rtp_session->rtcp_ice);
+	switch_mutex_unlock(ice_agent.mutex);
+}
 
-	switch_mutex_lock(rtp_session->ice_mutex);
+/* caller holds ice_agent.mutex */
+static void ice_agent_run(switch_rtp_ice_t *ice, switch_time_t now)
+{
+	switch_rtp_t *rtp_session = ice->rtp_session;
+	switch_time_t due = now + ICE_WHEEL_TICK;
 
-	if (!switch_rtp_ready(rtp_session)) {
-		goto end;
+	/* never wait on a busy session, it gets another try on the next tick */
+	if (switch_mutex_trylock(rtp_session->ice_mutex) == SWITCH_STATUS_SUCCESS) {
+		if (switch_rtp_ready(rtp_session) && ice->ice_user && !(ice == &rtp_session->rtcp_ice && rtp_session->flags[SWITCH_RTP_FLAG_RTCP_MUX])) {
+			ice_send_check(rtp_session, ice, SWITCH_FALSE);
+		}
+
+		if (ice->next_run > now) {
+			due = ice->next_run + (rand() % ICE_AGENT_JITTER);
+		}
+
+		switch_mutex_unlock(rtp_session->ice_mutex);
 	}
 
-	if (cpylen > sizeof(buf)) {
-		cpylen = sizeof(buf);
+	ice_wheel_link(ice, due);
+}
+
+static void *SWITCH_THREAD_FUNC ice_agent_thread(switch_thread_t *thread, void *obj)
+{
+	while (ice_agent.running) {
+		switch_time_t now;
+
+		switch_yield(ICE_WHEEL_TICK);
+		now = switch_micro_time_now();
+
+		switch_mutex_lock(ice_agent.mutex);
+		while (ice_agent.tick_time + ICE_WHEEL_TICK <= now) {
+			switch_rtp_ice_t *ice, *next;
+
+			ice_agent.cur = (ice_agent.cur + 1) % ICE_WHEEL_SLOTS;
+			ice_agent.tick_time += ICE_WHEEL_TICK;
+
+			for (ice = ice_agent.slots[ice_agent.cur]; ice; ice = next) {
+				next = ice->wheel_next;
+
+				if (ice->wheel_due <= now) {
+					ice_agent_run(ice, now);
+				}
+			}
+		}
+		switch_mutex_unlock(ice_agent.mutex);
 	}
 
-	channel = switch_core_session_get_channel(rtp_session->session);
+	return NULL;
+}
 
-	memcpy(buf, data, cpylen);
-	packet = switch_stun_packet_parse(buf, (uint32_t)cpylen);
-	if (!packet) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "Invalid STUN/ICE packet received %ld bytes\n", (long)cpylen);
-		goto end;
+static void ice_agent_init(switch_memory_pool_t *pool)
+{
+	switch_threadattr_t *thd_attr = NULL;
+
+	switch_mutex_init(&ice_agent.mutex, SWITCH_MUTEX_NESTED, pool);
 
+	if (!ICE_AGENT) {
+		return;
 	}
 
-	rtp_session->last_stun = switch_micro_time_now();
+	ice_agent.tick_time = switch_micro_time_now();
+	ice_agent.running = 1;
 
-	if (!rtp_session->first_stun) {
-		rtp_session->first_stun = rtp_session->last_stun;
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+	switch_thread_create(&ice_agent.thread, thd_attr, ice_agent_thread, NULL, pool);
+}
+
+static void ice_agent_destroy(void)
+{
+	switch_status_t st;
+
+	if (ice_agent.running) {
+		ice_agent.running = 0;
+		switch_thread_join(&st, ice_agent.thread);
+		ice_agent.thread = NULL;
 	}
+}
 
-	calc_elapsed(rtp_session, ice);
+SWITCH_DECLARE(void) switch_rtp_set_ice_agent(switch_bool_t enabled)
+{
+	ICE_AGENT = enabled;
+}
 
-	end_buf = buf + ((sizeof(buf) > packet->header.length) ? packet->header.length : sizeof(buf));
+/*
+ * Media relay: while two bridged legs carry the same codec and nothing needs to see the audio, a small
+ * pool of worker threads polls the inbound sockets, unprotects each packet with the receiving session's
+ * SRTP context, moves it onto the peer's payload type and timestamp base and sends it through
+ * rtp_common_write() on the peer, which stamps the peer's SSRC/seq and SRTP.  Every worker owns one
+ * packet buffer that is rewritten in place, so forwarding never allocates.  The read thread of a relayed
+ * session paces itself, keeps sending and receiving RTCP from the reception stats the worker feeds, and
+ * hands up CNG.  A worker slot is identified by a generation number rather than the session pointer, so
+ * a poll result for a session unlinked (and maybe freed and reallocated) meanwhile is never acted upon.
+ */
+#define RTP_RELAY_MAX_WORKERS 8
+#define RTP_RELAY_WORKER_SESSIONS 512
+#define RTP_RELAY_POLL_USEC 20000
+#define RTP_RELAY_HOLDOFF_USEC 2000000
 
-	switch_stun_packet_first_attribute(packet, attr);
-	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "%s STUN PACKET TYPE: %s\n",
-					  rtp_type(rtp_session), switch_stun_value_to_name(SWITCH_STUN_TYPE_PACKET_TYPE, packet->header.type));
-	do {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|---: %s STUN ATTR %d %x %s\n", rtp_type(rtp_session), attr->type, attr->type,
-						  switch_stun_value_to_name(SWITCH_STUN_TYPE_ATTRIBUTE, attr->type));
+typedef struct rtp_relay_worker_s {
+	switch_thread_t *thread;
+	switch_mutex_t *mutex;
+	switch_rtp_t *sessions[RTP_RELAY_WORKER_SESSIONS];
+	uint32_t gens[RTP_RELAY_WORKER_SESSIONS];
+	uint32_t pollgens[RTP_RELAY_WORKER_SESSIONS];
+	switch_pollfd_t pollfds[RTP_RELAY_WORKER_SESSIONS];
+	uint32_t count;
+	int dirty;
+	rtp_msg_t msg;
+} rtp_relay_worker_t;
+
+static struct {
+	rtp_relay_worker_t *workers;
+	uint32_t worker_count;
+	uint32_t gen;
+	int running;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+} rtp_relay;
 
-		switch (attr->type) {
-		case SWITCH_STUN_ATTR_USE_CAND:
-			{
-				ice->rready = 1;
-				for (i = 0; i < ice->ice_params->cand_idx[ice->proto]; i++) {
-					if (!strcmp(ice->ice_params->cands[i][ice->proto].con_addr, from_host) && ice->ice_params->cands[i][ice->proto].con_port == from_port) {
-						ice->ice_params->cands[i][ice->proto].use_candidate = 1;
-						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG6, "Got USE-CANDIDATE on %s:%d\n", ice->ice_params->cands[i][ice->proto].con_addr, ice->ice_params->cands[i][ice->proto].con_port);
-					}
-				}
-			}
-			break;
-		case SWITCH_STUN_ATTR_ERROR_CODE:
-			{
-				switch_stun_error_code_t *err = (switch_stun_error_code_t *) attr->value;
-				uint32_t code = (err->code * 100) + err->number;
+/* caller holds worker->mutex, returns the session polled in slot x if that slot still holds the same link */
+static switch_rtp_t *rtp_relay_linked(rtp_relay_worker_t *worker, uint32_t x)
+{
+	if (x < worker->count && worker->pollgens[x] && worker->gens[x] == worker->pollgens[x]) {
+		return worker->sessions[x];
+	}
 
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s got %s stun binding response %u\n",
-								  rtp_session_name(rtp_session),
-								  rtp_type(rtp_session),
-								  code
-								  );
+	return NULL;
+}
 
-				if ((ice->type & ICE_VANILLA) && code == 487) {
-					if ((ice->type & ICE_CONTROLLED)) {
-						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s STUN Changing role to CONTROLLING\n", rtp_type(rtp_session));
-						ice->type &= ~ICE_CONTROLLED;
-					} else {
-						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s STUN Changing role to CONTROLLED\n", rtp_type(rtp_session));
-						ice->type |= ICE_CONTROLLED;
-					}
-					packet->header.type = SWITCH_STUN_BINDING_RESPONSE;
-				}
+/* caller holds rtp_relay.mutex */
+static void rtp_relay_unlink(switch_rtp_t *rtp_session)
+{
+	rtp_relay_worker_t *worker = rtp_session->relay_worker;
+	uint32_t x;
 
-			}
-			break;
-		case SWITCH_STUN_ATTR_MAPPED_ADDRESS:
-			{
-				char ip[50];
-				uint16_t port;
-				switch_stun_packet_attribute_get_mapped_address(attr, ip, sizeof(ip), &port);
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s:%d\n", ip, port);
-			}
-			break;
-		case SWITCH_STUN_ATTR_XOR_MAPPED_ADDRESS:
-			{
-				char ip[50];
-				uint16_t port;
-				switch_stun_packet_attribute_get_xor_mapped_address(attr, &packet->header, ip, sizeof(ip), &port);
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s:%d\n", ip, port);
-			}
-			break;
-		case SWITCH_STUN_ATTR_USERNAME:
-			{
-				switch_stun_packet_attribute_get_username(attr, username, sizeof(username));
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s\n", username);
-			}
-			break;
+	if (!worker) {
+		return;
+	}
 
-		case SWITCH_STUN_ATTR_PRIORITY:
-			{
-				uint32_t priority = 0;
-				pri = (uint32_t *) attr->value;
-				priority = ntohl(*pri);
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %u\n", priority);
-				ok = priority == ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].priority;
-			}
+	switch_mutex_lock(worker->mutex);
+	for (x = 0; x < worker->count; x++) {
+		if (worker->sessions[x] == rtp_session) {
+			worker->count--;
+			worker->sessions[x] = worker->sessions[worker->count];
+			worker->gens[x] = worker->gens[worker->count];
+			worker->dirty = 1;
 			break;
 		}
+	}
 
-		if (!switch_stun_packet_next_attribute(attr, end_buf)) {
-			break;
-		}
+	if (rtp_session->relay_peer) {
+		rtp_session->relay_peer->relay_from = NULL;
+		rtp_session->relay_peer = NULL;
+	}
+	rtp_session->relay_worker = NULL;
+	switch_mutex_unlock(worker->mutex);
 
-		xlen += 4 + switch_stun_attribute_padded_length(attr);
-	} while (xlen <= packet->header.length);
+	/* whatever piled up in the jitter buffer before the relay started is stale now */
+	rtp_flush_read_buffer(rtp_session, SWITCH_RTP_FLUSH_ONCE);
 
-	if ((ice->type & ICE_GOOGLE_JINGLE) && ok) {
-		ok = !strcmp(ice->user_ice, username);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG, "Stop relaying %s\n", rtp_type(rtp_session));
+}
+
+/* called from the session's own read thread once a worker handed the packets back */
+static void rtp_relay_fallback(switch_rtp_t *rtp_session)
+{
+	switch_mutex_lock(rtp_relay.mutex);
+	if (rtp_session->relay_worker && rtp_session->relay_fallback) {
+		rtp_session->relay_holdoff = switch_micro_time_now() + RTP_RELAY_HOLDOFF_USEC;
+		rtp_relay_unlink(rtp_session);
 	}
+	switch_mutex_unlock(rtp_relay.mutex);
+}
 
-	if (packet->header.type != SWITCH_STUN_BINDING_REQUEST && packet->header.type != SWITCH_STUN_BINDING_RESPONSE) {
+/* caller holds worker->mutex */
+static void rtp_relay_forward(rtp_relay_worker_t *worker, switch_rtp_t *src)
+{
+	switch_rtp_t *dst = src->relay_peer;
+	rtp_msg_t *msg = &worker->msg;
+	switch_size_t bytes = sizeof(*msg);
+	switch_frame_flag_t flags = SFF_NONE;
+	uint32_t ts;
+	uint16_t seq, gap;
+
+	if (!dst || src->relay_fallback) {
+		return;
+	}
+
+	/* the read thread may still be inside a read it started before the relay did, leave the packet to it */
+	if (switch_mutex_trylock(src->read_mutex) != SWITCH_STATUS_SUCCESS) {
+		return;
+	}
+
+	if (switch_socket_recvfrom(src->from_addr, src->sock_input, 0, (void *) msg, &bytes) != SWITCH_STATUS_SUCCESS ||
+		bytes <= rtp_header_len || msg->header.version != 2) {
 		goto end;
 	}
 
-	if ((ice->type & ICE_VANILLA)) {
-		if (!ok) ok = !memcmp(packet->header.id, ice->last_sent_id, 12);
+	/* rtcp muxed onto the rtp port */
+	if (msg->header.pt >= 64 && msg->header.pt <= 95) {
+		goto end;
+	}
 
-		if (packet->header.type == SWITCH_STUN_BINDING_RESPONSE) {
-			ok = 1;
+	/* digits have to reach the core, the first event packet is lost but RFC4733 repeats it every packet interval */
+	if (msg->header.pt == src->recv_te) {
+		src->relay_fallback = 1;
+		worker->dirty = 1;
+		goto end;
+	}
 
-			if (rtp_session->flags[SWITCH_RTP_FLAG_RTCP_MUX]) {
-				rtp_session->ice.rready = 1;
-				rtp_session->rtcp_ice.rready = 1;
-			} else {
-				ice->rready = 1;
-			}
+#ifdef ENABLE_SRTP
+	if (src->flags[SWITCH_RTP_FLAG_SECURE_RECV]) {
+		int sbytes = (int) bytes;
+		srtp_err_status_t stat;
+
+		switch_mutex_lock(src->ice_mutex);
+		if (src->flags[SWITCH_RTP_FLAG_SECURE_RECV_RESET] || !src->recv_ctx[src->srtp_idx_rtp]) {
+			/* re-keyed, the read thread recreates the context */
+			switch_mutex_unlock(src->ice_mutex);
+			src->relay_fallback = 1;
+			worker->dirty = 1;
+			goto end;
+		}
 
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG6, "Received STUN Binding Response from %s\n", from_host);
+		if (!src->flags[SWITCH_RTP_FLAG_SECURE_RECV_MKI]) {
+			stat = srtp_unprotect(src->recv_ctx[src->srtp_idx_rtp], &msg->header, &sbytes);
+		} else {
+			stat = srtp_unprotect_mki(src->recv_ctx[src->srtp_idx_rtp], &msg->header, &sbytes, 1);
+		}
+		switch_mutex_unlock(src->ice_mutex);
 
-			if (ice->ice_params) {
-				for (i = 0; i < ice->ice_params->cand_idx[ice->proto]; i++) {
-					if (!strcmp(ice->ice_params->cands[i][ice->proto].con_addr, from_host) && ice->ice_params->cands[i][ice->proto].con_port == from_port) {
-						ice->ice_params->cands[i][ice->proto].responsive = 1;
-						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG5, "Marked ICE candidate %s:%d as responsive\n", ice->ice_params->cands[i][ice->proto].con_addr, ice->ice_params->cands[i][ice->proto].con_port);
-						if (!strcmp(ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].con_addr, from_host) && ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].con_port == from_port) {
-							ice->cand_responsive = 1;
+		if (stat) {
+			src->srtp_errs[src->srtp_idx_rtp]++;
+			goto end;
+		}
+
+		bytes = sbytes;
+	}
+#endif
+
+	if (src->flags[SWITCH_RTP_FLAG_ENABLE_RTCP]) {
+		/* the read thread still reports on what this session receives */
+		src->last_rtp_hdr = msg->header;
+		rtcp_stats(src);
+	}
+
+	if (msg->header.pt == src->cng_pt) {
+		if (dst->cng_pt == INVALID_PT) {
+			goto end;
+		}
+		msg->header.pt = dst->cng_pt;
+	} else {
+		msg->header.pt = dst->payload;
+	}
+
+	ts = ntohl(msg->header.ts);
+	seq = ntohs(msg->header.seq);
+
+	if (!src->relay_synced) {
+		/* carry on from the peer's last timestamp so the far end sees one continuous stream */
+		src->relay_ts_offset = dst->last_write_ts + dst->samples_per_interval - ts;
+		src->relay_synced = 1;
+	} else {
+		gap = (uint16_t) (seq - src->relay_last_seq);
+
+		if (!gap || gap > 0x8000) {
+			/* duplicate or late, there is no jitter buffer to put it back in order */
+			goto end;
+		}
+
+		if (gap > 1 && gap < 100) {
+			/* keep the loss visible to the far end, rtp_common_write adds the last one */
+			switch_mutex_lock(dst->write_mutex);
+			dst->seq += gap - 1;
+			switch_mutex_unlock(dst->write_mutex);
+		}
+	}
+
+	src->relay_last_seq = seq;
+	msg->header.ts = htonl(ts + src->relay_ts_offset);
+
+	switch_mutex_lock(src->flag_mutex);
+	src->stats.inbound.raw_bytes += bytes;
+	src->stats.inbound.packet_count++;
+	if (msg->header.pt == dst->cng_pt) {
+		src->stats.inbound.cng_packet_count++;
+	} else {
+		src->stats.inbound.media_packet_count++;
+		src->stats.inbound.media_bytes += bytes;
+	}
+	switch_mutex_unlock(src->flag_mutex);
+	src->last_media = switch_micro_time_now();
+	src->missed_count = 0;
+
+	rtp_common_write(dst, msg, NULL, (uint32_t) bytes, msg->header.pt, 0, &flags);
+
+ end:
+	switch_mutex_unlock(src->read_mutex);
+}
+
+static void *SWITCH_THREAD_FUNC rtp_relay_thread(switch_thread_t *thread, void *obj)
+{
+	rtp_relay_worker_t *worker = (rtp_relay_worker_t *) obj;
+	switch_memory_pool_t *pool = NULL;
+	switch_pollset_t *pollset = NULL;
+	uint32_t polled = 0;
+
+	while (rtp_relay.running) {
+		const switch_pollfd_t *fds = NULL;
+		int32_t i, n = 0;
+
+		if (worker->dirty) {
+			uint32_t x;
+
+			/* the pollset only ever changes here, so it needs no locking of its own */
+			switch_mutex_lock(worker->mutex);
+			worker->dirty = 0;
+			polled = 0;
+			pollset = NULL;
+
+			if (pool) {
+				switch_core_destroy_memory_pool(&pool);
+			}
+
+			if (worker->count) {
+				switch_core_new_memory_pool(&pool);
+				switch_pollset_create(&pollset, worker->count, pool, 0);
+
+				for (x = 0; pollset && x < worker->count; x++) {
+					switch_rtp_t *src = worker->sessions[x];
+
+					worker->pollgens[x] = 0;
+
+					if (src->relay_fallback) {
+						continue;
+					}
+
+					memset(&worker->pollfds[x], 0, sizeof(worker->pollfds[x]));
+					worker->pollfds[x].p = pool;
+					worker->pollfds[x].desc_type = SWITCH_POLL_SOCKET;
+					worker->pollfds[x].reqevents = SWITCH_POLLIN;
+					worker->pollfds[x].desc.s = src->sock_input;
+					worker->pollfds[x].client_data = (void *) (intptr_t) x;
+					worker->pollgens[x] = worker->gens[x];
+
+					if (switch_pollset_add(pollset, &worker->pollfds[x]) == SWITCH_STATUS_SUCCESS) {
+						polled++;
+					}
+				}
+			}
+			switch_mutex_unlock(worker->mutex);
+		}
+
+		if (!polled) {
+			switch_yield(RTP_RELAY_POLL_USEC);
+			continue;
+		}
+
+		if (switch_pollset_poll(pollset, RTP_RELAY_POLL_USEC, &n, &fds) != SWITCH_STATUS_SUCCESS) {
+			continue;
+		}
+
+		switch_mutex_lock(worker->mutex);
+		for (i = 0; i < n; i++) {
+			/* a session unlinked since the poll started may be gone already, only touch the links still here */
+			switch_rtp_t *src = rtp_relay_linked(worker, (uint32_t) (intptr_t) fds[i].client_data);
+
+			if (src) {
+				rtp_relay_forward(worker, src);
+			}
+		}
+		switch_mutex_unlock(worker->mutex);
+	}
+
+	if (pool) {
+		switch_core_destroy_memory_pool(&pool);
+	}
+
+	return NULL;
+}
+
+/* caller holds rtp_relay.mutex */
+static switch_status_t rtp_relay_start_workers(void)
+{
+	switch_threadattr_t *thd_attr = NULL;
+	uint32_t x;
+
+	if (rtp_relay.running) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	if (!(rtp_relay.worker_count = switch_core_cpu_count())) {
+		rtp_relay.worker_count = 1;
+	} else if (rtp_relay.worker_count > RTP_RELAY_MAX_WORKERS) {
+		rtp_relay.worker_count = RTP_RELAY_MAX_WORKERS;
+	}
+
+	rtp_relay.workers = switch_core_alloc(rtp_relay.pool, sizeof(*rtp_relay.workers) * rtp_relay.worker_count);
+	rtp_relay.running = 1;
+
+	for (x = 0; x < rtp_relay.worker_count; x++) {
+		switch_mutex_init(&rtp_relay.workers[x].mutex, SWITCH_MUTEX_NESTED, rtp_relay.pool);
+		switch_threadattr_create(&thd_attr, rtp_relay.pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		switch_threadattr_priority_set(thd_attr, SWITCH_PRI_REALTIME);
+		switch_thread_create(&rtp_relay.workers[x].thread, thd_attr, rtp_relay_thread, &rtp_relay.workers[x], rtp_relay.pool);
+	}
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %u RTP relay workers\n", rtp_relay.worker_count);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void rtp_relay_init(switch_memory_pool_t *pool)
+{
+	rtp_relay.pool = pool;
+	switch_mutex_init(&rtp_relay.mutex, SWITCH_MUTEX_NESTED, pool);
+}
+
+static void rtp_relay_destroy(void)
+{
+	switch_status_t st;
+	uint32_t x;
+
+	if (!rtp_relay.running) {
+		return;
+	}
+
+	rtp_relay.running = 0;
+
+	for (x = 0; x < rtp_relay.worker_count; x++) {
+		switch_thread_join(&st, rtp_relay.workers[x].thread);
+		rtp_relay.workers[x].thread = NULL;
+	}
+}
+
+static int rtp_relay_capable(switch_rtp_t *rtp_session)
+{
+	return switch_rtp_ready(rtp_session) && rtp_session->sock_input && rtp_session->remote_addr &&
+		!rtp_session->flags[SWITCH_RTP_FLAG_VIDEO] && !rtp_session->flags[SWITCH_RTP_FLAG_TEXT] &&
+		!rtp_session->flags[SWITCH_RTP_FLAG_UDPTL] && !rtp_session->flags[SWITCH_RTP_FLAG_PROXY_MEDIA] &&
+		!rtp_session->flags[SWITCH_RTP_FLAG_AUTOADJ] && !rtp_session->flags[SWITCH_RTP_FLAG_RTCP_MUX] &&
+		!rtp_session->flags[SWITCH_RTP_FLAG_PAUSE] && !rtp_session->ice.ice_user && !rtp_session->dtls &&
+		!rtp_session->dtmf_data.in_digit_ts && !rtp_session->sending_dtmf &&
+		rtp_session->relay_holdoff <= switch_micro_time_now();
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_relay_start(switch_rtp_t *rtp_session, switch_rtp_t *peer_session)
+{
+	rtp_relay_worker_t *worker = NULL;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+	uint32_t x;
+
+	if (!rtp_session || !peer_session || rtp_session == peer_session || !rtp_relay.mutex) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(rtp_relay.mutex);
+
+	if (rtp_session->relay_worker && rtp_session->relay_fallback) {
+		rtp_session->relay_holdoff = switch_micro_time_now() + RTP_RELAY_HOLDOFF_USEC;
+		rtp_relay_unlink(rtp_session);
+	}
+
+	if (!rtp_relay_capable(rtp_session) || !rtp_relay_capable(peer_session) ||
+		(peer_session->relay_from && peer_session->relay_from != rtp_session) ||
+		rtp_session->samples_per_interval != peer_session->samples_per_interval) {
+		if (rtp_session->relay_worker) {
+			rtp_relay_unlink(rtp_session);
+		}
+		goto end;
+	}
+
+	if (rtp_session->relay_worker) {
+		if (rtp_session->relay_peer == peer_session) {
+			status = SWITCH_STATUS_SUCCESS;
+			goto end;
+		}
+		rtp_relay_unlink(rtp_session);
+	}
+
+	if (rtp_relay_start_workers() != SWITCH_STATUS_SUCCESS) {
+		goto end;
+	}
+
+	for (x = 0; x < rtp_relay.worker_count; x++) {
+		if (rtp_relay.workers[x].count < RTP_RELAY_WORKER_SESSIONS && (!worker || rtp_relay.workers[x].count < worker->count)) {
+			worker = &rtp_relay.workers[x];
+		}
+	}
+
+	if (!worker) {
+		goto end;
+	}
+
+	switch_mutex_lock(worker->mutex);
+	rtp_session->relay_synced = 0;
+	rtp_session->relay_fallback = 0;
+	rtp_session->relay_peer = peer_session;
+	peer_session->relay_from = rtp_session;
+	rtp_session->relay_worker = worker;
+	if (!++rtp_relay.gen) {
+		rtp_relay.gen++;
+	}
+	worker->gens[worker->count] = rtp_relay.gen;
+	worker->sessions[worker->count++] = rtp_session;
+	worker->dirty = 1;
+	switch_mutex_unlock(worker->mutex);
+
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG, "Relaying %s to %s:%d\n",
+					  rtp_type(rtp_session), peer_session->eff_remote_host_str, peer_session->eff_remote_port);
+
+	status = SWITCH_STATUS_SUCCESS;
+
+ end:
+	switch_mutex_unlock(rtp_relay.mutex);
+
+	return status;
+}
+
+SWITCH_DECLARE(void) switch_rtp_relay_stop(switch_rtp_t *rtp_session)
+{
+	if (!rtp_session || !rtp_relay.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_relay.mutex);
+	if (rtp_session->relay_worker) {
+		rtp_relay_unlink(rtp_session);
+	}
+
+	if (rtp_session->relay_from) {
+		rtp_relay_unlink(rtp_session->relay_from);
+	}
+	switch_mutex_unlock(rtp_relay.mutex);
+}
+
+SWITCH_DECLARE(switch_bool_t) switch_rtp_relaying(switch_rtp_t *rtp_session)
+{
+	return (rtp_session && rtp_session->relay_worker && !rtp_session->relay_fallback) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+/*
+ * RTP quality telemetry: the read thread already keeps jitter, loss and MOS in rtp_session->stats and
+ * the RTCP path keeps the RTT.  Every interval a scheduler task walks the active audio sessions, reads
+ * those numbers without taking any session lock and drops one sample per session into histograms kept
+ * per gateway or profile, so a degrading trunk shows up live instead of at hangup.  A session's group is
+ * picked once when it is created, so the sampler never touches channel variables.
+ */
+#define RTP_TELEMETRY_BUCKETS 10
+#define RTP_TELEMETRY_MAX_GROUPS 1024
+
+typedef enum {
+	RTP_TELEMETRY_JITTER,
+	RTP_TELEMETRY_LOSS,
+	RTP_TELEMETRY_MOS,
+	RTP_TELEMETRY_RTT,
+	RTP_TELEMETRY_METRICS
+} rtp_telemetry_metric_t;
+
+typedef struct {
+	uint64_t buckets[RTP_TELEMETRY_BUCKETS];
+	uint64_t count;
+	double sum;
+} rtp_telemetry_hist_t;
+
+typedef struct rtp_telemetry_group_s {
+	const char *kind;
+	char *name;
+	uint32_t sessions;
+	rtp_telemetry_hist_t hist[RTP_TELEMETRY_METRICS];
+	struct rtp_telemetry_group_s *next;
+} rtp_telemetry_group_t;
+
+/* the last bucket of every histogram is +Inf */
+static const struct {
+	const char *name;
+	const char *help;
+	double bounds[RTP_TELEMETRY_BUCKETS - 1];
+} rtp_telemetry_metrics[RTP_TELEMETRY_METRICS] = {
+	{ "freeswitch_rtp_jitter_ms", "Inbound RTP interarrival jitter over the sample interval",
+	  { 1, 2, 5, 10, 20, 30, 50, 100, 200 } },
+	{ "freeswitch_rtp_loss_percent", "Inbound RTP packets lost over the sample interval",
+	  { 0, 0.5, 1, 2, 3, 5, 10, 20, 50 } },
+	{ "freeswitch_rtp_mos", "Inbound RTP estimated MOS",
+	  { 1, 2, 2.5, 3, 3.5, 3.8, 4, 4.2, 4.4 } },
+	{ "freeswitch_rtp_rtt_ms", "RTCP round trip time",
+	  { 10, 25, 50, 100, 150, 200, 300, 500, 1000 } }
+};
+
+static struct {
+	switch_rtp_t *sessions;
+	rtp_telemetry_group_t *groups;
+	rtp_telemetry_group_t *default_group;
+	switch_hash_t *group_hash;
+	uint32_t group_count;
+	uint32_t task_id;
+	switch_mutex_t *mutex;
+	switch_memory_pool_t *pool;
+} rtp_telemetry;
+
+static uint32_t TELEMETRY_INTERVAL = 10;
+
+/* returns NULL once RTP_TELEMETRY_MAX_GROUPS named groups exist */
+static rtp_telemetry_group_t *rtp_telemetry_find_group(const char *kind, const char *name)
+{
+	rtp_telemetry_group_t *group = NULL;
+	char key[256];
+
+	switch_snprintf(key, sizeof(key), "%s:%s", kind, name);
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+
+	if (rtp_telemetry.group_hash && !(group = switch_core_hash_find(rtp_telemetry.group_hash, key)) &&
+		rtp_telemetry.group_count < RTP_TELEMETRY_MAX_GROUPS) {
+		group = switch_core_alloc(rtp_telemetry.pool, sizeof(*group));
+		group->kind = kind;
+		group->name = switch_core_strdup(rtp_telemetry.pool, name);
+		group->next = rtp_telemetry.groups;
+		rtp_telemetry.groups = group;
+		rtp_telemetry.group_count++;
+		switch_core_hash_insert(rtp_telemetry.group_hash, key, group);
+	}
+
+	switch_mutex_unlock(rtp_telemetry.mutex);
+
+	return group;
+}
+
+/* called without rtp_telemetry.mutex, the channel variable lookups take the channel's own locks */
+static rtp_telemetry_group_t *rtp_telemetry_resolve_group(switch_rtp_t *rtp_session)
+{
+	rtp_telemetry_group_t *group = NULL;
+
+	if (rtp_session->session) {
+		switch_channel_t *channel = switch_core_session_get_channel(rtp_session->session);
+		static const char *vars[][2] = {
+			{ "rtp_telemetry_group", "group" },
+			{ "sip_gateway_name", "gateway" },
+			{ "sip_gateway", "gateway" },
+			{ "sofia_profile_name", "profile" }
+		};
+		int i;
+
+		for (i = 0; i < (int) (sizeof(vars) / sizeof(vars[0])) && !group; i++) {
+			const char *val = switch_channel_get_variable_dup(channel, vars[i][0], SWITCH_FALSE, -1);
+			char name[128];
+
+			if (!zstr(val)) {
+				switch_copy_string(name, val, sizeof(name));
+				group = rtp_telemetry_find_group(vars[i][1], name);
+			}
+		}
+	}
+
+	/* the default group is created at init and never counts against the cap */
+	return group ? group : rtp_telemetry.default_group;
+}
+
+static void rtp_telemetry_observe(rtp_telemetry_group_t *group, rtp_telemetry_metric_t metric, double val)
+{
+	rtp_telemetry_hist_t *hist = &group->hist[metric];
+	int i;
+
+	for (i = 0; i < RTP_TELEMETRY_BUCKETS - 1; i++) {
+		if (val <= rtp_telemetry_metrics[metric].bounds[i]) {
+			break;
+		}
+	}
+
+	hist->buckets[i]++;
+	hist->count++;
+	hist->sum += val;
+}
+
+/* caller holds rtp_telemetry.mutex */
+static void rtp_telemetry_sample_session(switch_rtp_t *rtp_session)
+{
+	switch_rtp_numbers_t *in = &rtp_session->stats.inbound;
+	rtp_telemetry_group_t *group;
+	switch_size_t recved, flaws, d_recved, d_flaws;
+	int64_t jitter_n, jitter_addsq;
+	int i;
+
+	if (!switch_rtp_ready(rtp_session) || rtp_session->flags[SWITCH_RTP_FLAG_VIDEO] || rtp_session->flags[SWITCH_RTP_FLAG_TEXT]) {
+		return;
+	}
+
+	if (!(group = rtp_session->telemetry_group)) {
+		return;
+	}
+
+	group->sessions++;
+
+	/* plain reads of counters only the read thread writes, a torn or stale value costs one sample at most */
+	recved = (switch_size_t) in->recved;
+	flaws = in->flaws;
+	jitter_n = in->jitter_n;
+	jitter_addsq = in->jitter_addsq;
+
+	/* the stats go backwards when the stream is reset or do_mos clamps the flaws */
+	if (recved < rtp_session->telemetry_recved) rtp_session->telemetry_recved = 0;
+	if (flaws < rtp_session->telemetry_flaws) rtp_session->telemetry_flaws = 0;
+	if (jitter_n < rtp_session->telemetry_jitter_n || jitter_addsq < rtp_session->telemetry_jitter_addsq) {
+		rtp_session->telemetry_jitter_n = rtp_session->telemetry_jitter_addsq = 0;
+	}
+
+	d_recved = recved - rtp_session->telemetry_recved;
+	d_flaws = flaws - rtp_session->telemetry_flaws;
+
+	/* nothing came in this interval (hold, no media yet), nothing to say about the stream */
+	if (d_recved) {
+		if (jitter_n > rtp_session->telemetry_jitter_n) {
+			rtp_telemetry_observe(group, RTP_TELEMETRY_JITTER,
+								  sqrt((double) (jitter_addsq - rtp_session->telemetry_jitter_addsq) / (double) (jitter_n - rtp_session->telemetry_jitter_n)));
+		}
+
+		rtp_telemetry_observe(group, RTP_TELEMETRY_LOSS, (double) d_flaws * 100.0 / (double) (d_recved + d_flaws));
+		rtp_telemetry_observe(group, RTP_TELEMETRY_MOS, in->mos);
+	}
+
+	/* the average only moves when a report comes in, sampling it again without one would weight quiet peers */
+	if (rtp_session->rtt_reports != rtp_session->telemetry_rtt_reports) {
+		for (i = 0; i < rtp_session->rtcp_frame.report_count && i < MAX_REPORT_BLOCKS; i++) {
+			double rtt = rtp_session->rtcp_frame.reports[i].rtt_avg;
+
+			if (rtt > 0) {
+				rtp_telemetry_observe(group, RTP_TELEMETRY_RTT, rtt * 1000);
+				break;
+			}
+		}
+
+		rtp_session->telemetry_rtt_reports = rtp_session->rtt_reports;
+	}
+
+	rtp_session->telemetry_recved = recved;
+	rtp_session->telemetry_flaws = flaws;
+	rtp_session->telemetry_jitter_n = jitter_n;
+	rtp_session->telemetry_jitter_addsq = jitter_addsq;
+}
+
+SWITCH_DECLARE(void) switch_rtp_telemetry_sample(void)
+{
+	rtp_telemetry_group_t *group;
+	switch_rtp_t *rtp_session;
+
+	if (!rtp_telemetry.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+
+	for (group = rtp_telemetry.groups; group; group = group->next) {
+		group->sessions = 0;
+	}
+
+	for (rtp_session = rtp_telemetry.sessions; rtp_session; rtp_session = rtp_session->telemetry_next) {
+		rtp_telemetry_sample_session(rtp_session);
+	}
+
+	switch_mutex_unlock(rtp_telemetry.mutex);
+}
+
+static void rtp_telemetry_add(switch_rtp_t *rtp_session)
+{
+	if (!rtp_telemetry.mutex) {
+		return;
+	}
+
+	rtp_session->telemetry_group = rtp_telemetry_resolve_group(rtp_session);
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+	rtp_session->telemetry_prev = NULL;
+	rtp_session->telemetry_next = rtp_telemetry.sessions;
+	if (rtp_session->telemetry_next) {
+		rtp_session->telemetry_next->telemetry_prev = rtp_session;
+	}
+	rtp_telemetry.sessions = rtp_session;
+	rtp_session->on_telemetry = 1;
+	switch_mutex_unlock(rtp_telemetry.mutex);
+}
+
+static void rtp_telemetry_del(switch_rtp_t *rtp_session)
+{
+	if (!rtp_telemetry.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+	if (rtp_session->on_telemetry) {
+		if (rtp_session->telemetry_prev) {
+			rtp_session->telemetry_prev->telemetry_next = rtp_session->telemetry_next;
+		} else {
+			rtp_telemetry.sessions = rtp_session->telemetry_next;
+		}
+
+		if (rtp_session->telemetry_next) {
+			rtp_session->telemetry_next->telemetry_prev = rtp_session->telemetry_prev;
+		}
+
+		rtp_session->telemetry_next = rtp_session->telemetry_prev = NULL;
+		rtp_session->on_telemetry = 0;
+	}
+	switch_mutex_unlock(rtp_telemetry.mutex);
+}
+
+SWITCH_STANDARD_SCHED_FUNC(rtp_telemetry_callback)
+{
+	switch_rtp_telemetry_sample();
+
+	if (TELEMETRY_INTERVAL) {
+		task->runtime = switch_epoch_time_now(NULL) + TELEMETRY_INTERVAL;
+	}
+}
+
+static void rtp_telemetry_init(switch_memory_pool_t *pool)
+{
+	rtp_telemetry.pool = pool;
+	switch_mutex_init(&rtp_telemetry.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&rtp_telemetry.group_hash);
+	rtp_telemetry.default_group = rtp_telemetry_find_group("default", "default");
+
+	if (TELEMETRY_INTERVAL) {
+		rtp_telemetry.task_id = switch_scheduler_add_task(switch_epoch_time_now(NULL) + TELEMETRY_INTERVAL, rtp_telemetry_callback,
+														  "rtp_telemetry", "core", 0, NULL, SSHF_NONE | SSHF_NO_DEL);
+	}
+}
+
+static void rtp_telemetry_destroy(void)
+{
+	if (!rtp_telemetry.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+	switch_core_hash_destroy(&rtp_telemetry.group_hash);
+	rtp_telemetry.groups = rtp_telemetry.default_group = NULL;
+	rtp_telemetry.group_count = 0;
+	switch_mutex_unlock(rtp_telemetry.mutex);
+}
+
+static void rtp_telemetry_write_label(switch_stream_handle_t *stream, rtp_telemetry_group_t *group)
+{
+	const char *p;
+
+	stream->write_function(stream, "kind=\"%s\",name=\"", group->kind);
+
+	for (p = group->name; *p; p++) {
+		if (*p == '\\' || *p == '"') {
+			stream->write_function(stream, "\\%c", *p);
+		} else if (*p == '\n') {
+			stream->write_function(stream, "\\n");
+		} else {
+			stream->write_function(stream, "%c", *p);
+		}
+	}
+
+	stream->write_function(stream, "\"");
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_telemetry_write(switch_stream_handle_t *stream, switch_bool_t reset)
+{
+	rtp_telemetry_group_t *group;
+	int m, i;
+
+	if (!rtp_telemetry.mutex) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(rtp_telemetry.mutex);
+
+	stream->write_function(stream, "# HELP freeswitch_rtp_sessions Active audio RTP sessions at the last sample\n");
+	stream->write_function(stream, "# TYPE freeswitch_rtp_sessions gauge\n");
+
+	for (group = rtp_telemetry.groups; group; group = group->next) {
+		stream->write_function(stream, "freeswitch_rtp_sessions{");
+		rtp_telemetry_write_label(stream, group);
+		stream->write_function(stream, "} %u\n", group->sessions);
+	}
+
+	for (m = 0; m < RTP_TELEMETRY_METRICS; m++) {
+		const char *name = rtp_telemetry_metrics[m].name;
+
+		stream->write_function(stream, "# HELP %s %s\n", name, rtp_telemetry_metrics[m].help);
+		stream->write_function(stream, "# TYPE %s histogram\n", name);
+
+		for (group = rtp_telemetry.groups; group; group = group->next) {
+			rtp_telemetry_hist_t *hist = &group->hist[m];
+			uint64_t total = 0;
+
+			for (i = 0; i < RTP_TELEMETRY_BUCKETS; i++) {
+				total += hist->buckets[i];
+				stream->write_function(stream, "%s_bucket{", name);
+				rtp_telemetry_write_label(stream, group);
+
+				if (i < RTP_TELEMETRY_BUCKETS - 1) {
+					stream->write_function(stream, ",le=\"%g\"} %" SWITCH_UINT64_T_FMT "\n", rtp_telemetry_metrics[m].bounds[i], total);
+				} else {
+					stream->write_function(stream, ",le=\"+Inf\"} %" SWITCH_UINT64_T_FMT "\n", total);
+				}
+			}
+
+			stream->write_function(stream, "%s_sum{", name);
+			rtp_telemetry_write_label(stream, group);
+			stream->write_function(stream, "} %f\n", hist->sum);
+			stream->write_function(stream, "%s_count{", name);
+			rtp_telemetry_write_label(stream, group);
+			stream->write_function(stream, "} %" SWITCH_UINT64_T_FMT "\n", hist->count);
+
+			if (reset) {
+				memset(hist, 0, sizeof(*hist));
+			}
+		}
+	}
+
+	switch_mutex_unlock(rtp_telemetry.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(void) switch_rtp_set_telemetry_interval(uint32_t seconds)
+{
+	TELEMETRY_INTERVAL = seconds;
+}
+
+int icecmp(const char *them, switch_rtp_ice_t *ice)
+{
+	if (strchr(them, ':')) {
+		return strcmp(them, ice->user_ice);
+	}
+
+	return strcmp(them, ice->luser_ice);
+}
+
+static void handle_ice(switch_rtp_t *rtp_session, switch_rtp_ice_t *ice, void *data, switch_size_t len)
+{
+	switch_stun_packet_t *packet;
+	switch_stun_packet_attribute_t *attr;
+	void *end_buf;
+	char username[STUN_USERNAME_MAX_SIZE] = { 0 };
+	unsigned char buf[1500] = { 0 };
+	switch_size_t cpylen = len;
+	int xlen = 0;
+	int ok = 1;
+	uint32_t *pri = NULL;
+	int is_rtcp = ice == &rtp_session->rtcp_ice;
+	switch_channel_t *channel;
+	int i;
+	switch_sockaddr_t *from_addr = rtp_session->from_addr;
+	const char *from_host = NULL;
+	switch_port_t from_port = 0;
+	char faddr_buf[80] = "";
+
+	if (is_rtcp) {
+		from_addr = rtp_session->rtcp_from_addr;
+	}
+
+	from_host = switch_get_addr(faddr_buf, sizeof(faddr_buf), from_addr);
+	from_port = switch_sockaddr_get_port(from_addr);
+
+	//if (rtp_session->flags[SWITCH_RTP_FLAG_VIDEO]) {
+	//	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "WTF OK %s CALL\n", rtp_type(rtp_session));
+	//}
+
+	if (!switch_rtp_ready(rtp_session) || zstr(ice->user_ice) || zstr(ice->ice_user)) {
+		return;
+	}
+
+	READ_INC(rtp_session);
+	WRITE_INC(rtp_session);
+
+	switch_mutex_lock(rtp_session->ice_mutex);
+
+	if (!switch_rtp_ready(rtp_session)) {
+		goto end;
+	}
+
+	if (cpylen > sizeof(buf)) {
+		cpylen = sizeof(buf);
+	}
+
+	channel = switch_core_session_get_channel(rtp_session->session);
+
+	memcpy(buf, data, cpylen);
+	packet = switch_stun_packet_parse(buf, (uint32_t)cpylen);
+	if (!packet) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "Invalid STUN/ICE packet received %ld bytes\n", (long)cpylen);
+		goto end;
+
+	}
+
+	rtp_session->last_stun = switch_micro_time_now();
+
+	if (!rtp_session->first_stun) {
+		rtp_session->first_stun = rtp_session->last_stun;
+	}
+
+	calc_elapsed(rtp_session, ice);
+
+	end_buf = buf + ((sizeof(buf) > packet->header.length) ? packet->header.length : sizeof(buf));
+
+	switch_stun_packet_first_attribute(packet, attr);
+	switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "%s STUN PACKET TYPE: %s\n",
+					  rtp_type(rtp_session), switch_stun_value_to_name(SWITCH_STUN_TYPE_PACKET_TYPE, packet->header.type));
+	do {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|---: %s STUN ATTR %d %x %s\n", rtp_type(rtp_session), attr->type, attr->type,
+						  switch_stun_value_to_name(SWITCH_STUN_TYPE_ATTRIBUTE, attr->type));
+
+		switch (attr->type) {
+		case SWITCH_STUN_ATTR_USE_CAND:
+			{
+				ice->rready = 1;
+				for (i = 0; i < ice->ice_params->cand_idx[ice->proto]; i++) {
+					if (!strcmp(ice->ice_params->cands[i][ice->proto].con_addr, from_host) && ice->ice_params->cands[i][ice->proto].con_port == from_port) {
+						ice->ice_params->cands[i][ice->proto].use_candidate = 1;
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG6, "Got USE-CANDIDATE on %s:%d\n", ice->ice_params->cands[i][ice->proto].con_addr, ice->ice_params->cands[i][ice->proto].con_port);
+					}
+				}
+			}
+			break;
+		case SWITCH_STUN_ATTR_ERROR_CODE:
+			{
+				switch_stun_error_code_t *err = (switch_stun_error_code_t *) attr->value;
+				uint32_t code = (err->code * 100) + err->number;
+
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s got %s stun binding response %u\n",
+								  rtp_session_name(rtp_session),
+								  rtp_type(rtp_session),
+								  code
+								  );
+
+				if ((ice->type & ICE_VANILLA) && code == 487) {
+					if ((ice->type & ICE_CONTROLLED)) {
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s STUN Changing role to CONTROLLING\n", rtp_type(rtp_session));
+						ice->type &= ~ICE_CONTROLLED;
+					} else {
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s STUN Changing role to CONTROLLED\n", rtp_type(rtp_session));
+						ice->type |= ICE_CONTROLLED;
+					}
+					packet->header.type = SWITCH_STUN_BINDING_RESPONSE;
+				}
+
+			}
+			break;
+		case SWITCH_STUN_ATTR_MAPPED_ADDRESS:
+			{
+				char ip[50];
+				uint16_t port;
+				switch_stun_packet_attribute_get_mapped_address(attr, ip, sizeof(ip), &port);
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s:%d\n", ip, port);
+			}
+			break;
+		case SWITCH_STUN_ATTR_XOR_MAPPED_ADDRESS:
+			{
+				char ip[50];
+				uint16_t port;
+				switch_stun_packet_attribute_get_xor_mapped_address(attr, &packet->header, ip, sizeof(ip), &port);
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s:%d\n", ip, port);
+			}
+			break;
+		case SWITCH_STUN_ATTR_USERNAME:
+			{
+				switch_stun_packet_attribute_get_username(attr, username, sizeof(username));
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %s\n", username);
+			}
+			break;
+
+		case SWITCH_STUN_ATTR_PRIORITY:
+			{
+				uint32_t priority = 0;
+				pri = (uint32_t *) attr->value;
+				priority = ntohl(*pri);
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG8, "|------: %u\n", priority);
+				ok = priority == ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].priority;
+			}
+			break;
+		}
+
+		if (!switch_stun_packet_next_attribute(attr, end_buf)) {
+			break;
+		}
+
+		xlen += 4 + switch_stun_attribute_padded_length(attr);
+	} while (xlen <= packet->header.length);
+
+	if ((ice->type & ICE_GOOGLE_JINGLE) && ok) {
+		ok = !strcmp(ice->user_ice, username);
+	}
+
+	if (packet->header.type != SWITCH_STUN_BINDING_REQUEST && packet->header.type != SWITCH_STUN_BINDING_RESPONSE) {
+		goto end;
+	}
+
+	if ((ice->type & ICE_VANILLA)) {
+		if (!ok) ok = !memcmp(packet->header.id, ice->last_sent_id, 12);
+
+		if (packet->header.type == SWITCH_STUN_BINDING_RESPONSE) {
+			ok = 1;
+
+			if (rtp_session->flags[SWITCH_RTP_FLAG_RTCP_MUX]) {
+				rtp_session->ice.rready = 1;
+				rtp_session->rtcp_ice.rready = 1;
+			} else {
+				ice->rready = 1;
+			}
+
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG6, "Received STUN Binding Response from %s\n", from_host);
+
+			if (ice->ice_params) {
+				for (i = 0; i < ice->ice_params->cand_idx[ice->proto]; i++) {
+					if (!strcmp(ice->ice_params->cands[i][ice->proto].con_addr, from_host) && ice->ice_params->cands[i][ice->proto].con_port == from_port) {
+						ice->ice_params->cands[i][ice->proto].responsive = 1;
+						switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG5, "Marked ICE candidate %s:%d as responsive\n", ice->ice_params->cands[i][ice->proto].con_addr, ice->ice_params->cands[i][ice->proto].con_port);
+						if (!strcmp(ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].con_addr, from_host) && ice->ice_params->cands[ice->ice_params->chosen[ice->proto]][ice->proto].con_port == from_port) {
+							ice->cand_responsive = 1;
 							ice->initializing = 0;
 							switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG5, "Chosen ICE candidate %s:%d is responsive\n", ice->ice_params->cands[i][ice->proto].con_addr, ice->ice_params->cands[i][ice->proto].con_port);
 						}
@@ -1540,7 +2659,10 @@ SWITCH_DECLARE(void) switch_rtp_init(switch_memory_pool_t *pool)
 	}
 #endif
 	switch_mutex_init(&port_lock, SWITCH_MUTEX_NESTED, pool);
-	switch_rtp_dtls_init();
+	switch_rtp_dtls_init(pool);
+	ice_agent_init(pool);
+	rtp_relay_init(pool);
+	rtp_telemetry_init(pool);
 	global_init = 1;
 }
 
@@ -2516,7 +3638,7 @@ static int check_rtcp_and_ice(switch_rtp_t *rtp_session)
 		}
 	}
 
-	if (rtp_session->ice.ice_user) {
+	if (rtp_session->ice.ice_user && !rtp_session->ice.on_wheel) {
 		if (ice_out(rtp_session, &rtp_session->ice, SWITCH_FALSE) == SWITCH_STATUS_GENERR) {
 			ret = -1;
 			goto end;
@@ -2524,7 +3646,7 @@ static int check_rtcp_and_ice(switch_rtp_t *rtp_session)
 	}
 
 	if (!rtp_session->flags[SWITCH_RTP_FLAG_RTCP_MUX]) {
-		if (rtp_session->rtcp_ice.ice_user) {
+		if (rtp_session->rtcp_ice.ice_user && !rtp_session->rtcp_ice.on_wheel) {
 			if (ice_out(rtp_session, &rtp_session->rtcp_ice, SWITCH_FALSE) == SWITCH_STATUS_GENERR) {
 				ret = -1;
 				goto end;
@@ -2579,6 +3701,9 @@ SWITCH_DECLARE(void) switch_rtp_shutdown(void)
 #ifdef ENABLE_SRTP
 	srtp_crypto_kernel_shutdown();
 #endif
+	ice_agent_destroy();
+	rtp_relay_destroy();
+	rtp_telemetry_destroy();
 	switch_rtp_dtls_destroy();
 }
 
@@ -3215,6 +4340,112 @@ static const char *dtls_state_names(dtls_state_t s)
 #define cr_saltlen 14
 #define cr_kslen 30
 
+/* caller holds dtls_globals.mutex */
+static void dtls_flush_sessions(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	for (hi = switch_core_hash_first(dtls_globals.sessions); hi; hi = switch_core_hash_next(&hi)) {
+		dtls_cached_session_t *cached;
+
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		if ((cached = (dtls_cached_session_t *) val)) {
+			SSL_SESSION_free(cached->session);
+			free(cached);
+		}
+	}
+
+	switch_core_hash_destroy(&dtls_globals.sessions);
+	switch_core_hash_init(&dtls_globals.sessions);
+	dtls_globals.session_count = 0;
+}
+
+static void dtls_record_handshake(switch_rtp_t *rtp_session, switch_dtls_t *dtls, int ok)
+{
+	switch_time_t elapsed;
+	int resumed, i;
+
+	if (dtls->stats_done) {
+		return;
+	}
+
+	dtls->stats_done = 1;
+	elapsed = dtls->hs_start ? switch_micro_time_now() - dtls->hs_start : 0;
+	resumed = ok && SSL_session_reused(dtls->ssl);
+
+	if (!dtls_globals.mutex) {
+		return;
+	}
+
+	switch_mutex_lock(dtls_globals.mutex);
+	if (ok) {
+		dtls_globals.stats.handshakes++;
+		dtls_globals.stats.total_usec += elapsed;
+		if ((uint64_t) elapsed > dtls_globals.stats.max_usec) {
+			dtls_globals.stats.max_usec = elapsed;
+		}
+		if (resumed) {
+			dtls_globals.stats.resumed++;
+		}
+		for (i = 0; dtls_hs_bounds_ms[i] && elapsed >= (switch_time_t) dtls_hs_bounds_ms[i] * 1000; i++);
+		dtls_globals.stats.hist[i]++;
+	} else {
+		dtls_globals.stats.failures++;
+	}
+	switch_mutex_unlock(dtls_globals.mutex);
+
+	if (ok) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_DEBUG, "%s DTLS handshake took %" SWITCH_TIME_T_FMT "ms%s\n",
+						  rtp_type(rtp_session), elapsed / 1000, resumed ? " (resumed)" : "");
+	}
+}
+
+/* remember a client session whose peer certificate matched the signalled fingerprint */
+static void dtls_cache_session(switch_dtls_t *dtls)
+{
+	dtls_cached_session_t *cached;
+	SSL_SESSION *session;
+
+	if (!dtls->fp_key || !dtls_globals.sessions || !(session = SSL_get1_session(dtls->ssl))) {
+		return;
+	}
+
+	switch_mutex_lock(dtls_globals.mutex);
+
+	if ((cached = switch_core_hash_find(dtls_globals.sessions, dtls->fp_key))) {
+		SSL_SESSION_free(cached->session);
+	} else {
+		if (dtls_globals.session_count >= DTLS_SESSION_CACHE_MAX) {
+			dtls_flush_sessions();
+		}
+
+		switch_zmalloc(cached, sizeof(*cached));
+		switch_core_hash_insert(dtls_globals.sessions, dtls->fp_key, cached);
+		dtls_globals.session_count++;
+	}
+
+	cached->session = session;
+	cached->expires = switch_epoch_time_now(NULL) + DTLS_SESSION_TIMEOUT;
+
+	switch_mutex_unlock(dtls_globals.mutex);
+}
+
+static void dtls_resume_session(switch_dtls_t *dtls)
+{
+	dtls_cached_session_t *cached;
+
+	if (!dtls->fp_key || !dtls_globals.sessions) {
+		return;
+	}
+
+	switch_mutex_lock(dtls_globals.mutex);
+	if ((cached = switch_core_hash_find(dtls_globals.sessions, dtls->fp_key)) && cached->expires > switch_epoch_time_now(NULL)) {
+		dtls->resume_attempt = SSL_set_session(dtls->ssl, cached->session) == 1;
+	}
+	switch_mutex_unlock(dtls_globals.mutex);
+}
+
 static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 {
 	X509 *cert;
@@ -3232,6 +4463,12 @@ static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 
 	if ((dtls->type & DTLS_TYPE_SERVER)) {
 		r = 1;
+	} else if (dtls->resume_attempt && SSL_session_reused(dtls->ssl)) {
+		/* the peer holds the master secret of a session already verified against this fingerprint */
+		r = 1;
+		switch_mutex_lock(dtls_globals.mutex);
+		dtls_globals.stats.verify_cache_hits++;
+		switch_mutex_unlock(dtls_globals.mutex);
 	} else if ((cert = SSL_get_peer_certificate(dtls->ssl))) {
 		switch_core_cert_extract_fingerprint(cert, dtls->remote_fp);
 		r = switch_core_cert_verify(dtls->remote_fp);
@@ -3240,6 +4477,7 @@ static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 
 	if (!r) {
 		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s Fingerprint Verification Failed!\n", rtp_type(rtp_session));
+		dtls_record_handshake(rtp_session, dtls, 0);
 		dtls_set_state(dtls, DS_FAIL);
 		return -1;
 	} else {
@@ -3250,6 +4488,7 @@ static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 #ifdef HAVE_OPENSSL_DTLS_SRTP
 		if (!SSL_export_keying_material(dtls->ssl, raw_key_data, sizeof(raw_key_data), "EXTRACTOR-dtls_srtp", 19, NULL, 0, 0)) {
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s Key material export failure\n", rtp_type(rtp_session));
+			dtls_record_handshake(rtp_session, dtls, 0);
 			dtls_set_state(dtls, DS_FAIL);
 			return -1;
 		}
@@ -3285,8 +4524,13 @@ static int dtls_state_setup(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_SEND, 0, &ssec);
 			switch_rtp_add_crypto_key(rtp_session, SWITCH_RTP_CRYPTO_RECV, 0, &ssec);
 		}
+
+		if ((dtls->type & DTLS_TYPE_CLIENT)) {
+			dtls_cache_session(dtls);
+		}
 	}
 
+	dtls_record_handshake(rtp_session, dtls, 1);
 	dtls_set_state(dtls, DS_READY);
 
 	return 0;
@@ -3332,6 +4576,7 @@ static int dtls_state_handshake(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 			break;
 		default:
 			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_WARNING, "%s Handshake failure %d. This may happen when you use legacy DTLS v1.0 (legacyDTLS channel var is set) but endpoint requires DTLS v1.2.\n", rtp_type(rtp_session), ret);
+			dtls_record_handshake(rtp_session, dtls, 0);
 			dtls_set_state(dtls, DS_FAIL);
 			return -1;
 		}
@@ -3352,26 +4597,160 @@ static void free_dtls(switch_dtls_t **dtlsp)
 		return;
 	}
 
-	dtls = *dtlsp;
-	*dtlsp = NULL;
+	dtls = *dtlsp;
+	*dtlsp = NULL;
+
+	if (dtls->flag_mutex) {
+		void *pop;
+
+		/* stop new work from being queued and wait for any worker still holding this handshake */
+		switch_mutex_lock(dtls->flag_mutex);
+		dtls->closing = 1;
+		while (dtls->queued) {
+			switch_thread_cond_wait(dtls->cond, dtls->flag_mutex);
+		}
+		switch_mutex_unlock(dtls->flag_mutex);
+
+		switch_mutex_lock(dtls->ssl_mutex);
+		switch_mutex_unlock(dtls->ssl_mutex);
+
+		while (dtls->pending && switch_queue_trypop(dtls->pending, &pop) == SWITCH_STATUS_SUCCESS) {
+			free(pop);
+		}
+	}
+
+	if (dtls->ssl) {
+		SSL_free(dtls->ssl);
+	}
+
+	if (dtls->ssl_ctx) {
+		SSL_CTX_free(dtls->ssl_ctx);
+	}
+}
+
+static void dtls_read_pending(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	void *pop;
+
+	while (dtls->pending && switch_queue_trypop(dtls->pending, &pop) == SWITCH_STATUS_SUCCESS) {
+		dtls_packet_t *pkt = (dtls_packet_t *) pop;
+		int ret = BIO_write(dtls->read_bio, pkt->data, (int)pkt->bytes);
+
+		if (ret <= 0) {
+			ret = SSL_get_error(dtls->ssl, ret);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet decode err: SSL err %d\n", rtp_type(rtp_session), ret);
+		}
+
+		free(pkt);
+	}
+}
+
+static void dtls_write_pending(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
+{
+	unsigned char buf[MAX_DTLS_MTU] = "";
+	switch_size_t bytes;
+	int ret, len, pending;
+
+	while ((pending = BIO_ctrl_pending(dtls->filter_bio)) > 0) {
+		switch_assert(pending <= sizeof(buf));
+
+		len = BIO_read(dtls->write_bio, buf, pending);
+		if (len > 0) {
+			bytes = len;
+			ret = switch_socket_sendto(dtls->sock_output, dtls->remote_addr, 0, (void *)buf, &bytes);
+
+			if (ret != SWITCH_STATUS_SUCCESS) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet not written to socket: %d\n", rtp_type(rtp_session), ret);
+			} else if (bytes != len) {
+				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet write err: written %d bytes instead of %d\n", rtp_type(rtp_session), (int)bytes, len);
+			}
+		} else {
+			ret = SSL_get_error(dtls->ssl, len);
+			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet encode err: SSL err %d\n", rtp_type(rtp_session), ret);
+		}
+	}
+}
+
+/* hand a handshake datagram to the crypto workers, the read thread never waits on the key exchange */
+static switch_status_t dtls_worker_push(switch_dtls_t *dtls)
+{
+	dtls_packet_t *pkt;
+	switch_status_t status = SWITCH_STATUS_FALSE;
+
+	if (!dtls->pending || !dtls_globals.running) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_zmalloc(pkt, sizeof(*pkt) + dtls->bytes);
+	pkt->bytes = dtls->bytes;
+	memcpy(pkt->data, dtls->data, dtls->bytes);
+
+	switch_mutex_lock(dtls->flag_mutex);
+	if (!dtls->closing && switch_queue_trypush(dtls->pending, pkt) == SWITCH_STATUS_SUCCESS) {
+		pkt = NULL;
+		status = SWITCH_STATUS_SUCCESS;
+
+		/* if every worker is backed up the packet stays pending and the next read picks it up inline */
+		if (!dtls->queued && switch_queue_trypush(dtls_globals.queue, dtls) == SWITCH_STATUS_SUCCESS) {
+			dtls->queued = 1;
+		}
+	}
+	switch_mutex_unlock(dtls->flag_mutex);
+
+	switch_safe_free(pkt);
+
+	return status;
+}
+
+static void dtls_worker_run(switch_dtls_t *dtls)
+{
+	switch_rtp_t *rtp_session = dtls->rtp_session;
+	uint8_t closing;
+
+	switch_mutex_lock(dtls->ssl_mutex);
+
+	switch_mutex_lock(dtls->flag_mutex);
+	dtls->queued = 0;
+	closing = dtls->closing;
+	switch_thread_cond_signal(dtls->cond);
+	switch_mutex_unlock(dtls->flag_mutex);
+
+	if (!closing) {
+		dtls_read_pending(rtp_session, dtls);
+
+		if (dtls->state == DS_HANDSHAKE) {
+			dtls_state_handshake(rtp_session, dtls);
+			dtls_write_pending(rtp_session, dtls);
+		}
+	}
+
+	switch_mutex_unlock(dtls->ssl_mutex);
+
+	switch_mutex_lock(dtls_globals.mutex);
+	dtls_globals.stats.offloaded++;
+	switch_mutex_unlock(dtls_globals.mutex);
+}
+
+static void *SWITCH_THREAD_FUNC dtls_worker_thread(switch_thread_t *thread, void *obj)
+{
+	void *pop = NULL;
 
-	if (dtls->ssl) {
-		SSL_free(dtls->ssl);
-	}
+	while (switch_queue_pop(dtls_globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+		if (!pop) {
+			break;
+		}
 
-	if (dtls->ssl_ctx) {
-		SSL_CTX_free(dtls->ssl_ctx);
+		dtls_worker_run((switch_dtls_t *) pop);
 	}
+
+	return NULL;
 }
 
 static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 {
-	int r = 0, ret = 0, len;
-	switch_size_t bytes;
-	unsigned char buf[MAX_DTLS_MTU] = "";
+	int r = 0, ret = 0;
 	uint8_t is_ice = rtp_session->ice.ice_user ? 1 : 0;
 	int ready = is_ice ? (rtp_session->ice.rready && rtp_session->ice.ready) : 1;
-	int pending;
 
 	if (!dtls->bytes && !ready) {
 		return 0;
@@ -3394,6 +4773,21 @@ static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 		return 0;
 	}
 
+	if (!dtls->hs_start && dtls->state == DS_HANDSHAKE) {
+		dtls->hs_start = switch_micro_time_now();
+	}
+
+	if (dtls->state == DS_HANDSHAKE && dtls->bytes > 0 && dtls->data && dtls_worker_push(dtls) == SWITCH_STATUS_SUCCESS) {
+		return 0;
+	}
+
+	if (switch_mutex_trylock(dtls->ssl_mutex) != SWITCH_STATUS_SUCCESS) {
+		/* a worker is in the middle of this handshake, pick up where it left off on the next read */
+		return 0;
+	}
+
+	dtls_read_pending(rtp_session, dtls);
+
 	if (dtls->bytes > 0 && dtls->data) {
 		ret = BIO_write(dtls->read_bio, dtls->data, (int)dtls->bytes);
 		if (ret <= 0) {
@@ -3408,24 +4802,9 @@ static int do_dtls(switch_rtp_t *rtp_session, switch_dtls_t *dtls)
 		r = dtls_states[dtls->state](rtp_session, dtls);
 	}
 
-	while ((pending = BIO_ctrl_pending(dtls->filter_bio)) > 0) {
-		switch_assert(pending <= sizeof(buf));
-
-		len = BIO_read(dtls->write_bio, buf, pending);
-		if (len > 0) {
-			bytes = len;
-			ret = switch_socket_sendto(dtls->sock_output, dtls->remote_addr, 0, (void *)buf, &bytes);
+	dtls_write_pending(rtp_session, dtls);
 
-			if (ret != SWITCH_STATUS_SUCCESS) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet not written to socket: %d\n", rtp_type(rtp_session), ret);
-			} else if (bytes != len) {
-				switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet write err: written %d bytes instead of %d\n", rtp_type(rtp_session), (int)bytes, len);
-			}
-		} else {
-			ret = SSL_get_error(dtls->ssl, len);
-			switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS packet encode err: SSL err %d\n", rtp_type(rtp_session), ret);
-		}
-	}
+	switch_mutex_unlock(dtls->ssl_mutex);
 
 	return r;
 }
@@ -3670,7 +5049,9 @@ static BIO_METHOD dtls_bio_filter_methods = {
 static BIO_METHOD *dtls_bio_filter_methods = NULL;
 #endif
 
-static void switch_rtp_dtls_init(void) {
+static void switch_rtp_dtls_init(switch_memory_pool_t *pool) {
+	int i;
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	dtls_bio_filter_methods = BIO_meth_new(BIO_TYPE_FILTER | BIO_get_new_index(), "DTLS filter");
 	BIO_meth_set_write(dtls_bio_filter_methods, dtls_bio_filter_write);
@@ -3678,9 +5059,89 @@ static void switch_rtp_dtls_init(void) {
 	BIO_meth_set_create(dtls_bio_filter_methods, dtls_bio_filter_new);
 	BIO_meth_set_destroy(dtls_bio_filter_methods, dtls_bio_filter_free);
 #endif
+
+	switch_mutex_init(&dtls_globals.mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_core_hash_init(&dtls_globals.sessions);
+
+	for (i = 0; i < SWITCH_RTP_DTLS_HIST_BUCKETS; i++) {
+		dtls_globals.stats.hist_bound_ms[i] = dtls_hs_bounds_ms[i];
+	}
+
+	dtls_globals.workers = DTLS_WORKERS;
+
+	if (dtls_globals.workers < 0) {
+		dtls_globals.workers = switch_core_cpu_count() / 4;
+		if (dtls_globals.workers < 1) {
+			dtls_globals.workers = 1;
+		}
+	}
+
+	if (dtls_globals.workers > DTLS_MAX_WORKERS) {
+		dtls_globals.workers = DTLS_MAX_WORKERS;
+	}
+
+	if (dtls_globals.workers) {
+		switch_threadattr_t *thd_attr = NULL;
+
+		switch_queue_create(&dtls_globals.queue, DTLS_WORKER_QUEUE_LEN, pool);
+		switch_threadattr_create(&thd_attr, pool);
+		switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+		dtls_globals.running = 1;
+
+		for (i = 0; i < dtls_globals.workers; i++) {
+			switch_thread_create(&dtls_globals.threads[i], thd_attr, dtls_worker_thread, NULL, pool);
+		}
+
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "Started %d DTLS handshake workers\n", dtls_globals.workers);
+	}
+
+	dtls_globals.stats.workers = dtls_globals.workers;
 }
 
 static void switch_rtp_dtls_destroy(void) {
+	int i, x;
+
+	if (dtls_globals.running) {
+		switch_status_t st;
+
+		dtls_globals.running = 0;
+
+		for (i = 0; i < dtls_globals.workers; i++) {
+			switch_queue_push(dtls_globals.queue, NULL);
+		}
+
+		for (i = 0; i < dtls_globals.workers; i++) {
+			switch_thread_join(&st, dtls_globals.threads[i]);
+			dtls_globals.threads[i] = NULL;
+		}
+
+		/* a worker that took its stop marker leaves the handshakes queued behind it, run them so nobody waits on queued */
+		{
+			void *pop = NULL;
+
+			while (switch_queue_trypop(dtls_globals.queue, &pop) == SWITCH_STATUS_SUCCESS) {
+				if (pop) {
+					dtls_worker_run((switch_dtls_t *) pop);
+				}
+			}
+		}
+	}
+
+	if (dtls_globals.mutex) {
+		switch_mutex_lock(dtls_globals.mutex);
+		for (i = 0; i < 2; i++) {
+			for (x = 0; x < 2; x++) {
+				if (dtls_globals.ctx[i][x]) {
+					SSL_CTX_free(dtls_globals.ctx[i][x]);
+					dtls_globals.ctx[i][x] = NULL;
+				}
+			}
+		}
+		dtls_flush_sessions();
+		switch_core_hash_destroy(&dtls_globals.sessions);
+		switch_mutex_unlock(dtls_globals.mutex);
+	}
+
 #if OPENSSL_VERSION_NUMBER >= 0x10100000L
 	if (dtls_bio_filter_methods) {
 		BIO_meth_free(dtls_bio_filter_methods);
@@ -3689,6 +5150,36 @@ static void switch_rtp_dtls_destroy(void) {
 #endif
 }
 
+SWITCH_DECLARE(void) switch_rtp_set_dtls_workers(int workers)
+{
+	DTLS_WORKERS = workers;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_get_dtls_stats(switch_rtp_dtls_stats_t *stats, switch_bool_t reset)
+{
+	if (!dtls_globals.mutex) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(dtls_globals.mutex);
+	dtls_globals.stats.cached_sessions = dtls_globals.session_count;
+	*stats = dtls_globals.stats;
+
+	if (reset) {
+		dtls_globals.stats.handshakes = 0;
+		dtls_globals.stats.failures = 0;
+		dtls_globals.stats.resumed = 0;
+		dtls_globals.stats.verify_cache_hits = 0;
+		dtls_globals.stats.offloaded = 0;
+		dtls_globals.stats.total_usec = 0;
+		dtls_globals.stats.max_usec = 0;
+		memset(dtls_globals.stats.hist, 0, sizeof(dtls_globals.stats.hist));
+	}
+	switch_mutex_unlock(dtls_globals.mutex);
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
 ///////////
 
 
@@ -3701,128 +5192,295 @@ SWITCH_DECLARE(int) switch_rtp_has_dtls(void) {
 #endif
 }
 
-SWITCH_DECLARE(dtls_state_t) switch_rtp_dtls_state(switch_rtp_t *rtp_session, dtls_type_t type)
-{
-	dtls_state_t s = DS_OFF;
+SWITCH_DECLARE(dtls_state_t) switch_rtp_dtls_state(switch_rtp_t *rtp_session, dtls_type_t type)
+{
+	dtls_state_t s = DS_OFF;
+
+	if (!rtp_session) {
+		return s;
+	}
+
+	switch_mutex_lock(rtp_session->ice_mutex);
+
+	if (!rtp_session->dtls && !rtp_session->rtcp_dtls) {
+		s = DS_OFF;
+		goto done;
+	}
+
+	if ((type == DTLS_TYPE_RTP) && rtp_session->dtls) {
+		s = rtp_session->dtls->state;
+		goto done;
+	}
+
+	if ((type == DTLS_TYPE_RTCP) && rtp_session->rtcp_dtls) {
+		s = rtp_session->rtcp_dtls->state;
+	}
+
+ done:
+
+	switch_mutex_unlock(rtp_session->ice_mutex);
+
+	return s;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_del_dtls(switch_rtp_t *rtp_session, dtls_type_t type)
+{
+	switch_status_t status = SWITCH_STATUS_SUCCESS;
+
+	if (!rtp_session) {
+		return SWITCH_STATUS_FALSE;
+	}
+
+	switch_mutex_lock(rtp_session->ice_mutex);
+
+	if (!rtp_session->dtls && !rtp_session->rtcp_dtls) {
+		switch_goto_status(SWITCH_STATUS_FALSE, done);
+	}
+
+	if ((type & DTLS_TYPE_RTP)) {
+		if (rtp_session->dtls && rtp_session->dtls == rtp_session->rtcp_dtls) {
+			rtp_session->rtcp_dtls = NULL;
+		}
+
+		if (rtp_session->dtls) {
+			free_dtls(&rtp_session->dtls);
+		}
+
+		if (rtp_session->jb) {
+			switch_jb_reset(rtp_session->jb);
+		}
+
+		if (rtp_session->vb) {
+			switch_jb_reset(rtp_session->vb);
+		}
+
+		if (rtp_session->vbw) {
+			switch_jb_reset(rtp_session->vbw);
+		}
+
+	}
+
+	if ((type & DTLS_TYPE_RTCP) && rtp_session->rtcp_dtls) {
+		free_dtls(&rtp_session->rtcp_dtls);
+	}
+
+
+#ifdef ENABLE_SRTP
+	if (rtp_session->flags[SWITCH_RTP_FLAG_SECURE_SEND]) {
+		int x;
+
+		rtp_session->flags[SWITCH_RTP_FLAG_SECURE_SEND] = 0;
+
+		for(x = 0; x < 2; x++) {
+			if (rtp_session->send_ctx[x]) {
+				srtp_dealloc(rtp_session->send_ctx[x]);
+				rtp_session->send_ctx[x] = NULL;
+			}
+		}
+	}
+
+	if (rtp_session->flags[SWITCH_RTP_FLAG_SECURE_RECV]) {
+		int x;
+
+		rtp_session->flags[SWITCH_RTP_FLAG_SECURE_RECV] = 0;
+
+		for (x = 0; x < 2; x++) {
+			if (rtp_session->recv_ctx[x]) {
+				srtp_dealloc(rtp_session->recv_ctx[x]);
+				rtp_session->recv_ctx[x] = NULL;
+			}
+		}
+	}
+#endif
+
+ done:
+
+	switch_mutex_unlock(rtp_session->ice_mutex);
+
+	return status;
+}
+
+static SSL_CTX *dtls_ctx_ref(SSL_CTX *ssl_ctx)
+{
+#if OPENSSL_VERSION_NUMBER >= 0x10100000L
+	SSL_CTX_up_ref(ssl_ctx);
+#else
+	CRYPTO_add(&ssl_ctx->references, 1, CRYPTO_LOCK_SSL_CTX);
+#endif
+	return ssl_ctx;
+}
+
+static SSL_CTX *dtls_new_ctx(switch_rtp_t *rtp_session, switch_dtls_t *dtls, dtls_type_t type, uint8_t want_DTLSv1_2)
+{
+	int ret;
+	unsigned long ssl_method_error = 0;
+	unsigned long ssl_ctx_error = 0;
+	const SSL_METHOD *ssl_method;
+	SSL_CTX *ssl_ctx;
+#if OPENSSL_VERSION_NUMBER < 0x30000000
+	BIO *bio;
+	DH *dh;
+#endif
+
+#if OPENSSL_VERSION_NUMBER >= 0x10100000
+	ssl_method = (type & DTLS_TYPE_SERVER) ? DTLS_server_method() : DTLS_client_method();
+#else
+    #ifdef HAVE_OPENSSL_DTLSv1_2_method
+		ssl_method = (type & DTLS_TYPE_SERVER) ? (want_DTLSv1_2 ? DTLSv1_2_server_method() : DTLSv1_server_method()) : (want_DTLSv1_2 ? DTLSv1_2_client_method() : DTLSv1_client_method());
+	#else
+		ssl_method = (type & DTLS_TYPE_SERVER) ? DTLSv1_server_method() : DTLSv1_client_method();
+    #endif // HAVE_OPENSSL_DTLSv1_2_method
+#endif
+
+	if (!ssl_method) {
+		ssl_method_error = ERR_peek_error();
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s ssl_method is NULL [%lu]\n", rtp_type(rtp_session), ssl_method_error);
+	}
+
+	ssl_ctx = SSL_CTX_new(ssl_method);
+
+	if (!ssl_ctx) {
+		ssl_ctx_error = ERR_peek_error();
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s SSL_CTX_new failed [%lu]\n", rtp_type(rtp_session), ssl_ctx_error);
+		switch_channel_hangup(switch_core_session_get_channel(rtp_session->session), SWITCH_CAUSE_NORMAL_TEMPORARY_FAILURE);
+		return NULL;
+	}
+
+
+#if OPENSSL_VERSION_NUMBER < 0x30000000
+	bio = BIO_new_file(dtls->pem, "r");
+	dh = PEM_read_bio_DHparams(bio, NULL, NULL, NULL);
+	BIO_free(bio);
+	if (dh) {
+		SSL_CTX_set_tmp_dh(ssl_ctx, dh);
+		DH_free(dh);
+	}
+#else
+	if(!SSL_CTX_set_dh_auto(ssl_ctx, 1)) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "Failed enable auto DH!\n");
+	}
+#endif
+	SSL_CTX_set_mode(ssl_ctx, SSL_MODE_AUTO_RETRY);
+
+	//SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
+	SSL_CTX_set_verify(ssl_ctx, SSL_VERIFY_NONE, NULL);
+
+	//SSL_CTX_set_cipher_list(ssl_ctx, "ECDH:!RC4:!SSLv3:RSA_WITH_AES_128_CBC_SHA");
+	//SSL_CTX_set_cipher_list(ssl_ctx, "ECDHE-RSA-AES256-GCM-SHA384");
+	SSL_CTX_set_cipher_list(ssl_ctx, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
+	//SSL_CTX_set_cipher_list(ssl_ctx, "SUITEB128");
+	SSL_CTX_set_read_ahead(ssl_ctx, 1);
+#ifdef HAVE_OPENSSL_DTLS_SRTP
+	//SSL_CTX_set_tlsext_use_srtp(ssl_ctx, "SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32");
+	SSL_CTX_set_tlsext_use_srtp(ssl_ctx, "SRTP_AES128_CM_SHA1_80");
+#endif
+
+	SSL_CTX_set_session_id_context(ssl_ctx, (const unsigned char *) "freeswitch-dtls", 15);
+	SSL_CTX_set_session_cache_mode(ssl_ctx, (type & DTLS_TYPE_SERVER) ? SSL_SESS_CACHE_SERVER : SSL_SESS_CACHE_OFF);
+	SSL_CTX_sess_set_cache_size(ssl_ctx, DTLS_SESSION_CACHE_MAX);
+	SSL_CTX_set_timeout(ssl_ctx, DTLS_SESSION_TIMEOUT);
 
-	if (!rtp_session) {
-		return s;
+	if ((ret=SSL_CTX_use_certificate_file(ssl_ctx, dtls->rsa, SSL_FILETYPE_PEM)) != 1) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS cert err [%d]\n", rtp_type(rtp_session), SSL_get_error(dtls->ssl, ret));
+		goto fail;
 	}
 
-	switch_mutex_lock(rtp_session->ice_mutex);
-
-	if (!rtp_session->dtls && !rtp_session->rtcp_dtls) {
-		s = DS_OFF;
-		goto done;
+	if ((ret=SSL_CTX_use_PrivateKey_file(ssl_ctx, dtls->pvt, SSL_FILETYPE_PEM)) != 1) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS key err [%d]\n", rtp_type(rtp_session), SSL_get_error(dtls->ssl, ret));
+		goto fail;
 	}
 
-	if ((type == DTLS_TYPE_RTP) && rtp_session->dtls) {
-		s = rtp_session->dtls->state;
-		goto done;
+	if (SSL_CTX_check_private_key(ssl_ctx) == 0) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS check key failed\n", rtp_type(rtp_session));
+		goto fail;
 	}
 
-	if ((type == DTLS_TYPE_RTCP) && rtp_session->rtcp_dtls) {
-		s = rtp_session->rtcp_dtls->state;
+	if (!zstr(dtls->ca) && switch_file_exists(dtls->ca, rtp_session->pool) == SWITCH_STATUS_SUCCESS
+		&& (ret = SSL_CTX_load_verify_locations(ssl_ctx, dtls->ca, NULL)) != 1) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS check chain cert failed [%d]\n",
+						  rtp_type(rtp_session) ,
+						  SSL_get_error(dtls->ssl, ret));
+		goto fail;
 	}
 
- done:
+	return ssl_ctx;
 
-	switch_mutex_unlock(rtp_session->ice_mutex);
+ fail:
 
-	return s;
+	SSL_CTX_free(ssl_ctx);
+
+	return NULL;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_rtp_del_dtls(switch_rtp_t *rtp_session, dtls_type_t type)
+/* sha-256 of the certificate in file, 0 if it can't be read */
+static unsigned int dtls_cert_digest(const char *file, unsigned char *md)
 {
-	switch_status_t status = SWITCH_STATUS_SUCCESS;
+	unsigned int len = 0;
+	X509 *x509;
+	BIO *bio;
 
-	if (!rtp_session) {
-		return SWITCH_STATUS_FALSE;
+	if (!(bio = BIO_new_file(file, "r"))) {
+		return 0;
 	}
 
-	switch_mutex_lock(rtp_session->ice_mutex);
+	x509 = PEM_read_bio_X509(bio, NULL, NULL, NULL);
+	BIO_free(bio);
 
-	if (!rtp_session->dtls && !rtp_session->rtcp_dtls) {
-		switch_goto_status(SWITCH_STATUS_FALSE, done);
+	if (!x509) {
+		return 0;
 	}
 
-	if ((type & DTLS_TYPE_RTP)) {
-		if (rtp_session->dtls && rtp_session->dtls == rtp_session->rtcp_dtls) {
-			rtp_session->rtcp_dtls = NULL;
-		}
-
-		if (rtp_session->dtls) {
-			free_dtls(&rtp_session->dtls);
-		}
-
-		if (rtp_session->jb) {
-			switch_jb_reset(rtp_session->jb);
-		}
-
-		if (rtp_session->vb) {
-			switch_jb_reset(rtp_session->vb);
-		}
-
-		if (rtp_session->vbw) {
-			switch_jb_reset(rtp_session->vbw);
-		}
-
+	if (X509_digest(x509, EVP_sha256(), md, &len) != 1) {
+		len = 0;
 	}
 
-	if ((type & DTLS_TYPE_RTCP) && rtp_session->rtcp_dtls) {
-		free_dtls(&rtp_session->rtcp_dtls);
-	}
+	X509_free(x509);
 
+	return len;
+}
 
-#ifdef ENABLE_SRTP
-	if (rtp_session->flags[SWITCH_RTP_FLAG_SECURE_SEND]) {
-		int x;
+/* loading the certificate and key is the same for every call, share one context per role and rebuild it if the certificate changes,
+   the fingerprint can't be the key, it depends on the hash the call negotiated */
+static SSL_CTX *dtls_get_ctx(switch_rtp_t *rtp_session, switch_dtls_t *dtls, dtls_type_t type, uint8_t want_DTLSv1_2)
+{
+	int server = (type & DTLS_TYPE_SERVER) ? 1 : 0, v12 = want_DTLSv1_2 ? 1 : 0, i, x;
+	unsigned char md[EVP_MAX_MD_SIZE];
+	unsigned int md_len = dtls_cert_digest(dtls->rsa, md);
+	SSL_CTX *ssl_ctx = NULL;
 
-		rtp_session->flags[SWITCH_RTP_FLAG_SECURE_SEND] = 0;
+	switch_mutex_lock(dtls_globals.mutex);
 
-		for(x = 0; x < 2; x++) {
-			if (rtp_session->send_ctx[x]) {
-				srtp_dealloc(rtp_session->send_ctx[x]);
-				rtp_session->send_ctx[x] = NULL;
+	if (md_len && (md_len != dtls_globals.ctx_cert_len || memcmp(md, dtls_globals.ctx_cert, md_len))) {
+		for (i = 0; i < 2; i++) {
+			for (x = 0; x < 2; x++) {
+				if (dtls_globals.ctx[i][x]) {
+					SSL_CTX_free(dtls_globals.ctx[i][x]);
+					dtls_globals.ctx[i][x] = NULL;
+				}
 			}
 		}
+		memcpy(dtls_globals.ctx_cert, md, md_len);
+		dtls_globals.ctx_cert_len = md_len;
 	}
 
-	if (rtp_session->flags[SWITCH_RTP_FLAG_SECURE_RECV]) {
-		int x;
-
-		rtp_session->flags[SWITCH_RTP_FLAG_SECURE_RECV] = 0;
-
-		for (x = 0; x < 2; x++) {
-			if (rtp_session->recv_ctx[x]) {
-				srtp_dealloc(rtp_session->recv_ctx[x]);
-				rtp_session->recv_ctx[x] = NULL;
-			}
-		}
+	if (!dtls_globals.ctx[server][v12]) {
+		dtls_globals.ctx[server][v12] = dtls_new_ctx(rtp_session, dtls, type, want_DTLSv1_2);
 	}
-#endif
 
- done:
+	if (dtls_globals.ctx[server][v12]) {
+		ssl_ctx = dtls_ctx_ref(dtls_globals.ctx[server][v12]);
+	}
 
-	switch_mutex_unlock(rtp_session->ice_mutex);
+	switch_mutex_unlock(dtls_globals.mutex);
 
-	return status;
+	return ssl_ctx;
 }
 
 SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, dtls_fingerprint_t *local_fp, dtls_fingerprint_t *remote_fp, dtls_type_t type, uint8_t want_DTLSv1_2)
 {
 	switch_dtls_t *dtls;
 	const char *var;
-	int ret;
 	const char *kind = "";
-	unsigned long ssl_method_error = 0;
-	unsigned long ssl_ctx_error = 0;
-	const SSL_METHOD *ssl_method;
-	SSL_CTX *ssl_ctx;
-#if OPENSSL_VERSION_NUMBER < 0x30000000
-	BIO *bio;
-	DH *dh;
-#endif
 	switch_status_t status = SWITCH_STATUS_SUCCESS;
 #ifndef OPENSSL_NO_EC
 #if OPENSSL_VERSION_NUMBER < 0x10002000L
@@ -3874,61 +5532,12 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	}
 
 	dtls->ca = switch_core_sprintf(rtp_session->pool, "%s%sca-bundle.crt", SWITCH_GLOBAL_dirs.certs_dir, SWITCH_PATH_SEPARATOR);
+	dtls->local_fp = local_fp;
 
-#if OPENSSL_VERSION_NUMBER >= 0x10100000
-	ssl_method = (type & DTLS_TYPE_SERVER) ? DTLS_server_method() : DTLS_client_method();
-#else
-    #ifdef HAVE_OPENSSL_DTLSv1_2_method
-		ssl_method = (type & DTLS_TYPE_SERVER) ? (want_DTLSv1_2 ? DTLSv1_2_server_method() : DTLSv1_server_method()) : (want_DTLSv1_2 ? DTLSv1_2_client_method() : DTLSv1_client_method());
-	#else
-		ssl_method = (type & DTLS_TYPE_SERVER) ? DTLSv1_server_method() : DTLSv1_client_method();
-    #endif // HAVE_OPENSSL_DTLSv1_2_method
-#endif
-
-	if (!ssl_method) {
-		ssl_method_error = ERR_peek_error();
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s ssl_method is NULL [%lu]\n", rtp_type(rtp_session), ssl_method_error);
-	}
-
-	dtls->ssl_ctx = ssl_ctx = SSL_CTX_new(ssl_method);
-
-	if (!ssl_ctx) {
-		ssl_ctx_error = ERR_peek_error();
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s SSL_CTX_new failed [%lu]\n", rtp_type(rtp_session), ssl_ctx_error);
-		switch_channel_hangup(switch_core_session_get_channel(rtp_session->session), SWITCH_CAUSE_NORMAL_TEMPORARY_FAILURE);
+	if (!(dtls->ssl_ctx = dtls_get_ctx(rtp_session, dtls, type, want_DTLSv1_2))) {
 		switch_goto_status(SWITCH_STATUS_FALSE, done);
 	}
 
-	switch_assert(dtls->ssl_ctx);
-
-#if OPENSSL_VERSION_NUMBER < 0x30000000
-	bio = BIO_new_file(dtls->pem, "r");
-	dh = PEM_read_bio_DHparams(bio, NULL, NULL, NULL);
-	BIO_free(bio);
-	if (dh) {
-		SSL_CTX_set_tmp_dh(dtls->ssl_ctx, dh);
-		DH_free(dh);
-	}
-#else
-	if(!SSL_CTX_set_dh_auto(dtls->ssl_ctx, 1)) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "Failed enable auto DH!\n");
-	}
-#endif
-	SSL_CTX_set_mode(dtls->ssl_ctx, SSL_MODE_AUTO_RETRY);
-
-	//SSL_CTX_set_verify(dtls->ssl_ctx, SSL_VERIFY_PEER | SSL_VERIFY_FAIL_IF_NO_PEER_CERT, NULL);
-	SSL_CTX_set_verify(dtls->ssl_ctx, SSL_VERIFY_NONE, NULL);
-
-	//SSL_CTX_set_cipher_list(dtls->ssl_ctx, "ECDH:!RC4:!SSLv3:RSA_WITH_AES_128_CBC_SHA");
-	//SSL_CTX_set_cipher_list(dtls->ssl_ctx, "ECDHE-RSA-AES256-GCM-SHA384");
-	SSL_CTX_set_cipher_list(dtls->ssl_ctx, "ALL:!ADH:!LOW:!EXP:!MD5:@STRENGTH");
-	//SSL_CTX_set_cipher_list(dtls->ssl_ctx, "SUITEB128");
-	SSL_CTX_set_read_ahead(dtls->ssl_ctx, 1);
-#ifdef HAVE_OPENSSL_DTLS_SRTP
-	//SSL_CTX_set_tlsext_use_srtp(dtls->ssl_ctx, "SRTP_AES128_CM_SHA1_80:SRTP_AES128_CM_SHA1_32");
-	SSL_CTX_set_tlsext_use_srtp(dtls->ssl_ctx, "SRTP_AES128_CM_SHA1_80");
-#endif
-
 	dtls->type = type;
 	dtls->read_bio = BIO_new(BIO_s_mem());
 	switch_assert(dtls->read_bio);
@@ -3939,29 +5548,6 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	BIO_set_mem_eof_return(dtls->read_bio, -1);
 	BIO_set_mem_eof_return(dtls->write_bio, -1);
 
-	if ((ret=SSL_CTX_use_certificate_file(dtls->ssl_ctx, dtls->rsa, SSL_FILETYPE_PEM)) != 1) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS cert err [%d]\n", rtp_type(rtp_session), SSL_get_error(dtls->ssl, ret));
-		switch_goto_status(SWITCH_STATUS_FALSE, done);
-	}
-
-	if ((ret=SSL_CTX_use_PrivateKey_file(dtls->ssl_ctx, dtls->pvt, SSL_FILETYPE_PEM)) != 1) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS key err [%d]\n", rtp_type(rtp_session), SSL_get_error(dtls->ssl, ret));
-		switch_goto_status(SWITCH_STATUS_FALSE, done);
-	}
-
-	if (SSL_CTX_check_private_key(dtls->ssl_ctx) == 0) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS check key failed\n", rtp_type(rtp_session));
-		switch_goto_status(SWITCH_STATUS_FALSE, done);
-	}
-
-	if (!zstr(dtls->ca) && switch_file_exists(dtls->ca, rtp_session->pool) == SWITCH_STATUS_SUCCESS
-		&& (ret = SSL_CTX_load_verify_locations(dtls->ssl_ctx, dtls->ca, NULL)) != 1) {
-		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG(rtp_session->session), SWITCH_LOG_ERROR, "%s DTLS check chain cert failed [%d]\n",
-						  rtp_type(rtp_session) ,
-						  SSL_get_error(dtls->ssl, ret));
-		switch_goto_status(SWITCH_STATUS_FALSE, done);
-	}
-
 	dtls->ssl = SSL_new(dtls->ssl_ctx);
 
 #if OPENSSL_VERSION_NUMBER < 0x10100000L
@@ -4001,11 +5587,18 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	SSL_set_verify(dtls->ssl, SSL_VERIFY_NONE, NULL);
 	SSL_set_app_data(dtls->ssl, dtls);
 
-	dtls->local_fp = local_fp;
 	dtls->remote_fp = remote_fp;
 	dtls->rtp_session = rtp_session;
 	dtls->mtu = 1200;
 
+	switch_mutex_init(&dtls->ssl_mutex, SWITCH_MUTEX_NESTED, rtp_session->pool);
+	switch_mutex_init(&dtls->flag_mutex, SWITCH_MUTEX_NESTED, rtp_session->pool);
+	switch_thread_cond_create(&dtls->cond, rtp_session->pool);
+
+	if (dtls_globals.running) {
+		switch_queue_create(&dtls->pending, DTLS_PENDING_LEN, rtp_session->pool);
+	}
+
 	if (rtp_session->session) {
 		switch_channel_t *channel = switch_core_session_get_channel(rtp_session->session);
 		if ((var = switch_channel_get_variable(channel, "rtp_dtls_mtu"))) {
@@ -4022,6 +5615,10 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	
 	switch_core_cert_expand_fingerprint(remote_fp, remote_fp->str);
 
+	if (!zstr(remote_fp->str)) {
+		dtls->fp_key = switch_core_sprintf(rtp_session->pool, "%s:%s", switch_str_nil(remote_fp->type), remote_fp->str);
+	}
+
 	if ((type & DTLS_TYPE_RTP)) {
 		rtp_session->dtls = dtls;
 		dtls->sock_output = rtp_session->sock_output;
@@ -4039,6 +5636,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_add_dtls(switch_rtp_t *rtp_session, d
 	if ((type & DTLS_TYPE_SERVER)) {
 		SSL_set_accept_state(dtls->ssl);
 	} else {
+		dtls_resume_session(dtls);
 		SSL_set_connect_state(dtls->ssl);
 	}
 
@@ -4614,6 +6212,7 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_create(switch_rtp_t **new_rtp_session
 	rtp_session->stats.inbound.last_processed_seq = -1;
 
 	rtp_session->ready = 1;
+	rtp_telemetry_add(rtp_session);
 	*new_rtp_session = rtp_session;
 
 	return SWITCH_STATUS_SUCCESS;
@@ -5015,6 +6614,8 @@ SWITCH_DECLARE(switch_status_t) switch_rtp_activate_ice(switch_rtp_t *rtp_sessio
 		switch_rtp_break(rtp_session);
 	}
 
+	ice_agent_add(rtp_session, ice);
+
 	switch_mutex_unlock(rtp_session->ice_mutex);
 
 	return SWITCH_STATUS_SUCCESS;
@@ -5203,14 +6804,22 @@ SWITCH_DECLARE(void) switch_rtp_destroy(switch_rtp_t **rtp_session)
 
 	(*rtp_session)->flags[SWITCH_RTP_FLAG_SHUTDOWN] = 1;
 
+	switch_rtp_relay_stop(*rtp_session);
+
 	READ_INC((*rtp_session));
 	WRITE_INC((*rtp_session));
 
+	/* the tail of a frame still waiting for its marker packet goes out while the socket is up */
+	rtp_send_batch_flush(*rtp_session);
+
 	(*rtp_session)->ready = 0;
 
 	WRITE_DEC((*rtp_session));
 	READ_DEC((*rtp_session));
 
+	ice_agent_del(*rtp_session);
+	rtp_telemetry_del(*rtp_session);
+
 	if ((*rtp_session)->flags[SWITCH_RTP_FLAG_VAD]) {
 		switch_rtp_disable_vad(*rtp_session);
 	}
@@ -6800,6 +8409,7 @@ static switch_status_t process_rtcp_report(switch_rtp_t *rtp_session, rtcp_msg_t
 						} else {
 							rtp_session->rtcp_frame.reports[i].rtt_avg = (double)((rtp_session->rtcp_frame.reports[i].rtt_avg * .7) + (rtt_now * .3 ));
 						}
+						rtp_session->rtt_reports++;
 					} else {
 #ifdef DEBUG_RTCP
 						switch_time_exp_t now_hr;
@@ -7208,6 +8818,35 @@ static int rtp_common_read(switch_rtp_t *rtp_session, switch_payload_t *payload_
 
 		bytes = 0;
 
+		if (rtp_session->relay_worker) {
+			if (rtp_session->relay_fallback) {
+				rtp_relay_fallback(rtp_session);
+			} else {
+				/* a relay worker owns the rtp socket, keep the packet pace and the rtcp going and hand up silence */
+				READ_DEC(rtp_session);
+				if (rtp_session->flags[SWITCH_RTP_FLAG_USE_TIMER]) {
+					switch_core_timer_next(&rtp_session->timer);
+				} else {
+					switch_yield(rtp_session->ms_per_packet);
+				}
+				READ_INC(rtp_session);
+
+				if (rtp_session->flags[SWITCH_RTP_FLAG_ENABLE_RTCP]) {
+					if (check_rtcp_and_ice(rtp_session) == -1) {
+						ret = -1;
+						goto end;
+					}
+
+					if (rtp_session->rtcp_read_pollfd && switch_poll(rtp_session->rtcp_read_pollfd, 1, &rtcp_fdr, 0) == SWITCH_STATUS_SUCCESS) {
+						rtcp_bytes = sizeof(rtcp_msg_t);
+						read_rtcp_packet(rtp_session, &rtcp_bytes, flags);
+					}
+				}
+
+				return_cng_frame();
+			}
+		}
+
 		if (rtp_session->flags[SWITCH_RTP_FLAG_USE_TIMER] &&
 			!rtp_session->flags[SWITCH_RTP_FLAG_PROXY_MEDIA] &&
 			!rtp_session->flags[SWITCH_RTP_FLAG_VIDEO] &&
@@ -8149,6 +9788,103 @@ static int rtp_write_ready(switch_rtp_t *rtp_session, uint32_t bytes, int line)
 }
 
 
+/* count a packet that went out on the wire, flag_mutex held */
+static void rtp_write_stats_add(switch_rtp_t *rtp_session, switch_payload_t pt, switch_size_t bytes)
+{
+	rtp_session->stats.outbound.raw_bytes += bytes;
+	rtp_session->stats.outbound.packet_count++;
+
+	if (rtp_session->flags[SWITCH_RTP_FLAG_ENABLE_RTCP]) {
+		rtp_session->stats.rtcp.sent_pkt_count++;
+	}
+
+	if (pt == rtp_session->cng_pt) {
+		rtp_session->stats.outbound.cng_packet_count++;
+	} else {
+		rtp_session->stats.outbound.media_packet_count++;
+		rtp_session->stats.outbound.media_bytes += bytes;
+	}
+}
+
+static switch_status_t rtp_send_batch_flush(switch_rtp_t *rtp_session)
+{
+	rtp_send_batch_t *batch = rtp_session->send_batch;
+	switch_status_t status;
+	uint32_t sent = 0, i;
+
+	if (!batch || !batch->count) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	status = switch_socket_sendto_batch(rtp_session->sock_output, rtp_session->remote_addr, 0, batch->packets, batch->lens, batch->count, &sent);
+
+	/* only what the socket took counts as sent */
+	if (sent) {
+		switch_mutex_lock(rtp_session->flag_mutex);
+		for (i = 0; i < sent; i++) {
+			rtp_write_stats_add(rtp_session, ((const rtp_msg_t *) batch->packets[i])->header.pt, batch->lens[i]);
+		}
+		switch_mutex_unlock(rtp_session->flag_mutex);
+	}
+
+	if (status != SWITCH_STATUS_SUCCESS && rtp_session->flags[SWITCH_RTP_FLAG_DEBUG_RTP_WRITE]) {
+		switch_log_printf(SWITCH_CHANNEL_SESSION_LOG_CLEAN(rtp_session->session), SWITCH_LOG_ERROR, "batch: %u of %u packets sent, status: %d\n",
+						  sent, batch->count, status);
+	}
+
+	batch->count = 0;
+
+	return status;
+}
+
+/* queue an already protected packet, the frame goes out on its marker packet, a new timestamp or a full batch */
+static switch_status_t rtp_send_batch_add(switch_rtp_t *rtp_session, rtp_msg_t *send_msg, switch_size_t bytes)
+{
+	rtp_send_batch_t *batch = rtp_session->send_batch;
+	uint32_t ts = ntohl(send_msg->header.ts);
+	switch_status_t status;
+	char *slot;
+
+	if (!batch) {
+		batch = switch_core_alloc(rtp_session->pool, sizeof(*batch));
+		batch->buf = switch_core_alloc(rtp_session->pool, RTP_SEND_BATCH_MAX * RTP_SEND_BATCH_SLOT);
+		rtp_session->send_batch = batch;
+	}
+
+	/* the previous frame lost its marker packet, a failed send fails this packet too rather than queueing behind it */
+	if (batch->count && batch->ts != ts && (status = rtp_send_batch_flush(rtp_session)) != SWITCH_STATUS_SUCCESS) {
+		return status;
+	}
+
+	slot = batch->buf + batch->count * RTP_SEND_BATCH_SLOT;
+	memcpy(slot, send_msg, bytes);
+	batch->packets[batch->count] = slot;
+	batch->lens[batch->count] = bytes;
+	batch->ts = ts;
+	batch->count++;
+
+	if (send_msg->header.m || batch->count == RTP_SEND_BATCH_MAX) {
+		return rtp_send_batch_flush(rtp_session);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+SWITCH_DECLARE(switch_status_t) switch_rtp_flush_send_batch(switch_rtp_t *rtp_session)
+{
+	switch_status_t status;
+
+	if (!switch_rtp_ready(rtp_session) || !rtp_session->send_batch || !rtp_session->send_batch->count) {
+		return SWITCH_STATUS_SUCCESS;
+	}
+
+	WRITE_INC(rtp_session);
+	status = rtp_send_batch_flush(rtp_session);
+	WRITE_DEC(rtp_session);
+
+	return status;
+}
+
 static int rtp_common_write(switch_rtp_t *rtp_session,
 							rtp_msg_t *send_msg, void *data, uint32_t datalen, switch_payload_t payload, uint32_t timestamp, switch_frame_flag_t *flags)
 {
@@ -8158,6 +9894,7 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 	int ret;
 	switch_time_t now;
 	uint8_t m = 0;
+	uint8_t batched = 0;
 
 	if (!switch_rtp_ready(rtp_session)) {
 		return -1;
@@ -8614,11 +10351,27 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 		//
 		//	//switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_WARNING, "SEND %u\n", ntohs(send_msg->header.seq));
 		//}
-		if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
-			rtp_session->seq -= delta;
+		if (rtp_session->flags[SWITCH_RTP_FLAG_VIDEO] && !rtp_session->flags[SWITCH_RTP_FLAG_PASSTHRU] &&
+			flags && (*flags & SFF_RAW_RTP_PARSE_FRAME) && bytes <= RTP_SEND_BATCH_SLOT) {
+			/* the packets of a frame we encoded ourselves come in back to back, one sendmmsg() for all of them */
+			if (rtp_send_batch_add(rtp_session, send_msg, bytes) != SWITCH_STATUS_SUCCESS) {
+				rtp_session->seq -= delta;
 
-			ret = -1;
-			goto end;
+				ret = -1;
+				goto end;
+			}
+			batched = 1;
+		} else {
+			if (rtp_session->send_batch && rtp_session->send_batch->count) {
+				rtp_send_batch_flush(rtp_session);
+			}
+
+			if (switch_socket_sendto(rtp_session->sock_output, rtp_session->remote_addr, 0, (void *) send_msg, &bytes) != SWITCH_STATUS_SUCCESS) {
+				rtp_session->seq -= delta;
+
+				ret = -1;
+				goto end;
+			}
 		}
 #endif
 		rtp_session->last_write_ts = this_ts;
@@ -8629,18 +10382,11 @@ static int rtp_common_write(switch_rtp_t *rtp_session,
 			rtp_session->queue_delay = 0;
 		}
 
-		rtp_session->stats.outbound.raw_bytes += bytes;
-		rtp_session->stats.outbound.packet_count++;
-
-		if (rtp_session->flags[SWITCH_RTP_FLAG_ENABLE_RTCP]) {
-			rtp_session->stats.rtcp.sent_pkt_count++;
-		}
-
-		if (send_msg->header.pt == rtp_session->cng_pt) {
-			rtp_session->stats.outbound.cng_packet_count++;
-		} else {
-			rtp_session->stats.outbound.media_packet_count++;
-			rtp_session->stats.outbound.media_bytes += bytes;
+		/* relay workers write here too, readers of the stats hold flag_mutex, batched packets are counted when the batch goes out */
+		if (!batched) {
+			switch_mutex_lock(rtp_session->flag_mutex);
+			rtp_write_stats_add(rtp_session, send_msg->header.pt, bytes);
+			switch_mutex_unlock(rtp_session->flag_mutex);
 		}
 
 		if (rtp_session->flags[SWITCH_RTP_FLAG_USE_TIMER]) {
@@ -59,6 +59,7 @@
 #include <switch_stun.h>
 #ifndef WIN32
 #include <sys/wait.h>
+#include <sys/mman.h>
 #include <switch_private.h>
 #include <glob.h>
 #else /* we're on windoze :( */
@@ -199,6 +200,14 @@ static void preprocess_env_set(char *keyval)
 
 static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rlevel);
 
+/* tags of a parsed document are carved out of these instead of one malloc each */
+#define SWITCH_XML_ARENA_BLOCK 65536
+typedef struct switch_xml_arena {
+	struct switch_xml_arena *next;
+	switch_size_t used;
+	switch_size_t size;
+} switch_xml_arena_t;
+
 typedef struct switch_xml_root *switch_xml_root_t;
 struct switch_xml_root {		/* additional data for the root tag */
 	struct switch_xml xml;		/* is a super-struct built on top of switch_xml struct */
@@ -214,6 +223,7 @@ struct switch_xml_root {		/* additional data for the root tag */
 	char ***pi;					/* processing instructions */
 	short standalone;			/* non-zero if <?xml standalone="yes"?> */
 	char err[SWITCH_XML_ERRL];	/* error string */
+	switch_xml_arena_t *arena;	/* memory of the SWITCH_XML_ARENA tags */
 };
 
 char *SWITCH_XML_NIL[] = { NULL };	/* empty, null terminated array of strings */
@@ -236,6 +246,71 @@ static switch_mutex_t *CACHE_MUTEX = NULL;
 static switch_mutex_t *REFLOCK = NULL;
 static switch_mutex_t *FILE_LOCK = NULL;
 
+/* Preprocessor cache for the main config, guarded by FILE_LOCK.
+ *
+ * Each file the preprocessor reads is recorded as the ranges of it that went
+ * out verbatim, the text it produced otherwise (expanded $${vars}, pieces of
+ * lines around comments), the variables it set, the $${vars} it used and the
+ * includes it made.  Only the expanded text is kept in memory, the verbatim
+ * ranges are read back from the file itself.  On the next reload a file whose
+ * size, inode, mtime and ctime are unchanged is replayed from that record
+ * instead of being expanded again, provided every $${var} it used still has
+ * the same value.  Its includes are globbed again and checked the same way,
+ * so only the files that changed get expanded.  Files using exec, exec-set,
+ * stun-set or env-set are never cached.
+ */
+typedef enum {
+	PP_OP_TEXT,
+	PP_OP_COPY,
+	PP_OP_SET,
+	PP_OP_USE,
+	PP_OP_INCLUDE
+} preprocess_op_type_t;
+
+typedef struct preprocess_op {
+	preprocess_op_type_t type;
+	char *a;
+	char *b;
+	switch_size_t len;
+	switch_size_t alloc;
+	int64_t offset;		/* PP_OP_COPY, where the len bytes start in the file */
+	struct preprocess_op *next;
+} preprocess_op_t;
+
+/* mtime alone has one second resolution, a file rewritten within the same
+ * second keeps it, so the nanoseconds and the change time are compared too */
+#if defined(WIN32)
+#define PP_MTIME_NSEC(st) 0
+#define PP_CTIME_NSEC(st) 0
+#elif defined(__APPLE__)
+#define PP_MTIME_NSEC(st) ((long) (st)->st_mtimespec.tv_nsec)
+#define PP_CTIME_NSEC(st) ((long) (st)->st_ctimespec.tv_nsec)
+#else
+#define PP_MTIME_NSEC(st) ((long) (st)->st_mtim.tv_nsec)
+#define PP_CTIME_NSEC(st) ((long) (st)->st_ctim.tv_nsec)
+#endif
+
+typedef struct preprocess_file {
+	int64_t size;
+	uint64_t ino;
+	time_t mtime;
+	long mtime_nsec;
+	time_t ctime;
+	long ctime_nsec;
+	uint32_t gen;
+	int busy;
+	switch_bool_t nocache;
+	preprocess_op_t *ops;
+	preprocess_op_t *tail;
+} preprocess_file_t;
+
+static switch_hash_t *PP_CACHE = NULL;
+static preprocess_file_t *PP_RECORD = NULL;
+static switch_bool_t PP_ENABLED = SWITCH_FALSE;
+static uint32_t PP_GEN = 0;
+static uint32_t PP_HITS = 0;
+static uint32_t PP_MISSES = 0;
+
 SWITCH_DECLARE_NONSTD(switch_xml_t) __switch_xml_open_root(uint8_t reload, const char **err, void *user_data);
 
 static switch_xml_open_root_function_t XML_OPEN_ROOT_FUNCTION = (switch_xml_open_root_function_t)__switch_xml_open_root;
@@ -691,6 +766,57 @@ static char *switch_xml_decode(char *s, char **ent, char t)
 }
 
 /* called when parser finds start of new tag */
+static void *switch_xml_arena_alloc(switch_xml_root_t root, switch_size_t len)
+{
+	switch_xml_arena_t *arena = root->arena;
+	void *ptr;
+
+	len = (len + 15) & ~((switch_size_t) 15);
+
+	if (!arena || arena->used + len > arena->size) {
+		switch_size_t size = len > SWITCH_XML_ARENA_BLOCK ? len : SWITCH_XML_ARENA_BLOCK;
+
+		arena = (switch_xml_arena_t *) switch_must_malloc(sizeof(switch_xml_arena_t) + 16 + size);
+		arena->next = root->arena;
+		arena->used = 0;
+		arena->size = size;
+		root->arena = arena;
+	}
+
+	ptr = (char *) arena + ((sizeof(switch_xml_arena_t) + 15) & ~((switch_size_t) 15)) + arena->used;
+	arena->used += len;
+
+	return ptr;
+}
+
+static void switch_xml_arena_free(switch_xml_root_t root)
+{
+	switch_xml_arena_t *arena = root->arena, *next;
+
+	for (; arena; arena = next) {
+		next = arena->next;
+		free(arena);
+	}
+
+	root->arena = NULL;
+}
+
+/* same as switch_xml_add_child() with the tag taken from the arena */
+static switch_xml_t switch_xml_add_child_arena(switch_xml_root_t root, switch_xml_t xml, char *name, switch_size_t off)
+{
+	switch_xml_t child = (switch_xml_t) switch_xml_arena_alloc(root, sizeof(struct switch_xml));
+
+	memset(child, '\0', sizeof(struct switch_xml));
+	child->name = name;
+	child->attr = SWITCH_XML_NIL;
+	child->off = off;
+	child->parent = xml;
+	child->txt = (char *) "";
+	child->flags = SWITCH_XML_ARENA;
+
+	return switch_xml_insert(child, xml, off);
+}
+
 static void switch_xml_open_tag(switch_xml_root_t root, char *name, char *open_pos, char **attr)
 {
 	switch_xml_t xml;
@@ -702,7 +828,7 @@ static void switch_xml_open_tag(switch_xml_root_t root, char *name, char *open_p
 	xml = root->cur;
 
 	if (xml->name)
-		xml = switch_xml_add_child(xml, name, strlen(xml->txt));
+		xml = switch_xml_add_child_arena(root, xml, name, strlen(xml->txt));
 	else
 		xml->name = name;		/* first open tag */
 
@@ -1266,6 +1392,269 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_fd(int fd)
 	return &root->xml;
 }
 
+static void preprocess_stat_fill(preprocess_file_t *pf, const struct stat *st)
+{
+	pf->size = (int64_t) st->st_size;
+	pf->ino = (uint64_t) st->st_ino;
+	pf->mtime = st->st_mtime;
+	pf->mtime_nsec = PP_MTIME_NSEC(st);
+	pf->ctime = st->st_ctime;
+	pf->ctime_nsec = PP_CTIME_NSEC(st);
+}
+
+static switch_bool_t preprocess_stat_same(const preprocess_file_t *pf, const struct stat *st)
+{
+	return (pf->size == (int64_t) st->st_size && pf->ino == (uint64_t) st->st_ino &&
+			pf->mtime == st->st_mtime && pf->mtime_nsec == PP_MTIME_NSEC(st) &&
+			pf->ctime == st->st_ctime && pf->ctime_nsec == PP_CTIME_NSEC(st)) ? SWITCH_TRUE : SWITCH_FALSE;
+}
+
+static void preprocess_file_free(preprocess_file_t *pf)
+{
+	preprocess_op_t *op, *next;
+
+	for (op = pf->ops; op; op = next) {
+		next = op->next;
+		switch_safe_free(op->a);
+		switch_safe_free(op->b);
+		free(op);
+	}
+
+	free(pf);
+}
+
+static preprocess_op_t *preprocess_record(preprocess_op_type_t type, const char *a, const char *b)
+{
+	preprocess_file_t *pf = PP_RECORD;
+	preprocess_op_t *op;
+
+	if (!pf || pf->nocache) {
+		return NULL;
+	}
+
+	op = (preprocess_op_t *) switch_must_malloc(sizeof(*op));
+	memset(op, 0, sizeof(*op));
+	op->type = type;
+	op->a = a ? switch_must_strdup(a) : NULL;
+	op->b = b ? switch_must_strdup(b) : NULL;
+
+	if (pf->tail) {
+		pf->tail->next = op;
+	} else {
+		pf->ops = op;
+	}
+	pf->tail = op;
+
+	return op;
+}
+
+static void preprocess_nocache(void)
+{
+	if (PP_RECORD) {
+		PP_RECORD->nocache = SWITCH_TRUE;
+	}
+}
+
+static void preprocess_write(FILE *write_fd, const char *buf, switch_size_t len)
+{
+	preprocess_file_t *pf = PP_RECORD;
+
+	if (!len) {
+		return;
+	}
+
+	if (fwrite(buf, 1, len, write_fd) != len) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+	}
+
+	if (pf && !pf->nocache) {
+		preprocess_op_t *op = pf->tail;
+
+		if (!op || op->type != PP_OP_TEXT) {
+			op = preprocess_record(PP_OP_TEXT, NULL, NULL);
+		}
+
+		if (op->len + len > op->alloc) {
+			op->alloc = (op->len + len) * 2;
+			op->a = (char *) switch_must_realloc(op->a, op->alloc);
+		}
+
+		memcpy(op->a + op->len, buf, len);
+		op->len += len;
+	}
+}
+
+/* a line that goes out exactly as it was read, the record only keeps where it was */
+static void preprocess_write_copy(FILE *write_fd, const char *buf, switch_size_t len, int64_t offset)
+{
+	preprocess_file_t *pf = PP_RECORD;
+	preprocess_op_t *op;
+
+#ifdef WIN32
+	/* lines are read in text mode there, their lengths don't add up to file offsets */
+	pf = NULL;
+#endif
+
+	if (!pf || pf->nocache) {
+		preprocess_write(write_fd, buf, len);
+		return;
+	}
+
+	if (!len) {
+		return;
+	}
+
+	if (fwrite(buf, 1, len, write_fd) != len) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+	}
+
+	op = pf->tail;
+	if (!op || op->type != PP_OP_COPY || op->offset + (int64_t) op->len != offset) {
+		op = preprocess_record(PP_OP_COPY, NULL, NULL);
+		op->offset = offset;
+	}
+	op->len += len;
+}
+
+static void preprocess_rewind(FILE *write_fd, long pos)
+{
+	fflush(write_fd);
+#ifdef WIN32
+	_chsize(_fileno(write_fd), pos);
+#else
+	if (ftruncate(fileno(write_fd), pos)) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Failed to truncate preprocessor output\n");
+	}
+#endif
+	fseek(write_fd, pos, SEEK_SET);
+}
+
+static FILE *preprocess_glob(const char *cwd, const char *pattern, FILE *write_fd, int rlevel);
+
+/* copies a verbatim range of the source file, it is opened on the first one */
+static int preprocess_replay_copy(preprocess_file_t *pf, const char *file, FILE **read_fd, preprocess_op_t *op, FILE *write_fd)
+{
+	char buf[8192];
+	switch_size_t left = op->len, n;
+	struct stat st;
+
+	if (!*read_fd) {
+		/* it may have changed since the stat() that let us replay it */
+		if (!(*read_fd = fopen(file, "rb")) || fstat(fileno(*read_fd), &st) || !preprocess_stat_same(pf, &st)) {
+			return -1;
+		}
+	}
+
+	if (fseek(*read_fd, (long) op->offset, SEEK_SET)) {
+		return -1;
+	}
+
+	while (left) {
+		if (!(n = fread(buf, 1, left < sizeof(buf) ? left : sizeof(buf), *read_fd))) {
+			return -1;
+		}
+		if (fwrite(buf, 1, n, write_fd) != n) {
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+		}
+		left -= n;
+	}
+
+	return 0;
+}
+
+/* Plays a cached file back, returns -1 as soon as a $${var} it used changed
+ * or the file can't be read back the way it was recorded */
+static int preprocess_replay(preprocess_file_t *pf, const char *file, FILE *write_fd, int rlevel)
+{
+	preprocess_op_t *op;
+	FILE *read_fd = NULL;
+	int r = 0;
+
+	for (op = pf->ops; op && !r; op = op->next) {
+		switch (op->type) {
+		case PP_OP_TEXT:
+			if (fwrite(op->a, 1, op->len, write_fd) != op->len) {
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+			}
+			break;
+		case PP_OP_COPY:
+			r = preprocess_replay_copy(pf, file, &read_fd, op, write_fd);
+			break;
+		case PP_OP_SET:
+			switch_core_set_variable(op->a, op->b);
+			break;
+		case PP_OP_USE:
+			{
+				char *val = switch_core_get_variable_dup(op->a);
+				int same = val ? (op->b && !strcmp(val, op->b)) : !op->b;
+
+				switch_safe_free(val);
+				if (!same) {
+					r = -1;
+				}
+			}
+			break;
+		case PP_OP_INCLUDE:
+			preprocess_glob(op->a, op->b, write_fd, rlevel + 1);
+			break;
+		}
+	}
+
+	if (read_fd) {
+		fclose(read_fd);
+	}
+
+	return r;
+}
+
+/* drops the files the last preprocessing run did not read anymore */
+static void preprocess_cache_prune(void)
+{
+	switch_hash_index_t *hi;
+	const void *key;
+	void *val;
+	char **stale = NULL;
+	switch_size_t n = 0, max = 0, i;
+
+	for (hi = switch_core_hash_first(PP_CACHE); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, &key, NULL, &val);
+
+		if (((preprocess_file_t *) val)->gen != PP_GEN) {
+			if (n == max) {
+				max = max ? max * 2 : 16;
+				stale = (char **) switch_must_realloc(stale, max * sizeof(char *));
+			}
+			stale[n++] = switch_must_strdup((const char *) key);
+		}
+	}
+
+	for (i = 0; i < n; i++) {
+		if ((val = switch_core_hash_delete(PP_CACHE, stale[i]))) {
+			preprocess_file_free((preprocess_file_t *) val);
+		}
+		free(stale[i]);
+	}
+
+	switch_safe_free(stale);
+}
+
+static void preprocess_cache_clear(void)
+{
+	switch_hash_index_t *hi;
+	void *val;
+
+	if (!PP_CACHE) {
+		return;
+	}
+
+	for (hi = switch_core_hash_first(PP_CACHE); hi; hi = switch_core_hash_next(&hi)) {
+		switch_core_hash_this(hi, NULL, NULL, &val);
+		preprocess_file_free((preprocess_file_t *) val);
+	}
+
+	switch_core_hash_destroy(&PP_CACHE);
+}
+
 static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_t *newlen, const char **err)
 {
 	char *var, *val;
@@ -1288,7 +1677,9 @@ static char *expand_vars(char *buf, char *ebuf, switch_size_t elen, switch_size_
 				var = rp;
 				*e++ = '\0';
 				rp = e;
-				if ((val = switch_core_get_variable_dup(var))) {
+				val = switch_core_get_variable_dup(var);
+				preprocess_record(PP_OP_USE, var, val);
+				if (val) {
 					char *p;
 					for (p = val; p && *p && wp <= ep; p++) {
 						*wp++ = *p;
@@ -1428,18 +1819,55 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 	char *q, *cmd, *buf = NULL, *ebuf = NULL;
 	char *tcmd, *targ;
 	int line = 0;
-	switch_size_t len = 0, eblen = 0;
+	switch_size_t len = 0, eblen = 0, raw = 0;
+	int64_t offset = 0, line_offset = 0;
+	preprocess_file_t *record = NULL, *prev_record = PP_RECORD;
+	struct stat st;
 
 	if (rlevel > 100) {
 		return -1;
 	}
 
+	if (PP_ENABLED && !stat(file, &st)) {
+		preprocess_file_t *pf = (preprocess_file_t *) switch_core_hash_find(PP_CACHE, file);
+
+		if (pf && !pf->busy && preprocess_stat_same(pf, &st)) {
+			long pos = ftell(write_fd);
+			int r;
+
+			pf->gen = PP_GEN;
+			pf->busy++;
+			PP_RECORD = NULL;
+			r = preprocess_replay(pf, file, write_fd, rlevel);
+			PP_RECORD = prev_record;
+			pf->busy--;
+
+			if (!r) {
+				PP_HITS++;
+				return 0;
+			}
+
+			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "%s or the variables it uses changed, preprocessing it again\n", file);
+			preprocess_rewind(write_fd, pos);
+		}
+
+		record = (preprocess_file_t *) switch_must_malloc(sizeof(*record));
+		memset(record, 0, sizeof(*record));
+		preprocess_stat_fill(record, &st);
+		record->gen = PP_GEN;
+	}
+
 	if (!(read_fd = fopen(file, "r"))) {
 		const char *reason = strerror(errno);
 		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Couldn't open %s (%s)\n", file, reason);
+		if (record) {
+			preprocess_file_free(record);
+		}
 		return -1;
 	}
 
+	PP_RECORD = record;
+
 	setvbuf(read_fd, (char *) NULL, _IOFBF, 65536);
 
 	for(;;) {
@@ -1453,6 +1881,10 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 			break;
 		}
 
+		raw = cur;
+		line_offset = offset;
+		offset += (int64_t) raw;
+
 		eblen = len * 2;
 		ebuf = switch_must_malloc(eblen);
 		memset(ebuf, 0, eblen);
@@ -1491,9 +1923,7 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 			if ((e = strstr(tcmd, "/>"))) {
 				e += 2;
 				*e = '\0';
-				if (fwrite(e, 1, (unsigned) strlen(e), write_fd) != (int) strlen(e)) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
-				}
+				preprocess_write(write_fd, e, strlen(e));
 			}
 
 			if (!(tcmd = (char *) switch_stristr("cmd", tcmd))) {
@@ -1550,17 +1980,23 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 
 				if (val) {
 					switch_core_set_variable(name, val);
+					preprocess_record(PP_OP_SET, name, val);
 				}
 
 			} else if (!strcasecmp(tcmd, "exec-set")) {
+				preprocess_nocache();
 				preprocess_exec_set(targ);
 			} else if (!strcasecmp(tcmd, "stun-set")) {
+				preprocess_nocache();
 				preprocess_stun_set(targ);
 			} else if (!strcasecmp(tcmd, "env-set")) {
+				preprocess_nocache();
 				preprocess_env_set(targ);
 			} else if (!strcasecmp(tcmd, "include")) {
+				preprocess_record(PP_OP_INCLUDE, cwd, targ);
 				preprocess_glob(cwd, targ, write_fd, rlevel + 1);
 			} else if (!strcasecmp(tcmd, "exec")) {
+				preprocess_nocache();
 				preprocess_exec(cwd, targ, write_fd, rlevel + 1);
 			}
 
@@ -1568,15 +2004,11 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 		}
 
 		if ((cmd = strstr(bp, "<!--#"))) {
-			if (fwrite(bp, 1, (unsigned) (cmd - bp), write_fd) != (unsigned) (cmd - bp)) {
-				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
-			}
+			preprocess_write(write_fd, bp, cmd - bp);
 			if ((e = strstr(cmd, "-->"))) {
 				*e = '\0';
 				e += 3;
-				if (fwrite(e, 1, (unsigned) strlen(e), write_fd) != (int) strlen(e)) {
-					switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
-				}
+				preprocess_write(write_fd, e, strlen(e));
 			} else {
 				ml++;
 			}
@@ -1614,15 +2046,20 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 
 					if (val) {
 						switch_core_set_variable(name, val);
+						preprocess_record(PP_OP_SET, name, val);
 					}
 
 				} else if (!strcasecmp(cmd, "exec-set")) {
+					preprocess_nocache();
 					preprocess_exec_set(arg);
 				} else if (!strcasecmp(cmd, "stun-set")) {
+					preprocess_nocache();
 					preprocess_stun_set(arg);
 				} else if (!strcasecmp(cmd, "include")) {
+					preprocess_record(PP_OP_INCLUDE, cwd, arg);
 					preprocess_glob(cwd, arg, write_fd, rlevel + 1);
 				} else if (!strcasecmp(cmd, "exec")) {
+					preprocess_nocache();
 					preprocess_exec(cwd, arg, write_fd, rlevel + 1);
 				}
 			}
@@ -1630,10 +2067,11 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 			continue;
 		}
 
-		if (fwrite(bp, 1, (unsigned) cur, write_fd) != (int) cur) {
-			switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Short write!\n");
+		if (bp == buf && cur == raw) {
+			preprocess_write_copy(write_fd, bp, cur, line_offset);
+		} else {
+			preprocess_write(write_fd, bp, cur);
 		}
-
 	}
 
 	switch_safe_free(buf);
@@ -1641,6 +2079,22 @@ static int preprocess(const char *cwd, const char *file, FILE *write_fd, int rle
 
 	fclose(read_fd);
 
+	PP_RECORD = prev_record;
+
+	if (record) {
+		preprocess_file_t *old = (preprocess_file_t *) switch_core_hash_find(PP_CACHE, file);
+
+		if (record->nocache || (old && old->busy)) {
+			preprocess_file_free(record);
+		} else {
+			switch_core_hash_insert(PP_CACHE, file, record);
+			if (old) {
+				preprocess_file_free(old);
+			}
+		}
+		PP_MISSES++;
+	}
+
 	return 0;
 }
 
@@ -1685,6 +2139,43 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file_simple(const char *file)
 	return NULL;
 }
 
+/* Like switch_xml_parse_fd() but maps the file instead of reading it into
+   memory, for the preprocessed files we write ourselves and never modify
+   in place afterwards. */
+static switch_xml_t switch_xml_parse_fd_mmap(int fd)
+{
+#ifndef WIN32
+	switch_xml_root_t root;
+	struct stat st;
+	void *m;
+
+	if (fd < 0)
+		return NULL;
+
+	if (fstat(fd, &st) == -1 || !st.st_size) {
+		return NULL;
+	}
+
+	if ((m = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0)) == MAP_FAILED) {
+		return switch_xml_parse_fd(fd);
+	}
+
+	madvise(m, st.st_size, MADV_SEQUENTIAL);
+
+	if (!(root = (switch_xml_root_t) switch_xml_parse_str((char *) m, st.st_size))) {
+		munmap(m, st.st_size);
+
+		return NULL;
+	}
+
+	root->len = st.st_size;	/* so we know to munmap m in switch_xml_free() */
+
+	return &root->xml;
+#else
+	return switch_xml_parse_fd(fd);
+#endif
+}
+
 SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 {
 	int fd = -1;
@@ -1693,6 +2184,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	char *new_file = NULL;
 	char *new_file_tmp = NULL;
 	const char *abs, *absw;
+	switch_bool_t main_conf;
+	int r;
 
 	abs = strrchr(file, '/');
 	absw = strrchr(file, '\\');
@@ -1702,6 +2195,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 		abs = file;
 	}
 
+	main_conf = !strcmp(abs, SWITCH_GLOBAL_filenames.conf_name);
+
 	switch_mutex_lock(FILE_LOCK);
 
 	if (!(new_file = switch_mprintf("%s%s%s.fsxml", SWITCH_GLOBAL_dirs.log_dir, SWITCH_PATH_SEPARATOR, abs))) {
@@ -1718,7 +2213,21 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 
 	setvbuf(write_fd, (char *) NULL, _IOFBF, 65536);
 
-	if (preprocess(SWITCH_GLOBAL_dirs.conf_dir, file, write_fd, 0) > -1) {
+	if (main_conf) {
+		PP_ENABLED = SWITCH_TRUE;
+		PP_GEN++;
+		PP_HITS = PP_MISSES = 0;
+	}
+
+	r = preprocess(SWITCH_GLOBAL_dirs.conf_dir, file, write_fd, 0);
+
+	if (main_conf) {
+		PP_ENABLED = SWITCH_FALSE;
+		preprocess_cache_prune();
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "Preprocessed %s: %u files from cache, %u expanded\n", file, PP_HITS, PP_MISSES);
+	}
+
+	if (r > -1) {
 		fclose(write_fd);
 		write_fd = NULL;
 		unlink (new_file);
@@ -1728,8 +2237,8 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 		}
 
 		if ((fd = open(new_file, O_RDONLY, 0)) > -1) {
-			if ((xml = switch_xml_parse_fd(fd))) {
-				if (strcmp(abs, SWITCH_GLOBAL_filenames.conf_name)) {
+			if ((xml = switch_xml_parse_fd_mmap(fd))) {
+				if (!main_conf) {
 					xml->free_path = new_file;
 					new_file = NULL;
 				}
@@ -1754,11 +2263,13 @@ SWITCH_DECLARE(switch_xml_t) switch_xml_parse_file(const char *file)
 	return xml;
 }
 
-SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
-												  const char *tag_name,
-												  const char *key_name,
-												  const char *key_value,
-												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+/* answered is cleared when a binding gave no usable document (timeout, HTTP error, parse error), the caller
+   can then tell a lookup that failed from one the directory really has no answer for */
+static switch_status_t xml_locate(const char *section,
+								  const char *tag_name,
+								  const char *key_name,
+								  const char *key_value,
+								  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone, switch_bool_t *answered)
 {
 	switch_xml_t conf = NULL;
 	switch_xml_t tag = NULL;
@@ -1767,6 +2278,10 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 	uint8_t loops = 0;
 	switch_xml_section_t sections = BINDINGS ? switch_xml_parse_section_string(section) : 0;
 
+	if (answered) {
+		*answered = SWITCH_TRUE;
+	}
+
 	switch_thread_rwlock_rdlock(B_RWLOCK);
 
 	for (binding = BINDINGS; binding; binding = binding->next) {
@@ -1774,7 +2289,11 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 			continue;
 		}
 
-		if ((xml = binding->function(section, tag_name, key_name, key_value, params, binding->user_data))) {
+		if (!(xml = binding->function(section, tag_name, key_name, key_value, params, binding->user_data))) {
+			if (answered) {
+				*answered = SWITCH_FALSE;
+			}
+		} else {
 			const char *err = NULL;
 
 			err = switch_xml_error(xml);
@@ -1797,6 +2316,9 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_ERROR, "Error[%s]\n", err);
 				switch_xml_free(xml);
 				xml = NULL;
+				if (answered) {
+					*answered = SWITCH_FALSE;
+				}
 			}
 		}
 	}
@@ -1836,6 +2358,15 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
 	return SWITCH_STATUS_FALSE;
 }
 
+SWITCH_DECLARE(switch_status_t) switch_xml_locate(const char *section,
+												  const char *tag_name,
+												  const char *key_name,
+												  const char *key_value,
+												  switch_xml_t *root, switch_xml_t *node, switch_event_t *params, switch_bool_t clone)
+{
+	return xml_locate(section, tag_name, key_name, key_value, root, node, params, clone, NULL);
+}
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_domain(const char *domain_name, switch_event_t *params, switch_xml_t *root, switch_xml_t *domain)
 {
 	switch_event_t *my_params = NULL;
@@ -2142,11 +2673,22 @@ static void switch_xml_user_cache(const char *key, const char *user_name, const
 	switch_mutex_unlock(CACHE_MUTEX);
 }
 
+static switch_status_t xml_locate_user(const char *key, const char *user_name, const char *domain_name, const char *ip,
+									   switch_xml_t *root, switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup,
+									   switch_event_t *params, switch_bool_t *not_found);
+
 SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, const char *user_name, const char *domain_name,
 															  const char *ip, switch_xml_t *user, switch_event_t *params)
+{
+	return switch_xml_locate_user_merged_ex(key, user_name, domain_name, ip, user, params, NULL);
+}
+
+SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged_ex(const char *key, const char *user_name, const char *domain_name,
+																 const char *ip, switch_xml_t *user, switch_event_t *params, switch_bool_t *not_found)
 {
 	switch_xml_t xml, domain, group, x_user, x_user_dup;
 	switch_status_t status = SWITCH_STATUS_FALSE;
+	switch_bool_t failed = SWITCH_FALSE, missing = SWITCH_FALSE;
 	char *kdup = NULL;
 	char *keys[10] = {0};
 	int i, nkeys;
@@ -2163,7 +2705,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, c
 		if ((status = switch_xml_locate_user_cache(keys[i], user_name, domain_name, &x_user)) == SWITCH_STATUS_SUCCESS) {
 			*user = x_user;
 			break;
-		} else if ((status = switch_xml_locate_user(keys[i], user_name, domain_name, ip, &xml, &domain, &x_user, &group, params)) == SWITCH_STATUS_SUCCESS) {
+		} else if ((status = xml_locate_user(keys[i], user_name, domain_name, ip, &xml, &domain, &x_user, &group, params, &missing)) == SWITCH_STATUS_SUCCESS) {
 			const char *cacheable = NULL;
 
 			x_user_dup = switch_xml_dup(x_user);
@@ -2188,11 +2730,17 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user_merged(const char *key, c
 			*user = x_user_dup;
 			switch_xml_free(xml);
 			break;
+		} else if (!missing) {
+			failed = SWITCH_TRUE;
 		}
 	}
 
 	switch_safe_free(kdup);
 
+	if (not_found) {
+		*not_found = (status != SWITCH_STATUS_SUCCESS && !failed) ? SWITCH_TRUE : SWITCH_FALSE;
+	}
+
 	return status;
 
 }
@@ -2203,10 +2751,23 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 													   const char *ip,
 													   switch_xml_t *root,
 													   switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup, switch_event_t *params)
+{
+	return xml_locate_user(key, user_name, domain_name, ip, root, domain, user, ingroup, params, NULL);
+}
+
+/* not_found is set when every binding answered and the domain has no such user */
+static switch_status_t xml_locate_user(const char *key, const char *user_name, const char *domain_name, const char *ip,
+									   switch_xml_t *root, switch_xml_t *domain, switch_xml_t *user, switch_xml_t *ingroup,
+									   switch_event_t *params, switch_bool_t *not_found)
 {
 	switch_status_t status = SWITCH_STATUS_FALSE;
 	switch_event_t *my_params = NULL;
 	switch_xml_t group = NULL, groups = NULL, users = NULL;
+	switch_bool_t answered = SWITCH_FALSE;
+
+	if (not_found) {
+		*not_found = SWITCH_FALSE;
+	}
 
 	*root = NULL;
 	*user = NULL;
@@ -2236,7 +2797,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 		switch_event_add_header_string(params, SWITCH_STACK_BOTTOM, "ip", ip);
 	}
 
-	if ((status = switch_xml_locate_domain(domain_name, params, root, domain)) != SWITCH_STATUS_SUCCESS) {
+	if ((status = xml_locate("directory", "domain", "name", domain_name, root, domain, params, SWITCH_FALSE, &answered)) != SWITCH_STATUS_SUCCESS) {
 		goto end;
 	}
 
@@ -2273,6 +2834,11 @@ SWITCH_DECLARE(switch_status_t) switch_xml_locate_user(const char *key,
 		switch_xml_free(*root);
 		*root = NULL;
 		*domain = NULL;
+
+		/* every binding answered and the domain is there, the user really does not exist */
+		if (answered && not_found) {
+			*not_found = SWITCH_TRUE;
+		}
 	}
 
 	return status;
@@ -2457,6 +3023,7 @@ SWITCH_DECLARE(switch_status_t) switch_xml_init(switch_memory_pool_t *pool, cons
 	switch_mutex_init(&FILE_LOCK, SWITCH_MUTEX_NESTED, XML_MEMORY_POOL);
 	switch_core_hash_init(&CACHE_HASH);
 	switch_core_hash_init(&CACHE_EXPIRES_HASH);
+	switch_core_hash_init(&PP_CACHE);
 
 	switch_thread_rwlock_create(&B_RWLOCK, XML_MEMORY_POOL);
 
@@ -2493,6 +3060,10 @@ SWITCH_DECLARE(switch_status_t) switch_xml_destroy(void)
 	switch_core_hash_destroy(&CACHE_HASH);
 	switch_core_hash_destroy(&CACHE_EXPIRES_HASH);
 
+	switch_mutex_lock(FILE_LOCK);
+	preprocess_cache_clear();
+	switch_mutex_unlock(FILE_LOCK);
+
 	return status;
 }
 
@@ -2878,8 +3449,14 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 
 		if (root->dynamic == 1)
 			free(root->m);		/* malloced xml data */
+#ifndef WIN32
+		else if (root->len)
+			munmap(root->m, root->len);	/* mem mapped xml data */
+#endif
 		if (root->u)
 			free(root->u);		/* utf8 conversion */
+
+		switch_xml_arena_free(root);	/* the children are done with it */
 	}
 
 	switch_xml_free_attr(xml->attr);	/* tag attributes */
@@ -2890,10 +3467,12 @@ SWITCH_DECLARE(void) switch_xml_free(switch_xml_t xml)
 	if (xml->ordered) {
 		orig_xml = xml;
 		xml = xml->ordered;
-		free(orig_xml);
+		if (!(orig_xml->flags & SWITCH_XML_ARENA))
+			free(orig_xml);
 		goto tailrecurse;
 	}
-	free(xml);
+	if (!(xml->flags & SWITCH_XML_ARENA))
+		free(xml);
 }
 
 /* return parser error message or empty string if none */
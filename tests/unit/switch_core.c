@@ -533,6 +533,66 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_switch_regex_cache)
+		{
+			switch_regex_t *re = NULL;
+			int ovector[30];
+			switch_regex_cache_stats_t before = { 0 }, after = { 0 };
+
+			switch_regex_cache_get_stats(&before);
+
+			fst_check_int_equals(switch_regex_perform("1005", "^10(\\d\\d)$", &re, ovector, sizeof(ovector) / sizeof(ovector[0])), 2);
+			fst_requires(re);
+			switch_regex_free(re);
+			re = NULL;
+
+			fst_check_int_equals(switch_regex_perform("1006", "^10(\\d\\d)$", &re, ovector, sizeof(ovector) / sizeof(ovector[0])), 2);
+			fst_requires(re);
+			switch_regex_free(re);
+			re = NULL;
+
+			switch_regex_cache_get_stats(&after);
+			fst_check(after.hits > before.hits);
+			fst_check(after.entries >= 1);
+
+			fst_check(switch_regex_cache_flush() >= 1);
+			switch_regex_cache_get_stats(&after);
+			fst_check_int_equals(after.entries, 0);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_switch_regex_cache_held_across_flush)
+		{
+			switch_regex_t *re = NULL, *re2 = NULL;
+			int ovector[30], ovector2[30];
+			char out[64] = "";
+			int i;
+
+			/* patterns spread over several shards, one held by the caller while the cache is flushed */
+			fst_check_int_equals(switch_regex_perform("2005", "^20(\\d\\d)$", &re, ovector, sizeof(ovector) / sizeof(ovector[0])), 2);
+			fst_requires(re);
+
+			for (i = 0; i < 64; i++) {
+				char expr[32];
+
+				switch_snprintf(expr, sizeof(expr), "^%d(\\d+)$", i);
+				fst_check(switch_regex_match("0", expr) != SWITCH_STATUS_SUCCESS);
+			}
+
+			switch_regex_cache_flush();
+
+			switch_perform_substitution(re, 2, "x$1", "2005", out, sizeof(out), ovector);
+			fst_check_string_equals(out, "x05");
+
+			fst_check_int_equals(switch_regex_perform("2006", "^20(\\d\\d)$", &re2, ovector2, sizeof(ovector2) / sizeof(ovector2[0])), 2);
+			fst_requires(re2);
+			fst_check(re2 != re);
+
+			switch_regex_safe_free(re);
+			switch_regex_safe_free(re2);
+		}
+		FST_TEST_END()
+
 		FST_SESSION_BEGIN(test_switch_channel_get_variable_strdup)
 		{
 			const char *val;
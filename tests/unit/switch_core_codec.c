@@ -153,6 +153,47 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_mod_opus_encode_stats)
+		{
+			int16_t pcm[960] = { 0 };
+			uint8_t encoded[SWITCH_RECOMMENDED_BUFFER_SIZE];
+			uint32_t encoded_len, encoded_rate = 48000;
+			unsigned int flags = 0;
+			switch_codec_t codec = { 0 };
+			switch_codec_settings_t codec_settings = { { 0 } };
+			switch_stream_handle_t stream = { 0 };
+			switch_status_t status;
+			int i;
+
+			status = switch_core_codec_init(&codec, "OPUS", "mod_opus", NULL, 48000, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+											&codec_settings, fst_pool);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			SWITCH_STANDARD_STREAM(stream);
+			fst_requires(switch_api_execute("opus_stats", "reset", NULL, &stream) == SWITCH_STATUS_SUCCESS);
+			switch_safe_free(stream.data);
+
+			for (i = 0; i < 100; i++) {
+				int x;
+
+				for (x = 0; x < 960; x++) {
+					pcm[x] = (int16_t) (8000 * sin(2 * M_PI * 440 * (i * 960 + x) / 48000.0));
+				}
+				encoded_len = sizeof(encoded);
+				status = switch_core_codec_encode(&codec, NULL, pcm, sizeof(pcm), 48000, encoded, &encoded_len, &encoded_rate, &flags);
+				fst_check_int_equals(status, SWITCH_STATUS_SUCCESS);
+			}
+			switch_core_codec_destroy(&codec);
+
+			/* every packet lands in the encode time histogram once the encoder is gone */
+			SWITCH_STANDARD_STREAM(stream);
+			fst_requires(switch_api_execute("opus_stats", NULL, NULL, &stream) == SWITCH_STATUS_SUCCESS);
+			fst_check(strstr((char *) stream.data, "Complexity: fixed") != NULL);
+			fst_check(strstr((char *) stream.data, " 100 ") != NULL);
+			switch_safe_free(stream.data);
+		}
+		FST_TEST_END()
+
 	}
 	FST_SUITE_END()
 }
@@ -31,6 +31,10 @@
  */
 #include <switch.h>
 #include <stdlib.h>
+#include <sys/resource.h>
+#ifndef WIN32
+#include <utime.h>
+#endif
 
 #include <test/switch_test.h>
 
@@ -224,6 +228,362 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEST_END()
 
+		FST_TEST_BEGIN(test_switch_core_file_cache)
+		{
+			switch_file_handle_t fh = { 0 };
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			static char filename[] = "/tmp/fs_cache_unit_test.wav";
+			int16_t buf[320], *first, *second;
+			switch_size_t len, first_len = 0, second_len = 0;
+			unsigned int pos = 0;
+			cJSON *stats;
+			int i;
+
+			status = switch_core_file_open(&fh, filename, 1, 16000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 50; i++) {
+				int j;
+
+				for (j = 0; j < 320; j++) {
+					buf[j] = (int16_t) ((i * 320 + j) * 7);
+				}
+
+				len = 320;
+				switch_core_file_write(&fh, buf, &len);
+			}
+
+			switch_core_file_close(&fh);
+
+			switch_core_file_cache_set_limit(1024 * 1024, 0);
+			switch_malloc(first, 16000 * sizeof(int16_t));
+			switch_malloc(second, 16000 * sizeof(int16_t));
+
+			/* the first playback decodes and resamples, and fills the cache when it reaches the end */
+			memset(&fh, 0, sizeof(fh));
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(!switch_test_flag(&fh, SWITCH_FILE_CACHED));
+
+			do {
+				len = 160;
+				status = switch_core_file_read(&fh, first + first_len, &len);
+				first_len += len;
+			} while (status == SWITCH_STATUS_SUCCESS && first_len + 160 <= 16000);
+
+			switch_core_file_close(&fh);
+			fst_check(first_len > 0);
+
+			/* the second one is served from memory and must be identical */
+			memset(&fh, 0, sizeof(fh));
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_test_flag(&fh, SWITCH_FILE_CACHED));
+			fst_check(fh.samplerate == 8000);
+
+			do {
+				len = 160;
+				status = switch_core_file_read(&fh, second + second_len, &len);
+				second_len += len;
+			} while (status == SWITCH_STATUS_SUCCESS && second_len + 160 <= 16000);
+
+			fst_check(first_len == second_len);
+			fst_check(!memcmp(first, second, first_len * sizeof(int16_t)));
+
+			status = switch_core_file_seek(&fh, &pos, 80, SEEK_SET);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(pos == 80);
+			len = 160;
+			status = switch_core_file_read(&fh, buf, &len);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 160);
+			fst_check(!memcmp(buf, first + 80, len * sizeof(int16_t)));
+
+			switch_core_file_close(&fh);
+			fst_check(!switch_test_flag(&fh, SWITCH_FILE_CACHED));
+
+			stats = switch_core_file_cache_stats();
+			fst_check(cJSON_GetObjectItem(stats, "hits")->valueint == 1);
+			fst_check(cJSON_GetObjectItem(stats, "misses")->valueint == 1);
+			fst_check(cJSON_GetObjectItem(stats, "entries")->valueint == 1);
+			cJSON_Delete(stats);
+
+			fst_check(switch_core_file_cache_flush() == 1);
+			switch_core_file_cache_set_limit(0, 0);
+
+			switch_safe_free(first);
+			switch_safe_free(second);
+			unlink(filename);
+		}
+		FST_TEST_END()
+
+#ifndef WIN32
+		FST_TEST_BEGIN(test_switch_core_file_cache_rewrite)
+		{
+			switch_file_handle_t fh = { 0 };
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			static char filename[] = "/tmp/fs_cache_rewrite_unit_test.wav";
+			int16_t buf[320];
+			switch_size_t len;
+			struct stat st;
+			struct utimbuf times;
+			int pass, i, j;
+
+			switch_core_file_cache_set_limit(1024 * 1024, 0);
+
+			/* the same size rewritten in the same second, mtime put back, must not replay the old audio */
+			for (pass = 0; pass < 2; pass++) {
+				memset(&fh, 0, sizeof(fh));
+				status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+				fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+				for (i = 0; i < 10; i++) {
+					for (j = 0; j < 320; j++) {
+						buf[j] = (int16_t) (pass ? -1000 : 1000);
+					}
+
+					len = 320;
+					switch_core_file_write(&fh, buf, &len);
+				}
+
+				switch_core_file_close(&fh);
+
+				if (pass) {
+					times.actime = st.st_atime;
+					times.modtime = st.st_mtime;
+					utime(filename, &times);
+				} else {
+					fst_requires(stat(filename, &st) == 0);
+				}
+
+				memset(&fh, 0, sizeof(fh));
+				status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+				fst_requires(status == SWITCH_STATUS_SUCCESS);
+				fst_check(!switch_test_flag(&fh, SWITCH_FILE_CACHED));
+
+				len = 160;
+				status = switch_core_file_read(&fh, buf, &len);
+				fst_check(status == SWITCH_STATUS_SUCCESS);
+				fst_check(buf[80] == (pass ? -1000 : 1000));
+
+				do {
+					len = 160;
+				} while (switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+
+				switch_core_file_close(&fh);
+			}
+
+			fst_check(switch_core_file_cache_flush() == 2);
+			switch_core_file_cache_set_limit(0, 0);
+			unlink(filename);
+		}
+		FST_TEST_END()
+#endif
+
+		FST_TEST_BEGIN(test_switch_core_file_mapped_read)
+		{
+			switch_file_handle_t fh = { 0 };
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			static char filename[] = "/tmp/fs_mmap_unit_test.wav";
+			int16_t buf[160];
+			switch_size_t len;
+			unsigned int pos = 0;
+			int i, j;
+
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 10; i++) {
+				for (j = 0; j < 160; j++) {
+					buf[j] = (int16_t) (i * 160 + j);
+				}
+
+				len = 160;
+				switch_core_file_write(&fh, buf, &len);
+			}
+
+			switch_core_file_close(&fh);
+
+			/* mapping is opt in, a plain open keeps going through libsndfile */
+			memset(&fh, 0, sizeof(fh));
+			status = switch_core_file_open(&fh, filename, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(!switch_test_flag(&fh, SWITCH_FILE_MAPPED));
+			switch_core_file_close(&fh);
+
+			memset(&fh, 0, sizeof(fh));
+			fh.pre_buffer_datalen = 4096;
+			status = switch_core_file_open(&fh, "{mmap=true}/tmp/fs_mmap_unit_test.wav", 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_test_flag(&fh, SWITCH_FILE_MAPPED));
+			fst_check(fh.pre_buffer == NULL);
+
+			len = 160;
+			fst_check(switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 160 && buf[0] == 0 && buf[159] == 159);
+
+			status = switch_core_file_seek(&fh, &pos, 1000, SEEK_SET);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(pos == 1000);
+			len = 160;
+			fst_check(switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 160 && buf[0] == 1000);
+
+			switch_core_file_close(&fh);
+			unlink(filename);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_switch_core_file_playback_benchmark)
+		{
+			static char filename[] = "/tmp/fs_bench_unit_test.wav";
+			const char *paths[2] = { "{mmap=true}/tmp/fs_bench_unit_test.wav", filename };
+			switch_file_handle_t *fhs;
+			switch_status_t status;
+			int16_t buf[160] = { 0 }, *played[2];
+			switch_size_t len, played_len[2] = { 0 };
+#ifdef BENCHMARK
+			int channels = 1000, seconds = 30;
+#else
+			int channels = 10, seconds = 2;
+#endif
+			int i, x, frame, mismatched = 0;
+
+			switch_zmalloc(fhs, sizeof(*fhs) * channels);
+			switch_zmalloc(played[0], seconds * 8000 * sizeof(int16_t));
+			switch_zmalloc(played[1], seconds * 8000 * sizeof(int16_t));
+
+			status = switch_core_file_open(&fhs[0], filename, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+
+			for (frame = 0; frame < seconds * 50; frame++) {
+				for (x = 0; x < 160; x++) {
+					buf[x] = (int16_t) (((frame * 160 + x) * 31) % 20000 - 10000);
+				}
+
+				len = 160;
+				switch_core_file_write(&fhs[0], buf, &len);
+			}
+
+			switch_core_file_close(&fhs[0]);
+
+			for (i = 0; i < 2; i++) {
+				struct rusage before, after;
+				double cpu_ms;
+
+				memset(fhs, 0, sizeof(*fhs) * channels);
+
+				for (x = 0; x < channels; x++) {
+					status = switch_core_file_open(&fhs[x], paths[i], 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+					fst_requires(status == SWITCH_STATUS_SUCCESS);
+				}
+
+				getrusage(RUSAGE_SELF, &before);
+
+				/* every channel pulls one 20ms frame per tick, like a timed playback; the first channel keeps
+				   what it played and the others have to play the same samples */
+				for (frame = 0; frame < seconds * 50; frame++) {
+					for (x = 0; x < channels; x++) {
+						len = 160;
+						if (switch_core_file_read(&fhs[x], buf, &len) != SWITCH_STATUS_SUCCESS) {
+							len = 0;
+						}
+
+						if (!x) {
+							memcpy(played[i] + played_len[i], buf, len * sizeof(int16_t));
+						} else if (memcmp(played[i] + played_len[i], buf, len * sizeof(int16_t))) {
+							mismatched++;
+						}
+
+						if (x == channels - 1) {
+							played_len[i] += len;
+						}
+					}
+				}
+
+				getrusage(RUSAGE_SELF, &after);
+
+				cpu_ms = (after.ru_utime.tv_sec - before.ru_utime.tv_sec + after.ru_stime.tv_sec - before.ru_stime.tv_sec) * 1000.0 +
+					(after.ru_utime.tv_usec - before.ru_utime.tv_usec + after.ru_stime.tv_usec - before.ru_stime.tv_usec) / 1000.0;
+
+				switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "file playback (%s): %.2f ms CPU per second of audio per 1000 channels\n",
+								  i ? "libsndfile" : "mmap", cpu_ms / seconds * 1000 / channels);
+
+				for (x = 0; x < channels; x++) {
+					switch_core_file_close(&fhs[x]);
+				}
+			}
+
+			/* mapped and read playback of the same file play exactly the same samples */
+			fst_check_int_equals(mismatched, 0);
+			fst_check(played_len[0] == (switch_size_t) seconds * 8000);
+			fst_check(played_len[0] == played_len[1]);
+			fst_check(!memcmp(played[0], played[1], played_len[0] * sizeof(int16_t)));
+
+			switch_safe_free(played[0]);
+			switch_safe_free(played[1]);
+			switch_safe_free(fhs);
+			unlink(filename);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_switch_core_file_native_prompt)
+		{
+			switch_file_handle_t fh = { 0 };
+			switch_status_t status = SWITCH_STATUS_FALSE;
+			static char filename[] = "/tmp/fs_unit_test." SWITCH_NATIVE_PROMPT_EXT;
+			switch_native_prompt_header_t hdr = { { 0 } };
+			uint32_t offsets[4] = { 0, 3, 8, 10 };
+			uint8_t payload[10] = { 1, 1, 1, 2, 2, 2, 2, 2, 3, 3 };
+			uint8_t buf[64];
+			switch_size_t len;
+			unsigned int pos = 0;
+			FILE *f = NULL;
+
+			memcpy(hdr.magic, SWITCH_NATIVE_PROMPT_MAGIC, sizeof(hdr.magic));
+			hdr.version = SWITCH_NATIVE_PROMPT_VERSION;
+			switch_copy_string(hdr.iananame, "opus", sizeof(hdr.iananame));
+			hdr.samples_per_second = hdr.actual_samples_per_second = 48000;
+			hdr.microseconds_per_packet = 20000;
+			hdr.samples_per_packet = 960;
+			hdr.channels = 1;
+			hdr.frames = 3;
+
+			f = fopen(filename, "w");
+			fst_requires(f != NULL);
+			fwrite(&hdr, 1, sizeof(hdr), f);
+			fwrite(offsets, 1, sizeof(offsets), f);
+			fwrite(payload, 1, sizeof(payload), f);
+			fclose(f);
+
+			status = switch_core_file_open(&fh, filename, 1, 48000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, NULL);
+			fst_requires(status == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_test_flag(&fh, SWITCH_FILE_NATIVE));
+			fst_check(switch_test_flag(&fh, SWITCH_FILE_NATIVE_FRAMED));
+
+			/* every read hands back exactly one stored packet */
+			len = sizeof(buf);
+			fst_check(switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 3 && buf[0] == 1);
+			len = sizeof(buf);
+			fst_check(switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 5 && buf[0] == 2);
+
+			status = switch_core_file_seek(&fh, &pos, 1920, SEEK_SET);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(pos == 1920);
+			len = sizeof(buf);
+			fst_check(switch_core_file_read(&fh, buf, &len) == SWITCH_STATUS_SUCCESS);
+			fst_check(len == 2 && buf[0] == 3);
+			len = sizeof(buf);
+			fst_check(switch_core_file_read(&fh, buf, &len) != SWITCH_STATUS_SUCCESS);
+			fst_check(len == 0);
+
+			switch_core_file_close(&fh);
+			unlink(filename);
+		}
+		FST_TEST_END()
+
 	}
 	FST_SUITE_END()
 }
@@ -3,6 +3,139 @@
 
 // #define BENCHMARK 1
 
+#ifdef BENCHMARK
+#define CONCURRENT_HASH_OPS 1000000
+#else
+#define CONCURRENT_HASH_OPS 10000
+#endif
+#define CONCURRENT_HASH_KEYS 1000
+
+typedef enum {
+	HASH_BENCH_MUTEX,
+	HASH_BENCH_RWLOCK,
+	HASH_BENCH_CONCURRENT
+} hash_bench_mode_t;
+
+static const char *hash_bench_names[] = { "mutex", "rwlock", "concurrent" };
+
+typedef struct {
+	hash_bench_mode_t mode;
+	switch_hash_t *hash;
+	switch_mutex_t *mutex;
+	switch_thread_rwlock_t *rwlock;
+	switch_concurrent_hash_t *chash;
+	char **index;
+	int id;
+	int misses;
+} hash_bench_t;
+
+/* 9 lookups for every insert/delete pair, roughly what the session table sees */
+static void *SWITCH_THREAD_FUNC hash_bench_thread(switch_thread_t *thread, void *obj)
+{
+	hash_bench_t *b = (hash_bench_t *) obj;
+	char key[64];
+	int x;
+
+	switch_snprintf(key, sizeof(key), "thread-%d", b->id);
+
+	for (x = 0; x < CONCURRENT_HASH_OPS; x++) {
+		const char *k = b->index[(x * 7 + b->id) % CONCURRENT_HASH_KEYS];
+		void *val = NULL;
+
+		if (x % 10 == 9) {
+			switch (b->mode) {
+			case HASH_BENCH_MUTEX:
+				switch_core_hash_insert_locked(b->hash, key, b, b->mutex);
+				switch_core_hash_delete_locked(b->hash, key, b->mutex);
+				break;
+			case HASH_BENCH_RWLOCK:
+				switch_core_hash_insert_wrlock(b->hash, key, b, b->rwlock);
+				switch_core_hash_delete_wrlock(b->hash, key, b->rwlock);
+				break;
+			case HASH_BENCH_CONCURRENT:
+				switch_core_concurrent_hash_insert(b->chash, key, b);
+				switch_core_concurrent_hash_delete(b->chash, key);
+				break;
+			}
+			continue;
+		}
+
+		switch (b->mode) {
+		case HASH_BENCH_MUTEX:
+			val = switch_core_hash_find_locked(b->hash, k, b->mutex);
+			break;
+		case HASH_BENCH_RWLOCK:
+			val = switch_core_hash_find_rdlock(b->hash, k, b->rwlock);
+			break;
+		case HASH_BENCH_CONCURRENT:
+			val = switch_core_concurrent_hash_find(b->chash, k);
+			break;
+		}
+
+		if (val != k) {
+			b->misses++;
+		}
+	}
+
+	return NULL;
+}
+
+static int hash_bench_run(hash_bench_mode_t mode, int threads, char **index, switch_memory_pool_t *pool)
+{
+	hash_bench_t *benches = switch_core_alloc(pool, sizeof(hash_bench_t) * threads);
+	switch_thread_t **thread_list = switch_core_alloc(pool, sizeof(switch_thread_t *) * threads);
+	switch_threadattr_t *thd_attr = NULL;
+	switch_hash_t *hash = NULL;
+	switch_concurrent_hash_t *chash = NULL;
+	switch_mutex_t *mutex = NULL;
+	switch_thread_rwlock_t *rwlock = NULL;
+	switch_time_t start_ts;
+	uint64_t micro_total;
+	int x, misses = 0;
+
+	switch_core_hash_init(&hash);
+	switch_core_hash_init_concurrent(&chash, 0, SWITCH_TRUE);
+	switch_mutex_init(&mutex, SWITCH_MUTEX_NESTED, pool);
+	switch_thread_rwlock_create(&rwlock, pool);
+
+	for (x = 0; x < CONCURRENT_HASH_KEYS; x++) {
+		switch_core_hash_insert(hash, index[x], index[x]);
+		switch_core_concurrent_hash_insert(chash, index[x], index[x]);
+	}
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	start_ts = switch_time_now();
+
+	for (x = 0; x < threads; x++) {
+		benches[x].mode = mode;
+		benches[x].hash = hash;
+		benches[x].mutex = mutex;
+		benches[x].rwlock = rwlock;
+		benches[x].chash = chash;
+		benches[x].index = index;
+		benches[x].id = x;
+		switch_thread_create(&thread_list[x], thd_attr, hash_bench_thread, &benches[x], pool);
+	}
+
+	for (x = 0; x < threads; x++) {
+		switch_status_t st;
+		switch_thread_join(&st, thread_list[x]);
+		misses += benches[x].misses;
+	}
+
+	micro_total = switch_time_now() - start_ts;
+
+	printf("switch_hash %s %d threads: Total %" SWITCH_UINT64_T_FMT "us, %.0f ops per second\n", hash_bench_names[mode], threads,
+		   micro_total, micro_total ? (double) CONCURRENT_HASH_OPS * threads * 1000000 / micro_total : 0);
+
+	switch_core_concurrent_hash_destroy(&chash);
+	switch_core_hash_destroy(&hash);
+
+	return misses;
+}
+
 FST_MINCORE_BEGIN("./conf")
 
 FST_SUITE_BEGIN(switch_hash)
@@ -132,6 +265,60 @@ FST_TEST_BEGIN(benchmark)
 }
 FST_TEST_END()
 
+FST_TEST_BEGIN(concurrent_hash)
+{
+  switch_concurrent_hash_t *hash = NULL;
+  char *keys[] = { "alpha", "bravo", "charlie", "delta" };
+  int x;
+
+  fst_requires(switch_core_hash_init_concurrent(&hash, 3, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+  fst_requires(hash);
+
+  for (x = 0; x < 4; x++) {
+    fst_check(switch_core_concurrent_hash_insert(hash, keys[x], keys[x]) == SWITCH_STATUS_SUCCESS);
+  }
+
+  fst_check_int_equals(switch_core_concurrent_hash_count(hash), 4);
+  fst_check_string_equals((char *) switch_core_concurrent_hash_find(hash, "BRAVO"), "bravo");
+
+  /* replacing a key keeps a single entry */
+  fst_check(switch_core_concurrent_hash_insert(hash, "Charlie", keys[0]) == SWITCH_STATUS_SUCCESS);
+  fst_check_int_equals(switch_core_concurrent_hash_count(hash), 4);
+  fst_check_string_equals((char *) switch_core_concurrent_hash_find(hash, "charlie"), "alpha");
+
+  fst_check_string_equals((char *) switch_core_concurrent_hash_delete(hash, "delta"), "delta");
+  fst_check(switch_core_concurrent_hash_find(hash, "delta") == NULL);
+  fst_check_int_equals(switch_core_concurrent_hash_count(hash), 3);
+
+  switch_core_concurrent_hash_destroy(&hash);
+  fst_check(hash == NULL);
+}
+FST_TEST_END()
+
+FST_TEST_BEGIN(concurrent_benchmark)
+{
+  int threads[] = { 1, 8, 32 };
+  char **index = NULL;
+  int x, t;
+
+  index = calloc(CONCURRENT_HASH_KEYS, sizeof(char *));
+  for (x = 0; x < CONCURRENT_HASH_KEYS; x++) {
+    index[x] = switch_mprintf("%d", x);
+  }
+
+  for (t = 0; t < 3; t++) {
+    fst_check_int_equals(hash_bench_run(HASH_BENCH_MUTEX, threads[t], index, fst_pool), 0);
+    fst_check_int_equals(hash_bench_run(HASH_BENCH_RWLOCK, threads[t], index, fst_pool), 0);
+    fst_check_int_equals(hash_bench_run(HASH_BENCH_CONCURRENT, threads[t], index, fst_pool), 0);
+  }
+
+  for (x = 0; x < CONCURRENT_HASH_KEYS; x++) {
+    free(index[x]);
+  }
+  free(index);
+}
+FST_TEST_END()
+
 FST_SUITE_END()
 
 FST_MINCORE_END()
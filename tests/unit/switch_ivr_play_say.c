@@ -100,6 +100,27 @@ static switch_status_t partial_play_and_collect_input_callback(switch_core_sessi
 	return status;
 }
 
+static char *find_stored_prompt(const char *dir, const char *want, switch_memory_pool_t *pool)
+{
+	switch_dir_t *dirp = NULL;
+	char buf[256], *path = NULL;
+	const char *name, *ext;
+
+	if (switch_dir_open(&dirp, dir, pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	while (!path && (name = switch_dir_next_file(dirp, buf, sizeof(buf)))) {
+		if ((ext = strrchr(name, '.')) && !strcmp(ext + 1, want) && strncmp(name, "decoy", 5)) {
+			path = switch_core_sprintf(pool, "%s%s%s", dir, SWITCH_PATH_SEPARATOR, name);
+		}
+	}
+
+	switch_dir_close(dirp);
+
+	return path;
+}
+
 FST_CORE_BEGIN("./conf_playsay")
 {
 	FST_SUITE_BEGIN(switch_ivr_play_say)
@@ -108,6 +129,7 @@ FST_CORE_BEGIN("./conf_playsay")
 		{
 			fst_requires_module("mod_tone_stream");
 			fst_requires_module("mod_sndfile");
+			fst_requires_module("mod_native_file");
 			fst_requires_module("mod_dptools");
 			fst_requires_module("mod_test");
 		}
@@ -471,6 +493,163 @@ FST_CORE_BEGIN("./conf_playsay")
 			unlink(record_filename);
 		}
 		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(native_prompt_store_round_trip)
+		{
+			const char *uuid = switch_core_session_get_uuid(fst_session);
+			char *source = switch_core_session_sprintf(fst_session, "%s" SWITCH_PATH_SEPARATOR "native_prompt_src-%s.wav", SWITCH_GLOBAL_dirs.temp_dir, uuid);
+			char *dir = switch_core_session_sprintf(fst_session, "%s" SWITCH_PATH_SEPARATOR "native_prompt_store-%s", SWITCH_GLOBAL_dirs.temp_dir, uuid);
+			char *decoy = switch_core_session_sprintf(fst_session, "%s" SWITCH_PATH_SEPARATOR "decoy." SWITCH_NATIVE_PROMPT_EXT, dir);
+			char *stored = NULL;
+			switch_file_handle_t src_fh = { 0 }, store_fh = { 0 }, play_fh = { 0 }, replay_fh = { 0 };
+			switch_codec_t codec = { 0 }, check = { 0 };
+			int16_t pcm[160];
+			uint8_t packet[SWITCH_RECOMMENDED_BUFFER_SIZE], enc[SWITCH_RECOMMENDED_BUFFER_SIZE];
+			switch_size_t len;
+			int x, frames = 0, matched = 0;
+			struct stat st;
+			FILE *f;
+
+			/* a deterministic half second prompt, so the stored packets can be compared with a fresh encode */
+			fst_requires(switch_core_file_open(&src_fh, source, 1, 8000, SWITCH_FILE_FLAG_WRITE | SWITCH_FILE_DATA_SHORT, fst_pool) == SWITCH_STATUS_SUCCESS);
+			for (frames = 0; frames < 25; frames++) {
+				for (x = 0; x < 160; x++) {
+					pcm[x] = (int16_t) (((frames * 160 + x) * 37) % 16000 - 8000);
+				}
+				len = 160;
+				switch_core_file_write(&src_fh, pcm, &len);
+			}
+			switch_core_file_close(&src_fh);
+
+			/* an old container twice the cap that the store has to evict once the new one lands */
+			fst_requires(switch_dir_make_recursive(dir, SWITCH_DEFAULT_DIR_PERMS, fst_pool) == SWITCH_STATUS_SUCCESS);
+			f = fopen(decoy, "w");
+			fst_requires(f != NULL);
+			fst_requires(ftruncate(fileno(f), 2 * 1024 * 1024) == 0);
+			fclose(f);
+
+			fst_requires(switch_core_codec_init(&codec, "PCMU", NULL, NULL, 8000, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+												NULL, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_core_session_set_read_codec(fst_session, &codec) == SWITCH_STATUS_SUCCESS);
+
+			switch_channel_set_variable(fst_channel, "native_prompt_store", "true");
+			switch_channel_set_variable(fst_channel, "native_prompt_store_dir", dir);
+			switch_channel_set_variable(fst_channel, "native_prompt_store_max_mb", "1");
+
+			/* the first play is a miss that schedules the encode */
+			fst_check(switch_ivr_play_file(fst_session, &play_fh, source, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_check(!switch_test_flag(&play_fh, SWITCH_FILE_NATIVE));
+
+			/* the container is renamed into place before the store is trimmed, so wait for both */
+			for (x = 0; x < 50; x++) {
+				if ((stored = find_stored_prompt(dir, SWITCH_NATIVE_PROMPT_EXT, fst_pool)) && switch_file_exists(decoy, fst_pool) != SWITCH_STATUS_SUCCESS) {
+					break;
+				}
+				switch_sleep(100000);
+			}
+			fst_requires(stored != NULL);
+			fst_xcheck(switch_file_exists(decoy, fst_pool) != SWITCH_STATUS_SUCCESS, "Expect the store to evict the oldest container over the cap");
+
+			/* every stored packet matches encoding the source directly */
+			fst_requires(switch_core_codec_init(&check, "PCMU", NULL, NULL, 8000, 20, 1, SWITCH_CODEC_FLAG_ENCODE, NULL, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_core_file_open(&src_fh, source, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_core_file_open(&store_fh, stored, 1, 8000, SWITCH_FILE_FLAG_READ | SWITCH_FILE_DATA_SHORT, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_test_flag(&store_fh, SWITCH_FILE_NATIVE_FRAMED));
+
+			for (frames = 0; ; frames++) {
+				uint32_t enclen = sizeof(enc), rate = 8000;
+				unsigned int flag = 0;
+
+				len = sizeof(packet);
+				if (switch_core_file_read(&store_fh, packet, &len) != SWITCH_STATUS_SUCCESS) {
+					break;
+				}
+
+				len = 160;
+				if (switch_core_file_read(&src_fh, pcm, &len) != SWITCH_STATUS_SUCCESS || len != 160) {
+					break;
+				}
+
+				switch_core_codec_encode(&check, NULL, pcm, sizeof(pcm), 8000, enc, &enclen, &rate, &flag);
+
+				if (enclen == 160 && !memcmp(packet, enc, enclen)) {
+					matched++;
+				}
+			}
+
+			fst_check_int_equals(frames, 25);
+			fst_check_int_equals(matched, 25);
+			switch_core_file_close(&store_fh);
+			switch_core_file_close(&src_fh);
+			switch_core_codec_destroy(&check);
+
+			/* the second play is a hit and streams the container, and marks it as just used for eviction */
+			fst_requires(switch_file_mtime_set(stored, switch_time_now() - 3600 * 1000000LL, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_ivr_play_file(fst_session, &replay_fh, source, NULL) == SWITCH_STATUS_SUCCESS);
+			fst_check(switch_test_flag(&replay_fh, SWITCH_FILE_NATIVE));
+			fst_requires(stat(stored, &st) == 0);
+			fst_xcheck(switch_epoch_time_now(NULL) - st.st_mtime < 60, "Expect a hit to refresh the container's last use");
+
+			switch_core_session_unset_read_codec(fst_session);
+			switch_core_codec_destroy(&codec);
+			unlink(stored);
+			unlink(decoy);
+			rmdir(dir);
+			unlink(source);
+		}
+		FST_SESSION_END()
+
+		FST_SESSION_BEGIN(native_prompt_store_failure_backoff)
+		{
+			const char *uuid = switch_core_session_get_uuid(fst_session);
+			char *source = switch_core_session_sprintf(fst_session, "%s" SWITCH_PATH_SEPARATOR "native_prompt_bad-%s.wav", SWITCH_GLOBAL_dirs.temp_dir, uuid);
+			char *dir = switch_core_session_sprintf(fst_session, "%s" SWITCH_PATH_SEPARATOR "native_prompt_fail-%s", SWITCH_GLOBAL_dirs.temp_dir, uuid);
+			char *fail = NULL;
+			switch_file_handle_t play_fh = { 0 }, replay_fh = { 0 };
+			switch_codec_t codec = { 0 };
+			struct stat st;
+			time_t marked;
+			int x;
+			FILE *f;
+
+			/* a prompt no file module can open, so the encode job fails */
+			f = fopen(source, "w");
+			fst_requires(f != NULL);
+			fputs("not a wav file", f);
+			fclose(f);
+
+			fst_requires(switch_core_codec_init(&codec, "PCMU", NULL, NULL, 8000, 20, 1, SWITCH_CODEC_FLAG_ENCODE | SWITCH_CODEC_FLAG_DECODE,
+												NULL, fst_pool) == SWITCH_STATUS_SUCCESS);
+			fst_requires(switch_core_session_set_read_codec(fst_session, &codec) == SWITCH_STATUS_SUCCESS);
+
+			switch_channel_set_variable(fst_channel, "native_prompt_store", "true");
+			switch_channel_set_variable(fst_channel, "native_prompt_store_dir", dir);
+
+			switch_ivr_play_file(fst_session, &play_fh, source, NULL);
+
+			for (x = 0; x < 50 && !(fail = find_stored_prompt(dir, "fail", fst_pool)); x++) {
+				switch_sleep(100000);
+			}
+			fst_requires(fail != NULL);
+			fst_requires(stat(fail, &st) == 0);
+			marked = st.st_mtime;
+
+			/* inside the backoff a play does not queue another encode */
+			switch_sleep(1100000);
+			switch_ivr_play_file(fst_session, &replay_fh, source, NULL);
+			switch_sleep(500000);
+			fst_check(find_stored_prompt(dir, "part", fst_pool) == NULL);
+			fst_check(find_stored_prompt(dir, SWITCH_NATIVE_PROMPT_EXT, fst_pool) == NULL);
+			fst_requires(stat(fail, &st) == 0);
+			fst_xcheck(st.st_mtime == marked, "Expect no second failed encode inside the backoff");
+
+			switch_core_session_unset_read_codec(fst_session);
+			switch_core_codec_destroy(&codec);
+			unlink(fail);
+			rmdir(dir);
+			unlink(source);
+		}
+		FST_SESSION_END()
 	}
 	FST_SUITE_END()
 }
@@ -0,0 +1,148 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2026, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ * Contributor(s):
+ *
+ *
+ * switch_loadable_module.c -- tests module load times
+ *
+ */
+#include <switch.h>
+#include <stdlib.h>
+
+#include <test/switch_test.h>
+
+#define LOAD_TEST_MODULE "mod_tone_stream"
+#define LOAD_TEST_EVENTS 8
+
+/* the load_ms headers of the MODULE_LOAD events seen for LOAD_TEST_MODULE */
+static struct {
+	switch_mutex_t *mutex;
+	char load_ms[LOAD_TEST_EVENTS][16];
+	int count;
+} load_test;
+
+static void load_test_event_handler(switch_event_t *event)
+{
+	const char *key = switch_event_get_header(event, "key");
+	const char *load_ms = switch_event_get_header(event, "load_ms");
+
+	if (!key || strcmp(key, LOAD_TEST_MODULE)) {
+		return;
+	}
+
+	switch_mutex_lock(load_test.mutex);
+	if (load_test.count < LOAD_TEST_EVENTS) {
+		switch_copy_string(load_test.load_ms[load_test.count++], switch_str_nil(load_ms), sizeof(load_test.load_ms[0]));
+	}
+	switch_mutex_unlock(load_test.mutex);
+}
+
+static cJSON *load_test_timeline_entry(cJSON *timeline, const char *module)
+{
+	cJSON *modules = cJSON_GetObjectItem(timeline, "modules"), *item;
+
+	cJSON_ArrayForEach(item, modules) {
+		const char *name = cJSON_GetObjectCstr(item, "module");
+
+		if (name && !strncmp(name, module, strlen(module))) {
+			return item;
+		}
+	}
+
+	return NULL;
+}
+
+FST_CORE_BEGIN("./conf")
+{
+	FST_SUITE_BEGIN(switch_loadable_module)
+	{
+		FST_SETUP_BEGIN()
+		{
+			switch_mutex_init(&load_test.mutex, SWITCH_MUTEX_NESTED, fst_pool);
+			memset(load_test.load_ms, 0, sizeof(load_test.load_ms));
+			load_test.count = 0;
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(startup_timeline)
+		{
+			cJSON *timeline = switch_loadable_module_load_timeline();
+			cJSON *entry = load_test_timeline_entry(timeline, LOAD_TEST_MODULE);
+			double total = cJSON_GetObjectItem(timeline, "total_us")->valuedouble;
+
+			fst_requires(entry);
+			fst_check_string_equals(cJSON_GetObjectCstr(entry, "status"), "loaded");
+			fst_check_string_equals(cJSON_GetObjectCstr(entry, "type"), "common");
+			fst_check(cJSON_GetObjectItem(entry, "duration_us")->valuedouble >= 0);
+			fst_check(cJSON_GetObjectItem(entry, "start_us")->valuedouble >= 0);
+			fst_check(cJSON_GetObjectItem(entry, "start_us")->valuedouble + cJSON_GetObjectItem(entry, "duration_us")->valuedouble <= total);
+
+			cJSON_Delete(timeline);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(load_ms_header)
+		{
+			const char *err = NULL;
+			int i;
+
+			fst_requires(switch_loadable_module_unload_module(SWITCH_GLOBAL_dirs.mod_dir, LOAD_TEST_MODULE, SWITCH_FALSE, &err) == SWITCH_STATUS_SUCCESS);
+
+			switch_event_bind("switch_loadable_module", SWITCH_EVENT_MODULE_LOAD, SWITCH_EVENT_SUBCLASS_ANY, load_test_event_handler, NULL);
+			fst_requires(switch_loadable_module_load_module(SWITCH_GLOBAL_dirs.mod_dir, LOAD_TEST_MODULE, SWITCH_TRUE, &err) == SWITCH_STATUS_SUCCESS);
+
+			for (i = 0; i < 20; i++) {
+				int count;
+
+				switch_mutex_lock(load_test.mutex);
+				count = load_test.count;
+				switch_mutex_unlock(load_test.mutex);
+
+				if (count) {
+					break;
+				}
+				switch_yield(100000);
+			}
+			switch_event_unbind_callback(load_test_event_handler);
+
+			/* every interface event of one load reports the same non negative whole ms */
+			switch_mutex_lock(load_test.mutex);
+			fst_check(load_test.count > 0);
+			for (i = 0; i < load_test.count; i++) {
+				fst_check(!zstr(load_test.load_ms[i]));
+				fst_check(switch_is_number(load_test.load_ms[i]));
+				fst_check(atoi(load_test.load_ms[i]) >= 0);
+				fst_check_string_equals(load_test.load_ms[i], load_test.load_ms[0]);
+			}
+			switch_mutex_unlock(load_test.mutex);
+		}
+		FST_TEST_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
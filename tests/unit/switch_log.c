@@ -88,6 +88,86 @@ static char *wait_for_log(switch_interval_time_t timeout_ms)
 	return log_str;
 }
 
+#define BENCH_LINES_PER_THREAD 2000
+static uint32_t bench_lines = 0;
+
+static switch_status_t bench_logger(const switch_log_node_t *node, switch_log_level_t level)
+{
+	if (node->content && strstr(node->content, "switch_log bench: ")) {
+		switch_mutex_lock(mutex);
+		bench_lines++;
+		switch_mutex_unlock(mutex);
+	}
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void *SWITCH_THREAD_FUNC bench_thread(switch_thread_t *thread, void *obj)
+{
+	int id = *(int *) obj;
+	int x;
+
+	for (x = 0; x < BENCH_LINES_PER_THREAD; x++) {
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_DEBUG, "switch_log bench: thread %d line %d\n", id, x);
+	}
+
+	return NULL;
+}
+
+static uint32_t run_bench(int threads)
+{
+	switch_thread_t *thread_list[16];
+	int ids[16];
+	switch_threadattr_t *thd_attr = NULL;
+	switch_time_t start, end;
+	uint32_t expected = threads * BENCH_LINES_PER_THREAD, delivered = 0, last = 0;
+	int x, idle = 0;
+
+	switch_mutex_lock(mutex);
+	bench_lines = 0;
+	switch_mutex_unlock(mutex);
+
+	switch_threadattr_create(&thd_attr, pool);
+	switch_threadattr_stacksize_set(thd_attr, SWITCH_THREAD_STACKSIZE);
+
+	start = switch_time_now();
+
+	for (x = 0; x < threads; x++) {
+		ids[x] = x;
+		switch_thread_create(&thread_list[x], thd_attr, bench_thread, &ids[x], pool);
+	}
+
+	for (x = 0; x < threads; x++) {
+		switch_status_t st;
+		switch_thread_join(&st, thread_list[x]);
+	}
+
+	/* wait for the log thread to catch up, lines dropped on a full queue never arrive */
+	while (idle < 20) {
+		switch_mutex_lock(mutex);
+		delivered = bench_lines;
+		switch_mutex_unlock(mutex);
+
+		if (delivered >= expected) {
+			break;
+		}
+
+		if (delivered == last) {
+			idle++;
+		} else {
+			idle = 0;
+		}
+		last = delivered;
+		switch_yield(10000);
+	}
+
+	end = switch_time_now();
+
+	switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "switch_log %d producer thread(s): %u/%u lines delivered in %" SWITCH_TIME_T_FMT "us, %.0f lines per second\n",
+					  threads, delivered, expected, end - start, end > start ? (double) delivered * 1000000 / (end - start) : 0);
+
+	return delivered;
+}
+
 FST_CORE_BEGIN("./conf")
 {
 	FST_SUITE_BEGIN(switch_log)
@@ -107,6 +187,30 @@ FST_CORE_BEGIN("./conf")
 		}
 		FST_TEARDOWN_END()
 
+		FST_TEST_BEGIN(switch_log_benchmark)
+		{
+			switch_stream_handle_t stream = { 0 };
+			int threads[] = { 1, 4, 16 };
+			int x;
+
+			/* keep the console quiet while the producers run */
+			SWITCH_STANDARD_STREAM(stream);
+			switch_api_execute("console", "loglevel console", NULL, &stream);
+
+			switch_log_bind_logger(bench_logger, SWITCH_LOG_DEBUG, SWITCH_FALSE);
+
+			/* the queue holds far more than the biggest run, so every line has to make it to the logger */
+			for (x = 0; x < 3; x++) {
+				fst_check_int_equals(run_bench(threads[x]), threads[x] * BENCH_LINES_PER_THREAD);
+			}
+
+			switch_log_unbind_logger(bench_logger);
+
+			switch_api_execute("console", "loglevel debug", NULL, &stream);
+			switch_safe_free(stream.data);
+		}
+		FST_TEST_END()
+
 		FST_SESSION_BEGIN(switch_log_meta_printf)
 		{
 			cJSON *item = NULL;
@@ -42,6 +42,91 @@ static void send_rtcp_event_handler(switch_event_t *event)
 	show_event(event);
 }
 
+static void send_rtp_packet(switch_socket_t *sock, switch_sockaddr_t *to, uint16_t seq, uint32_t ts, uint8_t pt, uint8_t fill)
+{
+	unsigned char buf[12 + 160];
+	switch_size_t len = sizeof(buf);
+
+	memset(buf, fill, sizeof(buf));
+	buf[0] = 0x80;
+	buf[1] = pt;
+	buf[2] = (unsigned char) (seq >> 8);
+	buf[3] = (unsigned char) seq;
+	buf[4] = (unsigned char) (ts >> 24);
+	buf[5] = (unsigned char) (ts >> 16);
+	buf[6] = (unsigned char) (ts >> 8);
+	buf[7] = (unsigned char) ts;
+	buf[8] = 0x00;
+	buf[9] = 0x00;
+	buf[10] = 0x12;
+	buf[11] = 0x34;
+
+	switch_socket_sendto(sock, to, 0, (void *) buf, &len);
+}
+
+/* waits up to timeout_ms for one datagram, returns its length or 0 */
+static switch_size_t recv_rtp_packet(switch_socket_t *sock, switch_sockaddr_t *from, unsigned char *buf, switch_size_t size, int timeout_ms)
+{
+	switch_time_t end = switch_micro_time_now() + timeout_ms * 1000;
+
+	while (switch_micro_time_now() < end) {
+		switch_size_t len = size;
+
+		if (switch_socket_recvfrom(from, sock, 0, (void *) buf, &len) == SWITCH_STATUS_SUCCESS && len) {
+			return len;
+		}
+
+		switch_yield(5000);
+	}
+
+	return 0;
+}
+
+/* run a DTLS handshake between two local sessions on this thread, returns 1 once both ends are ready */
+static int dtls_handshake(dtls_fingerprint_t *local_fp, switch_port_t server_port, switch_port_t client_port)
+{
+	switch_rtp_t *server = NULL, *client = NULL;
+	dtls_fingerprint_t server_remote_fp = *local_fp, client_remote_fp = *local_fp;
+	dtls_type_t rtp_rtcp = DTLS_TYPE_RTP | DTLS_TYPE_RTCP;
+	int i, ready = 0;
+
+	server = switch_rtp_new(rx_host, server_port, tx_host, client_port, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+	client = switch_rtp_new(tx_host, client_port, rx_host, server_port, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+
+	if (server && client &&
+		switch_rtp_add_dtls(server, local_fp, &server_remote_fp, rtp_rtcp | DTLS_TYPE_SERVER, 1) == SWITCH_STATUS_SUCCESS &&
+		switch_rtp_add_dtls(client, local_fp, &client_remote_fp, rtp_rtcp | DTLS_TYPE_CLIENT, 1) == SWITCH_STATUS_SUCCESS) {
+
+		/* both ends share this thread, reads drive the handshake while the workers do the key exchange */
+		for (i = 0; i < 500; i++) {
+			char buf[SWITCH_RTP_MAX_BUF_LEN];
+			uint32_t datalen = sizeof(buf);
+			switch_payload_t pt = 0;
+			switch_frame_flag_t fflags = 0;
+
+			if (switch_rtp_dtls_state(server, DTLS_TYPE_RTP) == DS_READY && switch_rtp_dtls_state(client, DTLS_TYPE_RTP) == DS_READY) {
+				ready = 1;
+				break;
+			}
+
+			switch_rtp_read(client, buf, &datalen, &pt, &fflags, SWITCH_IO_FLAG_NOBLOCK);
+			datalen = sizeof(buf);
+			fflags = 0;
+			switch_rtp_read(server, buf, &datalen, &pt, &fflags, SWITCH_IO_FLAG_NOBLOCK);
+			switch_yield(10000);
+		}
+	}
+
+	if (client) {
+		switch_rtp_destroy(&client);
+	}
+	if (server) {
+		switch_rtp_destroy(&server);
+	}
+
+	return ready;
+}
+
 FST_CORE_BEGIN("./conf")
 {
 FST_SUITE_BEGIN(switch_rtp)
@@ -79,6 +164,179 @@ FST_TEARDOWN_END()
 	}
 	FST_TEST_END()
 
+	FST_TEST_BEGIN(test_dtls_handshake)
+	{
+		dtls_fingerprint_t local_fp = { 0 };
+		switch_rtp_dtls_stats_t before, after;
+
+		switch_core_new_memory_pool(&pool);
+
+		local_fp.type = "sha-256";
+		fst_requires(switch_core_cert_gen_fingerprint(DTLS_SRTP_FNAME, &local_fp));
+
+		fst_requires(switch_rtp_get_dtls_stats(&before, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+		fst_requires(dtls_handshake(&local_fp, 1240, 1250));
+		fst_requires(switch_rtp_get_dtls_stats(&after, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+		fst_check(after.handshakes >= before.handshakes + 2);
+		fst_check(after.failures == before.failures);
+		fst_check(after.workers > 0);
+		fst_check(after.offloaded > before.offloaded);
+		fst_check(after.cached_sessions > 0);
+		fst_check(after.resumed == before.resumed);
+		fst_check(after.verify_cache_hits == before.verify_cache_hits);
+
+		/* the same peer again, the client offers the cached session and skips the certificate check */
+		before = after;
+		fst_requires(dtls_handshake(&local_fp, 1240, 1250));
+		fst_requires(switch_rtp_get_dtls_stats(&after, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+		fst_check(after.handshakes >= before.handshakes + 2);
+		fst_check(after.failures == before.failures);
+		fst_check(after.resumed >= before.resumed + 2);
+		fst_check(after.verify_cache_hits == before.verify_cache_hits + 1);
+
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
+	FST_TEST_BEGIN(test_ice_agent_keepalive)
+	{
+		switch_rtp_t *ice_rtp = NULL;
+		switch_socket_t *peer = NULL;
+		switch_sockaddr_t *peer_addr = NULL, *from = NULL;
+		static ice_t ice_params;
+		switch_time_t end;
+		int requests = 0;
+
+		switch_core_new_memory_pool(&pool);
+
+		fst_requires(switch_sockaddr_info_get(&peer_addr, rx_host, SWITCH_UNSPEC, 1260, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_create(&peer, switch_sockaddr_get_family(peer_addr), SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_bind(peer, peer_addr) == SWITCH_STATUS_SUCCESS);
+		switch_socket_opt_set(peer, SWITCH_SO_NONBLOCK, TRUE);
+		switch_sockaddr_create(&from, pool);
+
+		memset(&ice_params, 0, sizeof(ice_params));
+		ice_params.cands[0][IPR_RTP].con_addr = (char *) rx_host;
+		ice_params.cands[0][IPR_RTP].con_port = 1260;
+		ice_params.cands[0][IPR_RTP].priority = 2130706431;
+		ice_params.cands[0][IPR_RTP].cand_type = "host";
+		ice_params.cand_idx[IPR_RTP] = 1;
+
+		ice_rtp = switch_rtp_new(rx_host, 1270, rx_host, 1260, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+		fst_requires(ice_rtp);
+		fst_check(switch_rtp_activate_ice(ice_rtp, "ufraglocal", "ufragremote", "localpassword", "remotepassword", IPR_RTP, ICE_VANILLA, &ice_params) == SWITCH_STATUS_SUCCESS);
+
+		/* nobody reads the rtp session, the binding requests have to come from the agent */
+		end = switch_micro_time_now() + 3500000;
+		while (switch_micro_time_now() < end && requests < 3) {
+			char buf[1500];
+			switch_size_t len = sizeof(buf);
+
+			if (switch_socket_recvfrom(from, peer, 0, buf, &len) == SWITCH_STATUS_SUCCESS && len >= 20 && buf[0] == 0x00 && buf[1] == 0x01) {
+				requests++;
+				continue;
+			}
+
+			switch_yield(10000);
+		}
+
+		fst_check(requests >= 3);
+
+		switch_rtp_destroy(&ice_rtp);
+		switch_socket_close(peer);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
+	FST_TEST_BEGIN(test_rtp_relay)
+	{
+		switch_rtp_t *leg_a = NULL, *leg_b = NULL;
+		switch_socket_t *sender = NULL, *receiver = NULL;
+		switch_sockaddr_t *a_addr = NULL, *r_addr = NULL, *from = NULL;
+		switch_rtp_stats_t *stats;
+		unsigned char buf[1500];
+		uint16_t first_seq = 0, seq;
+		switch_size_t len;
+		int i;
+
+		switch_core_new_memory_pool(&pool);
+
+		/* sender -> leg a (1280), relayed out of leg b (1282) -> receiver (1283) */
+		fst_requires(switch_sockaddr_info_get(&a_addr, rx_host, SWITCH_UNSPEC, 1280, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_sockaddr_info_get(&r_addr, rx_host, SWITCH_UNSPEC, 1283, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_create(&sender, switch_sockaddr_get_family(a_addr), SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_create(&receiver, switch_sockaddr_get_family(r_addr), SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_bind(receiver, r_addr) == SWITCH_STATUS_SUCCESS);
+		switch_socket_opt_set(receiver, SWITCH_SO_NONBLOCK, TRUE);
+		switch_sockaddr_create(&from, pool);
+
+		leg_a = switch_rtp_new(rx_host, 1280, rx_host, 1281, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+		leg_b = switch_rtp_new(rx_host, 1282, rx_host, 1283, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+		fst_requires(leg_a);
+		fst_requires(leg_b);
+		switch_rtp_set_ssrc(leg_b, 0xbbbb);
+		switch_rtp_set_telephony_recv_event(leg_a, 101);
+
+		fst_requires(switch_rtp_relay_start(leg_a, leg_b) == SWITCH_STATUS_SUCCESS);
+		fst_check(switch_rtp_relaying(leg_a));
+
+		/* payload untouched, ssrc and seq are leg b's, a lost packet stays visible as a seq gap */
+		for (i = 0; i < 6; i++) {
+			uint16_t in_seq = (uint16_t) (100 + i + (i == 5));
+
+			send_rtp_packet(sender, a_addr, in_seq, 160 * in_seq, TEST_PT, (uint8_t) (0x40 + i));
+			len = recv_rtp_packet(receiver, from, buf, sizeof(buf), 1000);
+			fst_requires(len == 12 + 160);
+			fst_check_int_equals(buf[1] & 0x7f, TEST_PT);
+			fst_check_int_equals((buf[8] << 24) | (buf[9] << 16) | (buf[10] << 8) | buf[11], 0xbbbb);
+			fst_check_int_equals(buf[12], 0x40 + i);
+			fst_check_int_equals(buf[12 + 159], 0x40 + i);
+
+			seq = (uint16_t) ((buf[2] << 8) | buf[3]);
+			if (!i) {
+				first_seq = seq;
+			} else {
+				fst_check_int_equals((uint16_t) (seq - first_seq), i + (i == 5));
+			}
+		}
+
+		stats = switch_rtp_get_stats(leg_a, pool);
+		fst_check(stats->inbound.packet_count >= 6);
+		stats = switch_rtp_get_stats(leg_b, pool);
+		fst_check(stats->outbound.packet_count >= 6);
+
+		/* once stopped nothing is forwarded any more */
+		switch_rtp_relay_stop(leg_a);
+		fst_check(!switch_rtp_relaying(leg_a));
+		send_rtp_packet(sender, a_addr, 107, 160 * 107, TEST_PT, 0x50);
+		fst_check(recv_rtp_packet(receiver, from, buf, sizeof(buf), 200) == 0);
+
+		/* a digit hands the session back to its read thread, which holds off relaying for a while */
+		fst_requires(switch_rtp_relay_start(leg_a, leg_b) == SWITCH_STATUS_SUCCESS);
+		send_rtp_packet(sender, a_addr, 108, 160 * 108, 101, 0x00);
+		for (i = 0; i < 100 && switch_rtp_relaying(leg_a); i++) {
+			switch_yield(10000);
+		}
+		fst_check(!switch_rtp_relaying(leg_a));
+		fst_check(recv_rtp_packet(receiver, from, buf, sizeof(buf), 200) == 0);
+
+		{
+			uint32_t datalen = sizeof(buf);
+			switch_payload_t pt = 0;
+			switch_frame_flag_t fflags = 0;
+
+			switch_rtp_read(leg_a, buf, &datalen, &pt, &fflags, SWITCH_IO_FLAG_NOBLOCK);
+		}
+		fst_check(switch_rtp_relay_start(leg_a, leg_b) == SWITCH_STATUS_FALSE);
+
+		switch_rtp_destroy(&leg_a);
+		switch_rtp_destroy(&leg_b);
+		switch_socket_close(sender);
+		switch_socket_close(receiver);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
 	FST_TEST_BEGIN(test_session_with_rtp)
 	{
 		switch_core_session_t *session = NULL;
@@ -123,6 +381,124 @@ FST_TEARDOWN_END()
 		switch_core_destroy_memory_pool(&pool);
 	}
 	FST_TEST_END()
+
+	FST_TEST_BEGIN(test_rtp_telemetry)
+	{
+		switch_core_session_t *session = NULL;
+		switch_call_cause_t cause;
+		switch_stream_handle_t stream = { 0 };
+
+		switch_core_new_memory_pool(&pool);
+
+		switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+		fst_requires(session);
+		switch_channel_set_variable(switch_core_session_get_channel(session), "rtp_telemetry_group", "trunk \"a\"");
+
+		switch_core_memory_pool_set_data(pool, "__session", session);
+		rtp_session = switch_rtp_new(rx_host, rx_port, tx_host, tx_port, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+		fst_requires(rtp_session);
+
+		switch_rtp_telemetry_sample();
+
+		SWITCH_STANDARD_STREAM(stream);
+		fst_check(switch_rtp_telemetry_write(&stream, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+		fst_check(strstr((char *) stream.data, "# TYPE freeswitch_rtp_mos histogram\n") != NULL);
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_sessions{kind=\"group\",name=\"trunk \\\"a\\\"\"} 1\n") != NULL);
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_loss_percent_bucket{kind=\"group\",name=\"trunk \\\"a\\\"\",le=\"+Inf\"} 0\n") != NULL);
+		/* the fallback group exists from init, so it is always there to take sessions past the group cap */
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_sessions{kind=\"default\",name=\"default\"} 0\n") != NULL);
+		switch_safe_free(stream.data);
+
+		/* a destroyed session drops out of the next sample */
+		switch_rtp_destroy(&rtp_session);
+		switch_rtp_telemetry_sample();
+
+		SWITCH_STANDARD_STREAM(stream);
+		fst_check(switch_rtp_telemetry_write(&stream, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS);
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_sessions{kind=\"group\",name=\"trunk \\\"a\\\"\"} 0\n") != NULL);
+		switch_safe_free(stream.data);
+
+		switch_core_session_rwunlock(session);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
+	FST_TEST_BEGIN(test_rtp_telemetry_bucket)
+	{
+		switch_core_session_t *session = NULL;
+		switch_call_cause_t cause;
+		switch_stream_handle_t stream = { 0 };
+		switch_socket_t *sender = NULL;
+		switch_sockaddr_t *to = NULL;
+		const char *loss = "freeswitch_rtp_loss_percent_bucket{kind=\"group\",name=\"bucket\",le=";
+		char expect[256];
+		int i;
+
+		switch_core_new_memory_pool(&pool);
+
+		switch_ivr_originate(NULL, &session, &cause, "null/+15553334444", 2, NULL, NULL, NULL, NULL, NULL, SOF_NONE, NULL, NULL);
+		fst_requires(session);
+		switch_channel_set_variable(switch_core_session_get_channel(session), "rtp_telemetry_group", "bucket");
+
+		switch_core_memory_pool_set_data(pool, "__session", session);
+		rtp_session = switch_rtp_new(rx_host, 1286, tx_host, 1287, TEST_PT, 8000, 20 * 1000, flags, "soft", &err, pool, 0, 0);
+		fst_requires(rtp_session);
+
+		fst_requires(switch_sockaddr_info_get(&to, rx_host, SWITCH_UNSPEC, 1286, 0, pool) == SWITCH_STATUS_SUCCESS);
+		fst_requires(switch_socket_create(&sender, switch_sockaddr_get_family(to), SOCK_DGRAM, 0, pool) == SWITCH_STATUS_SUCCESS);
+
+		/* a clean stream past the jitter lead in, every packet read as it arrives */
+		for (i = 0; i < 30; i++) {
+			char buf[SWITCH_RTP_MAX_BUF_LEN];
+			uint32_t datalen = sizeof(buf);
+			switch_payload_t pt = 0;
+			switch_frame_flag_t fflags = 0;
+			int x;
+
+			send_rtp_packet(sender, to, (uint16_t) (1000 + i), 160 * i, TEST_PT, 0x55);
+			for (x = 0; x < 20; x++) {
+				datalen = sizeof(buf);
+				fflags = 0;
+				if (switch_rtp_read(rtp_session, buf, &datalen, &pt, &fflags, SWITCH_IO_FLAG_NOBLOCK) == SWITCH_STATUS_SUCCESS && datalen && !(fflags & SFF_CNG)) {
+					break;
+				}
+				switch_yield(1000);
+			}
+			switch_yield(20000);
+		}
+
+		/* one sample, no loss, lands in the first loss bucket and so in every bucket above it */
+		switch_rtp_telemetry_sample();
+
+		SWITCH_STANDARD_STREAM(stream);
+		fst_check(switch_rtp_telemetry_write(&stream, SWITCH_TRUE) == SWITCH_STATUS_SUCCESS);
+		switch_snprintf(expect, sizeof(expect), "%s\"0\"} 1\n", loss);
+		fst_check(strstr((char *) stream.data, expect) != NULL);
+		switch_snprintf(expect, sizeof(expect), "%s\"0.5\"} 1\n", loss);
+		fst_check(strstr((char *) stream.data, expect) != NULL);
+		switch_snprintf(expect, sizeof(expect), "%s\"+Inf\"} 1\n", loss);
+		fst_check(strstr((char *) stream.data, expect) != NULL);
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_loss_percent_count{kind=\"group\",name=\"bucket\"} 1\n") != NULL);
+		/* no RTCP report came in, so no RTT sample */
+		fst_check(strstr((char *) stream.data, "freeswitch_rtp_rtt_ms_count{kind=\"group\",name=\"bucket\"} 0\n") != NULL);
+		switch_safe_free(stream.data);
+
+		/* nothing new arrived, the next sample adds nothing */
+		switch_rtp_telemetry_sample();
+
+		SWITCH_STANDARD_STREAM(stream);
+		fst_check(switch_rtp_telemetry_write(&stream, SWITCH_FALSE) == SWITCH_STATUS_SUCCESS);
+		switch_snprintf(expect, sizeof(expect), "%s\"+Inf\"} 0\n", loss);
+		fst_check(strstr((char *) stream.data, expect) != NULL);
+		switch_safe_free(stream.data);
+
+		switch_rtp_destroy(&rtp_session);
+		switch_socket_close(sender);
+		switch_core_session_rwunlock(session);
+		switch_core_destroy_memory_pool(&pool);
+	}
+	FST_TEST_END()
+
 	FST_TEST_BEGIN(test_send_rtcp_event_audio)
 	{
 		switch_core_session_t *session = NULL;
@@ -0,0 +1,322 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2026, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_rtp_batch.c -- batched socket and video RTP send tests over loopback
+ *
+ */
+#include <switch.h>
+#include <test/switch_test.h>
+
+#define BATCH_TEST_PACKETS 40
+#define BATCH_TEST_PAYLOAD 200
+#define BATCH_TEST_PT 96
+
+static const char *batch_host = "127.0.0.1";
+static switch_port_t batch_tx_port = 1290;
+static switch_port_t batch_rx_port = 1291;
+static switch_port_t batch_rtp_port = 1292;
+static switch_port_t batch_rtp_remote_port = 1293;
+
+static switch_socket_t *batch_socket(const char *host, switch_port_t port, switch_sockaddr_t **addr, switch_memory_pool_t *pool)
+{
+	switch_socket_t *sock = NULL;
+
+	if (switch_sockaddr_info_get(addr, host, SWITCH_UNSPEC, port, 0, pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	if (switch_socket_create(&sock, switch_sockaddr_get_family(*addr), SOCK_DGRAM, 0, pool) != SWITCH_STATUS_SUCCESS) {
+		return NULL;
+	}
+
+	if (switch_socket_bind(sock, *addr) != SWITCH_STATUS_SUCCESS) {
+		switch_socket_close(sock);
+		return NULL;
+	}
+
+	switch_socket_opt_set(sock, SWITCH_SO_NONBLOCK, TRUE);
+
+	return sock;
+}
+
+/* waits up to timeout_ms for one datagram, returns its length or 0 */
+static switch_size_t batch_recv(switch_socket_t *sock, switch_sockaddr_t *from, unsigned char *buf, switch_size_t size, int timeout_ms)
+{
+	switch_time_t end = switch_micro_time_now() + timeout_ms * 1000;
+
+	while (switch_micro_time_now() < end) {
+		switch_size_t len = size;
+
+		if (switch_socket_recvfrom(from, sock, 0, (void *) buf, &len) == SWITCH_STATUS_SUCCESS && len) {
+			return len;
+		}
+
+		switch_yield(5000);
+	}
+
+	return 0;
+}
+
+/* one packet of a locally encoded video frame, the way the media layer hands it to switch_rtp_write_frame() */
+static int batch_write_video(switch_rtp_t *rtp_session, uint32_t ts, uint8_t m, uint8_t fill)
+{
+	unsigned char buf[12 + BATCH_TEST_PAYLOAD];
+	switch_frame_t frame = { 0 };
+
+	memset(buf, fill, sizeof(buf));
+	memset(buf, 0, 12);
+	buf[0] = 0x80;
+
+	frame.packet = buf;
+	frame.packetlen = sizeof(buf);
+	frame.data = buf + 12;
+	frame.datalen = BATCH_TEST_PAYLOAD;
+	frame.timestamp = ts;
+	frame.m = m;
+	frame.flags = SFF_RAW_RTP | SFF_RAW_RTP_PARSE_FRAME;
+
+	return switch_rtp_write_frame(rtp_session, &frame);
+}
+
+typedef struct {
+	uint16_t seq;
+	uint32_t ts;
+	uint8_t m;
+	uint8_t fill;
+} batch_rtp_hdr_t;
+
+/* receive count packets, check they are whole, in sequence and carry the expected fill, nothing may follow them */
+static int batch_recv_rtp(switch_socket_t *sock, switch_sockaddr_t *from, int count, uint16_t *next_seq, batch_rtp_hdr_t *hdrs)
+{
+	unsigned char buf[1500];
+	int i;
+
+	for (i = 0; i < count; i++) {
+		switch_size_t len = batch_recv(sock, from, buf, sizeof(buf), 1000);
+
+		if (len != 12 + BATCH_TEST_PAYLOAD) {
+			return i;
+		}
+
+		hdrs[i].m = (buf[1] & 0x80) ? 1 : 0;
+		hdrs[i].seq = (uint16_t) ((buf[2] << 8) | buf[3]);
+		hdrs[i].ts = ((uint32_t) buf[4] << 24) | ((uint32_t) buf[5] << 16) | ((uint32_t) buf[6] << 8) | buf[7];
+		hdrs[i].fill = buf[12];
+
+		if (*next_seq && hdrs[i].seq != *next_seq) {
+			return i;
+		}
+		*next_seq = hdrs[i].seq + 1;
+	}
+
+	if (batch_recv(sock, from, buf, sizeof(buf), 50)) {
+		return -1;
+	}
+
+	return count;
+}
+
+static switch_size_t batch_sent_packets(switch_rtp_t *rtp_session, switch_size_t *bytes)
+{
+	switch_rtp_stats_t *stats = switch_rtp_get_stats(rtp_session, NULL);
+
+	*bytes = stats->outbound.raw_bytes;
+	return stats->outbound.packet_count;
+}
+
+FST_CORE_BEGIN("./conf")
+{
+	FST_SUITE_BEGIN(switch_rtp_batch)
+	{
+		FST_SETUP_BEGIN()
+		{
+			fst_requires_module("mod_loopback");
+		}
+		FST_SETUP_END()
+
+		FST_TEARDOWN_BEGIN()
+		{
+		}
+		FST_TEARDOWN_END()
+
+		FST_TEST_BEGIN(sendto_batch)
+		{
+			static char payloads[BATCH_TEST_PACKETS][BATCH_TEST_PACKETS + 100];
+			const char *bufs[BATCH_TEST_PACKETS];
+			switch_size_t lens[BATCH_TEST_PACKETS];
+			switch_sockaddr_t *tx_addr = NULL, *rx_addr = NULL, *from = NULL;
+			switch_socket_t *tx, *rx;
+			unsigned char buf[1500];
+			uint32_t sent = 0;
+			int i;
+
+			tx = batch_socket(batch_host, batch_tx_port, &tx_addr, fst_pool);
+			rx = batch_socket(batch_host, batch_rx_port, &rx_addr, fst_pool);
+			fst_requires(tx && rx);
+			switch_sockaddr_create(&from, fst_pool);
+
+			/* more than one sendmmsg() worth, every datagram a different length */
+			for (i = 0; i < BATCH_TEST_PACKETS; i++) {
+				memset(payloads[i], i, sizeof(payloads[i]));
+				bufs[i] = payloads[i];
+				lens[i] = 100 + i;
+			}
+
+			fst_check_int_equals(switch_socket_sendto_batch(tx, rx_addr, 0, bufs, lens, BATCH_TEST_PACKETS, &sent), SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(sent, BATCH_TEST_PACKETS);
+
+			for (i = 0; i < BATCH_TEST_PACKETS; i++) {
+				switch_size_t len = batch_recv(rx, from, buf, sizeof(buf), 1000);
+
+				fst_check_int_equals(len, lens[i]);
+				fst_check_int_equals(buf[0], i);
+				fst_check_int_equals(buf[len ? len - 1 : 0], i);
+			}
+			fst_check_int_equals(batch_recv(rx, from, buf, sizeof(buf), 50), 0);
+
+			switch_socket_close(tx);
+			switch_socket_close(rx);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(sendto_batch_partial)
+		{
+			static char big[70000];
+			char small[6][100];
+			const char *bufs[6];
+			switch_size_t lens[6];
+			switch_sockaddr_t *tx_addr = NULL, *rx_addr = NULL, *from = NULL;
+			switch_socket_t *tx, *rx;
+			unsigned char buf[1500];
+			uint32_t sent = 0;
+			int i;
+
+			tx = batch_socket(batch_host, batch_tx_port, &tx_addr, fst_pool);
+			rx = batch_socket(batch_host, batch_rx_port, &rx_addr, fst_pool);
+			fst_requires(tx && rx);
+			switch_sockaddr_create(&from, fst_pool);
+
+			for (i = 0; i < 6; i++) {
+				memset(small[i], i, sizeof(small[i]));
+				bufs[i] = small[i];
+				lens[i] = sizeof(small[i]);
+			}
+
+			/* the fourth datagram is too big for udp, the batch stops there and says how far it got */
+			bufs[3] = big;
+			lens[3] = sizeof(big);
+
+			fst_check(switch_socket_sendto_batch(tx, rx_addr, 0, bufs, lens, 6, &sent) != SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(sent, 3);
+
+			for (i = 0; i < 3; i++) {
+				fst_check_int_equals(batch_recv(rx, from, buf, sizeof(buf), 1000), sizeof(small[i]));
+				fst_check_int_equals(buf[0], i);
+			}
+			fst_check_int_equals(batch_recv(rx, from, buf, sizeof(buf), 50), 0);
+
+			switch_socket_close(tx);
+			switch_socket_close(rx);
+		}
+		FST_TEST_END()
+
+		FST_SESSION_BEGIN(video_frame_flush)
+		{
+			switch_rtp_flag_t flags[SWITCH_RTP_FLAG_INVALID] = { 0 };
+			switch_sockaddr_t *rx_addr = NULL, *from = NULL;
+			batch_rtp_hdr_t hdrs[8];
+			switch_socket_t *rx;
+			switch_rtp_t *rtp_session;
+			switch_size_t packets, bytes;
+			uint16_t next_seq = 0;
+			uint32_t frame_ts;
+			const char *err = NULL;
+			int i;
+
+			rx = batch_socket(batch_host, batch_rtp_remote_port, &rx_addr, fst_pool);
+			fst_requires(rx);
+			switch_sockaddr_create(&from, fst_pool);
+
+			flags[SWITCH_RTP_FLAG_VIDEO] = 1;
+			flags[SWITCH_RTP_FLAG_RAW_WRITE] = 1;
+			rtp_session = switch_rtp_new(batch_host, batch_rtp_port, batch_host, batch_rtp_remote_port, BATCH_TEST_PT, 1, 90000, flags, NULL, &err,
+										 switch_core_session_get_pool(fst_session), 0, 0);
+			fst_requires(rtp_session);
+			fst_requires(switch_rtp_ready(rtp_session));
+
+			/* the packets of a frame wait for its marker and are only counted once they are on the wire */
+			for (i = 0; i < 3; i++) {
+				fst_check(batch_write_video(rtp_session, 3000, 0, 'a') > 0);
+			}
+			fst_check_int_equals(batch_recv_rtp(rx, from, 0, &next_seq, hdrs), 0);
+			packets = batch_sent_packets(rtp_session, &bytes);
+			fst_check_int_equals(packets, 0);
+			fst_check_int_equals(bytes, 0);
+
+			fst_check(batch_write_video(rtp_session, 3000, 1, 'a') > 0);
+			fst_check_int_equals(batch_recv_rtp(rx, from, 4, &next_seq, hdrs), 4);
+			for (i = 0; i < 4; i++) {
+				fst_check_int_equals(hdrs[i].ts, hdrs[0].ts);
+				fst_check_int_equals(hdrs[i].m, i == 3);
+				fst_check_int_equals(hdrs[i].fill, 'a');
+			}
+			frame_ts = hdrs[0].ts;
+			packets = batch_sent_packets(rtp_session, &bytes);
+			fst_check_int_equals(packets, 4);
+			fst_check_int_equals(bytes, 4 * (12 + BATCH_TEST_PAYLOAD));
+
+			/* a frame that never sends its marker goes out as soon as the next frame starts */
+			fst_check(batch_write_video(rtp_session, 6000, 0, 'b') > 0);
+			fst_check(batch_write_video(rtp_session, 6000, 0, 'b') > 0);
+			fst_check(batch_write_video(rtp_session, 9000, 0, 'c') > 0);
+			fst_check_int_equals(batch_recv_rtp(rx, from, 2, &next_seq, hdrs), 2);
+			fst_check_int_equals(hdrs[0].fill, 'b');
+			fst_check_int_equals(hdrs[1].fill, 'b');
+			fst_check(hdrs[0].ts != frame_ts);
+			fst_check_int_equals(hdrs[1].ts, hdrs[0].ts);
+
+			/* and at the end of the encoded frame */
+			fst_check_int_equals(switch_rtp_flush_send_batch(rtp_session), SWITCH_STATUS_SUCCESS);
+			fst_check_int_equals(batch_recv_rtp(rx, from, 1, &next_seq, hdrs), 1);
+			fst_check_int_equals(hdrs[0].fill, 'c');
+			packets = batch_sent_packets(rtp_session, &bytes);
+			fst_check_int_equals(packets, 7);
+
+			/* whatever is still queued leaves before the socket closes */
+			fst_check(batch_write_video(rtp_session, 12000, 0, 'd') > 0);
+			fst_check(batch_write_video(rtp_session, 12000, 0, 'd') > 0);
+			switch_rtp_destroy(&rtp_session);
+			fst_check_int_equals(batch_recv_rtp(rx, from, 2, &next_seq, hdrs), 2);
+			fst_check_int_equals(hdrs[0].fill, 'd');
+			fst_check_int_equals(hdrs[1].fill, 'd');
+
+			switch_socket_close(rx);
+		}
+		FST_SESSION_END()
+	}
+	FST_SUITE_END()
+}
+FST_CORE_END()
@@ -0,0 +1,330 @@
+/*
+ * FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ * Copyright (C) 2026, Anthony Minessale II <anthm@freeswitch.org>
+ *
+ * Version: MPL 1.1
+ *
+ * The contents of this file are subject to the Mozilla Public License Version
+ * 1.1 (the "License"); you may not use this file except in compliance with
+ * the License. You may obtain a copy of the License at
+ * http://www.mozilla.org/MPL/
+ *
+ * Software distributed under the License is distributed on an "AS IS" basis,
+ * WITHOUT WARRANTY OF ANY KIND, either express or implied. See the License
+ * for the specific language governing rights and limitations under the
+ * License.
+ *
+ * The Original Code is FreeSWITCH Modular Media Switching Software Library / Soft-Switch Application
+ *
+ * The Initial Developer of the Original Code is
+ * Anthony Minessale II <anthm@freeswitch.org>
+ * Portions created by the Initial Developer are Copyright (C)
+ * the Initial Developer. All Rights Reserved.
+ *
+ * Contributor(s):
+ *
+ *
+ * switch_teletone.c -- tone and DTMF detection tests
+ *
+ */
+#include <switch.h>
+#include <test/switch_test.h>
+
+// #define BENCHMARK 1
+
+#ifdef BENCHMARK
+#define TELETONE_BENCH_SECONDS 3600
+#else
+#define TELETONE_BENCH_SECONDS 60
+#endif
+
+#define TT_RATE 8000
+#define TT_FRAME 160
+
+static const char *tt_digits = "123A456B789C*0#D";
+static const double tt_rows[] = { 697.0, 770.0, 852.0, 941.0 };
+static const double tt_cols[] = { 1209.0, 1336.0, 1477.0, 1633.0 };
+
+/* simple LCG so the corpus is the same on every platform */
+static uint32_t tt_rand(uint32_t *seed)
+{
+	*seed = *seed * 1103515245 + 12345;
+	return (*seed >> 16) & 0x7fff;
+}
+
+static void tt_tone(int16_t *buf, int samples, double f1, double a1, double f2, double a2, int noise, uint32_t *seed)
+{
+	int i;
+
+	for (i = 0; i < samples; i++) {
+		double t = (double) i / TT_RATE;
+		double v = a1 * sin(2 * M_PI * f1 * t) + a2 * sin(2 * M_PI * f2 * t);
+
+		if (noise) {
+			v += (double) ((int) (tt_rand(seed) % (noise * 2)) - noise);
+		}
+
+		if (v > 32767) v = 32767;
+		if (v < -32768) v = -32768;
+		buf[i] = (int16_t) v;
+	}
+}
+
+/* digits with a given on/off time, row/col level, and noise floor */
+static int tt_dtmf_corpus(int16_t *buf, int max, const char *digits, int on_ms, int off_ms, double row_amp, double col_amp, int noise, uint32_t seed)
+{
+	int pos = 0;
+	const char *p;
+
+	for (p = digits; *p; p++) {
+		int idx = (int) (strchr(tt_digits, *p) - tt_digits);
+		int on = on_ms * TT_RATE / 1000, off = off_ms * TT_RATE / 1000;
+
+		if (pos + on + off > max) {
+			break;
+		}
+
+		tt_tone(buf + pos, on, tt_rows[idx >> 2], row_amp, tt_cols[idx & 3], col_amp, noise, &seed);
+		pos += on;
+		tt_tone(buf + pos, off, 0, 0, 0, 0, noise, &seed);
+		pos += off;
+	}
+
+	return pos;
+}
+
+/* run the same audio through the vectorized and the scalar filter bank and make sure every state and decision matches */
+static int tt_dtmf_compare(int16_t *buf, int samples, char *got, int got_len)
+{
+	teletone_dtmf_detect_state_t simd, scalar;
+	int i, n = 0, diffs = 0;
+
+	memset(&simd, 0, sizeof(simd));
+	memset(&scalar, 0, sizeof(scalar));
+	teletone_dtmf_detect_init(&simd, TT_RATE);
+	teletone_dtmf_detect_init(&scalar, TT_RATE);
+
+	for (i = 0; i + TT_FRAME <= samples; i += TT_FRAME) {
+		teletone_hit_type_t a, b;
+		char da = 0, db = 0;
+		unsigned int dura = 0, durb = 0;
+		int ga, gb;
+
+		teletone_detect_simd(1);
+		a = teletone_dtmf_detect(&simd, buf + i, TT_FRAME);
+		ga = teletone_dtmf_get(&simd, &da, &dura);
+
+		teletone_detect_simd(0);
+		b = teletone_dtmf_detect(&scalar, buf + i, TT_FRAME);
+		gb = teletone_dtmf_get(&scalar, &db, &durb);
+
+		if (a != b || ga != gb || da != db || dura != durb || memcmp(&simd, &scalar, sizeof(simd))) {
+			diffs++;
+		}
+
+		if (a == TT_HIT_BEGIN && ga && n < got_len - 1) {
+			got[n++] = da;
+		}
+	}
+
+	got[n] = '\0';
+	teletone_detect_simd(1);
+
+	return diffs;
+}
+
+static int tt_multi_compare(teletone_tone_map_t *map, int16_t *buf, int samples, int *hits)
+{
+	teletone_multi_tone_t simd = { 0 }, scalar = { 0 };
+	int i, diffs = 0;
+
+	teletone_multi_tone_init(&simd, map);
+	teletone_multi_tone_init(&scalar, map);
+	*hits = 0;
+
+	for (i = 0; i + TT_FRAME <= samples; i += TT_FRAME) {
+		int a, b;
+
+		teletone_detect_simd(1);
+		a = teletone_multi_tone_detect(&simd, buf + i, TT_FRAME);
+		teletone_detect_simd(0);
+		b = teletone_multi_tone_detect(&scalar, buf + i, TT_FRAME);
+
+		if (a != b || memcmp(&simd, &scalar, sizeof(simd))) {
+			diffs++;
+		}
+
+		*hits += a;
+	}
+
+	teletone_detect_simd(1);
+
+	return diffs;
+}
+
+FST_MINCORE_BEGIN("./conf")
+
+FST_SUITE_BEGIN(switch_teletone)
+
+FST_SETUP_BEGIN()
+{
+}
+FST_SETUP_END()
+
+FST_TEARDOWN_BEGIN()
+{
+}
+FST_TEARDOWN_END()
+
+FST_TEST_BEGIN(dtmf_regression)
+{
+	int16_t *buf = malloc(sizeof(int16_t) * TT_RATE * 30);
+	int max = TT_RATE * 30, samples;
+	char got[64];
+
+	fst_requires(buf);
+
+	/* clean digits, every key */
+	samples = tt_dtmf_corpus(buf, max, tt_digits, 100, 100, 8000, 8000, 0, 1);
+	fst_check_int_equals(tt_dtmf_compare(buf, samples, got, sizeof(got)), 0);
+	fst_check_string_equals(got, tt_digits);
+
+	/* noise floor and twist on both sides */
+	samples = tt_dtmf_corpus(buf, max, "0123456789", 80, 80, 6000, 9000, 200, 2);
+	fst_check_int_equals(tt_dtmf_compare(buf, samples, got, sizeof(got)), 0);
+	fst_check_string_equals(got, "0123456789");
+
+	samples = tt_dtmf_corpus(buf, max, "#*DCBA", 80, 80, 9000, 4500, 200, 3);
+	fst_check_int_equals(tt_dtmf_compare(buf, samples, got, sizeof(got)), 0);
+	fst_check_string_equals(got, "#*DCBA");
+
+	/* short gaps and too much twist only need to agree, not detect */
+	samples = tt_dtmf_corpus(buf, max, "555999", 40, 20, 8000, 8000, 2000, 4);
+	fst_check_int_equals(tt_dtmf_compare(buf, samples, got, sizeof(got)), 0);
+
+	samples = tt_dtmf_corpus(buf, max, "147", 100, 100, 12000, 500, 200, 5);
+	fst_check_int_equals(tt_dtmf_compare(buf, samples, got, sizeof(got)), 0);
+	fst_check_string_equals(got, "");
+
+	/* odd frame sizes cross the block boundary at every offset */
+	samples = tt_dtmf_corpus(buf, max, "2580", 100, 100, 8000, 8000, 300, 6);
+	{
+		teletone_dtmf_detect_state_t simd, scalar;
+		int i, step = 1, diffs = 0;
+
+		memset(&simd, 0, sizeof(simd));
+		memset(&scalar, 0, sizeof(scalar));
+		teletone_dtmf_detect_init(&simd, TT_RATE);
+		teletone_dtmf_detect_init(&scalar, TT_RATE);
+
+		for (i = 0; i < samples; i += step, step = (step % 211) + 7) {
+			int n = (i + step > samples) ? samples - i : step;
+			teletone_hit_type_t a, b;
+
+			teletone_detect_simd(1);
+			a = teletone_dtmf_detect(&simd, buf + i, n);
+			teletone_detect_simd(0);
+			b = teletone_dtmf_detect(&scalar, buf + i, n);
+
+			if (a != b || memcmp(&simd, &scalar, sizeof(simd))) {
+				diffs++;
+			}
+		}
+
+		teletone_detect_simd(1);
+		fst_check_int_equals(diffs, 0);
+	}
+
+	free(buf);
+}
+FST_TEST_END()
+
+FST_TEST_BEGIN(multi_tone_regression)
+{
+	int16_t *buf = malloc(sizeof(int16_t) * TT_RATE * 5);
+	int samples = TT_RATE * 5, hits = 0;
+	uint32_t seed = 7;
+	teletone_tone_map_t busy = { { 480, 620 } };
+	teletone_tone_map_t ring = { { 440, 480 } };
+	teletone_tone_map_t mf = { { 700, 900, 1100, 1300, 1500, 1700 } };
+	teletone_tone_map_t wide = { { 300, 350, 400, 440, 480, 620, 700, 900, 1000, 1100, 1300, 1400, 1500, 1700, 1800, 2000, 2100, 2600 } };
+
+	fst_requires(buf);
+
+	tt_tone(buf, samples, 480, 6000, 620, 6000, 300, &seed);
+	fst_check_int_equals(tt_multi_compare(&busy, buf, samples, &hits), 0);
+	fst_check(hits > 0);
+	fst_check_int_equals(tt_multi_compare(&ring, buf, samples, &hits), 0);
+
+	tt_tone(buf, samples, 900, 7000, 1100, 7000, 500, &seed);
+	fst_check_int_equals(tt_multi_compare(&mf, buf, samples, &hits), 0);
+	fst_check(hits > 0);
+	fst_check_int_equals(tt_multi_compare(&wide, buf, samples, &hits), 0);
+
+	tt_tone(buf, samples, 0, 0, 0, 0, 3000, &seed);
+	fst_check_int_equals(tt_multi_compare(&wide, buf, samples, &hits), 0);
+	fst_check_int_equals(hits, 0);
+
+	free(buf);
+}
+FST_TEST_END()
+
+FST_TEST_BEGIN(benchmark)
+{
+	int16_t *buf = malloc(sizeof(int16_t) * TT_RATE * 10);
+	int samples;
+	int mode;
+
+	fst_requires(buf);
+	samples = tt_dtmf_corpus(buf, TT_RATE * 10, "0123456789ABCD*#0123456789ABCD*#0123456789", 100, 100, 8000, 8000, 500, 8);
+
+	for (mode = 1; mode >= 0; mode--) {
+		teletone_dtmf_detect_state_t dtmf;
+		teletone_multi_tone_t mt = { 0 };
+		teletone_tone_map_t mf = { { 700, 900, 1100, 1300, 1500, 1700 } };
+		switch_time_t start_ts, end_ts;
+		int64_t total = 0;
+		int i, x;
+
+		teletone_detect_simd(mode);
+		teletone_dtmf_detect_init(&dtmf, TT_RATE);
+		teletone_multi_tone_init(&mt, &mf);
+
+		start_ts = switch_time_now();
+		for (x = 0; total < (int64_t) TELETONE_BENCH_SECONDS * TT_RATE; x++) {
+			for (i = 0; i + TT_FRAME <= samples; i += TT_FRAME) {
+				char digit;
+				unsigned int dur;
+
+				teletone_dtmf_detect(&dtmf, buf + i, TT_FRAME);
+				teletone_dtmf_get(&dtmf, &digit, &dur);
+			}
+			total += samples;
+		}
+		end_ts = switch_time_now();
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "dtmf %s: %" SWITCH_INT64_T_FMT " samples in %" SWITCH_TIME_T_FMT "us, %.1f channels realtime\n",
+						  teletone_detect_simd(-1) ? "simd" : "scalar", total, end_ts - start_ts,
+						  (double) total / TT_RATE * 1000000 / (double) (end_ts - start_ts + 1));
+
+		total = 0;
+		start_ts = switch_time_now();
+		for (x = 0; total < (int64_t) TELETONE_BENCH_SECONDS * TT_RATE; x++) {
+			for (i = 0; i + TT_FRAME <= samples; i += TT_FRAME) {
+				teletone_multi_tone_detect(&mt, buf + i, TT_FRAME);
+			}
+			total += samples;
+		}
+		end_ts = switch_time_now();
+		switch_log_printf(SWITCH_CHANNEL_LOG, SWITCH_LOG_INFO, "mf %s: %" SWITCH_INT64_T_FMT " samples in %" SWITCH_TIME_T_FMT "us, %.1f channels realtime\n",
+						  teletone_detect_simd(-1) ? "simd" : "scalar", total, end_ts - start_ts,
+						  (double) total / TT_RATE * 1000000 / (double) (end_ts - start_ts + 1));
+	}
+
+	teletone_detect_simd(1);
+	free(buf);
+}
+FST_TEST_END()
+
+FST_SUITE_END()
+
+FST_MINCORE_END()
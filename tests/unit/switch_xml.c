@@ -33,6 +33,98 @@
 #include <stdlib.h>
 
 #include <test/switch_test.h>
+#ifndef WIN32
+#include <utime.h>
+#endif
+
+/* a main config of its own for the preprocessor cache, the name makes it one */
+#define PP_TEST_DIR "/tmp/fst_xml_pp"
+#define PP_TEST_CONF PP_TEST_DIR "/freeswitch.xml"
+#define PP_TEST_INCLUDE PP_TEST_DIR "/pp_a.xml"
+
+static switch_mutex_t *pp_log_mutex = NULL;
+static char pp_log_line[512] = "";
+static int pp_log_count = 0;
+
+static switch_status_t pp_logger(const switch_log_node_t *node, switch_log_level_t level)
+{
+	if (node->data && strstr(node->data, "Preprocessed " PP_TEST_CONF)) {
+		switch_mutex_lock(pp_log_mutex);
+		switch_copy_string(pp_log_line, node->data, sizeof(pp_log_line));
+		pp_log_count++;
+		switch_mutex_unlock(pp_log_mutex);
+	}
+
+	return SWITCH_STATUS_SUCCESS;
+}
+
+static void pp_write(const char *path, const char *text)
+{
+	FILE *fp;
+
+	if ((fp = fopen(path, "w"))) {
+		fputs(text, fp);
+		fclose(fp);
+	}
+}
+
+/* Parses the test config and picks the cache counts out of the line it logs */
+static switch_xml_t pp_parse(int *hits, int *misses)
+{
+	switch_xml_t xml;
+	int count, i;
+
+	switch_mutex_lock(pp_log_mutex);
+	count = pp_log_count;
+	switch_mutex_unlock(pp_log_mutex);
+
+	xml = switch_xml_parse_file(PP_TEST_CONF);
+
+	*hits = *misses = -1;
+	for (i = 0; i < 200; i++) {
+		switch_bool_t logged;
+
+		switch_mutex_lock(pp_log_mutex);
+		if ((logged = (pp_log_count != count))) {
+			const char *p = strstr(pp_log_line, PP_TEST_CONF ": ");
+
+			if (p && sscanf(p + strlen(PP_TEST_CONF ": "), "%d files from cache, %d expanded", hits, misses) != 2) {
+				*hits = *misses = -1;
+			}
+		}
+		switch_mutex_unlock(pp_log_mutex);
+
+		if (logged) {
+			break;
+		}
+		switch_yield(10000);
+	}
+
+	return xml;
+}
+
+static const char *pp_section(switch_xml_t xml, const char *name)
+{
+	switch_xml_t section = xml ? switch_xml_find_child(xml, "section", "name", name) : NULL;
+
+	return section ? switch_xml_attr_soft(section, "description") : "";
+}
+
+/* a directory binding that knows one domain and fails to answer for another */
+static switch_xml_t dir_search(const char *section, const char *tag_name, const char *key_name, const char *key_value,
+							   switch_event_t *params, void *user_data)
+{
+	const char *domain = switch_event_get_header(params, "domain");
+
+	if (!domain || strcmp(domain, "bound.test")) {
+		return NULL;
+	}
+
+	return switch_xml_parse_str_dup("<document type=\"freeswitch/xml\"><section name=\"directory\">"
+									"<domain name=\"bound.test\"><users><user id=\"1000\"><params>"
+									"<param name=\"password\" value=\"secret\"/></params></user></users></domain>"
+									"</section></document>");
+}
 
 FST_MINCORE_BEGIN("./conf")
 {
@@ -117,6 +209,178 @@ FST_MINCORE_BEGIN("./conf")
 			free(xml_string);
 		}
 		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_preprocess_cache)
+		{
+			switch_memory_pool_t *pool = NULL;
+			switch_log_level_t level = SWITCH_LOG_DEBUG;
+			switch_xml_t xml;
+			int hits, misses;
+
+			switch_core_new_memory_pool(&pool);
+			switch_mutex_init(&pp_log_mutex, SWITCH_MUTEX_NESTED, pool);
+			switch_core_session_ctl(SCSC_LOGLEVEL, &level);
+			switch_log_bind_logger(pp_logger, SWITCH_LOG_INFO, SWITCH_FALSE);
+
+			switch_dir_make_recursive(PP_TEST_DIR, SWITCH_DEFAULT_DIR_PERMS, pool);
+			pp_write(PP_TEST_CONF,
+					 "<?xml version=\"1.0\"?>\n"
+					 "<document type=\"freeswitch/xml\">\n"
+					 "  <X-pre-process cmd=\"include\" data=\"" PP_TEST_DIR "/pp_*.xml\"/>\n"
+					 "</document>\n");
+			pp_write(PP_TEST_INCLUDE,
+					 "<include>\n"
+					 "  <section name=\"a\" description=\"$${fst_pp_var}\"/>\n"
+					 "  <!--# a comment the preprocessor drops -->\n"
+					 "  <section name=\"b\" description=\"plain\"/>\n"
+					 "</include>\n");
+			switch_core_set_variable("fst_pp_var", "first");
+
+			/* nothing cached yet */
+			xml = pp_parse(&hits, &misses);
+			fst_requires(xml);
+			fst_check_int_equals(hits, 0);
+			fst_check_int_equals(misses, 2);
+			fst_check_string_equals(pp_section(xml, "a"), "first");
+			fst_check_string_equals(pp_section(xml, "b"), "plain");
+			switch_xml_free(xml);
+
+			/* replayed, verbatim lines read back from the files, the expanded one from memory */
+			xml = pp_parse(&hits, &misses);
+			fst_requires(xml);
+			fst_check_int_equals(hits, 2);
+			fst_check_int_equals(misses, 0);
+			fst_check_string_equals(pp_section(xml, "a"), "first");
+			fst_check_string_equals(pp_section(xml, "b"), "plain");
+			switch_xml_free(xml);
+
+			/* a $${var} the include used changed, only the include is expanded again */
+			switch_core_set_variable("fst_pp_var", "second");
+			xml = pp_parse(&hits, &misses);
+			fst_requires(xml);
+			fst_check_int_equals(hits, 1);
+			fst_check_int_equals(misses, 1);
+			fst_check_string_equals(pp_section(xml, "a"), "second");
+			fst_check_string_equals(pp_section(xml, "b"), "plain");
+			switch_xml_free(xml);
+
+#ifndef WIN32
+			/* same size, mtime put back to the same second, still noticed */
+			{
+				struct stat st;
+				struct utimbuf times;
+
+				fst_requires(stat(PP_TEST_INCLUDE, &st) == 0);
+				pp_write(PP_TEST_INCLUDE,
+						 "<include>\n"
+						 "  <section name=\"a\" description=\"$${fst_pp_var}\"/>\n"
+						 "  <!--# a comment the preprocessor drops -->\n"
+						 "  <section name=\"b\" description=\"PLAIN\"/>\n"
+						 "</include>\n");
+				times.actime = st.st_atime;
+				times.modtime = st.st_mtime;
+				utime(PP_TEST_INCLUDE, &times);
+
+				xml = pp_parse(&hits, &misses);
+				fst_requires(xml);
+				fst_check_int_equals(hits, 1);
+				fst_check_int_equals(misses, 1);
+				fst_check_string_equals(pp_section(xml, "b"), "PLAIN");
+				switch_xml_free(xml);
+			}
+#endif
+
+			switch_log_unbind_logger(pp_logger);
+			level = SWITCH_LOG_DISABLE;
+			switch_core_session_ctl(SCSC_LOGLEVEL, &level);
+			unlink(PP_TEST_INCLUDE);
+			unlink(PP_TEST_CONF);
+			switch_core_destroy_memory_pool(&pool);
+			pp_log_mutex = NULL;
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_locate_user_not_found)
+		{
+			switch_xml_t user = NULL;
+			switch_bool_t not_found = SWITCH_TRUE;
+			switch_status_t status;
+
+			fst_requires(switch_xml_bind_search_function(dir_search, switch_xml_parse_section_string("directory"), NULL) == SWITCH_STATUS_SUCCESS);
+
+			status = switch_xml_locate_user_merged_ex("id", "1000", "bound.test", NULL, &user, NULL, &not_found);
+			fst_check(status == SWITCH_STATUS_SUCCESS);
+			fst_check(!not_found);
+			fst_requires(user);
+			fst_check_string_equals(switch_xml_attr(user, "id"), "1000");
+			switch_xml_free(user);
+			user = NULL;
+
+			/* the domain answered and has no such user */
+			status = switch_xml_locate_user_merged_ex("id", "2000", "bound.test", NULL, &user, NULL, &not_found);
+			fst_check(status == SWITCH_STATUS_FALSE);
+			fst_check(not_found);
+
+			/* the binding gave no answer, that is a failed lookup, not a missing user */
+			status = switch_xml_locate_user_merged_ex("id", "1000", "broken.test", NULL, &user, NULL, &not_found);
+			fst_check(status == SWITCH_STATUS_FALSE);
+			fst_check(!not_found);
+
+			/* the public return value is unchanged for existing callers */
+			fst_check(switch_xml_locate_user_merged("id", "2000", "bound.test", NULL, &user, NULL) == SWITCH_STATUS_FALSE);
+
+			switch_xml_unbind_search_function_ptr(dir_search);
+		}
+		FST_TEST_END()
+
+		FST_TEST_BEGIN(test_arena_tags)
+		{
+			switch_stream_handle_t stream = { 0 };
+			switch_xml_t xml, tag, added;
+			char *xml_string = NULL;
+			int i, count = 0;
+
+			/* enough tags to need several arena blocks */
+			SWITCH_STANDARD_STREAM(stream);
+			stream.write_function(&stream, "<xml>");
+			for (i = 0; i < 5000; i++) {
+				stream.write_function(&stream, "<tag id=\"%d\"><sub>%d</sub></tag>", i, i);
+			}
+			stream.write_function(&stream, "</xml>");
+
+			xml = switch_xml_parse_str_dynamic((char *)stream.data, SWITCH_TRUE);
+			switch_safe_free(stream.data);
+			fst_requires(xml);
+
+			for (tag = switch_xml_child(xml, "tag"); tag; tag = tag->next) {
+				fst_check(tag->flags & SWITCH_XML_ARENA);
+				count++;
+			}
+			fst_check_int_equals(count, 5000);
+
+			tag = switch_xml_find_child(xml, "tag", "id", "4999");
+			fst_requires(tag);
+			fst_check_string_equals(switch_xml_child(tag, "sub")->txt, "4999");
+
+			/* parsed and added tags mix in one tree */
+			switch_xml_remove(switch_xml_find_child(xml, "tag", "id", "0"));
+			added = switch_xml_add_child_d(xml, "added", 0);
+			fst_requires(added);
+			fst_check((added->flags & SWITCH_XML_ARENA) == 0);
+			switch_xml_set_attr_d(added, "id", "new");
+
+			fst_check(switch_xml_find_child(xml, "tag", "id", "0") == NULL);
+			fst_check(switch_xml_find_child(xml, "added", "id", "new") != NULL);
+
+			xml_string = switch_xml_toxml(xml, SWITCH_FALSE);
+			fst_requires(xml_string);
+			fst_check(strstr(xml_string, "<added id=\"new\">") != NULL);
+			fst_check(strstr(xml_string, "<tag id=\"0\">") == NULL);
+			free(xml_string);
+
+			switch_xml_free(xml);
+		}
+		FST_TEST_END()
 	}
 	FST_SUITE_END()
 }